@@ -4,6 +4,7 @@
 // Datadog, Inc.
 #pragma once
 
+#include <cstddef>
 #include <span>
 #include <string>
 
@@ -11,6 +12,9 @@ namespace ddprof {
 using BuildIdSpan = std::span<const unsigned char>;
 using BuildIdStr = std::string;
 
+// Largest build id reported by the kernel in mmap events (sha1)
+inline constexpr size_t k_max_build_id_size = 20;
+
 BuildIdStr format_build_id(BuildIdSpan build_id_span);
 
 } // namespace ddprof
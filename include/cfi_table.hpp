@@ -0,0 +1,105 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#pragma once
+
+#include "ddprof_defs.hpp"
+#include "ddprof_file_info.hpp"
+#include "go_pclntab.hpp"
+#include "perf_archmap.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+using Dwfl_Module = struct Dwfl_Module;
+
+namespace ddprof {
+
+// DWARF numbers of the registers tracked by the flat CFI unwinding and perf
+// index of the registers they start from
+#ifdef __x86_64__
+inline constexpr int k_dwarf_sp_regno = 7;
+inline constexpr int k_dwarf_fp_regno = 6;
+inline constexpr int k_perf_fp_regno = REGNAME(RBP);
+// return address is not held in a register
+inline constexpr int k_perf_ra_regno = -1;
+#elif __aarch64__
+inline constexpr int k_dwarf_sp_regno = 31;
+inline constexpr int k_dwarf_fp_regno = 29;
+inline constexpr int k_perf_fp_regno = REGNAME(FP);
+inline constexpr int k_perf_ra_regno = REGNAME(LR);
+#endif
+
+// Unwinding rules of a range of instructions, restricted to the rules that
+// compilers emit for regular code: the CFA is SP or FP plus an offset, the
+// return address and FP are saved at an offset from the CFA.
+struct CfiRow {
+  enum CfaRegister : uint8_t {
+    kCfaSp,
+    kCfaFp,
+    kCfaUnsupported, // rules of the range require libdw
+  };
+  enum Rule : uint8_t {
+    kUndefined,
+    kSameValue,
+    kOffset, // saved at CFA + offset
+  };
+
+  // addresses relative to the module (without bias)
+  ElfAddress_t start;
+  ElfAddress_t end;
+  int32_t cfa_offset;
+  int32_t ra_offset;
+  int32_t fp_offset;
+  CfaRegister cfa_reg;
+  Rule ra_rule;
+  Rule fp_rule;
+};
+
+// Unwinding rules of a file, compiled from its .eh_frame section (or from
+// the frame sizes of the function table of Go binaries).
+// Each row is compiled through libdw (CIE / FDE lookup and CFA program
+// interpretation) the first time an address of its range is unwound. Later
+// lookups are a binary search in a sorted table.
+class CfiTable {
+public:
+  static constexpr size_t k_max_rows = 1 << 16;
+
+  // Rules at `pc` of `mod` loaded with `bias`. `go_pclntab` is used for
+  // addresses that .eh_frame does not cover.
+  // Returns nullptr if the rules can not be expressed as a CfiRow. The
+  // pointer is valid until the next call.
+  const CfiRow *find_or_compile(Dwfl_Module *mod, ProcessAddress_t pc,
+                                Offset_t bias,
+                                const GoPclntab *go_pclntab = nullptr);
+
+  [[nodiscard]] size_t size() const { return _rows.size(); }
+
+  // Processes unwound with the table: it is freed with the last of them
+  void add_process() { ++_nb_processes; }
+  // Returns true if no process uses the table anymore
+  bool remove_process() { return --_nb_processes == 0; }
+
+  // Compile the rules at `addr` (relative to the module)
+  static std::optional<CfiRow> compile_row(Dwfl_Module *mod,
+                                           ElfAddress_t addr, Offset_t bias);
+  // Compile the rules at `addr` from the frame size of the Go function
+  static std::optional<CfiRow> compile_go_row(const GoPclntab &go_pclntab,
+                                              ElfAddress_t addr);
+
+private:
+  // sorted by start, ranges do not overlap
+  std::vector<CfiRow> _rows;
+  uint32_t _nb_processes{0};
+};
+
+// Tables are shared by processes that map the same file
+using CfiTables = std::unordered_map<FileInfoId_t, CfiTable>;
+// Rows kept across all tables (about 16 MB)
+inline constexpr size_t k_max_cfi_tables_rows = 1 << 19;
+
+} // namespace ddprof
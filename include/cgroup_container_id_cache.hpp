@@ -0,0 +1,51 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace ddprof {
+
+// Map cgroup ids (as reported by PERF_SAMPLE_CGROUP) to container ids.
+// A cgroup id is the inode number of the cgroup directory: unknown ids are
+// resolved by walking the cgroup filesystem, which caches all cgroups found
+// on the way. Walks happen at most once per k_min_scan_interval, unknown ids
+// are not resolved in between. Ids still unknown after a walk are cached as
+// unresolved. Only unresolved entries are evicted (returned views remain
+// valid).
+class CGroupContainerIdCache {
+public:
+  static constexpr size_t k_max_entries = 16384;
+  static constexpr std::chrono::seconds k_min_scan_interval{1};
+
+  // Empty root means the perf_event cgroup hierarchy is looked up
+  explicit CGroupContainerIdCache(std::string cgroup_root = {})
+      : _cgroup_root(std::move(cgroup_root)) {}
+
+  // Returns k_container_id_unknown if cgroup was not found
+  std::string_view get(uint64_t cgroup_id);
+
+  [[nodiscard]] size_t size() const { return _container_ids.size(); }
+
+private:
+  using Map = std::unordered_map<uint64_t, std::string>;
+
+  Map::iterator resolve(uint64_t cgroup_id);
+  void scan();
+
+  std::string _cgroup_root;
+  // empty string if cgroup is not a container
+  Map _container_ids;
+  std::chrono::steady_clock::time_point _last_scan_time{};
+};
+
+} // namespace ddprof
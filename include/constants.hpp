@@ -52,6 +52,11 @@ DDPROF_CONSTREXPR const char *k_startup_wait_ms_env_variable =
 DDPROF_CONSTREXPR const char *k_allocation_profiling_follow_execs =
     "DD_PROFILING_NATIVE_ALLOCATION_PROFILING_FOLLOW_EXECS";
 
+// Env variable giving the expected number of bytes allocated per second by a
+// process, used to size its allocation ring buffer
+DDPROF_CONSTREXPR const char *k_allocation_rate_env_variable =
+    "DD_PROFILING_NATIVE_ALLOCATION_RATE";
+
 DDPROF_CONSTREXPR const char *k_libdd_profiling_name = "libdd_profiling.so";
 
 DDPROF_CONSTREXPR const char *k_libdd_profiling_embedded_name =
@@ -11,9 +11,15 @@
 
 #include <optional>
 #include <string>
+#include <string_view>
 
 namespace ddprof {
 using ContainerId = std::optional<std::string>;
+
+// Returns the container id ending a cgroup path (if any)
+std::optional<std::string_view>
+container_id_from_cgroup_path(std::string_view path);
+
 // Extract container id information
 // Expects the path to the /proc/<PID>/cgroup file
 DDRes extract_container_id(const std::string &filepath,
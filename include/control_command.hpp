@@ -0,0 +1,62 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace ddprof {
+
+// Commands accepted on the control socket (--control_socket), one line of
+// text per connection
+inline constexpr std::string_view k_control_help =
+    "help                     list commands\n"
+    "status                   list watchers with their sampling values\n"
+    "rate <watcher> <value>   set the period (or frequency) of a watcher\n"
+    "enable <watcher>         resume a disabled watcher\n"
+    "disable <watcher>        stop sampling a watcher\n"
+    "allocation_rate <bytes>  set the allocation sampling interval "
+    "(negative\n"
+    "                         for deterministic sampling)\n"
+    "export                   export the current profile now\n"
+    "dump                     export the events of the flight recorder\n"
+    "<watcher> is the position of the watcher or its name (see status).\n"
+    "Changes are applied at the next export.\n";
+
+enum class ControlCommandType : uint8_t {
+  kHelp,
+  kStatus,
+  kRate,
+  kEnable,
+  kDisable,
+  kAllocationRate,
+  kExport,
+  kDump,
+};
+
+struct ControlCommand {
+  ControlCommandType type;
+  std::string watcher{}; // empty for commands that do not target a watcher
+  int64_t value{0};
+};
+
+inline constexpr size_t k_max_control_command_size = 256;
+
+// Returns nullopt if the line is not a valid command
+std::optional<ControlCommand> parse_control_command(std::string_view line);
+
+// Read what is available on a connection of the control socket, without
+// blocking, and append it to `buffer`.
+// Returns the command once complete (up to the first new line or the end of
+// the connection), nullopt while more is expected.
+std::optional<std::string> read_control_command(int fd, std::string &buffer);
+
+// Best effort: the client might already be gone
+void write_control_reply(int fd, std::string_view reply);
+
+} // namespace ddprof
@@ -0,0 +1,49 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#pragma once
+
+#include "perf_sample_parser.hpp"
+
+#include <cstdint>
+#include <span>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+namespace ddprof {
+
+// Turns the cumulative counters read with the samples of a group leader
+// (PERF_SAMPLE_READ) into their increase since the previous sample of the same
+// event.  Events are keyed on the id of their leader, which differs per CPU.
+// Inherited events report the id of their parent: events of a thread
+// (per_thread) are also keyed on its tid.
+// The first read of an event is a baseline that reports no increase: counters
+// are cumulative since the event was enabled, which can predate the worker.
+class CounterGroupDeltas {
+public:
+  // Returns the increase of the counters that follow the leader in the group
+  // (empty if the sample did not read a group).  The span remains valid until
+  // the next call.
+  std::span<const uint64_t> update(const PerfSampleView &sample,
+                                   bool per_thread);
+
+  // Forgets the events of an exited thread
+  void thread_exit(pid_t tid);
+
+  [[nodiscard]] size_t size() const;
+
+private:
+  struct EventState {
+    uint64_t id;
+    std::vector<uint64_t> values;
+  };
+
+  // tid (-1 for events that are not per thread) -> events
+  std::unordered_map<pid_t, std::vector<EventState>> _threads;
+  std::vector<uint64_t> _deltas;
+};
+
+} // namespace ddprof
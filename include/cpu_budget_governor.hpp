@@ -0,0 +1,32 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#pragma once
+
+#include <cstdint>
+
+namespace ddprof {
+
+struct PerfWatcher;
+
+// Closed loop control of sampling rates, so that the CPU used by the profiler
+// converges to a budget.
+// The rate scale is the ratio between effective and configured sampling rates
+// (1 means configured rates are used). Profiler CPU usage is assumed to be
+// roughly proportional to the number of samples.
+inline constexpr double k_min_sampling_rate_scale = 1.0 / 64;
+
+// Compute next rate scale from the CPU used by the profiler during last cycle.
+// The scale changes by at most a factor 2 per cycle and does not change while
+// usage is within 10% below the budget.
+double cpu_budget_next_rate_scale(double rate_scale, int64_t used_millicores,
+                                  int64_t budget_millicores);
+
+// Sample period (or frequency for frequency based watchers) of `watcher` once
+// `rate_scale` is applied
+uint64_t watcher_scaled_sample_value(const PerfWatcher &watcher,
+                                     double rate_scale);
+
+} // namespace ddprof
@@ -41,6 +41,7 @@ public:
   // Profiling options
   int pid{0};
   bool global{false};
+  std::string cgroup;
   bool inlined_functions{false};
   std::chrono::seconds upload_period;
   unsigned worker_period; // worker_period
@@ -71,9 +72,15 @@ public:
   bool remote_symbolization{false};
   bool disable_symbolization{false};
   bool reorder_events{false}; // reorder events by timestamp
+  bool load_shedding{false};  // drop samples when worker lags behind
   int maximum_pids{-1};
+  int cpu_budget{0}; // millicores, 0 means no budget
+  int ring_buffer_budget{0}; // MiB, 0 means ring buffers are not resized
+  int process_ring_buffers{0}; // allocation ring buffers dedicated to a process
+  bool flight_recorder{false}; // perf events are only read on dumps
 
   std::string socket_path;
+  std::string control_socket_path; // empty means no control socket
   int pipefd_to_library{-1};
   bool continue_exec{false};
   bool timeline{true};
@@ -27,16 +27,23 @@ struct DDProfContext {
     int nice{-1};
     int num_cpu{};
     pid_t pid{0}; // ! only use for perf attach (can be -1 in global mode)
+    std::string cgroup_path; // profile members of this cgroup (pid is -1)
     uint32_t worker_period{}; // exports between worker refreshes
     int dd_profiling_fd{-1};  // opened file descriptor to our internal lib
     std::string socket_path;
+    std::string control_socket_path; // live reconfiguration (empty if none)
     UniqueFd pipefd_to_library;
     bool show_samples{false};
     bool timeline{false};
     bool remote_symbolization{false};
     bool disable_symbolization{false};
     bool reorder_events{false}; // reorder events by timestamp
+    bool load_shedding{false};  // drop samples when worker lags behind
     int maximum_pids{0};
+    int cpu_budget_millicores{0}; // adapt sampling rates to this CPU usage
+    int ring_buffer_budget_mib{0}; // resize perf ring buffers within budget
+    int process_ring_buffers{0};   // allocation ring buffers per process
+    bool flight_recorder{false};   // perf events are only read on dumps
 
     cpu_set_t cpu_affinity{};
     std::string switch_user;
@@ -47,6 +54,7 @@ struct DDProfContext {
   } params;
 
   ddprof::UniqueFd socket_fd;
+  ddprof::UniqueFd control_socket_fd;
   bool backpopulate_pid_upon_start{false};
   PerfClockSource perf_clock_source{PerfClockSource::kNoClock};
   std::vector<PerfWatcher> watchers;
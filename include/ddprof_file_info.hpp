@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include "build_id.hpp"
 #include "ddprof_defs.hpp"
 #include "ddprof_file_info-i.hpp"
 #include "hash_helper.hpp"
@@ -52,6 +53,8 @@ struct FileInfo {
   std::string _path;
   int64_t _size;
   inode_t _inode;
+  // from mmap events, empty if the kernel did not report it
+  BuildIdStr _build_id;
 };
 
 /// Keeps metadata on the file associated to a key
@@ -63,6 +66,7 @@ public:
   FileInfoId_t get_id() const { return _id; }
   int64_t get_size() const { return _info._size; }
   const std::string &get_path() const { return _info._path; }
+  const BuildIdStr &get_build_id() const { return _info._build_id; }
 
   bool errored() const { return _errored; }
   void set_errored() const { _errored = true; }
@@ -79,6 +83,8 @@ private:
 };
 
 using FileInfoInodeMap = std::unordered_map<FileInfoInodeKey, FileInfoId_t>;
+// Identical binaries share their build id across containers and inodes
+using FileInfoBuildIdMap = std::unordered_map<BuildIdStr, FileInfoId_t>;
 using FileInfoVector = std::vector<FileInfoValue>;
 
 } // namespace ddprof
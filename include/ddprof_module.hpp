@@ -38,6 +38,9 @@ struct DDProfMod {
   // The symbol bias (0 for position dependant)
   Offset_t _sym_bias{static_cast<Offset_t>(-1)};
   Status _status{kUnknown};
+  // Generation of the CFI tables the process was counted in as a user of the
+  // table of this file (0 if never counted)
+  uint32_t _cfi_tables_generation{0};
 };
 
 } // namespace ddprof
@@ -36,4 +36,7 @@ DDRes report_module(Dwfl *dwfl, ProcessAddress_t pc, const Dso &dso,
 
 std::optional<std::string> find_build_id(const char *filepath);
 
+// Go binaries are identified by their build id note
+bool has_go_build_id(Elf *elf);
+
 } // namespace ddprof
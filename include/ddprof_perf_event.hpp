@@ -5,6 +5,8 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <linux/perf_event.h>
 
 // Extend the perf event types
@@ -13,6 +15,7 @@ enum : uint16_t {
   PERF_CUSTOM_EVENT_DEALLOCATION = 1000,
   PERF_CUSTOM_EVENT_CLEAR_LIVE_ALLOCATION,
   PERF_CUSTOM_EVENT_ALLOCATION_TRACKER_STATE,
+  PERF_CUSTOM_EVENT_DEALLOCATION_BATCH,
 };
 
 static_assert(static_cast<uint32_t>(PERF_CUSTOM_EVENT_DEALLOCATION) >
@@ -28,6 +31,23 @@ struct DeallocationEvent {
   uintptr_t ptr;
 };
 
+// Deallocations of a thread, pushed in a single record
+struct DeallocationBatchEvent {
+  struct Deallocation {
+    uintptr_t ptr;
+    uint64_t time;
+  };
+  perf_event_header hdr;
+  struct sample_id sample_id; // time is the time of the oldest deallocation
+  uint64_t nb_deallocations;
+  Deallocation deallocations[];
+};
+
+inline size_t sizeof_deallocation_batch_event(size_t nb_deallocations) {
+  return sizeof(DeallocationBatchEvent) +
+      (nb_deallocations * sizeof(DeallocationBatchEvent::Deallocation));
+}
+
 // Event to notify we have tracked too many allocations
 struct ClearLiveAllocationEvent {
   perf_event_header hdr;
@@ -42,6 +62,9 @@ struct AllocationTrackerStateEvent {
   uint32_t active_shards;
   uint32_t lost_alloc_count;
   uint32_t lost_dealloc_count;
+  // tracked addresses over the slots of the library address tables
+  uint32_t address_table_load_factor_pct;
+  uint32_t address_table_max_probe_length;
 };
 
 } // namespace ddprof
@@ -10,12 +10,17 @@
 #include "ddres_def.hpp"
 #include "dwfl_wrapper.hpp"
 #include "logger.hpp"
+#include "perf_clock.hpp"
 
+#include <chrono>
+#include <deque>
 #include <limits>
 #include <memory>
+#include <string>
 #include <sys/types.h>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 namespace ddprof {
 
@@ -38,7 +43,24 @@ public:
 
   uint64_t increment_counter() { return ++_sample_counter; }
 
-  [[nodiscard]] std::string_view get_or_insert_thread_name(pid_t tid);
+  // Number of renames kept for a given thread
+  static constexpr size_t k_max_thread_name_history = 8;
+
+  // Name of thread at `timestamp` (latest name by default).
+  // Names are maintained from perf events, procfs is only read for threads
+  // that no event was received for (eg. threads started before profiling).
+  [[nodiscard]] std::string_view
+  get_or_insert_thread_name(pid_t tid, PerfClock::time_point timestamp =
+                                           PerfClock::time_point::max());
+
+  // Record a thread name change (eg. from PERF_RECORD_COMM)
+  void set_thread_name(pid_t tid, std::string_view name,
+                       PerfClock::time_point timestamp);
+
+  // Drop names of the thread set up to `until` (names set later belong to a new
+  // thread reusing the id)
+  void erase_thread_name(pid_t tid, PerfClock::time_point until =
+                                        PerfClock::time_point::max());
 
   [[nodiscard]] DwflWrapper *get_or_insert_dwfl();
   [[nodiscard]] DwflWrapper *get_dwfl();
@@ -51,7 +73,20 @@ private:
   static DDRes read_cgroup_ns(pid_t pid, std::string_view path_to_proc,
                               CGroupId_t &cgroup);
 
-  std::unordered_map<pid_t, std::string> _thread_name_map;
+  [[nodiscard]] std::string read_thread_name(pid_t tid) const;
+
+  struct ThreadName {
+    PerfClock::time_point since;
+    std::string name;
+  };
+  // sorted by `since`
+  using ThreadNameHistory = std::vector<ThreadName>;
+
+  static bool set_after(PerfClock::time_point t, const ThreadName &n) {
+    return t < n.since;
+  }
+
+  std::unordered_map<pid_t, ThreadNameHistory> _thread_name_map;
   std::unique_ptr<DwflWrapper> _dwfl_wrapper;
   ContainerId _container_id;
   pid_t _pid;
@@ -61,10 +96,16 @@ private:
 
 class ProcessHdr {
 public:
+  // Exited processes are kept for this duration so that samples still in
+  // flight in other ring buffers can be unwound
+  static constexpr std::chrono::milliseconds k_exit_grace_window{1000};
+
   explicit ProcessHdr(std::string_view path_to_proc = "")
       : _path_to_proc(path_to_proc) {}
   void flag_visited(pid_t pid);
   Process &get(pid_t pid);
+  // Returns nullptr if process is not tracked (does not flag it as visited)
+  Process *find(pid_t pid);
   const ContainerId &get_container_id(pid_t pid);
   void clear(pid_t pid) { _process_map.erase(pid); }
 
@@ -72,6 +113,23 @@ public:
   const std::unordered_set<pid_t> &get_visited() const { return _visited_pid; }
   void reset_unvisited();
 
+  // Record the exit of the thread group leader of `pid`
+  void flag_exited(pid_t pid, PerfClock::time_point exit_time);
+  // Forget a recorded exit (pid reused by a new process)
+  void cancel_exit(pid_t pid);
+  // Pids that exited before `deadline`, removed from the exited list
+  std::vector<pid_t> take_exited(PerfClock::time_point deadline);
+  size_t exited_count() const {
+    return _exited.size() + _exited_threads.size();
+  }
+
+  // Record the exit of a thread other than the group leader: its name is
+  // kept for the exit grace window, for samples still in flight
+  void flag_thread_exited(pid_t pid, pid_t tid,
+                          PerfClock::time_point exit_time);
+  // Drop names of threads that exited before `deadline`
+  void erase_exited_thread_names(PerfClock::time_point deadline);
+
   unsigned process_count() const { return _process_map.size(); }
   void display_stats() const;
 
@@ -81,6 +139,14 @@ private:
   std::unordered_set<pid_t> _visited_pid;
   using ProcessMap = std::unordered_map<pid_t, Process>;
   ProcessMap _process_map;
+  // ordered by exit time (perf events of a pid are mostly in order)
+  std::deque<std::pair<pid_t, PerfClock::time_point>> _exited;
+  struct ExitedThread {
+    pid_t pid;
+    pid_t tid;
+    PerfClock::time_point exit_time;
+  };
+  std::deque<ExitedThread> _exited_threads;
   std::string _path_to_proc;
 };
 
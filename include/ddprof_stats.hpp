@@ -18,9 +18,14 @@ namespace ddprof {
   X(EVENT_DEALLOC_LOST, "event.dealloc_lost", STAT_GAUGE)                      \
   X(EVENT_OUT_OF_ORDER, "event.out_of_order", STAT_GAUGE)                      \
   X(SAMPLE_COUNT, "sample.count", STAT_GAUGE)                                  \
+  X(SAMPLE_SHED, "sample.shed", STAT_GAUGE)                                    \
+  X(SAMPLE_COUNTED, "sample.counted", STAT_GAUGE)                              \
   X(UNMATCHED_DEALLOCATION_COUNT, "unmatched_deallocation.count", STAT_GAUGE)  \
   X(ALREADY_EXISTING_ALLOCATION_COUNT, "already_existing_allocation.count",    \
     STAT_GAUGE)                                                                \
+  X(RECONCILED_ALLOCATION_COUNT, "reconciled_allocation.count", STAT_GAUGE)    \
+  X(ADDRESS_TABLE_LOAD_FACTOR, "address_table.load_factor_pct", STAT_GAUGE)   \
+  X(ADDRESS_TABLE_MAX_PROBE, "address_table.max_probe_length", STAT_GAUGE)     \
   X(TARGET_CPU_USAGE, "target_process.cpu_usage.millicores", STAT_GAUGE)       \
   X(UNWIND_AVG_TIME, "unwind.avg_time_ns", STAT_GAUGE)                         \
   X(UNWIND_FRAMES, "unwind.frames", STAT_GAUGE)                                \
@@ -30,6 +35,8 @@ namespace ddprof {
   X(UNWIND_INCOMPLETE_STACK, "unwind.stack.incomplete", STAT_GAUGE)            \
   X(UNWIND_AVG_STACK_SIZE, "unwind.stack.avg_size", STAT_GAUGE)                \
   X(UNWIND_AVG_STACK_DEPTH, "unwind.stack.avg_depth", STAT_GAUGE)              \
+  X(UNWIND_CACHE_HITS, "unwind.cache.hits", STAT_GAUGE)                        \
+  X(UNWIND_CFI_TABLE_FALLBACKS, "unwind.cfi_table.fallbacks", STAT_GAUGE)      \
   X(UNUSED_SYMBOLS_BINARIES_COUNT, "symbols.binaries.unused.count",            \
     STAT_GAUGE)                                                                \
   X(SYMBOLS_JIT_READS, "symbols.jit.reads", STAT_GAUGE)                        \
@@ -37,12 +44,20 @@ namespace ddprof {
   X(SYMBOLS_JIT_SYMBOL_COUNT, "symbols.jit.symbol_count", STAT_GAUGE)          \
   X(PROFILER_RSS, "profiler.rss", STAT_GAUGE)                                  \
   X(PROFILER_CPU_USAGE, "profiler.cpu_usage.millicores", STAT_GAUGE)           \
+  X(SAMPLING_RATE_PCT, "profiler.sampling_rate.pct", STAT_GAUGE)               \
   X(DSO_NEW_DSO, "dso.new", STAT_GAUGE)                                        \
   X(DSO_SIZE, "dso.size", STAT_GAUGE)                                          \
   X(PPROF_SIZE, "pprof.size", STAT_GAUGE)                                      \
   X(PROFILE_DURATION, "profile.duration_ms", STAT_GAUGE)                       \
   X(AGGREGATION_AVG_TIME, "aggregation.avg_time_ns", STAT_GAUGE)               \
-  X(BACKPOPULATE_COUNT, "backpopulate.count", STAT_GAUGE)
+  X(BACKPOPULATE_COUNT, "backpopulate.count", STAT_GAUGE)                      \
+  X(PROCESS_EXIT_FREED, "process.exit_freed", STAT_GAUGE)                     \
+  X(PROCESS_EVICTED, "process.evicted", STAT_GAUGE)                            \
+  X(OFF_CPU_THREADS, "off_cpu.threads", STAT_GAUGE)                            \
+  X(RING_BUFFER_SIZE, "ring_buffer.size", STAT_GAUGE)                          \
+  X(RING_BUFFER_GROWN, "ring_buffer.grown", STAT_GAUGE)                        \
+  X(RING_BUFFER_PROCESS_LOST, "ring_buffer.process.lost", STAT_GAUGE)          \
+  X(RING_BUFFER_PROCESS_MAX_LOST, "ring_buffer.process.max_lost", STAT_GAUGE)
 
 // Expand the enum/index for the individual stats
 enum DDPROF_STATS : uint8_t { STATS_TABLE(X_ENUM) STATS_LEN };
@@ -14,6 +14,7 @@
 
 namespace ddprof {
 struct DDProfContext;
+struct LiveAddressSnapshot;
 
 DDRes ddprof_worker_init(DDProfContext &ctx,
                          PersistentWorkerState *persistent_worker_state);
@@ -23,8 +24,21 @@ DDRes ddprof_worker_maybe_export(DDProfContext &ctx,
 DDRes ddprof_worker_cycle(DDProfContext &ctx,
                           std::chrono::steady_clock::time_point now,
                           bool synchronous_export);
+// load_shedding: false for events dumped from the flight recorder, whose age
+// is not a sign of the worker lagging behind
 DDRes ddprof_worker_process_event(const perf_event_header *hdr, int watcher_pos,
-                                  DDProfContext &ctx);
+                                  DDProfContext &ctx,
+                                  bool load_shedding = true);
+// Drop live allocations whose deallocation was lost by the library
+void ddprof_worker_reconcile_live_allocations(
+    DDProfContext &ctx, const LiveAddressSnapshot &snapshot);
+// Serve the control socket without blocking: accept a connection, read its
+// command as it arrives and reply once complete. `poll_fd` is set to the fd to
+// poll next (the connection while its command is incomplete).
+DDRes ddprof_worker_control(DDProfContext &ctx, int &poll_fd);
+// Unwind the events kept in overwrite ring buffers (flight recorder) since
+// the previous dump and export them
+DDRes ddprof_worker_dump_flight_recorder(DDProfContext &ctx);
 
 // Only init unwinding elements
 DDRes worker_library_init(DDProfContext &ctx,
@@ -5,18 +5,28 @@
 
 #pragma once
 
+#include "control_command.hpp"
+#include "counter_group.hpp"
+#include "event_counts.hpp"
 #include "live_allocation.hpp"
+#include "load_shedder.hpp"
+#include "off_cpu_tracker.hpp"
 #include "pevent.hpp"
 #include "proc_status.hpp"
+#include "ring_buffer_sizer.hpp"
+#include "unique_fd.hpp"
 
 #include <array>
 #include <chrono>
+#include <string>
+#include <vector>
 
 namespace ddprof {
 
 struct DDProfExporter;
 struct DDProfPProf;
 struct PersistentWorkerState;
+class ProcessRingBuffers;
 struct UnwindState;
 struct UserTags;
 class Symbolizer;
@@ -42,8 +52,27 @@ struct DDProfWorkerContext {
   uint32_t count_worker{0}; // exports since last cache clear
   std::array<uint64_t, kMaxTypeWatcher> lost_events_per_watcher{};
   LiveAllocation live_allocation;
+  OffCpuTracker off_cpu_tracker; // threads switched out (sOFFCPU)
+  EventCounts event_counts;      // events of count-only watchers
+  CounterGroupDeltas counter_group_deltas; // counters read by group leaders
   int64_t perfclock_offset;
   PerfClock::time_point last_processed_event_timestamp;
+  LoadShedder load_shedder;
+  double sampling_rate_scale{1.0}; // effective / configured sampling rates
+  // received on the control socket, applied at next export
+  std::vector<ControlCommand> pending_control_commands;
+  // connection of the control socket whose command is being received
+  UniqueFd control_connection;
+  std::string control_command_buffer;
+  std::chrono::steady_clock::time_point control_command_deadline;
+  bool export_requested{false};
+  bool flight_recorder_dump_requested{false};
+  // usage of perf ring buffers since worker start (indexed as pevent_hdr.pes)
+  std::array<RingBufferUsage, k_max_nb_perf_event_open> ring_buffer_usage{};
+  bool ring_buffer_resize_requested{false}; // restart worker to resize
+  // allocation ring buffers dedicated to a process (null if not profiling
+  // allocations)
+  ProcessRingBuffers *process_ring_buffers{};
 };
 
 } // namespace ddprof
@@ -7,9 +7,12 @@
 
 #include "ddprof_defs.hpp"
 
+#include "build_id.hpp"
 #include "ddprof_file_info-i.hpp"
 #include "dso_type.hpp"
 
+#include <algorithm>
+#include <array>
 #include <iostream>
 #include <string>
 #include <sys/mman.h>
@@ -62,11 +65,23 @@ public:
   ProcessAddress_t end() const { return _end; }
   Offset_t offset() const { return _offset; }
 
+  BuildIdSpan build_id() const { return {_build_id.data(), _build_id_size}; }
+  void set_build_id(BuildIdSpan build_id) {
+    _build_id_size =
+        static_cast<uint8_t>(std::min(build_id.size(), _build_id.size()));
+    std::copy_n(build_id.begin(), _build_id_size, _build_id.begin());
+  }
+  // file identity: build id if both are known, inode otherwise
+  bool is_same_identity(const Dso &o) const;
+
   ProcessAddress_t _start{};
   ProcessAddress_t _end{}; // Beware, end is inclusive !
   Offset_t _offset{};      // file offset
   std::string _filename;   // path as perceived by the user
-  inode_t _inode{};
+  inode_t _inode{}; // 0 if the mmap event reported a build id instead
+  // build id reported by the mmap event (empty if unknown)
+  std::array<unsigned char, k_max_build_id_size> _build_id{};
+  uint8_t _build_id_size{};
   pid_t _pid{-1};
   uint32_t _prot{};
   mutable FileInfoId_t _id{k_file_info_error};
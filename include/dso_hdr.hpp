@@ -221,6 +221,7 @@ private:
   DsoPidMap _pid_map;
   DsoStats _stats;
   FileInfoInodeMap _file_info_inode_map;
+  FileInfoBuildIdMap _file_info_build_id_map;
   FileInfoVector _file_info_vector;
   std::string _path_to_proc; // /proc files can be mounted at various places
                              // (whole host profiling)
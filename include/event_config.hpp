@@ -132,6 +132,19 @@ enum class EventConfField : uint8_t {
    * are copied from the user application. This will define how far we can
    * unwind.
    */
+  kCountOnly,
+  /*
+   *  Events are counted per thread instead of being sampled with their stack,
+   *  so that high frequency events can be recorded at full rate.  A raw field
+   *  (`RawOffset` / `RawSize`) then splits counts per value of the field
+   *  instead of defining the value of the event.
+   */
+  kCounterGroup,
+  /*
+   *  A nonzero group number.  Events sharing a group number are opened as a
+   *  perf event group: the first one samples stacks and the others are only
+   *  counted, their values being read with each sample of the first event.
+   */
 };
 
 struct EventConf {
@@ -149,6 +162,8 @@ struct EventConf {
   uint64_t raw_offset{};
   uint32_t stack_sample_size{k_default_perf_stack_sample_size};
   double value_scale{};
+  bool count_only{};
+  uint8_t counter_group{};
 
   EventConfCadenceType cad_type{};
   int64_t cadence{};
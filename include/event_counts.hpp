@@ -0,0 +1,67 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#pragma once
+
+#include "ddprof_defs.hpp"
+#include "symbol_table.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <sys/types.h>
+#include <unordered_map>
+
+namespace ddprof {
+
+// Events of count-only watchers, aggregated per thread (and raw field value)
+// instead of being unwound one by one. Counts are reported at export.
+class EventCounts {
+public:
+  // Distinct raw values with a frame of their own, further values share an
+  // "other" frame per watcher
+  static constexpr size_t k_max_raw_symbols = 4096;
+
+  struct Key {
+    int watcher_pos;
+    pid_t pid;
+    pid_t tid;
+    uint64_t raw_value; // 0 when the watcher has no raw field
+    friend bool operator==(const Key &, const Key &) = default;
+  };
+
+  struct Value {
+    uint64_t value;
+    uint64_t count;
+  };
+
+  struct KeyHash {
+    std::size_t operator()(const Key &key) const noexcept;
+  };
+
+  using CountMap = std::unordered_map<Key, Value, KeyHash>;
+
+  void add(const Key &key, uint64_t value, uint64_t count) {
+    Value &el = _counts[key];
+    el.value += value;
+    el.count += count;
+  }
+
+  [[nodiscard]] const CountMap &counts() const { return _counts; }
+  void clear() { _counts.clear(); }
+
+  // Frame standing for the raw field value of the watcher (or for any value,
+  // once k_max_raw_symbols values have a frame)
+  SymbolIdx_t get_or_insert_raw_symbol(int watcher_pos, std::string_view label,
+                                       uint64_t raw_value,
+                                       SymbolTable &symbol_table);
+
+private:
+  CountMap _counts;
+  // symbols are kept across exports, like the symbol table
+  std::unordered_map<Key, SymbolIdx_t, KeyHash> _raw_symbols;
+};
+
+} // namespace ddprof
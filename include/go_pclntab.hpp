@@ -0,0 +1,106 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#pragma once
+
+#include "ddprof_defs.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace ddprof {
+
+// Function table of a Go binary (.gopclntab section).
+// Go binaries carry the name, file, line and stack frame size of every
+// function in this table, for the runtime to walk goroutine stacks. This
+// avoids loading the symbol table or DWARF of large statically linked
+// binaries. Tables from Go 1.16 onwards are supported.
+class GoPclntab {
+public:
+  struct Location {
+    std::string_view function;
+    std::string_view file;
+    int32_t line;
+    // address belongs to a call inlined in the function: file and line are
+    // the ones of the inlined call, not of the function
+    bool inlined;
+  };
+
+  // Stack frame of a range of instructions
+  struct Frame {
+    // range of addresses sharing this frame size
+    ElfAddress_t start;
+    ElfAddress_t end;
+    // SP adjustment since function entry (return address excluded)
+    int32_t sp_delta;
+    // outermost frame of goroutine stacks
+    bool top_frame;
+  };
+
+  // `data` is the content of the section (it should outlive the table).
+  // `text_addr` is the address of .text, used when the table does not
+  // record it.
+  static std::optional<GoPclntab> parse(std::span<const std::byte> data,
+                                        ElfAddress_t text_addr);
+
+  std::optional<Location> find_location(ElfAddress_t addr) const;
+  std::optional<Frame> find_frame(ElfAddress_t addr) const;
+
+  [[nodiscard]] uint64_t nb_functions() const { return _nb_funcs; }
+
+private:
+  enum class Version : uint8_t {
+    kGo116,
+    kGo118,
+    kGo120,
+  };
+
+  // Function metadata (runtime._func) following the entry address
+  struct FuncFields {
+    int32_t name_off;
+    int32_t args;
+    uint32_t deferreturn;
+    uint32_t pcsp;
+    uint32_t pcfile;
+    uint32_t pcln;
+    uint32_t npcdata;
+    uint32_t cu_offset;
+  };
+
+  struct Func {
+    ElfAddress_t entry;
+    ElfAddress_t end;
+    uint64_t offset; // offset of runtime._func in the table
+    FuncFields fields;
+  };
+
+  GoPclntab() = default;
+
+  bool read_func_entry(uint64_t idx, ElfAddress_t &entry,
+                       uint64_t &func_off) const;
+  std::optional<Func> find_func(ElfAddress_t addr) const;
+  // Offset of the fields following FuncFields (funcID, flag, nfuncdata)
+  uint64_t func_tail_offset(const Func &func) const;
+  // Value of the pc-value table `table_off` at `addr`, and range of
+  // addresses sharing this value
+  bool pc_value(uint32_t table_off, ElfAddress_t entry, ElfAddress_t addr,
+                int32_t &value, ElfAddress_t &start, ElfAddress_t &end) const;
+
+  std::span<const std::byte> _data;
+  Version _version{};
+  uint8_t _pc_quantum{};
+  uint64_t _nb_funcs{};
+  ElfAddress_t _text_start{};
+  uint64_t _funcname_off{};
+  uint64_t _cu_off{};
+  uint64_t _filetab_off{};
+  uint64_t _pctab_off{};
+  uint64_t _functab_off{};
+};
+
+} // namespace ddprof
@@ -0,0 +1,58 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#pragma once
+
+#include "create_elf.hpp"
+#include "ddprof_defs.hpp"
+#include "ddprof_file_info.hpp"
+#include "go_pclntab.hpp"
+#include "symbol_table.hpp"
+#include "unique_fd.hpp"
+
+#include <optional>
+#include <unordered_map>
+
+namespace ddprof {
+
+// Symbols of Go binaries, read from their function table instead of their
+// symbol table (and DWARF) through the generic symbolizer.
+class GoSymbolLookup {
+public:
+  // Returns k_symbol_idx_null if the file is not a Go binary or if its
+  // function table does not cover the address
+  SymbolIdx_t get_or_insert(const FileInfoValue &file_info,
+                            ElfAddress_t elf_addr, SymbolTable &symbol_table);
+
+  // Function table of the file (nullptr if it is not a Go binary)
+  const GoPclntab *find_pclntab(const FileInfoValue &file_info);
+
+  // Close files that were not used since the previous cycle (they are opened
+  // again on their next use)
+  void cycle();
+  // Close the file (eg. no process maps it anymore)
+  void release(FileInfoId_t file_info_id);
+
+  void stats_display() const;
+
+private:
+  struct GoFile {
+    UniqueFd fd;
+    UniqueElf elf;
+    // points into the mapping of the file
+    std::optional<GoPclntab> pclntab;
+    std::unordered_map<ElfAddress_t, SymbolIdx_t> symbols;
+    bool is_go{true}; // false if the table could not be loaded
+    bool used{false}; // used since the previous cycle
+  };
+
+  GoFile &get_or_open(const FileInfoValue &file_info);
+  // symbols found so far remain cached
+  static void close(GoFile &go_file);
+
+  std::unordered_map<FileInfoId_t, GoFile> _files;
+};
+
+} // namespace ddprof
@@ -13,8 +13,10 @@
 #include <functional>
 #include <latch>
 #include <span>
+#include <sys/socket.h>
 #include <system_error>
 #include <thread>
+#include <vector>
 
 namespace ddprof {
 
@@ -66,10 +68,20 @@ private:
 
 struct RequestMessage {
   // Request flags
-  enum : uint8_t { kProfilerInfo = 0x1 };
+  // kDedicatedRingBuffer: with kProfilerInfo, ask for a ring buffer dedicated
+  // to the requesting process. The connection must then be kept open as long
+  // as the ring buffer is in use, the profiler releases it on hangup.
+  enum : uint8_t {
+    kProfilerInfo = 0x1,
+    kLiveAddressSnapshot = 0x2,
+    kDedicatedRingBuffer = 0x4
+  };
   // request is bit mask of request flags
   uint32_t request = 0;
   pid_t pid = -1;
+  // expected number of bytes allocated per second, 0 if unknown
+  // (used to size dedicated ring buffers)
+  uint64_t allocation_rate = 0;
 };
 
 struct RingBufferInfo {
@@ -82,6 +94,7 @@ struct RingBufferInfo {
 struct ReplyMessage {
   enum : uint8_t { kLiveSum = 0x1 };
   // reply with the request flags from the request
+  // (kDedicatedRingBuffer is only set if the ring buffer is dedicated)
   uint32_t request = 0;
   // profiler pid
   int32_t pid = -1;
@@ -94,15 +107,59 @@ struct ReplyMessage {
   uint32_t stack_sample_size = 0;
 };
 
+// Addresses tracked by the allocation tracker of the requesting process.
+// Sent after a RequestMessage with the kLiveAddressSnapshot flag, as a
+// sequence of chunks terminated by a chunk with `last` set. There is no reply.
+struct LiveAddressChunk {
+  static constexpr size_t k_max_addresses = 510;
+  // perf clock time at which the library started collecting addresses
+  uint64_t timestamp = 0;
+  uint32_t nb_addresses = 0;
+  uint32_t last = 0;
+  uintptr_t addresses[k_max_addresses];
+};
+
+struct LiveAddressSnapshot {
+  pid_t pid = -1;
+  uint64_t timestamp = 0;
+  std::vector<uintptr_t> addresses; // sorted
+};
+
+using LiveAddressSnapshotCallback =
+    std::function<void(LiveAddressSnapshot &&snapshot)>;
+
+// Called from the server thread to manage ring buffers dedicated to a process
+struct DedicatedRingBufferCallbacks {
+  // Fill `info` with a new ring buffer for `pid` and return its id, or 0 to
+  // fall back to the shared ring buffer. File descriptors in `info` remain
+  // owned by the callee.
+  std::function<uint64_t(pid_t pid, uint64_t allocation_rate,
+                         RingBufferInfo &info)>
+      create;
+  // The connection of the process using ring buffer `id` was closed
+  std::function<void(uint64_t id)> release;
+};
+
 DDRes send(const UnixSocket &socket, const RequestMessage &msg);
 DDRes send(const UnixSocket &socket, const ReplyMessage &msg);
+DDRes send(const UnixSocket &socket, const LiveAddressChunk &chunk);
 DDRes receive(const UnixSocket &socket, RequestMessage &msg);
 DDRes receive(const UnixSocket &socket, ReplyMessage &msg);
+DDRes receive(const UnixSocket &socket, LiveAddressChunk &chunk);
 
-UniqueFd create_server_socket(std::string_view path) noexcept;
+// `type` can be combined with SOCK_NONBLOCK
+UniqueFd create_server_socket(std::string_view path,
+                              int type = SOCK_SEQPACKET) noexcept;
 UniqueFd create_client_socket(std::string_view path) noexcept;
 DDRes get_profiler_info(UniqueFd &&socket, std::chrono::microseconds timeout,
                         ReplyMessage *reply) noexcept;
+// Same as get_profiler_info, but ask for a ring buffer dedicated to the calling
+// process. If reply->request has the kDedicatedRingBuffer flag, `socket` must
+// be kept open until the ring buffer is no longer used.
+DDRes get_profiler_info_dedicated(const UniqueFd &socket,
+                                  std::chrono::microseconds timeout,
+                                  uint64_t allocation_rate,
+                                  ReplyMessage *reply) noexcept;
 
 bool is_socket_abstract(std::string_view path) noexcept;
 
@@ -113,17 +170,32 @@ public:
   ~WorkerServer();
 
 private:
-  friend WorkerServer start_worker_server(int socket, const ReplyMessage &msg);
-
-  WorkerServer(int socket, const ReplyMessage &msg);
+  friend WorkerServer
+  start_worker_server(int socket, const ReplyMessage &msg,
+                      LiveAddressSnapshotCallback snapshot_callback,
+                      DedicatedRingBufferCallbacks ring_buffer_callbacks);
+
+  WorkerServer(int socket, const ReplyMessage &msg,
+               LiveAddressSnapshotCallback snapshot_callback,
+               DedicatedRingBufferCallbacks ring_buffer_callbacks);
   void event_loop();
+  void receive_live_address_snapshot(const UnixSocket &socket, pid_t pid);
+  // returns the id of the dedicated ring buffer sent to the client, 0 if none
+  uint64_t reply_profiler_info(const UnixSocket &socket,
+                               const RequestMessage &request);
 
   int _socket;
   std::latch _latch;
   ReplyMessage _msg;
+  LiveAddressSnapshotCallback _snapshot_callback;
+  DedicatedRingBufferCallbacks _ring_buffer_callbacks;
   std::jthread _loop_thread;
 };
 
-WorkerServer start_worker_server(int socket, const ReplyMessage &msg);
+// callbacks are called from the server thread
+WorkerServer start_worker_server(
+    int socket, const ReplyMessage &msg,
+    LiveAddressSnapshotCallback snapshot_callback = {},
+    DedicatedRingBufferCallbacks ring_buffer_callbacks = {});
 
 } // namespace ddprof
@@ -21,12 +21,17 @@ struct AddressTable {
   size_t table_size;
   size_t table_mask;
   size_t max_capacity;
+  // Number of tables of the shard, including this one
+  unsigned generation;
+  // Previous (smaller) table of the shard. It keeps the addresses inserted
+  // before the shard grew and drains as they are removed.
+  AddressTable *older;
 
   std::unique_ptr<std::atomic<uintptr_t>[]> slots;
   std::atomic<size_t> count{0};
 
-  explicit AddressTable(size_t size);
-  ~AddressTable() = default;
+  explicit AddressTable(size_t size, AddressTable *older_table = nullptr);
+  ~AddressTable();
 
   // Delete copy/move operations (non-copyable due to atomic members)
   AddressTable(const AddressTable &) = delete;
@@ -35,6 +40,53 @@ struct AddressTable {
   AddressTable &operator=(AddressTable &&) = delete;
 };
 
+// Counting Bloom filter over the tracked addresses.
+// Most frees are for addresses that were never sampled: they are rejected
+// with two counter loads, without probing the hash tables.
+// Counters saturate and a saturated counter is never decremented.
+class AddressFilter {
+public:
+  // 128 KB (L2 resident): keeps false positives low with tens of thousands of
+  // tracked addresses
+  static constexpr size_t _k_nb_counters = 131072;
+  static constexpr uint8_t _k_saturated = UINT8_MAX;
+
+  AddressFilter()
+      : _counters(std::make_unique<std::atomic<uint8_t>[]>(_k_nb_counters)) {}
+
+  // hash is the full hash of the address (see AddressBitset)
+  [[nodiscard]] bool may_contain(uint64_t hash) const {
+    return _counters[index1(hash)].load(std::memory_order_relaxed) &&
+        _counters[index2(hash)].load(std::memory_order_relaxed);
+  }
+  void add(uint64_t hash) {
+    increment(_counters[index1(hash)]);
+    increment(_counters[index2(hash)]);
+  }
+  void remove(uint64_t hash) {
+    decrement(_counters[index1(hash)]);
+    decrement(_counters[index2(hash)]);
+  }
+  void clear();
+
+private:
+  static constexpr unsigned _k_counter_bits = 17;
+  static_assert(_k_nb_counters == size_t{1} << _k_counter_bits);
+  // Use the upper bits of the hash: lower bits select the table slot
+  static size_t index1(uint64_t hash) {
+    return (hash >> 32) & (_k_nb_counters - 1);
+  }
+  // Second index from a remix of the whole hash (golden ratio multiply), so
+  // that it spans all counters and is independent from index1
+  static size_t index2(uint64_t hash) {
+    return (hash * 0x9e3779b97f4a7c15ULL) >> (64 - _k_counter_bits);
+  }
+  static void increment(std::atomic<uint8_t> &counter);
+  static void decrement(std::atomic<uint8_t> &counter);
+
+  std::unique_ptr<std::atomic<uint8_t>[]> _counters;
+};
+
 class AddressBitset {
   // Two-level sharded address tracking:
   // Level 1: Fixed redirect table mapping address ranges to tables
@@ -47,12 +99,26 @@ public:
   // Chunk size: 128MB per chunk (matches typical glibc arena spacing)
   static constexpr uintptr_t _k_chunk_shift = 27; // log2(128MB)
   static constexpr size_t _k_max_chunks = 128;
-  // Max memory: 128 chunks × 32K slots × 8 bytes = 32 MB
+  // Initial memory: 128 chunks × 32K slots × 8 bytes = 32 MB
   constexpr static size_t _k_default_table_size = 32768;
 
   // Maximum probe distance before giving up
   constexpr static size_t _k_max_probe_distance = 64;
 
+  // A full shard grows by chaining a table twice as large in front of its
+  // current table: no rehash, no global pause.
+  constexpr static size_t _k_max_table_size = size_t{1} << 21;
+  constexpr static unsigned _k_max_generations = 8;
+  // Bound on the slots of all tables: 16M slots × 8 bytes = 128 MB
+  constexpr static size_t _k_max_total_slots = size_t{1} << 24;
+
+  struct Stats {
+    size_t count;            // tracked addresses
+    size_t capacity;         // slots of all tables
+    size_t max_probe_length; // longest probe sequence of an insertion
+    size_t nb_growths;       // tables added to full shards
+  };
+
   explicit AddressBitset(size_t table_size = 0) { init(table_size); }
   AddressBitset(AddressBitset &&other) noexcept;
   AddressBitset &operator=(AddressBitset &&other) noexcept;
@@ -70,8 +136,14 @@ public:
   bool add(uintptr_t addr, bool is_large_alloc = false);
   // returns true if the element was removed
   bool remove(uintptr_t addr, bool is_large_alloc = false);
+  [[nodiscard]] bool contains(uintptr_t addr,
+                              bool is_large_alloc = false) const;
   void clear();
 
+  // Call func on each tracked address (both small and large allocations).
+  // Concurrent insertions / removals may or may not be visited.
+  template <typename Func> void for_each(Func &&func) const;
+
   // Get approximate count (for stats/reporting only, not for capacity checks)
   // Aggregates counts from all active tables
   [[nodiscard]] int count() const;
@@ -79,6 +151,8 @@ public:
   // Get number of active shards (for stats/reporting)
   [[nodiscard]] int active_shards() const;
 
+  [[nodiscard]] Stats stats() const;
+
   // Initialize with given table size (can be called on default-constructed
   // object)
   void init(size_t table_size);
@@ -94,8 +168,20 @@ private:
   // Avoids excessive sharding for large, scattered allocations
   std::unique_ptr<std::atomic<AddressTable *>> _large_alloc_table;
 
+  // Fast rejection of untracked addresses, shared by all tables
+  AddressFilter _filter;
+
+  std::atomic<size_t> _total_slots{0};
+  std::atomic<size_t> _max_probe_length{0};
+  std::atomic<size_t> _nb_growths{0};
+
+  enum class InsertResult : uint8_t { kInserted, kAlreadyTracked, kFull };
+
   void move_from(AddressBitset &other) noexcept;
 
+  std::atomic<AddressTable *> *get_shard(uintptr_t addr,
+                                         bool is_large_alloc) const;
+
   // Get or create table for address. Chunk selection uses the address directly
   // to keep nearby addresses in the same shard.
   // is_large_alloc: if true, returns the dedicated large allocation table
@@ -104,6 +190,20 @@ private:
   //                    remove)
   AddressTable *get_table(uintptr_t addr, bool is_large_alloc,
                           bool create_if_missing);
+  [[nodiscard]] AddressTable *find_table(uintptr_t addr,
+                                         bool is_large_alloc) const;
+  // Install a larger table in front of table. Returns the current table of
+  // the shard, or nullptr if the shard can not grow.
+  AddressTable *grow(std::atomic<AddressTable *> &shard, AddressTable *table);
+  AddressTable *new_table(size_t size, AddressTable *older);
+
+  InsertResult insert(AddressTable &table, uintptr_t addr, uint64_t hash);
+  static bool remove_from(AddressTable &table, uintptr_t addr, uint64_t hash);
+  static bool find_in(const AddressTable &table, uintptr_t addr,
+                      uint64_t hash);
+
+  template <typename Func>
+  static void for_each_in_table(const AddressTable *table, Func &func);
 
   static constexpr uint64_t _k_hash_multiplier_1 =
       0x9E3779B97F4A7C15ULL; // Golden ratio * 2^64
@@ -125,4 +225,30 @@ private:
     return static_cast<uint32_t>(hash) & table_mask;
   }
 };
+
+template <typename Func>
+void AddressBitset::for_each_in_table(const AddressTable *table, Func &func) {
+  for (; table; table = table->older) {
+    for (size_t i = 0; i < table->table_size; ++i) {
+      uintptr_t const addr = table->slots[i].load(std::memory_order_acquire);
+      if (addr != AddressTable::_empty_slot &&
+          addr != AddressTable::_deleted_slot) {
+        func(addr);
+      }
+    }
+  }
+}
+
+template <typename Func> void AddressBitset::for_each(Func &&func) const {
+  if (_chunk_tables) {
+    for (size_t i = 0; i < _k_max_chunks; ++i) {
+      for_each_in_table(_chunk_tables[i].load(std::memory_order_acquire),
+                        func);
+    }
+  }
+  if (_large_alloc_table) {
+    for_each_in_table(_large_alloc_table->load(std::memory_order_acquire),
+                      func);
+  }
+}
 } // namespace ddprof
@@ -12,10 +12,15 @@
 #include "pevent.hpp"
 #include "unlikely.hpp"
 
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <cstddef>
 #include <functional>
 #include <mutex>
+#include <pthread.h>
+#include <string>
+#include <string_view>
 
 namespace ddprof {
 
@@ -32,9 +37,20 @@ public:
 
   enum AllocationTrackingFlags : uint8_t {
     kTrackDeallocations = 0x1,
-    kDeterministicSampling = 0x2
+    kDeterministicSampling = 0x2,
+    // Stage deallocations per thread and push them in batches
+    kBatchDeallocations = 0x4,
   };
 
+  // Staged deallocations are pushed once the batch is full or once its oldest
+  // entry is older than this: on the next free of the thread or, for an idle
+  // thread, from the hooks of any other thread
+  static constexpr std::chrono::milliseconds k_max_dealloc_batch_age{10};
+  static constexpr uint8_t k_dealloc_batch_size = 8;
+  // Threads staging deallocations at the same time. Threads that find no
+  // free batch push their deallocations one by one.
+  static constexpr size_t k_max_dealloc_batches = 256;
+
   struct IntervalTimerCheck {
     [[nodiscard]] bool is_set() const {
       return callback && (initial_delay.count() > 0 || interval.count() > 0);
@@ -48,15 +64,20 @@ public:
   static constexpr uint32_t k_max_consecutive_failures{5};
 
   static void notify_thread_start();
+  static void notify_thread_exit();
+  static void notify_fork_prepare();
   static void notify_fork();
   static void notify_pthread_getattr_np();
   static void notify_pthread_getattr_np_end();
 
+  // socket_path: profiler socket, used to send snapshots of tracked
+  // addresses when deallocation events were lost
   static DDRes allocation_tracking_init(uint64_t allocation_profiling_rate,
                                         uint32_t flags,
                                         uint32_t stack_sample_size,
                                         const RingBufferInfo &ring_buffer,
-                                        const IntervalTimerCheck &timer_check);
+                                        const IntervalTimerCheck &timer_check,
+                                        std::string_view socket_path = {});
   static void allocation_tracking_free();
 
   static inline DDPROF_NO_SANITIZER_ADDRESS void
@@ -98,6 +119,39 @@ private:
     std::atomic<uint32_t> address_conflict_count;
     std::atomic<pid_t> pid; // lazy cache of pid (0 is un-init value)
     std::atomic<PerfClock::time_point> next_check_time;
+    std::atomic<PerfClock::time_point> next_dealloc_flush_time;
+  };
+
+  // Deallocations that could not be pushed to the ring buffer.
+  // The free path never waits for room in the ring buffer: lost deallocations
+  // are stored here and replayed from update_timer. If an entry cannot be
+  // stored, a snapshot of the tracked addresses is sent to the profiler
+  // instead so that it can reconcile its view of the live heap.
+  struct LostFreeLog {
+    static constexpr size_t k_capacity = 1024;
+    static constexpr size_t k_max_probes = 8;
+    // low bit of the address is used to flag large allocations
+    static constexpr uintptr_t k_large_alloc_flag = 1;
+
+    std::array<std::atomic<uintptr_t>, k_capacity> entries;
+    std::atomic<uint32_t> cursor;
+    std::atomic<bool> overflow;
+  };
+
+  // Deallocations staged by a thread. Batches live in the tracker rather than
+  // in thread local storage so that other threads can push the batches of
+  // idle threads. busy is held by the thread staging into or pushing the
+  // batch.
+  struct DeallocBatch {
+    struct Entry {
+      uintptr_t addr;
+      int64_t time; // PerfClock time of the deallocation
+    };
+    std::atomic<pid_t> owner{0}; // tid of the owning thread, 0 if free
+    std::atomic<bool> busy{false};
+    std::atomic<uint8_t> nb_deallocs{0};
+    uint8_t large_allocs{0}; // bit i set if entry i is a large alloc
+    std::array<Entry, k_dealloc_batch_size> entries{};
   };
   // NOLINTEND(misc-non-private-member-variables-in-classes)
 
@@ -106,9 +160,10 @@ private:
   uint64_t next_sample_interval(std::minstd_rand &gen) const;
 
   DDRes init(uint64_t mem_profile_interval, bool deterministic_sampling,
-             bool track_deallocations, uint32_t stack_sample_size,
-             const RingBufferInfo &ring_buffer,
-             const IntervalTimerCheck &timer_check);
+             bool track_deallocations, bool batch_deallocations,
+             uint32_t stack_sample_size, const RingBufferInfo &ring_buffer,
+             const IntervalTimerCheck &timer_check,
+             std::string_view socket_path);
   void free();
 
   void track_allocation(uintptr_t addr, size_t size,
@@ -124,7 +179,48 @@ private:
                          TrackerThreadLocalState &tl_state,
                          bool &notify_needed);
 
-  DDRes push_dealloc_sample(uintptr_t addr, TrackerThreadLocalState &tl_state);
+  DDRes push_dealloc_sample(uintptr_t addr, TrackerThreadLocalState &tl_state,
+                            bool is_large_alloc);
+
+  // Stage the deallocation in the batch of the thread, push the batch if
+  // needed
+  DDRes stage_dealloc_sample(uintptr_t addr, TrackerThreadLocalState &tl_state,
+                             bool is_large_alloc);
+
+  // Returns the batch of the thread with busy held, null if the thread has
+  // no batch (claims one if claim is true) or if another thread pushes it
+  DeallocBatch *lock_dealloc_batch(TrackerThreadLocalState &tl_state,
+                                   bool claim);
+  static void unlock_dealloc_batch(DeallocBatch &batch);
+
+  DDRes push_thread_dealloc_batch(TrackerThreadLocalState &tl_state);
+
+  // batch must be locked
+  DDRes push_dealloc_batch(DeallocBatch &batch);
+
+  // Push the stale batches of all threads
+  void push_stale_dealloc_batches(PerfClock::time_point now);
+
+  static bool dealloc_batch_is_stale(int64_t oldest_time,
+                                     PerfClock::time_point now);
+
+  // Flush the staged deallocations of the current thread
+  static void flush_current_thread_deallocs();
+
+  // returns false if the lost free log is full
+  bool log_lost_free(uintptr_t addr, bool is_large_alloc);
+
+  void replay_lost_frees();
+
+  // Live address snapshots are sent from a dedicated thread: they involve
+  // blocking socket I/O that must not run from the allocation hooks.
+  // Returns true if the snapshot thread must be started by the caller.
+  bool request_live_address_snapshot();
+  void start_snapshot_thread();
+  void stop_snapshot_thread();
+  static void *snapshot_thread_main(void *arg);
+
+  DDRes push_live_address_snapshot();
 
   DDRes push_clear_live_allocation(TrackerThreadLocalState &tl_state);
 
@@ -137,15 +233,29 @@ private:
 
   DDPROF_NOINLINE void update_timer(PerfClock::time_point now);
 
+  void update_sampling_interval();
+
   TrackerState _state;
-  uint64_t _sampling_interval;
+  // can be updated by the profiler through the ring buffer metadata page
+  std::atomic<uint64_t> _sampling_interval;
   uint32_t _stack_sample_size;
   PEvent _pevent;
   bool _deterministic_sampling;
+  bool _batch_deallocations;
   size_t _high_priority_area_size;
 
   AddressBitset _allocated_address_set;
+  LostFreeLog _lost_free_log;
+  std::array<DeallocBatch, k_max_dealloc_batches> _dealloc_batches;
   IntervalTimerCheck _interval_timer_check;
+  std::string _socket_path;
+
+  enum SnapshotRequest : uint32_t { kSnapshotIdle, kSnapshotPending, kStop };
+  std::atomic<uint32_t> _snapshot_request{kSnapshotIdle};
+  // pid of the process that owns the snapshot thread (guarded by mutex),
+  // the thread does not survive a fork
+  pid_t _snapshot_thread_pid{0};
+  pthread_t _snapshot_thread{};
 
   static std::atomic<AllocationTracker *> _instance;
 };
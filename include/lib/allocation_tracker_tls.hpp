@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <random>
 #include <span>
@@ -36,6 +37,14 @@ struct TrackerThreadLocalState {
   // Set to true by placement new in init_tl_state().
   // Zero-initialized (false) in a fresh thread's TLS before init.
   bool initialized{true};
+
+  // Index + 1 of the batch holding the deallocations staged by this thread
+  // (see AllocationTracker::DeallocBatch), 0 if none was claimed yet
+  static constexpr uint16_t k_no_dealloc_batch = UINT16_MAX; // none left
+  uint16_t dealloc_batch{0};
+  // PerfClock time of the oldest deallocation staged by this thread, 0 if
+  // none. Outdated when another thread pushed the batch.
+  int64_t dealloc_batch_time{0};
 };
 
 } // namespace ddprof
@@ -7,10 +7,12 @@
 
 #include "ddprof_defs.hpp"
 #include "logger.hpp"
+#include "perf_clock.hpp"
 #include "unlikely.hpp"
 #include "unwind_output_hash.hpp"
 
 #include <cstddef>
+#include <span>
 #include <sys/types.h>
 #include <unordered_map>
 
@@ -40,6 +42,7 @@ public:
   struct ValuePerAddress {
     int64_t _value = 0;
     PprofStacks::value_type *_unique_stack = nullptr;
+    PerfClock::time_point _timestamp; // time of the allocation event
   };
 
   using AddressMap = std::unordered_map<uintptr_t, ValuePerAddress>;
@@ -80,22 +83,35 @@ public:
   // instead of a stack, we would have a total size for this unique stack trace
   // and a count.
   void register_allocation(const UnwindOutput &uo, uintptr_t addr, size_t size,
-                           int watcher_pos, pid_t pid) {
+                           int watcher_pos, pid_t pid,
+                           PerfClock::time_point timestamp = {}) {
     PidMap &pid_map = access_resize(_watcher_vector, watcher_pos);
     PidStacks &pid_stacks = pid_map[pid];
-    register_allocation(uo, addr, size, pid_stacks._unique_stacks,
+    register_allocation(uo, addr, size, timestamp, pid_stacks._unique_stacks,
                         pid_stacks._address_map);
   }
 
-  void register_deallocation(uintptr_t addr, int watcher_pos, pid_t pid) {
+  // A deallocation older than the allocation registered at the same address
+  // is stale (deallocation replayed by the library after a reuse of the
+  // address) and is ignored.
+  void register_deallocation(uintptr_t addr, int watcher_pos, pid_t pid,
+                             PerfClock::time_point timestamp = {}) {
     PidMap &pid_map = access_resize(_watcher_vector, watcher_pos);
     PidStacks &pid_stacks = pid_map[pid];
-    if (!register_deallocation(addr, pid_stacks._unique_stacks,
+    if (!register_deallocation(addr, timestamp, pid_stacks._unique_stacks,
                                pid_stacks._address_map)) {
       ++_stats._unmatched_deallocations;
     }
   }
 
+  // Remove allocations registered before snapshot_time that are no longer
+  // tracked by the library (their deallocation events were lost).
+  // sorted_addresses are the addresses tracked by the library at
+  // snapshot_time. Returns the number of allocations removed.
+  size_t reconcile(int watcher_pos, pid_t pid,
+                   std::span<const uintptr_t> sorted_addresses,
+                   PerfClock::time_point snapshot_time);
+
   void clear_pid_for_watcher(int watcher_pos, pid_t pid) {
     PidMap &pid_map = access_resize(_watcher_vector, watcher_pos);
     pid_map.erase(pid);
@@ -115,20 +131,29 @@ public:
     return _stats._already_existing_allocations;
   }
 
+  [[nodiscard]] unsigned get_nb_reconciled_allocations() const {
+    return _stats._reconciled_allocations;
+  }
+
   void cycle() { _stats = {}; }
 
 private:
   // returns true if the deallocation was registered
-  static bool register_deallocation(uintptr_t address, PprofStacks &stacks,
+  static bool register_deallocation(uintptr_t address,
+                                    PerfClock::time_point timestamp,
+                                    PprofStacks &stacks,
                                     AddressMap &address_map);
 
+  static void remove_from_stack(const ValuePerAddress &v, PprofStacks &stacks);
+
   // returns true if the allocation was registerd
   bool register_allocation(const UnwindOutput &uo, uintptr_t address,
-                           int64_t value, PprofStacks &stacks,
-                           AddressMap &address_map);
+                           int64_t value, PerfClock::time_point timestamp,
+                           PprofStacks &stacks, AddressMap &address_map);
   struct {
     unsigned _unmatched_deallocations = {};
     unsigned _already_existing_allocations = {};
+    unsigned _reconciled_allocations = {};
   } _stats;
 };
 
@@ -0,0 +1,60 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#pragma once
+
+#include "perf_clock.hpp"
+#include "prng.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+
+namespace ddprof {
+
+// Chooses which samples are dropped when the worker cannot keep up, instead
+// of letting the kernel drop events.
+// Pressure is assessed from ring buffer fill level and event age (delay
+// between the event timestamp and its processing). Under pressure, samples
+// are kept with probability 2^-keep_shift and kept samples are weighted by
+// 2^keep_shift, so that aggregated values remain unbiased.
+class LoadShedder {
+public:
+  static constexpr double k_high_fill_ratio = 0.5;
+  static constexpr double k_low_fill_ratio = 0.1;
+  static constexpr std::chrono::milliseconds k_max_event_age{500};
+  static constexpr int k_max_keep_shift = 6; // keep at least 1/64 samples
+
+  explicit LoadShedder(uint64_t seed = std::random_device{}()) : _rng(seed) {}
+
+  // Called once per processing round with the highest ring buffer fill ratio
+  // and the current time (PerfClock epoch if no perf clock is available)
+  void update(double fill_ratio, PerfClock::time_point now);
+
+  // Returns 0 if sample should be skipped, otherwise the sample weight
+  uint32_t sample_weight(PerfClock::time_point timestamp) {
+    if (timestamp < _now && _now - timestamp > _max_age) {
+      _max_age = _now - timestamp;
+    }
+    if (!_keep_shift) {
+      return 1;
+    }
+    uint64_t const mask = (1ULL << _keep_shift) - 1;
+    if (_rng() & mask) {
+      return 0;
+    }
+    return 1U << _keep_shift;
+  }
+
+  [[nodiscard]] int keep_shift() const { return _keep_shift; }
+
+private:
+  xoshiro256ss _rng;
+  int _keep_shift{0};
+  PerfClock::time_point _now{};
+  PerfClock::duration _max_age{};
+};
+
+} // namespace ddprof
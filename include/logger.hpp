@@ -99,6 +99,17 @@ void LOG_setratelimit(uint64_t max_log_per_interval,
 
 bool LOG_is_logging_enabled_for_level(int level);
 
+// Asynchronous mode: messages are queued in per-thread rings and written by a
+// background thread, which coalesces identical consecutive messages. The
+// thread only wakes up when messages are queued.
+// When a ring is full, messages are written synchronously unless
+// `drop_when_full` is set (callers that must not block, eg. allocation hooks).
+// Forked children fall back to synchronous logging.
+bool LOG_set_async(bool async, bool drop_when_full = false);
+
+// Write messages queued in asynchronous mode
+void LOG_flush();
+
 using LogsAllowedCallback = std::function<bool()>;
 
 // Allow to inject a function used by logger to check if logs are allowed
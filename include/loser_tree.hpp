@@ -0,0 +1,132 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace ddprof {
+
+// Tournament tree of losers used to merge k sorted sources.
+// Each source exposes a single key (its current head). Exhausted sources hold
+// the sentinel key, which must not compare less than any valid key.
+// Ties are broken on source index, which makes the merge deterministic.
+//
+// Internal node `n` stores the source that lost the match played at `n`, the
+// overall winner is kept aside. The best non-winning source (runner-up) is
+// always one of the losers stored on the winner's path, it is cached so that
+// updating the winner with a key that still beats the runner-up is O(1): the
+// tree is only replayed (O(log k)) when the winning source changes.
+//
+// Only the winner can be updated in place (`update_top`). Other sources are
+// updated in batch through `set_key` followed by `rebuild` (O(k)).
+// All memory is allocated at construction.
+template <typename Key, typename Compare = std::less<Key>> class LoserTree {
+public:
+  static constexpr uint32_t k_min_capacity = 2;
+
+  LoserTree(size_t nb_sources, Key sentinel, Compare comp = Compare{})
+      : _nb_sources(nb_sources), _comp(std::move(comp)),
+        _capacity(std::bit_ceil(std::max<size_t>(nb_sources, k_min_capacity))),
+        _keys(_capacity, sentinel), _losers(_capacity), _winners(_capacity) {
+    rebuild();
+  }
+
+  [[nodiscard]] size_t size() const { return _nb_sources; }
+
+  // Source currently holding the smallest key
+  [[nodiscard]] size_t top() const { return _winner; }
+  [[nodiscard]] const Key &top_key() const { return _keys[_winner]; }
+
+  [[nodiscard]] const Key &key(size_t source) const { return _keys[source]; }
+
+  // Replace key of the winning source (eg. after consuming its head)
+  void update_top(Key key) {
+    _keys[_winner] = std::move(key);
+    if (!less(_runner_up, _winner)) {
+      // winner still beats every other source: tree is unchanged
+      return;
+    }
+    replay(_winner);
+    update_runner_up();
+  }
+
+  // Set key of any source, tree is invalid until `rebuild` is called
+  void set_key(size_t source, Key key) {
+    assert(source < _nb_sources);
+    _keys[source] = std::move(key);
+  }
+
+  void rebuild() {
+    // winners of each sub-tree, computed bottom-up
+    for (size_t node = _capacity - 1; node > 0; --node) {
+      auto child_winner = [&](size_t child) -> uint32_t {
+        return child >= _capacity ? child - _capacity : _winners[child];
+      };
+      uint32_t const left = child_winner(2 * node);
+      uint32_t const right = child_winner((2 * node) + 1);
+      if (less(right, left)) {
+        _winners[node] = right;
+        _losers[node] = left;
+      } else {
+        _winners[node] = left;
+        _losers[node] = right;
+      }
+    }
+    _winner = _winners[1];
+    update_runner_up();
+  }
+
+private:
+  [[nodiscard]] bool less(size_t lhs, size_t rhs) const {
+    if (_comp(_keys[lhs], _keys[rhs])) {
+      return true;
+    }
+    if (_comp(_keys[rhs], _keys[lhs])) {
+      return false;
+    }
+    return lhs < rhs;
+  }
+
+  // Play matches from leaf of `source` to the root
+  void replay(size_t source) {
+    auto cur = static_cast<uint32_t>(source);
+    for (size_t node = (source + _capacity) / 2; node > 0; node /= 2) {
+      if (less(_losers[node], cur)) {
+        std::swap(_losers[node], cur);
+      }
+    }
+    _winner = cur;
+  }
+
+  // Runner-up only lost against the winner, hence is on the winner's path
+  void update_runner_up() {
+    size_t node = (_winner + _capacity) / 2;
+    _runner_up = _losers[node];
+    for (node /= 2; node > 0; node /= 2) {
+      if (less(_losers[node], _runner_up)) {
+        _runner_up = _losers[node];
+      }
+    }
+  }
+
+  size_t _nb_sources;
+  Compare _comp;
+  size_t _capacity; // number of leaves (power of two)
+  std::vector<Key> _keys;
+  std::vector<uint32_t> _losers;
+  std::vector<uint32_t> _winners; // scratch space for rebuild
+  size_t _winner{0};
+  size_t _runner_up{0};
+};
+
+} // namespace ddprof
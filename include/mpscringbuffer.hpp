@@ -91,6 +91,8 @@ struct MPSCRingBufferMetaDataPage {
   uint16_t time_shift;
   uint8_t perf_clock_source;
   bool tsc_available;
+  // Allocation sampling interval requested by the profiler (0 if unset)
+  uint64_t sampling_interval;
 };
 
 } // namespace ddprof
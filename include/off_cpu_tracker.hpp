@@ -0,0 +1,53 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#pragma once
+
+#include "perf_clock.hpp"
+#include "unwind_output.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <sys/types.h>
+#include <unordered_map>
+
+namespace ddprof {
+
+// Pairs the switch out of a thread (sampled with its stack) with its next
+// switch in, to report the time the thread spent off CPU with the stack it
+// was blocked in.
+// A single entry is kept per thread and reused across switches, so that no
+// allocation happens once the stacks of a thread were seen.
+class OffCpuTracker {
+public:
+  struct OffCpuSample {
+    const UnwindOutput *output;
+    std::chrono::nanoseconds off_cpu_time;
+    uint64_t scale; // number of switches represented by the sample
+  };
+
+  void switch_out(const UnwindOutput &output, PerfClock::time_point time,
+                  uint64_t scale);
+
+  // Returns a null output if the switch out of the thread was not sampled.
+  // The output remains valid until the next call for the same thread.
+  OffCpuSample switch_in(pid_t tid, PerfClock::time_point time);
+
+  void clear_tid(pid_t tid) { _threads.erase(tid); }
+  void clear_pid(pid_t pid);
+
+  [[nodiscard]] size_t size() const { return _threads.size(); }
+
+private:
+  struct ThreadState {
+    UnwindOutput output;
+    PerfClock::time_point switch_out_time;
+    uint64_t scale{0}; // 0 while the thread is on CPU
+  };
+
+  std::unordered_map<pid_t, ThreadState> _threads;
+};
+
+} // namespace ddprof
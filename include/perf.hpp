@@ -25,11 +25,22 @@ inline constexpr int k_mpsc_buffer_size_shift{10};
 // sample frequency check
 inline constexpr std::chrono::milliseconds k_sample_default_wakeup{100};
 
-struct read_format {
-  uint64_t value;        // The value of the event
-  uint64_t time_enabled; // if PERF_FORMAT_TOTAL_TIME_ENABLED
-  uint64_t time_running; // if PERF_FORMAT_TOTAL_TIME_RUNNING
-  //  uint64_t id;            // if PERF_FORMAT_ID
+// PERF_RECORD_MISC_MMAP_BUILD_ID (not defined by older kernel headers)
+inline constexpr uint16_t k_perf_record_misc_mmap_build_id = 1U << 14;
+
+// Counter groups are always read with this format (see read_group_format)
+inline constexpr uint64_t k_perf_read_format =
+    PERF_FORMAT_GROUP | PERF_FORMAT_ID;
+
+// PERF_SAMPLE_READ content with k_perf_read_format: the leader comes first,
+// followed by the other counters in the order they were opened
+struct read_group_entry {
+  uint64_t value; // Cumulative value of the counter
+  uint64_t id;    // if PERF_FORMAT_ID
+};
+struct read_group_format {
+  uint64_t nr; // Number of counters in the group
+  struct read_group_entry values[];
 };
 
 struct sample_id {
@@ -73,10 +84,21 @@ struct perf_event_mmap2 {
   uint64_t addr;
   uint64_t len;
   uint64_t pgoff;
-  uint32_t maj;
-  uint32_t min;
-  uint64_t ino;
-  uint64_t ino_generation;
+  union {
+    struct {
+      uint32_t maj;
+      uint32_t min;
+      uint64_t ino;
+      uint64_t ino_generation;
+    };
+    // set when header.misc has k_perf_record_misc_mmap_build_id
+    struct {
+      uint8_t build_id_size;
+      uint8_t __reserved_1;
+      uint16_t __reserved_2;
+      uint8_t build_id[20];
+    };
+  };
   uint32_t prot;
   uint32_t flags;
   char filename[];
@@ -98,6 +120,20 @@ struct perf_event_lost {
   struct sample_id sample_id;
 };
 
+// header.misc has PERF_RECORD_MISC_SWITCH_OUT on switch out
+struct perf_event_switch {
+  struct perf_event_header header;
+  struct sample_id sample_id;
+};
+
+// System wide events also report the task switched to (or from)
+struct perf_event_switch_cpu_wide {
+  struct perf_event_header header;
+  uint32_t next_prev_pid;
+  uint32_t next_prev_tid;
+  struct sample_id sample_id;
+};
+
 // clang-format off
 struct perf_event_sample {
   struct      perf_event_header header;
@@ -110,7 +146,7 @@ struct perf_event_sample {
   uint64_t    stream_id;                // if PERF_SAMPLE_STREAM_ID
   uint32_t    cpu, res;                 // if PERF_SAMPLE_CPU
   uint64_t    period;                   // if PERF_SAMPLE_PERIOD
-  const struct read_format *v;          // if PERF_SAMPLE_READ
+  const struct read_group_format *read_group; // if PERF_SAMPLE_READ
   uint64_t    nr;                       // if PERF_SAMPLE_CALLCHAIN
   const uint64_t *ips;                  // if PERF_SAMPLE_CALLCHAIN
   uint32_t    size_raw;                 // if PERF_SAMPLE_RAW
@@ -144,10 +180,16 @@ struct PerfMmapRegion {
   bool mirrored;
 };
 
+// A read-only mapping puts the perf ring buffer in overwrite mode: the kernel
+// never waits for the reader and overwrites the oldest records
 PerfMmapRegion perfown_sz(int fd, size_t size_of_buffer,
-                          bool allow_single_mapping);
+                          bool allow_single_mapping, bool read_only = false);
 int perfdisown(void *region, size_t size, bool mirrored);
 long get_page_size();
+// Check if the kernel can report the cgroup of sampled tasks
+bool perf_sample_cgroup_available();
+// Check if the kernel can report build ids in mmap events
+bool perf_mmap_build_id_available();
 size_t get_mask_from_size(size_t size);
 const char *perf_type_str(int type_id);
 
@@ -155,8 +197,12 @@ std::vector<perf_event_attr>
 all_perf_configs_from_watcher(const PerfWatcher *watcher, bool extras,
                               PerfClockSource perf_clock_source);
 
+// Config of a member of the counter group of `leader_attr`
+perf_event_attr perf_config_group_member(const PerfWatcher *watcher,
+                                         const perf_event_attr &leader_attr);
+
 uint64_t perf_value_from_sample(const PerfWatcher *watcher,
-                                const perf_event_sample *sample);
+                                const PerfSampleView &sample);
 
 perf_event_attr perf_config_from_watcher(const PerfWatcher *watcher,
                                          bool extras,
@@ -38,6 +38,7 @@ struct RingBuffer {
 
   // only used for MPSCRingBuffer
   SpinLock *spinlock;
+  uint64_t *sampling_interval;
   uint64_t time_zero;
   uint32_t time_mult;
   uint16_t time_shift;
@@ -0,0 +1,113 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/perf_event.h>
+
+namespace ddprof {
+
+// Zero-copy view over a PERF_RECORD_SAMPLE.
+// Fields are read from the record memory (usually ring buffer memory), the
+// view only stores their offsets from the start of the record. An offset of 0
+// means the field is absent from the sample (offset 0 is the header).
+// The record must remain valid during the lifetime of the view.
+class PerfSampleView {
+public:
+  PerfSampleView() = default;
+  explicit PerfSampleView(const perf_event_header *hdr) : _hdr(hdr) {}
+
+  [[nodiscard]] const perf_event_header *header() const { return _hdr; }
+
+  [[nodiscard]] uint32_t pid() const { return read<uint32_t>(_tid_off); }
+  [[nodiscard]] uint32_t tid() const {
+    return read<uint32_t>(_tid_off, sizeof(uint32_t));
+  }
+  [[nodiscard]] uint64_t ip() const { return read<uint64_t>(_ip_off); }
+  [[nodiscard]] uint64_t time() const { return read<uint64_t>(_time_off); }
+  [[nodiscard]] uint64_t addr() const { return read<uint64_t>(_addr_off); }
+  [[nodiscard]] uint32_t cpu() const { return read<uint32_t>(_cpu_off); }
+  [[nodiscard]] uint64_t period() const { return read<uint64_t>(_period_off); }
+
+  // Counters of the group of the event (if PERF_SAMPLE_READ), read with
+  // PERF_FORMAT_GROUP | PERF_FORMAT_ID: a {value, id} pair per counter,
+  // starting with the leader
+  [[nodiscard]] uint64_t nr_read_values() const {
+    return read<uint64_t>(_read_off);
+  }
+  [[nodiscard]] uint64_t read_value(uint64_t pos) const {
+    return read<uint64_t>(_read_off, (1 + (2 * pos)) * sizeof(uint64_t));
+  }
+  [[nodiscard]] uint64_t read_id(uint64_t pos) const {
+    return read<uint64_t>(_read_off, (2 + (2 * pos)) * sizeof(uint64_t));
+  }
+
+  [[nodiscard]] uint64_t nr() const { return read<uint64_t>(_callchain_off); }
+  [[nodiscard]] const uint64_t *ips() const {
+    return ptr<uint64_t>(_callchain_off, sizeof(uint64_t));
+  }
+
+  [[nodiscard]] uint32_t size_raw() const { return read<uint32_t>(_raw_off); }
+  [[nodiscard]] const char *data_raw() const {
+    return size_raw() ? ptr<char>(_raw_off, sizeof(uint32_t)) : nullptr;
+  }
+
+  [[nodiscard]] const uint64_t *regs() const {
+    return ptr<uint64_t>(_regs_off);
+  }
+
+  // Usable size of the captured stack (0 if inconsistent)
+  [[nodiscard]] uint64_t size_stack() const { return _size_stack; }
+  [[nodiscard]] const char *data_stack() const {
+    return ptr<char>(_stack_off);
+  }
+  // Id of the cgroup of the sampled task (0 if not requested)
+  [[nodiscard]] uint64_t cgroup() const { return read<uint64_t>(_cgroup_off); }
+
+private:
+  template <typename T>
+  friend bool parse_sample_fields(const perf_event_header *hdr, T mask,
+                                  PerfSampleView *view);
+
+  template <typename T>
+  [[nodiscard]] const T *ptr(uint16_t off, size_t shift = 0) const {
+    return off ? reinterpret_cast<const T *>(
+                     reinterpret_cast<const std::byte *>(_hdr) + off + shift)
+               : nullptr;
+  }
+
+  template <typename T>
+  [[nodiscard]] T read(uint16_t off, size_t shift = 0) const {
+    return off ? *ptr<T>(off, shift) : T{};
+  }
+
+  const perf_event_header *_hdr{nullptr};
+  uint16_t _ip_off{0};
+  uint16_t _tid_off{0};
+  uint16_t _time_off{0};
+  uint16_t _addr_off{0};
+  uint16_t _cpu_off{0};
+  uint16_t _period_off{0};
+  uint16_t _read_off{0};
+  uint16_t _callchain_off{0};
+  uint16_t _raw_off{0};
+  uint16_t _regs_off{0};
+  uint16_t _stack_off{0};
+  uint16_t _cgroup_off{0};
+  uint64_t _size_stack{0};
+};
+
+// Parse a sample record according to `sample_type` mask.
+// Returns false if sample can not be used (eg. non 64-bit register ABI).
+using PerfSampleParser = bool (*)(const perf_event_header *hdr,
+                                  uint64_t sample_type, PerfSampleView *view);
+
+// Returns a parser specialized for `sample_type` when one was generated,
+// otherwise a generic parser that checks each field at runtime.
+PerfSampleParser perf_sample_parser_from_type(uint64_t sample_type);
+
+} // namespace ddprof
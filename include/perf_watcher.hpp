@@ -7,11 +7,13 @@
 
 #include "ddprof_defs.hpp"
 #include "event_config.hpp"
+#include "perf_sample_parser.hpp"
 #include "watcher_sample_types.hpp"
 
 #include <cstdint>
 #include <linux/perf_event.h>
 #include <string>
+#include <string_view>
 
 namespace ddprof {
 
@@ -29,6 +31,9 @@ struct PerfWatcherOptions {
                              // frames belonging to libdd_profiling.so)
   uint32_t stack_sample_size{
       k_default_perf_stack_sample_size}; // size of the user stack to capture
+  bool count_only{false}; // events are counted per thread, without stacks
+  bool flight_recorder{false}; // events are kept in an overwrite ring buffer
+                               // and only read on dumps
 };
 
 struct PProfIndices {
@@ -38,6 +43,7 @@ struct PProfIndices {
 
 struct PerfWatcher {
   uint64_t sample_type; // perf sample type: specifies values included in sample
+  PerfSampleParser sample_parser{nullptr}; // set when opening perf events
   unsigned long config; // specifies which perf event is requested
   double value_scale;
   union {
@@ -75,8 +81,21 @@ struct PerfWatcher {
   bool suppress_tid;
 
   bool instrument_self; // do my own perf_event_open, etc
+
+  // Watchers sharing a nonzero counter group are opened as a perf event group:
+  // the leader (first watcher of the group) samples stacks and reads the
+  // counters of the other members with each sample
+  uint8_t counter_group{0};
+  int group_leader_pos{-1}; // set on the members that are not the leader
 };
 
+#define BASE_STYPES                                                            \
+  (PERF_SAMPLE_STACK_USER | PERF_SAMPLE_REGS_USER | PERF_SAMPLE_TID |          \
+   PERF_SAMPLE_TIME | PERF_SAMPLE_PERIOD)
+
+// PERF_SAMPLE_CGROUP (Linux 5.7) is not defined by older kernel headers
+inline constexpr uint64_t k_perf_sample_cgroup = 1ULL << 21;
+
 // Define our own event type on top of perf event types
 enum DDProfTypeId : uint8_t { kDDPROF_TYPE_CUSTOM = PERF_TYPE_MAX + 100 };
 
@@ -102,6 +121,11 @@ enum DDProfCustomCountId : uint8_t {
 
 #define SKIP_FRAMES {.nb_frames_to_skip = NB_FRAMES_TO_SKIP}
 
+// Off-CPU watcher: sched:sched_switch tracepoint (id resolved when the watcher
+// is configured)
+inline constexpr std::string_view k_off_cpu_tracepoint_group = "sched";
+inline constexpr std::string_view k_off_cpu_tracepoint_event = "sched_switch";
+
 // Whereas tracepoints are dynamically configured and can be checked at runtime,
 // we lack the ability to inspect events of type other than TYPE_TRACEPOINT.
 // Accordingly, we maintain a list of events, even though the type of these
@@ -130,6 +154,7 @@ enum DDProfCustomCountId : uint8_t {
   X(sALGN,      "Align. Faults",      PERF_TYPE_SOFTWARE,   PERF_COUNT_SW_ALIGNMENT_FAULTS,        99,           k_stype_tracepoint,    IS_FREQ)     \
   X(sEMU,       "Emu. Faults",        PERF_TYPE_SOFTWARE,   PERF_COUNT_SW_EMULATION_FAULTS,        99,           k_stype_tracepoint,    IS_FREQ)     \
   X(sDUM,       "Dummy",              PERF_TYPE_SOFTWARE,   PERF_COUNT_SW_DUMMY,                   1,            k_stype_dummy,         {})          \
+  X(sOFFCPU,    "Off-CPU Time",       PERF_TYPE_TRACEPOINT, 0,                                     1,            k_stype_off_cpu,       USE_KERNEL)  \
   X(sALLOC,     "Allocations",        kDDPROF_TYPE_CUSTOM,  kDDPROF_COUNT_ALLOCATIONS,             524288,       k_stype_alloc,         SKIP_FRAMES)
 
 // clang-format on
@@ -147,6 +172,9 @@ const PerfWatcher *ewatcher_from_str(const char *str);
 const PerfWatcher *tracepoint_default_watcher();
 bool watcher_has_tracepoint(const PerfWatcher *watcher);
 const char *event_type_name_from_idx(int idx);
+inline bool watcher_is_off_cpu(const PerfWatcher *watcher) {
+  return watcher->ddprof_event_type == DDPROF_PWE_sOFFCPU;
+}
 
 // Helper functions, mostly for tests
 uint64_t perf_event_default_sample_type();
@@ -5,6 +5,12 @@
 
 #pragma once
 
+#include "ddprof_defs.hpp"
+#include "pevent.hpp"
+#include "process_ring_buffers.hpp"
+
+#include <cstdint>
+
 namespace ddprof {
 // Workers are reset by creating new forks. This structure is shared accross
 // processes
@@ -15,6 +21,24 @@ struct PersistentWorkerState {
   // Why not volatile ? Although several threads can update the number of
   // cycles, by design Only a single thread reads and writes to this variable.
   uint32_t profile_seq;
+  // Ratio between effective and configured sampling rates (CPU budget), 0 if
+  // rates were never adjusted
+  double sampling_rate_scale;
+  // Processes using the dedicated allocation ring buffers
+  ProcessRingBuffers::Slot
+      dedicated_ring_buffers[ProcessRingBuffers::k_nb_ring_buffers];
+  uint64_t next_dedicated_ring_buffer_id;
+  // Changes received on the control socket, applied to the watchers of each
+  // new worker (perf events keep their state across workers)
+  int64_t sample_value_overrides[kMaxTypeWatcher]; // 0 if not overridden
+  bool watcher_disabled[kMaxTypeWatcher];
+  // Size orders of perf ring buffers (indexed as PEventHdr::pes) chosen by
+  // workers, applied by the main process before spawning the next worker.
+  // 0 if the ring buffer keeps its size.
+  int8_t ring_buffer_orders[k_max_nb_perf_event_open];
+  // Perf timestamp of the newest event exported by a flight recorder dump:
+  // overwrite ring buffers outlive workers, their events are exported once
+  uint64_t flight_recorder_dumped_until;
 };
 
 } // namespace ddprof
@@ -25,10 +25,14 @@ struct PEvent {
   RingBufferType ring_buffer_type = RingBufferType::kMPSCRingBuffer;
   bool custom_event = false; // true if custom event (not handled by perf, eg.
                              // memory allocations)
+  bool overwrite = false; // perf ring buffer in overwrite mode (flight
+                          // recorder), only read on dumps
   RingBuffer rb; // metadata and buffers for processing perf ringbuffer
   std::vector<int>
       sub_fds; // perf FDs of other events outputting to the same ring buffer
                // (eg. perf events for other process threads in PID mode)
+  std::vector<int> group_fds; // perf FDs of the other members of the counter
+                              // group led by `fd`
 };
 
 struct PEventHdr {
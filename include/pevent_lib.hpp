@@ -30,12 +30,36 @@ int pevent_compute_min_mmap_order(int min_buffer_size_order,
                                   unsigned min_number_samples);
 
 /// Setup watchers = setup mmap + setup perfevent
+/// In cgroup mode, `pids` holds a file descriptor of the cgroup directory.
 DDRes pevent_setup(DDProfContext &ctx, std::span<pid_t> pids, int num_cpu,
                    PEventHdr *pevent_hdr);
 
 /// Call ioctl PERF_EVENT_IOC_ENABLE on available file descriptors
 DDRes pevent_enable(PEventHdr *pevent_hdr);
 
+// Update sample period (or frequency) of events attached to watcher
+// For custom events, value is forwarded through the ring buffer metadata page
+DDRes pevent_update_sample_rate(PEventHdr *pevent_hdr, int watcher_pos,
+                                uint64_t value);
+
+// Start or stop counting the perf events attached to watcher (custom events
+// are left untouched)
+DDRes pevent_set_enabled(PEventHdr *pevent_hdr, int watcher_pos, bool enabled);
+
+// Size order of the perf ring buffers of watcher before any resize
+int pevent_initial_mmap_order(const PerfWatcher &watcher);
+
+// Stop or resume writing to the overwrite ring buffers (flight recorder) so
+// that they can be read consistently. Events are dropped while paused.
+DDRes pevent_pause_overwrite(PEventHdr *pevent_hdr, bool paused);
+
+// Remap perf ring buffers to the size orders in `orders` (0 keeps the current
+// size). Must only be called while no other process maps the ring buffers:
+// their pending events are lost. A ring buffer that can not be remapped keeps
+// its size.
+DDRes pevent_resize_ring_buffers(PEventHdr *pevent_hdr,
+                                 std::span<const int8_t> orders);
+
 /// Clean the buffers allocated by mmap
 DDRes pevent_munmap(PEventHdr *pevent_hdr);
 
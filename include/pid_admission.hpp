@@ -0,0 +1,60 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+#include <unordered_map>
+
+namespace ddprof {
+
+// Decides which processes are unwound when their number is capped
+// (maximum_pids). Processes are ranked on their recent sample weight, which
+// is halved at each cycle. Once all slots are taken, a newcomer is admitted if
+// it outweighs the least valuable admitted process (least recently sampled
+// among equals), whose unwinding state should then be released.
+class PidAdmission {
+public:
+  static constexpr pid_t k_no_pid = -1;
+  // a newcomer needs this many times the weight of the evicted process
+  static constexpr uint64_t k_eviction_weight_ratio = 2;
+
+  struct Decision {
+    bool admitted;
+    pid_t evicted; // k_no_pid if no process was evicted
+  };
+
+  // A negative maximum means no limit
+  explicit PidAdmission(int maximum_pids) : _maximum_pids(maximum_pids) {}
+
+  // Accounts for a sample of `pid`, representing `weight` samples
+  Decision add_sample(pid_t pid, uint64_t weight);
+
+  void remove(pid_t pid);
+
+  // Decays weights and forgets processes that are neither admitted nor sampled
+  void cycle();
+
+  [[nodiscard]] size_t nb_admitted() const { return _nb_admitted; }
+  [[nodiscard]] bool is_admitted(pid_t pid) const;
+
+private:
+  struct PidState {
+    uint64_t weight{0};
+    uint64_t last_sample{0}; // sequence number of the last sample
+    bool admitted{false};
+  };
+
+  std::unordered_map<pid_t, PidState>::iterator find_eviction_candidate();
+
+  std::unordered_map<pid_t, PidState> _pids;
+  size_t _nb_admitted{0};
+  uint64_t _nb_samples{0};
+  int _maximum_pids;
+};
+
+} // namespace ddprof
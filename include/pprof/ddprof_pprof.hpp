@@ -14,6 +14,7 @@
 #include "tags.hpp"
 #include "unwind_output.hpp"
 
+#include <span>
 #include <unordered_map>
 
 namespace ddprof {
@@ -21,6 +22,10 @@ namespace ddprof {
 class Symbolizer;
 struct SymbolHdr;
 
+// Upper bound on distinct ddog_prof_SampleType slots (sum + live types +
+// their count companions across all watcher kinds).
+inline constexpr int k_max_value_types = 16;
+
 struct DDProfPProf {
   /* single profile gathering several value types */
   ddog_prof_Profile _profile{};
@@ -30,10 +35,18 @@ struct DDProfPProf {
   std::unordered_map<pid_t, std::string> _pid_str;
 };
 
+// Value of another watcher reported in the same sample (counter groups)
+struct DDProfGroupValue {
+  const PerfWatcher *watcher;
+  int64_t value;
+  uint64_t count;
+};
+
 struct DDProfValuePack {
   int64_t value;
   uint64_t count;
   uint64_t timestamp;
+  std::span<const DDProfGroupValue> group_values{};
 };
 
 DDRes pprof_create_profile(DDProfPProf *pprof, DDProfContext &ctx);
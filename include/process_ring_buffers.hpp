@@ -0,0 +1,104 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#pragma once
+
+#include "perf_clock.hpp"
+#include "pevent.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <sys/types.h>
+
+namespace ddprof {
+
+struct PersistentWorkerState;
+struct RingBufferInfo;
+
+// Allocation ring buffers dedicated to a single process.
+// With a single ring buffer shared by all profiled processes, a process that
+// allocates a lot starves the others and lost events cannot be attributed.
+// Dedicated ring buffers are created along with the shared one, before
+// workers are spawned, so that they outlive worker restarts. They are
+// assigned by the worker server to processes that connect, released when the
+// process exits (PERF_RECORD_EXIT of its leader) or closes its connection,
+// and fall back to the shared ring buffer when none is available.
+// Assignments are kept in PersistentWorkerState.
+class ProcessRingBuffers {
+public:
+  // Dedicated ring buffers are only created when several processes are
+  // expected (global and cgroup modes, flagged as pid -1): elsewhere they
+  // would waste tens of megabytes.
+  static bool enabled(pid_t profiled_pid, int nb_ring_buffers) {
+    return profiled_pid == -1 && nb_ring_buffers > 0;
+  }
+
+  // Ring buffer orders relative to the order of the shared ring buffer.
+  // The first `--process_ring_buffers` ones are created: sizes are mixed so
+  // that a few ring buffers still fit small and large processes.
+  static constexpr std::array<int, 16> k_order_offsets = {
+      0, -2, 0, -2, -2, 0, 2, -2, 0, -2, 0, -2, 2, -2, 0, -2};
+  static constexpr size_t k_nb_ring_buffers = k_order_offsets.size();
+  // Ring buffers should hold samples for this duration at the allocation
+  // rate announced by the process
+  static constexpr std::chrono::milliseconds k_buffered_duration{100};
+
+  struct Slot {
+    pid_t pid;         // 0 if free
+    uint64_t id;       // assignment id
+    int64_t timestamp; // perf clock time of assignment
+    uint64_t nb_lost;  // events lost by the process
+  };
+
+  // Dedicated ring buffers are the pevents of `watcher_pos` following the
+  // shared one
+  ProcessRingBuffers(std::span<const PEvent> pevents, int watcher_pos,
+                     uint32_t stack_sample_size, uint64_t sampling_interval,
+                     PersistentWorkerState &persistent_state);
+
+  ProcessRingBuffers(const ProcessRingBuffers &) = delete;
+  ProcessRingBuffers &operator=(const ProcessRingBuffers &) = delete;
+
+  // Assign a ring buffer to `pid` and fill `info` with it.
+  // Returns the assignment id, 0 if no ring buffer is available.
+  uint64_t assign(pid_t pid, uint64_t allocation_rate, RingBufferInfo &info);
+
+  // Release assignment `id` (connection closed)
+  void release(uint64_t id);
+
+  // Release ring buffers of `pid` assigned before `exit_time`
+  void release_pid(pid_t pid, PerfClock::time_point exit_time);
+
+  // Returns the events lost by `pid` since the assignment of its ring
+  // buffer, 0 if it has none
+  uint64_t add_lost_events(pid_t pid, uint64_t nb_lost);
+
+  // Release ring buffers of processes that no longer exist (their exit might
+  // have been missed while no worker was running)
+  void release_dead_processes();
+
+  [[nodiscard]] size_t nb_assigned() const;
+
+  // Minimum order of the ring buffer of a process allocating
+  // `allocation_rate` bytes per second (0 if unknown)
+  [[nodiscard]] int ring_buffer_order(uint64_t allocation_rate) const;
+
+private:
+  void release_slot(Slot &slot);
+
+  mutable std::mutex _mutex;
+  std::span<Slot> _slots;
+  uint64_t *_next_id;
+  std::array<const PEvent *, k_nb_ring_buffers> _pevents{};
+  uint32_t _stack_sample_size;
+  uint64_t _sampling_interval;
+  // current sampling interval, updated through the shared ring buffer
+  const uint64_t *_shared_sampling_interval{nullptr};
+};
+
+} // namespace ddprof
@@ -0,0 +1,47 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+namespace ddprof {
+
+// Adaptive sizing of perf ring buffers within a memory budget.
+// Ring buffers that were seen almost full while their watcher lost events
+// grow, ring buffers that remained almost empty shrink back towards the size
+// chosen from static heuristics (pevent_compute_min_mmap_order).
+// Perf ring buffers can only be resized once no process maps them: sizes are
+// chosen by workers and applied by the main process before it spawns the
+// next worker.
+inline constexpr double k_ring_buffer_grow_fill_ratio = 0.75;
+inline constexpr double k_ring_buffer_shrink_fill_ratio = 0.125;
+inline constexpr int k_max_ring_buffer_order_increase = 4;
+
+struct RingBufferUsage {
+  double peak_fill_ratio{0};
+  bool lost_events{false}; // the watcher of the ring buffer lost events
+};
+
+struct RingBufferOrder {
+  int order;     // current size order
+  int min_order; // size order chosen from static heuristics
+};
+
+// Pages of a perf ring buffer of the given order (with its metadata page)
+constexpr size_t ring_buffer_pages(int order) {
+  return (static_cast<size_t>(1) << order) + 1;
+}
+
+// Compute the next size orders of ring buffers (one step at most), keeping
+// their total size within `budget_pages`. Ring buffers closest to overflow
+// grow first.
+// Returns true if a ring buffer grew.
+bool ring_buffer_next_orders(std::span<const RingBufferOrder> orders,
+                             std::span<const RingBufferUsage> usage,
+                             size_t budget_pages, std::span<int> next_orders);
+
+} // namespace ddprof
@@ -15,6 +15,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <mutex>
+#include <vector>
 
 namespace ddprof {
 
@@ -435,6 +436,20 @@ inline void perf_rb_advance(RingBuffer &rb) {
   __atomic_store_n(rb.reader_pos, rb.intermediate_reader_pos, __ATOMIC_RELEASE);
 }
 
+// Fraction of the ring buffer holding data not yet released by the reader
+inline double rb_fill_ratio(const RingBuffer &rb) {
+  auto head = __atomic_load_n(rb.writer_pos, __ATOMIC_ACQUIRE);
+  auto tail = __atomic_load_n(rb.reader_pos, __ATOMIC_ACQUIRE);
+  return static_cast<double>(head - tail) / static_cast<double>(rb.data_size);
+}
+
+// Copy the records of a perf ring buffer written backward in overwrite mode
+// (flight recorder) to `snapshot`. The writer must be paused.
+// Returns the offsets of the records in `snapshot`, from the oldest to the
+// newest. The oldest record is dropped if it was partially overwritten.
+std::vector<size_t> perf_rb_backward_snapshot(const RingBuffer &rb,
+                                              std::vector<std::byte> &snapshot);
+
 class MPSCRingBufferReader {
 public:
   explicit MPSCRingBufferReader(RingBuffer *rb) : _rb(rb) {
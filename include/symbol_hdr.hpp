@@ -10,6 +10,7 @@
 #include "common_symbol_lookup.hpp"
 #include "ddres_def.hpp"
 #include "dso_symbol_lookup.hpp"
+#include "go_symbol_lookup.hpp"
 #include "logger.hpp"
 #include "mapinfo_lookup.hpp"
 #include "runtime_symbol_lookup.hpp"
@@ -20,8 +21,14 @@ namespace ddprof {
 struct SymbolHdr {
   explicit SymbolHdr(std::string_view path_to_proc = "")
       : _runtime_symbol_lookup(path_to_proc) {}
-  void display_stats() const { _dso_symbol_lookup.stats_display(); }
-  void cycle() { _runtime_symbol_lookup.cycle(); }
+  void display_stats() const {
+    _dso_symbol_lookup.stats_display();
+    _go_symbol_lookup.stats_display();
+  }
+  void cycle() {
+    _runtime_symbol_lookup.cycle();
+    _go_symbol_lookup.cycle();
+  }
 
   void clear(pid_t pid) {
     _base_frame_symbol_lookup.erase(pid);
@@ -34,6 +41,7 @@ struct SymbolHdr {
   BaseFrameSymbolLookup _base_frame_symbol_lookup;
   CommonSymbolLookup _common_symbol_lookup;
   DsoSymbolLookup _dso_symbol_lookup;
+  GoSymbolLookup _go_symbol_lookup;
   RuntimeSymbolLookup _runtime_symbol_lookup;
   // Symbol table (contains the references to strings)
   SymbolTable _symbol_table;
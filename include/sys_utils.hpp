@@ -11,5 +11,9 @@ namespace ddprof {
 
 DDRes sys_perf_event_paranoid(int32_t &val);
 
+// Highest sampling frequency accepted by perf_event_open (adjusted by the
+// kernel when sampling takes too long)
+DDRes sys_perf_event_max_sample_rate(int32_t &val);
+
 DDRes sys_read_int_from_file(const char *filename, int32_t &val);
 } // namespace ddprof
@@ -6,8 +6,10 @@
 #pragma once
 
 #include "ddres_def.hpp"
+#include "perf_clock.hpp"
 
 #include <sys/types.h>
+#include <vector>
 
 namespace ddprof {
 
@@ -26,6 +28,11 @@ DDRes unwindstate_unwind(UnwindState *us);
 // Mark a cycle: garbadge collection, stats
 void unwind_cycle(UnwindState *us);
 
+// Pids whose exit grace window elapsed at `now`, their state is to be freed
+// with unwind_pid_free. Names of exited threads are dropped.
+std::vector<pid_t> unwind_take_exited_pids(UnwindState *us,
+                                           PerfClock::time_point now);
+
 // Clear unwinding structures of this pid
 void unwind_pid_free(UnwindState *us, pid_t pid);
 
@@ -0,0 +1,83 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#pragma once
+
+#include "perf_archmap.hpp"
+#include "unwind_output.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+namespace ddprof {
+
+// Memoize unwinding results of samples that share the same stack.
+// Samples taken in hot loops often have identical register-relative stacks.
+// An entry is keyed on the registers the unwinding starts from and records
+// which stack words the unwinding read, with their values. A sample matches an
+// entry when those words are identical.
+// Unwinding rules are assumed to only depend on the key registers and on the
+// stack contents. Unwinds that read other registers must not be inserted.
+class UnwindCache {
+public:
+  static constexpr size_t k_max_entries_per_pid = 1024;
+
+#ifdef __x86_64__
+  static constexpr std::array k_key_registers{REGNAME(PC), REGNAME(SP),
+                                              REGNAME(RBP)};
+#else
+  static constexpr std::array k_key_registers{REGNAME(PC), REGNAME(SP),
+                                              REGNAME(FP), REGNAME(LR)};
+#endif
+
+  // Returns the cached frames or nullptr if the sample does not match
+  const std::vector<FunLoc> *find(pid_t pid, std::span<const uint64_t> regs,
+                                  std::span<const std::byte> stack);
+
+  // `read_offsets` are the offsets (from SP) of the words read during unwind
+  void insert(pid_t pid, std::span<const uint64_t> regs,
+              std::span<const std::byte> stack,
+              std::span<const uint32_t> read_offsets,
+              std::span<const FunLoc> locs);
+
+  void clear(pid_t pid) { _pid_map.erase(pid); }
+  void clear() { _pid_map.clear(); }
+
+  [[nodiscard]] uint64_t hit_count() const { return _hit_count; }
+
+private:
+  struct Key {
+    std::array<uint64_t, k_key_registers.size()> regs;
+    uint64_t stack_size;
+    friend bool operator==(const Key &, const Key &) = default;
+  };
+
+  struct KeyHash {
+    std::size_t operator()(const Key &key) const noexcept;
+  };
+
+  struct Entry {
+    std::vector<uint32_t> read_offsets;
+    std::vector<uint64_t> words; // values of the words at read_offsets
+    std::vector<FunLoc> locs;
+  };
+
+  using EntryMap = std::unordered_map<Key, Entry, KeyHash>;
+
+  static Key make_key(std::span<const uint64_t> regs,
+                      std::span<const std::byte> stack);
+  static uint64_t read_word(std::span<const std::byte> stack, uint32_t offset);
+  static bool same_words(std::span<const std::byte> stack, const Entry &entry);
+
+  std::unordered_map<pid_t, EntryMap> _pid_map;
+  uint64_t _hit_count{0};
+};
+
+} // namespace ddprof
@@ -5,6 +5,8 @@
 
 #pragma once
 
+#include "cfi_table.hpp"
+#include "cgroup_container_id_cache.hpp"
 #include "create_elf.hpp"
 #include "ddprof_defs.hpp"
 #include "ddprof_process.hpp"
@@ -14,7 +16,9 @@
 #include "dwfl_wrapper.hpp"
 #include "perf.hpp"
 #include "perf_archmap.hpp"
+#include "pid_admission.hpp"
 #include "symbol_hdr.hpp"
+#include "unwind_cache.hpp"
 #include "unwind_output.hpp"
 
 #include <optional>
@@ -45,24 +49,50 @@ struct UnwindState {
                        int nb_max_pids = k_default_max_profiled_pids,
                        bool timeline = true)
       : dso_hdr("", dd_profiling_fd), ref_elf(std::move(ref_elf)),
-        maximum_pids(nb_max_pids), is_timeline(timeline) {
+        pid_admission(nb_max_pids), maximum_pids(nb_max_pids),
+        is_timeline(timeline) {
     output.clear();
     output.locs.reserve(kMaxStackDepth);
   }
+
+  // rows are compiled again on demand
+  void clear_cfi_tables() {
+    cfi_tables.clear();
+    nb_cfi_rows = 0;
+    ++cfi_tables_generation;
+  }
   DwflWrapper *_dwfl_wrapper{nullptr}; // pointer to current dwfl element
   DsoHdr dso_hdr;
   SymbolHdr symbol_hdr;
   ProcessHdr process_hdr;
 
   pid_t pid{-1};
+  uint32_t sample_weight{1}; // samples represented by the current sample
   const char *stack{nullptr};
   size_t stack_sz{0};
 
   UnwindRegisters initial_regs;
   ProcessAddress_t current_ip{0};
+  // used to label samples with the thread name active at that time
+  PerfClock::time_point sample_time{PerfClock::time_point::max()};
+  // cgroup of the sampled task (0 if not reported)
+  uint64_t cgroup_id{0};
+  CGroupContainerIdCache container_id_cache;
+
+  UnwindCache unwind_cache;
+  // unwinding rules compiled from .eh_frame, libdw unwinds stacks that have
+  // other rules
+  CfiTables cfi_tables;
+  size_t nb_cfi_rows{0}; // rows of all tables (k_max_cfi_tables_rows)
+  // incremented when all tables are dropped, see DDProfMod
+  uint32_t cfi_tables_generation{1};
+  bool use_cfi_tables{true};
+  std::vector<uint32_t> stack_reads; // offsets of stack words read by unwind
+  bool stack_reads_cacheable{true};  // false if unwind read other registers
 
   UnwindOutput output;
   UniqueElf ref_elf; // reference elf object used to initialize dwfl
+  PidAdmission pid_admission; // processes that can be unwound (maximum_pids)
   int maximum_pids;
   bool is_timeline;
 };
@@ -41,6 +41,11 @@ inline constexpr WatcherSampleTypes k_stype_alloc = {
     {DDOG_PROF_SAMPLE_TYPE_ALLOC_SPACE,   DDOG_PROF_SAMPLE_TYPE_INUSE_SPACE},
     {DDOG_PROF_SAMPLE_TYPE_ALLOC_SAMPLES, DDOG_PROF_SAMPLE_TYPE_INUSE_OBJECTS}};
 
+// Off-CPU: nanoseconds spent blocked, in sum mode only.
+inline constexpr WatcherSampleTypes k_stype_off_cpu = {
+    {DDOG_PROF_SAMPLE_TYPE_WALL_TIME,    k_stype_none},
+    {DDOG_PROF_SAMPLE_TYPE_WALL_SAMPLES, k_stype_none}};
+
 // Dummy: watcher does not contribute to pprof (e.g., sDUM).
 inline constexpr WatcherSampleTypes k_stype_dummy = {
     {k_stype_none, k_stype_none},
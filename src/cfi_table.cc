@@ -0,0 +1,178 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include "cfi_table.hpp"
+
+#include "defer.hpp"
+#include "dwfl_internals.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <dwarf.h>
+#include <limits>
+
+namespace ddprof {
+
+namespace {
+
+bool to_offset(Dwarf_Word value, int32_t &offset) {
+  auto const signed_value = static_cast<int64_t>(value);
+  if (signed_value < std::numeric_limits<int32_t>::min() ||
+      signed_value > std::numeric_limits<int32_t>::max()) {
+    return false;
+  }
+  offset = static_cast<int32_t>(signed_value);
+  return true;
+}
+
+// CFA defined as register + offset
+bool compile_cfa(Dwarf_Frame *frame, CfiRow &row) {
+  Dwarf_Op *ops = nullptr;
+  size_t nops = 0;
+  if (dwarf_frame_cfa(frame, &ops, &nops) != 0 || nops != 1) {
+    return false;
+  }
+  int regno = -1;
+  Dwarf_Word offset = 0;
+  if (ops[0].atom == DW_OP_bregx) {
+    regno = static_cast<int>(ops[0].number);
+    offset = ops[0].number2;
+  } else if (ops[0].atom >= DW_OP_breg0 && ops[0].atom <= DW_OP_breg31) {
+    regno = ops[0].atom - DW_OP_breg0;
+    offset = ops[0].number;
+  }
+  if (regno == k_dwarf_sp_regno) {
+    row.cfa_reg = CfiRow::kCfaSp;
+  } else if (regno == k_dwarf_fp_regno) {
+    row.cfa_reg = CfiRow::kCfaFp;
+  } else {
+    return false;
+  }
+  return to_offset(offset, row.cfa_offset);
+}
+
+// Register undefined, unchanged or saved at CFA + offset
+bool compile_register(Dwarf_Frame *frame, int regno, CfiRow::Rule &rule,
+                      int32_t &offset) {
+  Dwarf_Op ops_mem[3];
+  Dwarf_Op *ops = nullptr;
+  size_t nops = 0;
+  if (dwarf_frame_register(frame, regno, ops_mem, &ops, &nops) != 0) {
+    return false;
+  }
+  offset = 0;
+  if (nops == 0) {
+    rule = ops ? CfiRow::kSameValue : CfiRow::kUndefined;
+    return true;
+  }
+  if (ops[0].atom != DW_OP_call_frame_cfa) {
+    return false;
+  }
+  rule = CfiRow::kOffset;
+  if (nops == 1) {
+    return true;
+  }
+  return nops == 2 && ops[1].atom == DW_OP_plus_uconst &&
+      to_offset(ops[1].number, offset);
+}
+
+} // namespace
+
+std::optional<CfiRow> CfiTable::compile_row(Dwfl_Module *mod,
+                                            ElfAddress_t addr, Offset_t bias) {
+  Dwarf_Addr cfi_bias = 0;
+  Dwarf_CFI *cfi = dwfl_module_eh_cfi(mod, &cfi_bias);
+  if (!cfi || cfi_bias != bias) {
+    // no .eh_frame (libdw also looks for .debug_frame)
+    return std::nullopt;
+  }
+  Dwarf_Frame *frame = nullptr;
+  if (dwarf_cfi_addrframe(cfi, addr, &frame) != 0) {
+    LG_DBG("[CFI] No frame at %lx (%s)", addr, dwarf_errmsg(-1));
+    return std::nullopt;
+  }
+  defer { free(frame); };
+
+  CfiRow row{};
+  bool signal_frame = false;
+  int const ra_regno =
+      dwarf_frame_info(frame, &row.start, &row.end, &signal_frame);
+  if (ra_regno < 0 || addr < row.start || addr >= row.end) {
+    return std::nullopt;
+  }
+  // Only keep rules that unwinding can apply without libdw. Signal frames
+  // restore all registers from the signal context.
+  if (signal_frame || !compile_cfa(frame, row) ||
+      !compile_register(frame, ra_regno, row.ra_rule, row.ra_offset) ||
+      !compile_register(frame, k_dwarf_fp_regno, row.fp_rule,
+                        row.fp_offset)) {
+    row.cfa_reg = CfiRow::kCfaUnsupported;
+  }
+  return row;
+}
+
+std::optional<CfiRow> CfiTable::compile_go_row(const GoPclntab &go_pclntab,
+                                               ElfAddress_t addr) {
+  std::optional<GoPclntab::Frame> const frame = go_pclntab.find_frame(addr);
+  if (!frame) {
+    return std::nullopt;
+  }
+  CfiRow row{};
+  row.start = frame->start;
+  row.end = frame->end;
+  row.cfa_reg = CfiRow::kCfaSp;
+  row.ra_rule = frame->top_frame ? CfiRow::kUndefined : CfiRow::kOffset;
+  // Go saves the caller's frame pointer next to the return address once the
+  // frame is allocated
+#ifdef __x86_64__
+  // return address is pushed by the call
+  row.cfa_offset = frame->sp_delta + static_cast<int32_t>(sizeof(uint64_t));
+  row.ra_offset = -static_cast<int32_t>(sizeof(uint64_t));
+  row.fp_rule = frame->sp_delta ? CfiRow::kOffset : CfiRow::kSameValue;
+  row.fp_offset = -2 * static_cast<int32_t>(sizeof(uint64_t));
+#elif __aarch64__
+  // return address is in LR until the prologue stores it at the top of the
+  // frame, frame pointer is stored below it
+  row.cfa_offset = frame->sp_delta;
+  if (!frame->sp_delta) {
+    row.ra_rule = frame->top_frame ? CfiRow::kUndefined : CfiRow::kSameValue;
+    row.fp_rule = CfiRow::kSameValue;
+  } else {
+    row.ra_offset = -frame->sp_delta;
+    row.fp_rule = CfiRow::kOffset;
+    row.fp_offset =
+        -frame->sp_delta - static_cast<int32_t>(sizeof(uint64_t));
+  }
+#endif
+  return row;
+}
+
+const CfiRow *CfiTable::find_or_compile(Dwfl_Module *mod, ProcessAddress_t pc,
+                                        Offset_t bias,
+                                        const GoPclntab *go_pclntab) {
+  ElfAddress_t const addr = pc - bias;
+  auto it = std::upper_bound(
+      _rows.begin(), _rows.end(), addr,
+      [](ElfAddress_t lhs, const CfiRow &rhs) { return lhs < rhs.start; });
+  if (it == _rows.begin() || addr >= std::prev(it)->end) {
+    if (_rows.size() >= k_max_rows) {
+      return nullptr;
+    }
+    std::optional<CfiRow> row = compile_row(mod, addr, bias);
+    if (!row && go_pclntab) {
+      row = compile_go_row(*go_pclntab, addr);
+    }
+    if (!row) {
+      return nullptr;
+    }
+    // row starts after the end of the previous one
+    it = _rows.insert(it, *row) + 1;
+  }
+  const CfiRow &row = *std::prev(it);
+  return row.cfa_reg != CfiRow::kCfaUnsupported ? &row : nullptr;
+}
+
+} // namespace ddprof
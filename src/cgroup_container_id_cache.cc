@@ -0,0 +1,108 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include "cgroup_container_id_cache.hpp"
+
+#include "container_id.hpp"
+#include "logger.hpp"
+
+#include <filesystem>
+#include <sys/stat.h>
+
+namespace ddprof {
+
+namespace {
+// perf_event controller is only mounted here with cgroup v1
+constexpr std::string_view k_cgroup_v1_perf_event_root =
+    "/sys/fs/cgroup/perf_event";
+constexpr std::string_view k_cgroup_root = "/sys/fs/cgroup";
+// marks cgroups that were not found in the hierarchy
+constexpr std::string_view k_unresolved{"\0", 1};
+
+std::string find_cgroup_root() {
+  std::error_code ec;
+  if (std::filesystem::is_directory(k_cgroup_v1_perf_event_root, ec)) {
+    return std::string{k_cgroup_v1_perf_event_root};
+  }
+  return std::string{k_cgroup_root};
+}
+} // namespace
+
+std::string_view CGroupContainerIdCache::get(uint64_t cgroup_id) {
+  auto it = _container_ids.find(cgroup_id);
+  if (it == _container_ids.end()) {
+    it = resolve(cgroup_id);
+    if (it == _container_ids.end()) {
+      return k_container_id_unknown;
+    }
+  }
+  if (it->second == k_unresolved) {
+    return k_container_id_unknown;
+  }
+  return it->second.empty() ? k_container_id_none : it->second;
+}
+
+CGroupContainerIdCache::Map::iterator
+CGroupContainerIdCache::resolve(uint64_t cgroup_id) {
+  auto const now = std::chrono::steady_clock::now();
+  if (now - _last_scan_time < k_min_scan_interval) {
+    return _container_ids.end();
+  }
+  _last_scan_time = now;
+  if (_container_ids.size() >= k_max_entries) {
+    // no view on unresolved entries was returned
+    std::erase_if(_container_ids,
+                  [](const auto &el) { return el.second == k_unresolved; });
+    if (_container_ids.size() >= k_max_entries) {
+      return _container_ids.end();
+    }
+  }
+  scan();
+  auto it = _container_ids.find(cgroup_id);
+  if (it == _container_ids.end() && _container_ids.size() < k_max_entries) {
+    // avoid scanning again for this cgroup
+    it = _container_ids.emplace(cgroup_id, k_unresolved).first;
+  }
+  return it;
+}
+
+void CGroupContainerIdCache::scan() {
+  if (_cgroup_root.empty()) {
+    _cgroup_root = find_cgroup_root();
+  }
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  auto add_cgroup = [this](const fs::path &path, std::string_view rel_path) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+      return;
+    }
+    auto container_id = container_id_from_cgroup_path(rel_path);
+    _container_ids.try_emplace(info.st_ino,
+                               container_id.value_or(std::string_view{}));
+  };
+  add_cgroup(_cgroup_root, "/");
+  for (fs::recursive_directory_iterator
+           it{_cgroup_root, fs::directory_options::skip_permission_denied, ec},
+       end;
+       it != end && _container_ids.size() < k_max_entries;
+       it.increment(ec)) {
+    if (ec) {
+      break;
+    }
+    if (!it->is_directory(ec) || it->is_symlink(ec)) {
+      continue;
+    }
+    std::string const path = it->path().string();
+    add_cgroup(it->path(),
+               std::string_view{path}.substr(_cgroup_root.size()));
+  }
+  if (ec) {
+    LG_DBG("Unable to walk cgroup hierarchy %s (%s)", _cgroup_root.c_str(),
+           ec.message().c_str());
+  }
+}
+
+} // namespace ddprof
@@ -8,36 +8,108 @@
 #include "ddres.hpp"
 #include "logger.hpp"
 
+#include <algorithm>
 #include <fstream>
-#include <regex>
 
 namespace ddprof {
 
-constexpr static std::string_view UUID_SOURCE =
-    "[0-9a-f]{8}[-_][0-9a-f]{4}[-_][0-9a-f]{4}[-_][0-9a-f]{4}[-_][0-9a-f]{12}";
-constexpr static std::string_view CONTAINER_SOURCE = "[0-9a-f]{64}";
-constexpr static std::string_view TASK_SOURCE = "[0-9a-f]{32}-\\d+";
-
 namespace {
-std::optional<std::string> container_id_from_line(const std::string &line) {
-  std::smatch line_matches;
-  std::smatch container_matches;
-  const std::regex LINE_REGEX(R"(^\d+:[^:]*:(.+)$)");
-  const std::regex CONTAINER_REGEX(
-      "(" + std::string(UUID_SOURCE) + "|" + std::string(CONTAINER_SOURCE) +
-      "|" + std::string(TASK_SOURCE) + ")(?:.scope)? *$");
-
-  if (std::regex_search(line, line_matches, LINE_REGEX)) {
-    std::string const match = line_matches[1].str();
-    if (std::regex_search(match, container_matches, CONTAINER_REGEX)) {
-      return container_matches[1].str();
+// Container ids are matched at the end of cgroup paths, with any of the
+// following formats (optionally followed by ".scope"):
+// - UUID: 8-4-4-4-12 hex digits, separated by '-' or '_'
+// - container: [0-9a-f]{64}
+// - task: [0-9a-f]{32}-[0-9]+
+constexpr size_t k_uuid_size = 36;
+constexpr size_t k_container_size = 64;
+constexpr size_t k_task_hex_size = 32;
+constexpr std::string_view k_scope_suffix = ".scope";
+
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+bool is_hex(char c) { return is_digit(c) || (c >= 'a' && c <= 'f'); }
+
+bool all_hex(std::string_view str) {
+  return std::all_of(str.begin(), str.end(), is_hex);
+}
+
+bool is_uuid(std::string_view str) {
+  constexpr size_t k_separators[] = {8, 13, 18, 23};
+  if (str.size() != k_uuid_size) {
+    return false;
+  }
+  for (size_t i = 0; i < str.size(); ++i) {
+    bool const separator =
+        std::find(std::begin(k_separators), std::end(k_separators), i) !=
+        std::end(k_separators);
+    if (separator ? (str[i] != '-' && str[i] != '_') : !is_hex(str[i])) {
+      return false;
     }
   }
-  return std::nullopt;
+  return true;
+}
+
+// Returns the size of the task id ending `str` (0 if none)
+size_t task_id_size(std::string_view str) {
+  size_t nb_digits = 0;
+  while (nb_digits < str.size() && is_digit(str[str.size() - nb_digits - 1])) {
+    ++nb_digits;
+  }
+  size_t const size = k_task_hex_size + 1 + nb_digits;
+  if (nb_digits == 0 || str.size() < size ||
+      str[str.size() - nb_digits - 1] != '-' ||
+      !all_hex(str.substr(str.size() - size, k_task_hex_size))) {
+    return 0;
+  }
+  return size;
+}
+
+std::optional<std::string> container_id_from_line(std::string_view line) {
+  // Lines are formatted as hierarchy-ID:controller-list:cgroup-path
+  size_t pos = 0;
+  while (pos < line.size() && is_digit(line[pos])) {
+    ++pos;
+  }
+  if (pos == 0 || pos >= line.size() || line[pos] != ':') {
+    return std::nullopt;
+  }
+  size_t const path_pos = line.find(':', pos + 1);
+  if (path_pos == std::string_view::npos || path_pos + 1 >= line.size()) {
+    return std::nullopt;
+  }
+  auto id = container_id_from_cgroup_path(line.substr(path_pos + 1));
+  if (!id) {
+    return std::nullopt;
+  }
+  return std::string(*id);
 }
 
 } // namespace
 
+std::optional<std::string_view>
+container_id_from_cgroup_path(std::string_view path) {
+  while (!path.empty() && path.back() == ' ') {
+    path.remove_suffix(1);
+  }
+  if (path.ends_with(k_scope_suffix)) {
+    path.remove_suffix(k_scope_suffix.size());
+  }
+  // Formats can not overlap except for task ids ending with many digits: keep
+  // the longest match (as a regex search would do)
+  size_t size = task_id_size(path);
+  if (size < k_container_size && path.size() >= k_container_size &&
+      all_hex(path.substr(path.size() - k_container_size))) {
+    size = k_container_size;
+  }
+  if (size < k_uuid_size && path.size() >= k_uuid_size &&
+      is_uuid(path.substr(path.size() - k_uuid_size))) {
+    size = k_uuid_size;
+  }
+  if (size == 0) {
+    return std::nullopt;
+  }
+  return path.substr(path.size() - size);
+}
+
 DDRes extract_container_id(const std::string &filepath,
                            ContainerId &container_id) {
   container_id = std::nullopt;
@@ -59,4 +131,4 @@ DDRes extract_container_id(const std::string &filepath,
   return {};
 }
 
-} // namespace ddprof
\ No newline at end of file
+} // namespace ddprof
@@ -0,0 +1,135 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include "control_command.hpp"
+
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <sys/socket.h>
+
+namespace ddprof {
+
+namespace {
+
+constexpr std::string_view k_whitespace = " \t\r\n";
+constexpr size_t k_max_tokens = 3;
+
+// Split `line` on whitespace, returns the number of tokens or
+// k_max_tokens + 1 if there are too many
+size_t tokenize(std::string_view line,
+                std::array<std::string_view, k_max_tokens> &tokens) {
+  size_t nb_tokens = 0;
+  size_t pos = line.find_first_not_of(k_whitespace);
+  while (pos != std::string_view::npos) {
+    if (nb_tokens == k_max_tokens) {
+      return k_max_tokens + 1;
+    }
+    size_t const end = line.find_first_of(k_whitespace, pos);
+    tokens[nb_tokens++] = line.substr(pos, end - pos);
+    pos = line.find_first_not_of(k_whitespace, end);
+  }
+  return nb_tokens;
+}
+
+std::optional<int64_t> parse_value(std::string_view str) {
+  int64_t value = 0;
+  const auto *end = str.data() + str.size();
+  auto [ptr, ec] = std::from_chars(str.data(), end, value);
+  if (ec != std::errc{} || ptr != end || value == 0) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+} // namespace
+
+std::optional<ControlCommand> parse_control_command(std::string_view line) {
+  std::array<std::string_view, k_max_tokens> tokens;
+  size_t const nb_tokens = tokenize(line, tokens);
+  if (nb_tokens == 0 || nb_tokens > k_max_tokens) {
+    return std::nullopt;
+  }
+  std::string_view const name = tokens[0];
+  if (nb_tokens == 1) {
+    if (name == "help") {
+      return ControlCommand{.type = ControlCommandType::kHelp};
+    }
+    if (name == "status") {
+      return ControlCommand{.type = ControlCommandType::kStatus};
+    }
+    if (name == "export") {
+      return ControlCommand{.type = ControlCommandType::kExport};
+    }
+    if (name == "dump") {
+      return ControlCommand{.type = ControlCommandType::kDump};
+    }
+    return std::nullopt;
+  }
+  if (nb_tokens == 2) {
+    if (name == "enable" || name == "disable") {
+      return ControlCommand{.type = name == "enable"
+                                ? ControlCommandType::kEnable
+                                : ControlCommandType::kDisable,
+                            .watcher = std::string(tokens[1])};
+    }
+    if (name == "allocation_rate") {
+      auto value = parse_value(tokens[1]);
+      if (!value) {
+        return std::nullopt;
+      }
+      return ControlCommand{.type = ControlCommandType::kAllocationRate,
+                            .value = *value};
+    }
+    return std::nullopt;
+  }
+  if (name == "rate") {
+    auto value = parse_value(tokens[2]);
+    if (!value || *value < 0) {
+      return std::nullopt;
+    }
+    return ControlCommand{.type = ControlCommandType::kRate,
+                          .watcher = std::string(tokens[1]),
+                          .value = *value};
+  }
+  return std::nullopt;
+}
+
+std::optional<std::string> read_control_command(int fd, std::string &buffer) {
+  while (buffer.size() < k_max_control_command_size &&
+         buffer.find('\n') == std::string::npos) {
+    char buf[k_max_control_command_size];
+    ssize_t const sz = ::recv(
+        fd, buf, k_max_control_command_size - buffer.size(), MSG_DONTWAIT);
+    if (sz < 0 && errno == EINTR) {
+      continue;
+    }
+    if (sz < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return std::nullopt;
+    }
+    if (sz <= 0) {
+      // end of connection (or error): use what was received
+      break;
+    }
+    buffer.append(buf, sz);
+  }
+  return buffer.substr(0, buffer.find('\n'));
+}
+
+void write_control_reply(int fd, std::string_view reply) {
+  while (!reply.empty()) {
+    ssize_t const sz =
+        ::send(fd, reply.data(), reply.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (sz < 0 && errno == EINTR) {
+      continue;
+    }
+    if (sz <= 0) {
+      return;
+    }
+    reply.remove_prefix(sz);
+  }
+}
+
+} // namespace ddprof
@@ -0,0 +1,48 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include "counter_group.hpp"
+
+#include <algorithm>
+
+namespace ddprof {
+
+std::span<const uint64_t>
+CounterGroupDeltas::update(const PerfSampleView &sample, bool per_thread) {
+  uint64_t const nr = sample.nr_read_values();
+  if (nr <= 1) {
+    return {};
+  }
+  uint64_t const id = sample.read_id(0);
+  std::vector<EventState> &events =
+      _threads[per_thread ? static_cast<pid_t>(sample.tid()) : -1];
+  auto it = std::ranges::find(events, id, &EventState::id);
+  bool const baseline = it == events.end();
+  if (baseline) {
+    it = events.insert(events.end(), {.id = id, .values = {}});
+  }
+  EventState &state = *it;
+  state.values.resize(nr - 1);
+  _deltas.resize(nr - 1);
+  for (uint64_t i = 0; i < nr - 1; ++i) {
+    uint64_t const value = sample.read_value(i + 1);
+    _deltas[i] =
+        !baseline && value > state.values[i] ? value - state.values[i] : 0;
+    state.values[i] = value;
+  }
+  return _deltas;
+}
+
+void CounterGroupDeltas::thread_exit(pid_t tid) { _threads.erase(tid); }
+
+size_t CounterGroupDeltas::size() const {
+  size_t nb_events = 0;
+  for (const auto &[_, events] : _threads) {
+    nb_events += events.size();
+  }
+  return nb_events;
+}
+
+} // namespace ddprof
@@ -0,0 +1,54 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include "cpu_budget_governor.hpp"
+
+#include "perf_watcher.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace ddprof {
+
+namespace {
+constexpr double k_max_scale_step = 2.0;
+constexpr double k_low_usage_ratio = 0.9;
+} // namespace
+
+double cpu_budget_next_rate_scale(double rate_scale, int64_t used_millicores,
+                                  int64_t budget_millicores) {
+  if (budget_millicores <= 0) {
+    return 1.0;
+  }
+  if (used_millicores <= budget_millicores &&
+      (used_millicores >= k_low_usage_ratio * budget_millicores ||
+       rate_scale >= 1.0)) {
+    return rate_scale;
+  }
+  // avoid dividing by 0 when no CPU usage was measured
+  double const ratio = used_millicores > 0
+      ? static_cast<double>(budget_millicores) / used_millicores
+      : k_max_scale_step;
+  double const step =
+      std::clamp(ratio, 1.0 / k_max_scale_step, k_max_scale_step);
+  return std::clamp(rate_scale * step, k_min_sampling_rate_scale, 1.0);
+}
+
+uint64_t watcher_scaled_sample_value(const PerfWatcher &watcher,
+                                     double rate_scale) {
+  if (watcher.sample_period == 0) {
+    return 0;
+  }
+  if (watcher.options.is_freq) {
+    return std::max<uint64_t>(
+        1, std::llround(watcher.sample_frequency * rate_scale));
+  }
+  // negative periods are used to request deterministic allocation sampling
+  return std::max<uint64_t>(
+      1, std::llround(std::abs(watcher.sample_period) / rate_scale));
+}
+
+} // namespace ddprof
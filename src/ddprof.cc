@@ -17,12 +17,15 @@
 #include "pevent_lib.hpp"
 #include "signal_helper.hpp"
 #include "sys_utils.hpp"
+#include "unique_fd.hpp"
 #include "version.hpp"
 
 #include <absl/strings/numbers.h>
 #include <absl/strings/str_format.h>
 #include <cerrno>
 #include <csignal>
+#include <cstring>
+#include <fcntl.h>
 #include <filesystem>
 #include <sys/resource.h>
 
@@ -77,7 +80,17 @@ DDRes ddprof_setup(DDProfContext &ctx) {
     display_system_info();
 
     std::vector<pid_t> threads;
-    if (ctx.params.pid != -1) {
+    UniqueFd cgroup_fd;
+    if (!ctx.params.cgroup_path.empty()) {
+      // perf events only need the cgroup fd while they are opened
+      cgroup_fd = UniqueFd{open(ctx.params.cgroup_path.c_str(),
+                                O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+      if (!cgroup_fd) {
+        DDRES_RETURN_ERROR_LOG(DD_WHAT_CGROUP, "Unable to open cgroup %s (%s)",
+                               ctx.params.cgroup_path.c_str(), strerror(errno));
+      }
+      threads.push_back(cgroup_fd.get());
+    } else if (ctx.params.pid != -1) {
       DDRES_CHECK_FWD(get_process_threads(ctx.params.pid, threads));
     } else {
       threads.push_back(-1);
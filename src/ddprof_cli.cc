@@ -18,6 +18,7 @@
 #include "ddprof_defs.hpp"
 #include "ddres_helpers.hpp"
 #include "logger.hpp"
+#include "process_ring_buffers.hpp"
 #include "uuid.hpp"
 #include "version.hpp"
 
@@ -33,6 +34,7 @@ constexpr std::chrono::seconds k_default_upload_period{59};
 constexpr size_t k_default_worker_period{240};
 constexpr std::chrono::milliseconds k_default_loaded_libs_check_delay{5000};
 constexpr std::chrono::milliseconds k_default_loaded_libs_check_interval{59000};
+constexpr int k_default_process_ring_buffers{4};
 
 std::string api_key_to_dbg_string(std::string_view value) {
   if (value.size() != k_size_api_key) {
@@ -172,15 +174,28 @@ int DDProfCLI::parse(int argc, const char *argv[]) {
              "Instrument the given PID rather than launching a new process.")
           ->group("Profiling settings")
           ->excludes(exec_option);
-  app.add_flag("--global,-g", global,
-               "[DEPRECATED] Instrument all processes.\n"
-               "This option is deprecated. Please use dd-otel-host-profiler "
-               "instead:\n"
-               "https://github.com/DataDog/dd-otel-host-profiler\n"
-               "Requires specific capabilities or a perf_event_paranoid "
-               "value of less than 1.")
+  CLI::Option *global_opt =
+      app.add_flag("--global,-g", global,
+                   "[DEPRECATED] Instrument all processes.\n"
+                   "This option is deprecated. Please use "
+                   "dd-otel-host-profiler instead:\n"
+                   "https://github.com/DataDog/dd-otel-host-profiler\n"
+                   "Requires specific capabilities or a perf_event_paranoid "
+                   "value of less than 1.")
+          ->group("Profiling settings")
+          ->excludes(pid_opt)
+          ->excludes(exec_option);
+  app.add_option("--cgroup", cgroup,
+                 "Instrument all processes of the given cgroup.\n"
+                 "Path of the cgroup directory, "
+                 "eg. /sys/fs/cgroup/system.slice/foo.service\n"
+                 "Processes joining the cgroup (or its descendants) are "
+                 "profiled without restarting.\n"
+                 "Requires the same permissions as global mode.")
       ->group("Profiling settings")
+      ->envname("DD_PROFILING_CGROUP")
       ->excludes(pid_opt)
+      ->excludes(global_opt)
       ->excludes(exec_option);
   app.add_option("--inlined_functions,--inlined-functions,-I",
                  inlined_functions,
@@ -360,6 +375,13 @@ int DDProfCLI::parse(int argc, const char *argv[]) {
              "Override the automatically created socket with a specific path")
           ->envname("DD_PROFILING_NATIVE_SOCKET")
           ->group(""));
+  extended_options.push_back(
+      app.add_option("--control-socket,--control_socket", control_socket_path,
+                     "Unix socket accepting commands to change sampling rates,"
+                     "\nenable or disable watchers and trigger exports at "
+                     "runtime.\nSend \"help\" for the list of commands.")
+          ->envname("DD_PROFILING_CONTROL_SOCKET")
+          ->group(""));
   extended_options.push_back(
       app.add_option("--pipefd", pipefd_to_library,
                      "Pipe file descriptor to communicate with library that "
@@ -421,14 +443,66 @@ int DDProfCLI::parse(int argc, const char *argv[]) {
           ->envname("DD_PROFILING_REORDER_EVENTS")
           ->group(""));
 
+  extended_options.push_back(
+      app.add_flag("--load-shedding,!--no-load-shedding", load_shedding,
+                   "Skip a random subset of samples when the profiler lags "
+                   "behind (kept samples are weighted accordingly).\n"
+                   "Only applies to samples that are unwound.")
+          ->default_val(false)
+          ->envname("DD_PROFILING_LOAD_SHEDDING")
+          ->group(""));
+
   extended_options.push_back(app.add_option("--maximum-pids,--maximum_pids",
                                             maximum_pids,
-                                            "Maximum number of profiled PIDs."
+                                            "Maximum number of profiled PIDs "
+                                            "(the most sampled ones are kept). "
                                             "Setting -1 means no limit.")
                                  ->check(MaximumPidsValidator())
                                  ->default_val(k_default_max_profiled_pids)
                                  ->envname("DD_PROFILING_MAXIMUM_PIDS")
                                  ->group(""));
+
+  extended_options.push_back(
+      app.add_option("--cpu-budget,--cpu_budget", cpu_budget,
+                     "CPU usage target of the profiler in millicores.\n"
+                     "Sampling rates are lowered when the profiler uses more "
+                     "CPU (0 means no limit).")
+          ->check(CLI::NonNegativeNumber)
+          ->default_val(0)
+          ->envname("DD_PROFILING_CPU_BUDGET")
+          ->group(""));
+
+  extended_options.push_back(
+      app.add_option("--ring-buffer-budget,--ring_buffer_budget",
+                     ring_buffer_budget,
+                     "Memory budget of perf ring buffers in MiB.\n"
+                     "Ring buffers losing events grow (and idle ones shrink) "
+                     "across worker\nrestarts (0 means sizes are fixed).")
+          ->check(CLI::NonNegativeNumber)
+          ->default_val(0)
+          ->envname("DD_PROFILING_RING_BUFFER_BUDGET")
+          ->group(""));
+
+  extended_options.push_back(
+      app.add_option("--process-ring-buffers,--process_ring_buffers",
+                     process_ring_buffers,
+                     "Number of allocation ring buffers dedicated to single "
+                     "processes\nin global and cgroup modes (0 means all "
+                     "processes share one).")
+          ->check(CLI::Range(
+              0, static_cast<int>(ProcessRingBuffers::k_nb_ring_buffers)))
+          ->default_val(k_default_process_ring_buffers)
+          ->envname("DD_PROFILING_PROCESS_RING_BUFFERS")
+          ->group(""));
+
+  extended_options.push_back(
+      app.add_flag("--flight-recorder,--flight_recorder", flight_recorder,
+                   "Keep perf events in overwrite ring buffers without "
+                   "reading them.\nThe recent history is unwound and exported "
+                   "on SIGUSR2 (or the dump\ncommand of the control socket).")
+          ->default_val(false)
+          ->envname("DD_PROFILING_FLIGHT_RECORDER")
+          ->group(""));
   // Parse
   CLI11_PARSE(app, argc, argv);
 
@@ -460,7 +534,7 @@ int DDProfCLI::parse(int argc, const char *argv[]) {
   }
 
   // Are we setup to do something ?
-  if (command_line.empty() && pid == 0 && !global) {
+  if (command_line.empty() && pid == 0 && !global && cgroup.empty()) {
     (void)fprintf(stderr, "Please specify a target to profile \n");
     return static_cast<int>(CLI::ExitCodes::RequiredError);
   }
@@ -521,6 +595,9 @@ void DDProfCLI::print() const {
   if (global) {
     PRINT_NFO("  - global: %s", global ? "true" : "false");
   }
+  if (!cgroup.empty()) {
+    PRINT_NFO("  - cgroup: %s", cgroup.c_str());
+  }
   PRINT_NFO("  - timeline: %s", timeline ? "true" : "false");
   if (!command_line.empty()) {
     std::string command_line_str = "[" + command_line[0];
@@ -556,6 +633,9 @@ void DDProfCLI::print() const {
   if (!socket_path.empty()) {
     PRINT_NFO("  - socket_path: %s", socket_path.c_str());
   }
+  if (!control_socket_path.empty()) {
+    PRINT_NFO("  - control_socket_path: %s", control_socket_path.c_str());
+  }
   if (pipefd_to_library != -1) {
     PRINT_NFO("  - pipefd_to_library: %d", pipefd_to_library);
   }
@@ -594,7 +674,12 @@ void DDProfCLI::print() const {
   PRINT_NFO("  - disable_symbolization: %s",
             disable_symbolization ? "true" : "false");
   PRINT_NFO("  - reorder_events: %s", reorder_events ? "true" : "false");
+  PRINT_NFO("  - load_shedding: %s", load_shedding ? "true" : "false");
   PRINT_NFO("  - maximum_pids: %d", maximum_pids);
+  PRINT_NFO("  - cpu_budget: %dm", cpu_budget);
+  PRINT_NFO("  - ring_buffer_budget: %dMiB", ring_buffer_budget);
+  PRINT_NFO("  - process_ring_buffers: %d", process_ring_buffers);
+  PRINT_NFO("  - flight_recorder: %s", flight_recorder ? "true" : "false");
 }
 
 CommandLineWrapper DDProfCLI::get_user_command_line() const {
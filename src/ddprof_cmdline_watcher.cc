@@ -29,6 +29,14 @@ bool watcher_from_config(EventConf *conf, PerfWatcher *watcher) {
   if (tmp_watcher) {
     *watcher = *tmp_watcher;
     conf->id = kIgnoredWatcherID; // matched, so invalidate Tracepoint checks
+    if (watcher_is_off_cpu(watcher)) {
+      int64_t const tracepoint_id = tracepoint_get_id(
+          k_off_cpu_tracepoint_group, k_off_cpu_tracepoint_event);
+      if (tracepoint_id == kIgnoredWatcherID) {
+        return false;
+      }
+      watcher->config = tracepoint_id;
+    }
   } else if (!conf->groupname.empty()) {
     // If the event doesn't match an ewatcher, it is only valid if a group was
     // also provided (splitting events on ':' is the responsibility of the
@@ -94,6 +102,21 @@ bool watcher_from_config(EventConf *conf, PerfWatcher *watcher) {
   watcher->tracepoint_group = conf->groupname;
   watcher->tracepoint_label = conf->label;
   watcher->options.stack_sample_size = conf->stack_sample_size;
+  watcher->counter_group = conf->counter_group;
+  if (conf->count_only) {
+    // Custom events and off-CPU time need the stack of each event
+    if (watcher->type >= kDDPROF_TYPE_CUSTOM || watcher_is_off_cpu(watcher) ||
+        watcher->aggregation_mode != EventAggregationMode::kSum) {
+      return false;
+    }
+    // Nothing to copy or unwind: the worker only counts events
+    watcher->options.count_only = true;
+    watcher->options.stack_sample_size = 0;
+    watcher->sample_type &= ~PERF_SAMPLE_STACK_USER;
+    if (watcher->value_source != EventConfValueSource::kRegister) {
+      watcher->sample_type &= ~PERF_SAMPLE_REGS_USER;
+    }
+  }
   // Allocation watcher, has an extra field to ensure we capture address
 
   if (watcher->config == kDDPROF_COUNT_ALLOCATIONS) {
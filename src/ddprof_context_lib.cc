@@ -58,6 +58,57 @@ void order_watchers(std::span<PerfWatcher> watchers) {
       });
 }
 
+// Perf events of the watchers are kept in overwrite ring buffers until a
+// dump. Allocations are still unwound as they come and need the process
+// events (mmap, fork, exit): a dummy watcher keeps reporting them.
+void setup_flight_recorder(std::vector<PerfWatcher> &watchers) {
+  bool has_custom_watcher = false;
+  bool has_dummy_watcher = false;
+  for (auto &watcher : watchers) {
+    if (watcher.type >= PERF_TYPE_MAX) {
+      has_custom_watcher = true;
+    } else if (watcher.ddprof_event_type == DDPROF_PWE_sDUM) {
+      has_dummy_watcher = true;
+    } else {
+      watcher.options.flight_recorder = true;
+    }
+  }
+  if (has_custom_watcher && !has_dummy_watcher) {
+    watchers.push_back(*ewatcher_from_str("sDUM"));
+  }
+}
+
+// Links the members of counter groups to their leader, and returns the first
+// watcher that can not be part of a counter group (if any)
+const PerfWatcher *link_counter_groups(std::span<PerfWatcher> watchers) {
+  for (size_t i = 0; i < watchers.size(); ++i) {
+    PerfWatcher &watcher = watchers[i];
+    if (!watcher.counter_group) {
+      continue;
+    }
+    // Counters are read from the kernel with the samples of the leader
+    if (watcher.type >= PERF_TYPE_MAX || watcher.options.count_only ||
+        watcher_is_off_cpu(&watcher) ||
+        watcher.aggregation_mode != EventAggregationMode::kSum) {
+      return &watcher;
+    }
+    auto leader = std::find_if(
+        watchers.begin(), watchers.begin() + i, [&](const auto &other) {
+          return other.counter_group == watcher.counter_group;
+        });
+    if (leader == watchers.begin() + i) {
+      watcher.sample_type |= PERF_SAMPLE_READ;
+      continue;
+    }
+    // The value of other members is their counter
+    if (watcher.value_source != EventConfValueSource::kSample) {
+      return &watcher;
+    }
+    watcher.group_leader_pos = leader - watchers.begin();
+  }
+  return nullptr;
+}
+
 void copy_cli_values(const DDProfCLI &ddprof_cli, DDProfContext &ctx) {
 
   // Do we want to std::move more ?
@@ -65,9 +116,10 @@ void copy_cli_values(const DDProfCLI &ddprof_cli, DDProfContext &ctx) {
   // todo avoid manual copies
   ctx.params.tags = ddprof_cli.tags;
   // Profiling settings
-  if (ddprof_cli.global) {
-    // global mode is flagged as pid == -1
+  if (ddprof_cli.global || !ddprof_cli.cgroup.empty()) {
+    // global and cgroup modes are flagged as pid == -1
     ctx.params.pid = -1;
+    ctx.params.cgroup_path = ddprof_cli.cgroup;
   } else {
     ctx.params.pid = ddprof_cli.pid;
   }
@@ -88,17 +140,24 @@ void copy_cli_values(const DDProfCLI &ddprof_cli, DDProfContext &ctx) {
   }
 
   ctx.params.show_samples = ddprof_cli.show_samples;
-  ctx.params.timeline = ddprof_cli.timeline;
+  // a dump is a short window of history, worth looking at as a timeline
+  ctx.params.timeline = ddprof_cli.timeline || ddprof_cli.flight_recorder;
   ctx.params.fault_info = ddprof_cli.fault_info;
   ctx.params.remote_symbolization = ddprof_cli.remote_symbolization;
   ctx.params.disable_symbolization = ddprof_cli.disable_symbolization;
   ctx.params.reorder_events = ddprof_cli.reorder_events;
+  ctx.params.load_shedding = ddprof_cli.load_shedding;
   ctx.params.maximum_pids = ddprof_cli.maximum_pids;
+  ctx.params.cpu_budget_millicores = ddprof_cli.cpu_budget;
+  ctx.params.ring_buffer_budget_mib = ddprof_cli.ring_buffer_budget;
+  ctx.params.process_ring_buffers = ddprof_cli.process_ring_buffers;
+  ctx.params.flight_recorder = ddprof_cli.flight_recorder;
 
   ctx.params.initial_loaded_libs_check_delay =
       ddprof_cli.initial_loaded_libs_check_delay;
   ctx.params.loaded_libs_check_interval = ddprof_cli.loaded_libs_check_interval;
   ctx.params.socket_path = ddprof_cli.socket_path;
+  ctx.params.control_socket_path = ddprof_cli.control_socket_path;
   ctx.params.pipefd_to_library = UniqueFd{ddprof_cli.pipefd_to_library};
 }
 
@@ -121,7 +180,8 @@ DDRes context_add_watchers(const DDProfCLI &ddprof_cli, DDProfContext &ctx) {
 
   if (!preset.empty()) {
     const bool pid_or_global_mode =
-        (ddprof_cli.global || ddprof_cli.pid) && !ctx.params.pipefd_to_library;
+        (ddprof_cli.global || ddprof_cli.pid || !ddprof_cli.cgroup.empty()) &&
+        !ctx.params.pipefd_to_library;
     DDRES_CHECK_FWD(add_preset(preset, pid_or_global_mode,
                                ddprof_cli.default_stack_sample_size, watchers));
   }
@@ -134,7 +194,17 @@ DDRes context_add_watchers(const DDProfCLI &ddprof_cli, DDProfContext &ctx) {
     watchers.push_back(*ewatcher_from_str("sDUM"));
   }
 
+  if (ddprof_cli.flight_recorder) {
+    setup_flight_recorder(watchers);
+  }
+
   order_watchers(watchers);
+  if (const PerfWatcher *invalid_watcher = link_counter_groups(watchers);
+      invalid_watcher != nullptr) {
+    DDRES_RETURN_ERROR_LOG(
+        DD_WHAT_INPUT_PROCESS, "Event can not be part of a counter group: %s",
+        event_type_name_from_idx(invalid_watcher->ddprof_event_type));
+  }
 
   ctx.watchers = std::move(watchers);
   return {};
@@ -152,6 +222,18 @@ DDRes context_set(const DDProfCLI &ddprof_cli, DDProfContext &ctx) {
 
   DDRES_CHECK_FWD(context_add_watchers(ddprof_cli, ctx));
 
+  // Switches of a thread are recorded in the ring buffer of the CPU it runs
+  // on: pairing a switch out with the next switch in requires all buffers to
+  // be merged by timestamp
+  if (!ctx.params.reorder_events &&
+      std::any_of(ctx.watchers.begin(), ctx.watchers.end(),
+                  [](const auto &watcher) {
+                    return watcher_is_off_cpu(&watcher);
+                  })) {
+    LG_NTC("Enabling event reordering for off-CPU profiling");
+    ctx.params.reorder_events = true;
+  }
+
   if (ctx.params.socket_path.empty()) {
     ctx.params.socket_path = generate_socket_path();
   }
@@ -211,6 +211,12 @@ DDRes compute_elf_bias(Elf *elf, const std::string &filepath, const Dso &dso,
 }
 } // namespace
 
+bool has_go_build_id(Elf *elf) {
+  return !get_elf_note(elf, kGoBuildIdSection, kGoBuildIdTag,
+                       kGoBuildIdNoteName)
+              .empty();
+}
+
 DDRes report_module(Dwfl *dwfl, ProcessAddress_t pc, const Dso &dso,
                     const FileInfoValue &fileInfoValue, DDProfMod &ddprof_mod) {
   const std::string &filepath = fileInfoValue.get_path();
@@ -267,10 +273,10 @@ DDRes report_module(Dwfl *dwfl, ProcessAddress_t pc, const Dso &dso,
   ddprof_mod._mod = dwfl_report_elf(dwfl, module_name, filepath.c_str(),
                                     fd_holder.get(), bias, true);
 
-  auto maybe_build_id = find_build_id(elf);
-
-  // Retrieve build id
-  if (maybe_build_id) {
+  // Retrieve build id (reported by mmap events when the kernel supports it)
+  if (!fileInfoValue.get_build_id().empty()) {
+    ddprof_mod.set_build_id(fileInfoValue.get_build_id());
+  } else if (auto maybe_build_id = find_build_id(elf)) {
     ddprof_mod.set_build_id(std::move(maybe_build_id.value()));
   }
 
@@ -13,6 +13,7 @@
 #include <absl/strings/str_cat.h>
 #include <absl/strings/str_format.h>
 
+#include <algorithm>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <vector>
@@ -107,26 +108,67 @@ DDRes Process::read_cgroup_ns(pid_t pid, std::string_view path_to_proc,
   return {};
 }
 
-std::string_view Process::get_or_insert_thread_name(pid_t tid) {
-  // Try to insert an empty string first, to ensure only one lookup happens
-  auto [it, inserted] = _thread_name_map.emplace(tid, "");
+std::string_view
+Process::get_or_insert_thread_name(pid_t tid, PerfClock::time_point timestamp) {
+  // Try to insert an empty history first, to ensure only one lookup happens
+  auto [it, inserted] = _thread_name_map.try_emplace(tid);
+  ThreadNameHistory &history = it->second;
 
-  // If the thread name is already cached (not inserted), return the cached name
-  if (!inserted) {
-    return it->second;
+  if (inserted) {
+    // No event was received for this thread: fallback to procfs.
+    // An empty name is kept on failure to avoid further lookups.
+    history.push_back({PerfClock::time_point::min(), read_thread_name(tid)});
   }
 
+  // Latest name that was set before the timestamp
+  auto name_it =
+      std::upper_bound(history.begin(), history.end(), timestamp, set_after);
+  if (name_it != history.begin()) {
+    --name_it;
+  }
+  return name_it->name;
+}
+
+void Process::set_thread_name(pid_t tid, std::string_view name,
+                              PerfClock::time_point timestamp) {
+  ThreadNameHistory &history = _thread_name_map[tid];
+  if (!history.empty() && history.back().since <= timestamp &&
+      history.back().name == name) {
+    return;
+  }
+  auto pos =
+      std::upper_bound(history.begin(), history.end(), timestamp, set_after);
+  history.insert(pos, {timestamp, std::string(name)});
+  if (history.size() > k_max_thread_name_history) {
+    history.erase(history.begin());
+  }
+}
+
+void Process::erase_thread_name(pid_t tid, PerfClock::time_point until) {
+  auto it = _thread_name_map.find(tid);
+  if (it == _thread_name_map.end()) {
+    return;
+  }
+  ThreadNameHistory &history = it->second;
+  history.erase(history.begin(),
+                std::upper_bound(history.begin(), history.end(), until,
+                                 set_after));
+  if (history.empty()) {
+    _thread_name_map.erase(it);
+  }
+}
+
+std::string Process::read_thread_name(pid_t tid) const {
   // Attempt to open the comm file for the thread
   const UniqueFile comm_file = open_proc_comm(_pid, tid);
   if (!comm_file) {
-    // Leave the empty string we just inserted
-    return it->second; // This will return the empty string
+    return {};
   }
 
   // Thread names in Linux are limited to 16 bytes, though 256 is fine
   char thread_name[256];
   if (fgets(thread_name, sizeof(thread_name), comm_file.get()) == nullptr) {
-    return it->second; // This will return the empty string
+    return {};
   }
 
   // Remove the trailing newline character if present
@@ -134,10 +176,7 @@ std::string_view Process::get_or_insert_thread_name(pid_t tid) {
   if (len > 0 && thread_name[len - 1] == '\n') {
     thread_name[len - 1] = '\0';
   }
-
-  // Update the value with the actual thread name
-  it->second = thread_name;
-  return it->second;
+  return thread_name;
 }
 
 const ContainerId &ProcessHdr::get_container_id(pid_t pid) {
@@ -157,6 +196,11 @@ Process &ProcessHdr::get(pid_t pid) {
   return it->second;
 }
 
+Process *ProcessHdr::find(pid_t pid) {
+  auto it = _process_map.find(pid);
+  return it != _process_map.end() ? &it->second : nullptr;
+}
+
 void ProcessHdr::reset_unvisited() {
   // clear the list of visited for next cycle
   _visited_pid.clear();
@@ -172,6 +216,39 @@ std::vector<pid_t> ProcessHdr::get_unvisited() const {
   return pids_remove;
 }
 
+void ProcessHdr::flag_exited(pid_t pid, PerfClock::time_point exit_time) {
+  _exited.emplace_back(pid, exit_time);
+}
+
+void ProcessHdr::cancel_exit(pid_t pid) {
+  std::erase_if(_exited, [pid](const auto &el) { return el.first == pid; });
+}
+
+std::vector<pid_t> ProcessHdr::take_exited(PerfClock::time_point deadline) {
+  std::vector<pid_t> pids;
+  while (!_exited.empty() && _exited.front().second < deadline) {
+    pids.push_back(_exited.front().first);
+    _exited.pop_front();
+  }
+  return pids;
+}
+
+void ProcessHdr::flag_thread_exited(pid_t pid, pid_t tid,
+                                    PerfClock::time_point exit_time) {
+  _exited_threads.push_back({pid, tid, exit_time});
+}
+
+void ProcessHdr::erase_exited_thread_names(PerfClock::time_point deadline) {
+  while (!_exited_threads.empty() &&
+         _exited_threads.front().exit_time < deadline) {
+    const ExitedThread &thread = _exited_threads.front();
+    if (Process *process = find(thread.pid); process) {
+      process->erase_thread_name(thread.tid, thread.exit_time);
+    }
+    _exited_threads.pop_front();
+  }
+}
+
 int ProcessHdr::get_nb_mod() const {
   int nb_mods = 0;
   std::for_each(_process_map.begin(), _process_map.end(),
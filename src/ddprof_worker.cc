@@ -5,29 +5,52 @@
 
 #include "ddprof_worker.hpp"
 
+#include "control_command.hpp"
+#include "cpu_budget_governor.hpp"
 #include "ddprof_context.hpp"
+#include "ddprof_context_lib.hpp"
 #include "ddprof_perf_event.hpp"
 #include "ddprof_stats.hpp"
 #include "dso_hdr.hpp"
 #include "exporter/ddprof_exporter.hpp"
+#include "ipc.hpp"
 #include "logger.hpp"
 #include "perf.hpp"
 #include "pevent_lib.hpp"
 #include "pprof/ddprof_pprof.hpp"
+#include "process_ring_buffers.hpp"
 #include "procutils.hpp"
+#include "ring_buffer_sizer.hpp"
+#include "ringbuffer_utils.hpp"
 #include "symbolizer.hpp"
+#include "sys_utils.hpp"
 #include "tags.hpp"
 #include "tsc_clock.hpp"
+#include "unique_fd.hpp"
 #include "unwind.hpp"
 #include "unwind_helper.hpp"
 #include "unwind_state.hpp"
 
+#include <absl/strings/str_format.h>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
 #include <chrono>
+#include <cmath>
 #include <ctime>
+#include <optional>
+#include <span>
+#include <string>
+#include <sys/socket.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <utility>
+#include <vector>
 
 static constexpr std::chrono::seconds k_export_timeout{60};
+// time given to a client of the control socket to send its command
+static constexpr std::chrono::milliseconds k_control_command_timeout{100};
 
 namespace ddprof {
 
@@ -36,7 +59,10 @@ namespace {
 const DDPROF_STATS s_cycled_stats[] = {
     STATS_UNWIND_AVG_TIME, STATS_AGGREGATION_AVG_TIME, STATS_EVENT_COUNT,
     STATS_EVENT_LOST,      STATS_EVENT_DEALLOC_LOST,   STATS_EVENT_OUT_OF_ORDER,
-    STATS_SAMPLE_COUNT,    STATS_TARGET_CPU_USAGE};
+    STATS_SAMPLE_COUNT,    STATS_SAMPLE_SHED,          STATS_TARGET_CPU_USAGE,
+    STATS_UNWIND_CACHE_HITS, STATS_PROCESS_EXIT_FREED, STATS_SAMPLE_COUNTED,
+    STATS_PROCESS_EVICTED, STATS_RING_BUFFER_PROCESS_LOST,
+    STATS_RING_BUFFER_PROCESS_MAX_LOST};
 
 const long k_clock_ticks_per_sec = sysconf(_SC_CLK_TCK);
 
@@ -84,6 +110,96 @@ DDRes report_lost_events(DDProfContext &ctx) {
   return {};
 }
 
+// Choose the next sizes of perf ring buffers from their usage (lost events
+// are read before being reported). Growing ring buffers requires a worker
+// restart: it is requested for the next export.
+DDRes worker_size_ring_buffers(DDProfContext &ctx) {
+  DDProfWorkerContext &worker_ctx = ctx.worker_ctx;
+  std::span const pevents{worker_ctx.pevent_hdr.pes,
+                          worker_ctx.pevent_hdr.size};
+  std::vector<RingBufferOrder> orders;
+  std::vector<RingBufferUsage> usage;
+  std::vector<size_t> pevent_indices;
+  size_t total_size = 0;
+  for (size_t i = 0; i < pevents.size(); ++i) {
+    const PEvent &pevent = pevents[i];
+    if (pevent.custom_event || pevent.mapfd == -1) {
+      continue;
+    }
+    total_size += pevent.ring_buffer_size;
+    if (pevent.overwrite) {
+      // only read on dumps (flight recorder), the history keeps its length
+      continue;
+    }
+    RingBufferUsage &pevent_usage = worker_ctx.ring_buffer_usage[i];
+    if (worker_ctx.lost_events_per_watcher[pevent.watcher_pos]) {
+      pevent_usage.lost_events = true;
+    }
+    // size is a power of 2 pages, plus the metadata page
+    int const order = std::countr_zero(
+        pevent.ring_buffer_size / get_page_size() - 1);
+    orders.push_back(
+        {order, pevent_initial_mmap_order(ctx.watchers[pevent.watcher_pos])});
+    usage.push_back(pevent_usage);
+    pevent_indices.push_back(i);
+  }
+  ddprof_stats_set(STATS_RING_BUFFER_SIZE, total_size);
+  ddprof_stats_set(STATS_RING_BUFFER_GROWN,
+                   std::count_if(orders.begin(), orders.end(),
+                                 [](const RingBufferOrder &order) {
+                                   return order.order > order.min_order;
+                                 }));
+  if (ctx.params.ring_buffer_budget_mib <= 0) {
+    return {};
+  }
+
+  size_t const budget_pages =
+      (static_cast<size_t>(ctx.params.ring_buffer_budget_mib) << 20) /
+      get_page_size();
+  std::vector<int> next_orders(orders.size());
+  bool const grew =
+      ring_buffer_next_orders(orders, usage, budget_pages, next_orders);
+  for (size_t k = 0; k < next_orders.size(); ++k) {
+    worker_ctx.persistent_worker_state->ring_buffer_orders[pevent_indices[k]] =
+        static_cast<int8_t>(next_orders[k]);
+  }
+  if (grew && !worker_ctx.ring_buffer_resize_requested) {
+    LG_NTC("Ring buffers lost events, restarting worker to grow them");
+    worker_ctx.ring_buffer_resize_requested = true;
+  }
+  return {};
+}
+
+// Events of count-only watchers are reported with a synthetic stack: the raw
+// field value (if any) on top of the process frame
+DDRes report_event_counts(DDProfContext &ctx) {
+  EventCounts &event_counts = ctx.worker_ctx.event_counts;
+  UnwindState *us = ctx.worker_ctx.us;
+  for (const auto &[key, count] : event_counts.counts()) {
+    const PerfWatcher *watcher = &ctx.watchers[key.watcher_pos];
+    us->output.clear();
+    us->output.pid = key.pid;
+    us->output.tid = key.tid;
+    us->pid = key.pid;
+    if (watcher->value_source == EventConfValueSource::kRaw) {
+      SymbolIdx_t const symbol_idx = event_counts.get_or_insert_raw_symbol(
+          key.watcher_pos, watcher->tracepoint_label, key.raw_value,
+          us->symbol_hdr._symbol_table);
+      DDRES_CHECK_FWD(add_frame(symbol_idx, k_file_info_undef,
+                                k_mapinfo_idx_null, 0, 0, us));
+    }
+    add_virtual_base_frame(us);
+    DDRES_CHECK_FWD(pprof_aggregate(
+        &us->output, us->symbol_hdr,
+        {static_cast<int64_t>(count.value), count.count, 0}, watcher,
+        us->dso_hdr.get_file_info_vector(), false, kSumPos,
+        ctx.worker_ctx.symbolizer,
+        ctx.worker_ctx.pprof[ctx.worker_ctx.i_current_pprof]));
+  }
+  event_counts.clear();
+  return {};
+}
+
 std::chrono::system_clock::time_point perfclock_epoch_to_system_time() {
   return std::chrono::system_clock::now() -
       ddprof::PerfClock::now().time_since_epoch();
@@ -138,6 +254,11 @@ DDRes worker_update_stats(DDProfWorkerContext &worker_context,
   ddprof_stats_set(
       STATS_ALREADY_EXISTING_ALLOCATION_COUNT,
       worker_context.live_allocation.get_nb_already_existing_allocations());
+  ddprof_stats_set(
+      STATS_RECONCILED_ALLOCATION_COUNT,
+      worker_context.live_allocation.get_nb_reconciled_allocations());
+  ddprof_stats_set(STATS_OFF_CPU_THREADS,
+                   worker_context.off_cpu_tracker.size());
   // Symbol stats
   ddprof_stats_set(STATS_UNUSED_SYMBOLS_BINARIES_COUNT,
                    count_symbolizer_cleared);
@@ -181,26 +302,35 @@ DDRes worker_update_stats(DDProfWorkerContext &worker_context,
   return {};
 }
 
-DDRes ddprof_unwind_sample(DDProfContext &ctx, perf_event_sample *sample,
-                           int watcher_pos, bool &inconsistent_pid_state) {
+DDRes ddprof_unwind_sample(DDProfContext &ctx, const PerfSampleView &sample,
+                           int watcher_pos, uint32_t weight,
+                           bool &inconsistent_pid_state) {
   inconsistent_pid_state = false;
   struct UnwindState *us = ctx.worker_ctx.us;
   PerfWatcher *watcher = &ctx.watchers[watcher_pos];
 
   ddprof_stats_add(STATS_SAMPLE_COUNT, 1, nullptr);
-  ddprof_stats_add(STATS_UNWIND_AVG_STACK_SIZE, sample->size_stack, nullptr);
+  ddprof_stats_add(STATS_UNWIND_AVG_STACK_SIZE, sample.size_stack(), nullptr);
 
   // copy the sample context into the unwind structure
-  unwind_init_sample(us, sample->regs, sample->pid, sample->size_stack,
-                     sample->data_stack);
+  unwind_init_sample(us, sample.regs(), sample.pid(), sample.size_stack(),
+                     sample.data_stack());
 
   // If a sample has a PID, it has a TID.  Include it for downstream labels
-  us->output.pid = sample->pid;
-  us->output.tid = sample->tid;
+  us->output.pid = sample.pid();
+  us->output.tid = sample.tid();
+  // processes are ranked on the samples they represent (load shedding)
+  us->sample_weight = weight;
+  if (watcher->sample_type & PERF_SAMPLE_TIME) {
+    us->sample_time = perf_clock_time_point_from_timestamp(sample.time());
+  }
+  if (watcher->sample_type & k_perf_sample_cgroup) {
+    us->cgroup_id = sample.cgroup();
+  }
 
   // If this is a SW_TASK_CLOCK-type event, then aggregate the time
   if (watcher->config == PERF_COUNT_SW_TASK_CLOCK) {
-    ddprof_stats_add(STATS_TARGET_CPU_USAGE, sample->period, nullptr);
+    ddprof_stats_add(STATS_TARGET_CPU_USAGE, sample.period(), nullptr);
   }
 
   // Attempt to fully unwind if the watcher has a callgraph type
@@ -225,7 +355,7 @@ DDRes ddprof_unwind_sample(DDProfContext &ctx, perf_event_sample *sample,
    * That's why we consider the stack as truncated in input only if it is also
    * detected as incomplete during unwinding.
    */
-  if (sample->size_stack ==
+  if (sample.size_stack() ==
       ctx.watchers[watcher_pos].options.stack_sample_size) {
     ddprof_stats_add(STATS_UNWIND_TRUNCATED_INPUT, 1, nullptr);
   }
@@ -305,6 +435,7 @@ DDRes worker_pid_free(DDProfContext &ctx, pid_t el) {
   UnwindState *us = ctx.worker_ctx.us;
   unwind_pid_free(us, el);
   ctx.worker_ctx.live_allocation.clear_pid(el);
+  ctx.worker_ctx.off_cpu_tracker.clear_pid(el);
   return {};
 }
 
@@ -324,6 +455,22 @@ DDRes clear_unvisited_pids(DDProfContext &ctx) {
   return {};
 }
 
+// Free state of processes whose grace window after exit elapsed
+DDRes free_exited_pids(DDProfContext &ctx) {
+  ProcessHdr &process_hdr = ctx.worker_ctx.us->process_hdr;
+  if (!process_hdr.exited_count()) {
+    return {};
+  }
+  const std::vector<pid_t> pids =
+      unwind_take_exited_pids(ctx.worker_ctx.us, PerfClock::now());
+  for (pid_t const pid : pids) {
+    LG_DBG("Freeing state of exited pid %d", pid);
+    DDRES_CHECK_FWD(worker_pid_free(ctx, pid));
+  }
+  ddprof_stats_add(STATS_PROCESS_EXIT_FREED, pids.size(), nullptr);
+  return {};
+}
+
 [[maybe_unused]] DDRes worker_init_stats(DDProfWorkerContext *worker_ctx) {
   DDRES_CHECK_FWD(proc_read(&worker_ctx->proc_status));
   worker_ctx->cycle_start_time = std::chrono::steady_clock::now();
@@ -333,16 +480,29 @@ DDRes clear_unvisited_pids(DDProfContext &ctx) {
 /************************* perf_event_open() helpers **************************/
 void ddprof_pr_mmap(DDProfContext &ctx, const perf_event_mmap2 *map,
                     int watcher_pos, PerfClock::time_point timestamp) {
-  LG_DBG("<%d>(MAP)%d: %s (%lx/%lx/%lx) %c%c%c %02u:%02u %lu", watcher_pos,
-         map->pid, map->filename, map->addr, map->len, map->pgoff,
+  bool const has_build_id =
+      map->header.misc & k_perf_record_misc_mmap_build_id;
+  LG_DBG("<%d>(MAP)%d: %s (%lx/%lx/%lx) %c%c%c %s", watcher_pos, map->pid,
+         map->filename, map->addr, map->len, map->pgoff,
          map->prot & PROT_READ ? 'r' : '-', map->prot & PROT_WRITE ? 'w' : '-',
-         map->prot & PROT_EXEC ? 'x' : '-', map->maj, map->min, map->ino);
+         map->prot & PROT_EXEC ? 'x' : '-', has_build_id ? "build-id" : "");
+  // the build id replaces the device / inode information
   Dso new_dso(map->pid, map->addr, map->addr + map->len - 1, map->pgoff,
-              std::string(map->filename), map->ino, map->prot);
-  ctx.worker_ctx.us->dso_hdr.maybe_insert_erase_overlap(std::move(new_dso),
-                                                        timestamp);
+              std::string(map->filename), has_build_id ? 0 : map->ino,
+              map->prot);
+  if (has_build_id) {
+    new_dso.set_build_id(
+        {map->build_id, std::min<size_t>(map->build_id_size,
+                                         sizeof(map->build_id))});
+  }
+  UnwindState *us = ctx.worker_ctx.us;
+  if (us->dso_hdr.maybe_insert_erase_overlap(std::move(new_dso), timestamp) &&
+      (map->prot & PROT_EXEC)) {
+    // cached frames might refer to replaced mappings
+    us->unwind_cache.clear(map->pid);
+  }
   // ensure we access the process (to avoid a premature clear)
-  ctx.worker_ctx.us->process_hdr.flag_visited(map->pid);
+  us->process_hdr.flag_visited(map->pid);
 }
 
 void ddprof_pr_lost(DDProfContext &ctx, const perf_event_lost *lost,
@@ -352,41 +512,69 @@ void ddprof_pr_lost(DDProfContext &ctx, const perf_event_lost *lost,
 }
 
 DDRes ddprof_pr_comm(DDProfContext &ctx, const perf_event_comm *comm,
-                     int watcher_pos) {
+                     int watcher_pos, PerfClock::time_point timestamp) {
+  ProcessHdr &process_hdr = ctx.worker_ctx.us->process_hdr;
   // Change in process name (assuming exec) : clear all associated dso
   if (comm->header.misc & PERF_RECORD_MISC_COMM_EXEC) {
     LG_DBG("<%d>(COMM)%d -> %s", watcher_pos, comm->pid, comm->comm);
     DDRES_CHECK_FWD(worker_pid_free(ctx, comm->pid));
+    process_hdr.get(comm->pid).set_thread_name(comm->tid, comm->comm,
+                                               timestamp);
+  } else if (Process *process = process_hdr.find(comm->pid)) {
+    // Thread rename (eg. prctl(PR_SET_NAME))
+    LG_DBG("<%d>(COMM)%d/%d -> %s", watcher_pos, comm->pid, comm->tid,
+           comm->comm);
+    process->set_thread_name(comm->tid, comm->comm, timestamp);
   }
   return {};
 }
 
 DDRes ddprof_pr_fork(DDProfContext &ctx, const perf_event_fork *frk,
-                     int watcher_pos) {
+                     int watcher_pos, PerfClock::time_point timestamp) {
   LG_DBG("<%d>(FORK)%d -> %d/%d", watcher_pos, frk->ppid, frk->pid, frk->tid);
+  ProcessHdr &process_hdr = ctx.worker_ctx.us->process_hdr;
   if (frk->ppid != frk->pid) {
     // Clear everything and populate at next error or with coming samples
     DDRES_CHECK_FWD(worker_pid_free(ctx, frk->pid));
+    // pid could be reused before the end of the grace window of its exit
+    process_hdr.cancel_exit(frk->pid);
     ctx.worker_ctx.us->dso_hdr.pid_fork(frk->pid, frk->ppid);
     // ensure we access the process (to avoid a premature clear)
-    ctx.worker_ctx.us->process_hdr.flag_visited(frk->pid);
+    process_hdr.flag_visited(frk->pid);
+  }
+  // New tasks inherit the name of the thread that created them
+  Process *parent = process_hdr.find(frk->ppid);
+  if (parent) {
+    std::string const name{
+        parent->get_or_insert_thread_name(frk->ptid, timestamp)};
+    process_hdr.get(frk->pid).set_thread_name(frk->tid, name, timestamp);
   }
   return {};
 }
 
 void ddprof_pr_exit(DDProfContext &ctx, const perf_event_exit *ext,
-                    int watcher_pos) {
+                    int watcher_pos, PerfClock::time_point timestamp) {
   // On Linux, it seems that the thread group leader is the one whose task ID
   // matches the process ID of the group.  Moreover, it seems that it is the
   // overwhelming convention that this thread is closed after the other threads
   // (upheld by both pthreads and runtimes).
-  // We do not clear the PID at this time because we currently cleanup anyway.
-  (void)ctx;
+  // State of the PID is freed once the exit grace window elapsed, samples of
+  // the process might still be pending in other ring buffers.
   if (ext->pid == ext->tid) {
     LG_DBG("<%d>(EXIT)%d", watcher_pos, ext->pid);
+    ctx.worker_ctx.us->process_hdr.flag_exited(ext->pid, timestamp);
+    if (ctx.worker_ctx.process_ring_buffers) {
+      ctx.worker_ctx.process_ring_buffers->release_pid(ext->pid, timestamp);
+    }
   } else {
     LG_DBG("<%d>(EXIT)%d/%d", watcher_pos, ext->pid, ext->tid);
+    // Thread ids can be reused, drop name history of exited thread once
+    // samples still in flight were labelled
+    ctx.worker_ctx.us->process_hdr.flag_thread_exited(ext->pid, ext->tid,
+                                                      timestamp);
+    ctx.worker_ctx.off_cpu_tracker.clear_tid(ext->tid);
   }
+  ctx.worker_ctx.counter_group_deltas.thread_exit(ext->tid);
 }
 
 void ddprof_pr_clear_live_allocation(DDProfContext &ctx,
@@ -399,26 +587,121 @@ void ddprof_pr_clear_live_allocation(DDProfContext &ctx,
 
 void ddprof_pr_deallocation(DDProfContext &ctx, const DeallocationEvent *event,
                             int watcher_pos) {
-  ctx.worker_ctx.live_allocation.register_deallocation(event->ptr, watcher_pos,
-                                                       event->sample_id.pid);
+  ctx.worker_ctx.live_allocation.register_deallocation(
+      event->ptr, watcher_pos, event->sample_id.pid,
+      perf_clock_time_point_from_timestamp(event->sample_id.time));
 }
 
-/// Entry point for sample aggregation
-DDRes ddprof_pr_sample(DDProfContext &ctx, perf_event_sample *sample,
-                       int watcher_pos) {
-  if (!sample) {
-    return ddres_warn(DD_WHAT_PERFSAMP);
+void ddprof_pr_deallocation_batch(DDProfContext &ctx,
+                                  const DeallocationBatchEvent *event,
+                                  int watcher_pos) {
+  uint64_t const max_nb_deallocations =
+      (event->hdr.size - sizeof(DeallocationBatchEvent)) /
+      sizeof(DeallocationBatchEvent::Deallocation);
+  uint64_t const nb_deallocations =
+      std::min(event->nb_deallocations, max_nb_deallocations);
+  for (uint64_t i = 0; i < nb_deallocations; ++i) {
+    const auto &dealloc = event->deallocations[i];
+    ctx.worker_ctx.live_allocation.register_deallocation(
+        dealloc.ptr, watcher_pos, event->sample_id.pid,
+        perf_clock_time_point_from_timestamp(dealloc.time));
+  }
+}
+
+void ddprof_worker_reconcile_live_allocations(
+    DDProfContext &ctx, const LiveAddressSnapshot &snapshot) {
+  int const watcher_pos = context_allocation_profiling_watcher_idx(ctx);
+  if (watcher_pos == -1) {
+    return;
+  }
+  ctx.worker_ctx.live_allocation.reconcile(
+      watcher_pos, snapshot.pid, snapshot.addresses,
+      perf_clock_time_point_from_timestamp(snapshot.timestamp));
+}
+
+// Count-only watchers: no stack to unwind, the raw field (if any) is a key
+void ddprof_pr_counted_sample(DDProfContext &ctx, const PerfSampleView &sample,
+                              int watcher_pos, uint32_t weight) {
+  const PerfWatcher *watcher = &ctx.watchers[watcher_pos];
+  uint64_t const raw_value =
+      watcher->value_source == EventConfValueSource::kRaw
+      ? perf_value_from_sample(watcher, sample)
+      : 0;
+  uint64_t const value = watcher->value_source == EventConfValueSource::kRaw
+      ? sample.period()
+      : perf_value_from_sample(watcher, sample);
+  ctx.worker_ctx.event_counts.add(
+      {watcher_pos, static_cast<pid_t>(sample.pid()),
+       static_cast<pid_t>(sample.tid()), raw_value},
+      value * weight, weight);
+  ddprof_stats_add(STATS_SAMPLE_COUNTED, 1, nullptr);
+}
+
+struct GroupValues {
+  // reported as values of the sample of the leader
+  std::array<DDProfGroupValue, kMaxTypeWatcher> merged;
+  size_t nb_merged{0};
+  // reported as samples of their own, with the stack of the leader
+  std::array<DDProfGroupValue, kMaxTypeWatcher> separate;
+  size_t nb_separate{0};
+};
+
+// Counters read with a sample of a group leader are merged in the sample of
+// the leader, unless their pprof value is already taken or they are told apart
+// by a label (hardware counters share the tracepoint sample type)
+GroupValues split_group_counters(DDProfContext &ctx,
+                                 const PerfSampleView &sample, int leader_pos,
+                                 uint32_t weight) {
+  GroupValues group_values;
+  // in pid mode, events are per thread (inherited)
+  std::span<const uint64_t> const deltas =
+      ctx.worker_ctx.counter_group_deltas.update(sample, ctx.params.pid > 0);
+  std::array<bool, k_max_value_types> used_values{};
+  used_values[ctx.watchers[leader_pos].pprof_indices[kSumPos].pprof_index] =
+      true;
+  // members follow the leader in the order of the watchers
+  size_t member = 0;
+  for (size_t watcher_pos = leader_pos + 1;
+       watcher_pos < ctx.watchers.size() && member < deltas.size();
+       ++watcher_pos) {
+    const PerfWatcher *watcher = &ctx.watchers[watcher_pos];
+    if (watcher->group_leader_pos != leader_pos) {
+      continue;
+    }
+    // the delta since the previous read already covers the samples skipped by
+    // load shedding: only the count is scaled
+    const DDProfGroupValue value{
+        watcher, static_cast<int64_t>(deltas[member++]), weight};
+    int const pprof_index = watcher->pprof_indices[kSumPos].pprof_index;
+    if (!watcher_has_tracepoint(watcher) && !used_values[pprof_index]) {
+      used_values[pprof_index] = true;
+      group_values.merged[group_values.nb_merged++] = value;
+    } else {
+      group_values.separate[group_values.nb_separate++] = value;
+    }
   }
+  return group_values;
+}
 
+/// Entry point for sample aggregation
+/// `weight` is the number of samples this sample accounts for (> 1 when other
+/// samples were skipped by load shedding)
+DDRes ddprof_pr_sample(DDProfContext &ctx, const PerfSampleView &sample,
+                       int watcher_pos, uint32_t weight) {
+  if (ctx.watchers[watcher_pos].options.count_only) {
+    ddprof_pr_counted_sample(ctx, sample, watcher_pos, weight);
+    return {};
+  }
   // If this is a SW_TASK_CLOCK-type event, then aggregate the time
   if (ctx.watchers[watcher_pos].config == PERF_COUNT_SW_TASK_CLOCK) {
-    ddprof_stats_add(STATS_TARGET_CPU_USAGE, sample->period, nullptr);
+    ddprof_stats_add(STATS_TARGET_CPU_USAGE, sample.period() * weight,
+                     nullptr);
   }
 
   auto ticks0 = TscClock::cycles_now();
   bool inconsistent_pid_state = false;
-  DDRes const res =
-      ddprof_unwind_sample(ctx, sample, watcher_pos, inconsistent_pid_state);
+  DDRes const res = ddprof_unwind_sample(ctx, sample, watcher_pos, weight,
+                                         inconsistent_pid_state);
   auto unwind_ticks = TscClock::cycles_now();
   ddprof_stats_add(STATS_UNWIND_AVG_TIME, unwind_ticks - ticks0, nullptr);
 
@@ -430,12 +713,18 @@ DDRes ddprof_pr_sample(DDProfContext &ctx, perf_event_sample *sample,
   if (!IsDDResFatal(res)) {
     struct UnwindState *us = ctx.worker_ctx.us;
     if (Any(EventAggregationMode::kLiveSum & watcher->aggregation_mode) &&
-        sample->addr) {
+        sample.addr()) {
       // null address means we should not account it
       ctx.worker_ctx.live_allocation.register_allocation(
-          us->output, sample->addr, sample->period, watcher_pos, sample->pid);
+          us->output, sample.addr(), sample.period() * weight, watcher_pos,
+          sample.pid(), perf_clock_time_point_from_timestamp(sample.time()));
     }
-    if (Any(EventAggregationMode::kSum & watcher->aggregation_mode)) {
+    if (watcher_is_off_cpu(watcher)) {
+      // Blocked time is only known once the thread is switched back in
+      ctx.worker_ctx.off_cpu_tracker.switch_out(
+          us->output, perf_clock_time_point_from_timestamp(sample.time()),
+          sample.period() * weight);
+    } else if (Any(EventAggregationMode::kSum & watcher->aggregation_mode)) {
       // Depending on the type of watcher, compute a value for sample
       uint64_t const sample_val = perf_value_from_sample(watcher, sample);
 
@@ -447,16 +736,31 @@ DDRes ddprof_pr_sample(DDProfContext &ctx, perf_event_sample *sample,
       // it is, we also want to adjust the source to be in the system_time
       // frame
       uint64_t timestamp = 0;
-      if (ctx.params.timeline && sample->time != 0) {
-        timestamp = sample->time + ctx.worker_ctx.perfclock_offset;
+      if (ctx.params.timeline && sample.time() != 0) {
+        timestamp = sample.time() + ctx.worker_ctx.perfclock_offset;
+      }
+      GroupValues group_values;
+      if (watcher->sample_type & PERF_SAMPLE_READ) {
+        group_values = split_group_counters(ctx, sample, watcher_pos, weight);
       }
-      const DDProfValuePack pack{static_cast<int64_t>(sample_val), 1,
-                                 timestamp};
+      const DDProfValuePack pack{
+          static_cast<int64_t>(sample_val * weight), weight, timestamp,
+          std::span{group_values.merged.data(), group_values.nb_merged}};
 
       DDRES_CHECK_FWD(pprof_aggregate(
           &us->output, us->symbol_hdr, pack, watcher,
           us->dso_hdr.get_file_info_vector(), ctx.params.show_samples, kSumPos,
           ctx.worker_ctx.symbolizer, pprof));
+      // The stack is shared with the counters that need their own sample
+      for (size_t i = 0; i < group_values.nb_separate; ++i) {
+        const DDProfGroupValue &counter = group_values.separate[i];
+        const DDProfValuePack counter_pack{counter.value, counter.count,
+                                           timestamp};
+        DDRES_CHECK_FWD(pprof_aggregate(
+            &us->output, us->symbol_hdr, counter_pack, counter.watcher,
+            us->dso_hdr.get_file_info_vector(), ctx.params.show_samples,
+            kSumPos, ctx.worker_ctx.symbolizer, pprof));
+      }
     }
   }
   // We need to free the PID only after any aggregation operations
@@ -469,6 +773,42 @@ DDRes ddprof_pr_sample(DDProfContext &ctx, perf_event_sample *sample,
   return {};
 }
 
+// Report the time spent off CPU by a thread switched back in, with the stack
+// sampled when it was switched out
+DDRes ddprof_pr_switch(DDProfContext &ctx, const perf_event_header *hdr,
+                       int watcher_pos, PerfClock::time_point timestamp) {
+  if (hdr->misc & PERF_RECORD_MISC_SWITCH_OUT) {
+    return {};
+  }
+  // the sample id is the one of the thread switched in
+  pid_t const tid = hdr->type == PERF_RECORD_SWITCH_CPU_WIDE
+      ? reinterpret_cast<const perf_event_switch_cpu_wide *>(hdr)->sample_id.tid
+      : reinterpret_cast<const perf_event_switch *>(hdr)->sample_id.tid;
+  OffCpuTracker::OffCpuSample const off_cpu =
+      ctx.worker_ctx.off_cpu_tracker.switch_in(tid, timestamp);
+  if (!off_cpu.output) {
+    return {};
+  }
+  const PerfWatcher *watcher = &ctx.watchers[watcher_pos];
+  const UnwindState *us = ctx.worker_ctx.us;
+  DDProfPProf *pprof = ctx.worker_ctx.pprof[ctx.worker_ctx.i_current_pprof];
+  // timeline shows the sample when the thread was switched out
+  uint64_t switch_out_timestamp = 0;
+  if (ctx.params.timeline) {
+    switch_out_timestamp =
+        (timestamp - off_cpu.off_cpu_time).time_since_epoch().count() +
+        ctx.worker_ctx.perfclock_offset;
+  }
+  const DDProfValuePack pack{
+      static_cast<int64_t>(off_cpu.off_cpu_time.count() * off_cpu.scale),
+      off_cpu.scale, switch_out_timestamp};
+  DDRES_CHECK_FWD(pprof_aggregate(
+      off_cpu.output, us->symbol_hdr, pack, watcher,
+      us->dso_hdr.get_file_info_vector(), ctx.params.show_samples, kSumPos,
+      ctx.worker_ctx.symbolizer, pprof));
+  return {};
+}
+
 void ddprof_pr_allocation_tracker_state(
     DDProfContext &ctx, const AllocationTrackerStateEvent *event,
     int watcher_pos) {
@@ -479,8 +819,250 @@ void ddprof_pr_allocation_tracker_state(
   ddprof_stats_add(STATS_EVENT_LOST, event->lost_alloc_count, nullptr);
   ddprof_stats_add(STATS_EVENT_DEALLOC_LOST, event->lost_dealloc_count,
                    nullptr);
+  ddprof_stats_set(STATS_ADDRESS_TABLE_LOAD_FACTOR,
+                   event->address_table_load_factor_pct);
+  ddprof_stats_set(STATS_ADDRESS_TABLE_MAX_PROBE,
+                   event->address_table_max_probe_length);
   ctx.worker_ctx.lost_events_per_watcher[watcher_pos] +=
       event->lost_alloc_count;
+  if (ctx.worker_ctx.process_ring_buffers) {
+    uint64_t const nb_lost =
+        event->lost_alloc_count + event->lost_dealloc_count;
+    uint64_t const process_nb_lost =
+        ctx.worker_ctx.process_ring_buffers->add_lost_events(
+            event->sample_id.pid, nb_lost);
+    if (process_nb_lost) {
+      // events lost by processes with a dedicated ring buffer
+      ddprof_stats_add(STATS_RING_BUFFER_PROCESS_LOST, nb_lost, nullptr);
+      long max_lost = 0;
+      ddprof_stats_get(STATS_RING_BUFFER_PROCESS_MAX_LOST, &max_lost);
+      if (process_nb_lost > static_cast<uint64_t>(max_lost)) {
+        ddprof_stats_set(STATS_RING_BUFFER_PROCESS_MAX_LOST, process_nb_lost);
+      }
+    }
+  }
+}
+
+// Recreate current profile so that its period matches effective rate
+DDRes recreate_current_profile(DDProfContext &ctx) {
+  DDProfPProf *pprof = ctx.worker_ctx.pprof[ctx.worker_ctx.i_current_pprof];
+  DDRES_CHECK_FWD(pprof_free_profile(pprof));
+  DDRES_CHECK_FWD(pprof_create_profile(pprof, ctx));
+  return {};
+}
+
+// Apply sampling rates of watchers (scaled by CPU budget) to perf events
+DDRes update_sample_rates(DDProfContext &ctx) {
+  DDProfWorkerContext &worker_ctx = ctx.worker_ctx;
+  for (int i = 0; i < static_cast<int>(ctx.watchers.size()); ++i) {
+    uint64_t const value = watcher_scaled_sample_value(
+        ctx.watchers[i], worker_ctx.sampling_rate_scale);
+    if (value) {
+      DDRES_CHECK_FWD(
+          pevent_update_sample_rate(&worker_ctx.pevent_hdr, i, value));
+    }
+  }
+  return recreate_current_profile(ctx);
+}
+
+// Lower (or restore) sampling rates depending on the CPU used by the profiler
+DDRes worker_apply_cpu_budget(DDProfContext &ctx) {
+  DDProfWorkerContext &worker_ctx = ctx.worker_ctx;
+  if (ctx.params.cpu_budget_millicores > 0) {
+    long millicores = 0;
+    DDRES_CHECK_FWD(ddprof_stats_get(STATS_PROFILER_CPU_USAGE, &millicores));
+    double const scale =
+        cpu_budget_next_rate_scale(worker_ctx.sampling_rate_scale, millicores,
+                                   ctx.params.cpu_budget_millicores);
+    if (scale != worker_ctx.sampling_rate_scale) {
+      LG_NTC("Profiler CPU usage %ldm (budget %dm), sampling at %.1f%% of "
+             "configured rates",
+             millicores, ctx.params.cpu_budget_millicores, scale * 100);
+      worker_ctx.sampling_rate_scale = scale;
+      worker_ctx.persistent_worker_state->sampling_rate_scale = scale;
+      DDRES_CHECK_FWD(update_sample_rates(ctx));
+    }
+  }
+  ddprof_stats_set(STATS_SAMPLING_RATE_PCT,
+                   std::lround(worker_ctx.sampling_rate_scale * 100));
+  return {};
+}
+
+const char *watcher_name(const PerfWatcher &watcher) {
+  if (!watcher.tracepoint_label.empty()) {
+    return watcher.tracepoint_label.c_str();
+  }
+  return event_type_name_from_idx(watcher.ddprof_event_type);
+}
+
+// Position of the watcher designated by `name` (position or name), -1 if none
+int find_watcher(const DDProfContext &ctx, std::string_view name) {
+  int pos = -1;
+  auto [ptr, ec] = std::from_chars(name.data(), name.data() + name.size(), pos);
+  if (ec == std::errc{} && ptr == name.data() + name.size()) {
+    return pos >= 0 && pos < static_cast<int>(ctx.watchers.size()) ? pos : -1;
+  }
+  for (int i = 0; i < static_cast<int>(ctx.watchers.size()); ++i) {
+    const char *watcher_str = watcher_name(ctx.watchers[i]);
+    if (watcher_str && name == watcher_str) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void set_sample_value(PerfWatcher &watcher, int64_t value) {
+  if (watcher.options.is_freq) {
+    watcher.sample_frequency = value;
+  } else {
+    watcher.sample_period = value;
+  }
+}
+
+std::string control_status(const DDProfContext &ctx) {
+  const PersistentWorkerState &state = *ctx.worker_ctx.persistent_worker_state;
+  std::string status =
+      absl::StrFormat("sampling at %.1f%% of configured rates\n",
+                      ctx.worker_ctx.sampling_rate_scale * 100);
+  for (int i = 0; i < static_cast<int>(ctx.watchers.size()); ++i) {
+    const PerfWatcher &watcher = ctx.watchers[i];
+    absl::StrAppendFormat(
+        &status, "#%d %s %s=%d%s%s\n", i, watcher_name(watcher),
+        watcher.options.is_freq ? "frequency" : "period",
+        watcher.options.is_freq
+            ? static_cast<int64_t>(watcher.sample_frequency)
+            : watcher.sample_period,
+        watcher.group_leader_pos != -1 ? " (counter group member)" : "",
+        state.watcher_disabled[i] ? " (disabled)" : "");
+  }
+  return status;
+}
+
+// Returns an error message if the watcher can not sample at `value`
+std::string check_sample_value(const PerfWatcher &watcher, int64_t value) {
+  if (value <= 0) {
+    return "error: sampling value must be positive\n";
+  }
+  int32_t max_sample_rate = 0;
+  if (watcher.options.is_freq && watcher.type < kDDPROF_TYPE_CUSTOM &&
+      IsDDResOK(sys_perf_event_max_sample_rate(max_sample_rate)) &&
+      value > max_sample_rate) {
+    return absl::StrFormat(
+        "error: frequency above perf_event_max_sample_rate (%d)\n",
+        max_sample_rate);
+  }
+  return {};
+}
+
+// Check a command received on the control socket and queue it (changes are
+// applied at the next export). Returns the reply sent to the client.
+std::string worker_control(DDProfContext &ctx, const ControlCommand &command) {
+  switch (command.type) {
+  case ControlCommandType::kHelp:
+    return std::string(k_control_help);
+  case ControlCommandType::kStatus:
+    return control_status(ctx);
+  case ControlCommandType::kExport:
+    ctx.worker_ctx.export_requested = true;
+    return "ok\n";
+  case ControlCommandType::kDump:
+    if (!ctx.params.flight_recorder) {
+      return "error: flight recorder is not enabled\n";
+    }
+    ctx.worker_ctx.flight_recorder_dump_requested = true;
+    return "ok\n";
+  case ControlCommandType::kAllocationRate:
+    if (context_allocation_profiling_watcher_idx(ctx) == -1) {
+      return "error: allocation profiling is not enabled\n";
+    }
+    break;
+  case ControlCommandType::kRate:
+  case ControlCommandType::kEnable:
+  case ControlCommandType::kDisable: {
+    int const pos = find_watcher(ctx, command.watcher);
+    if (pos == -1) {
+      return "error: unknown watcher " + command.watcher + "\n";
+    }
+    const PerfWatcher &watcher = ctx.watchers[pos];
+    if (watcher.group_leader_pos != -1) {
+      return "error: members of a counter group follow their leader\n";
+    }
+    if (command.type != ControlCommandType::kRate &&
+        watcher.type >= kDDPROF_TYPE_CUSTOM) {
+      return "error: watcher can not be disabled, lower its rate instead\n";
+    }
+    if (command.type == ControlCommandType::kRate) {
+      std::string const error = check_sample_value(watcher, command.value);
+      if (!error.empty()) {
+        return error;
+      }
+    }
+    break;
+  }
+  }
+  ctx.worker_ctx.pending_control_commands.push_back(command);
+  return "ok, applied at next export\n";
+}
+
+// Apply the changes received on the control socket since last export
+DDRes worker_apply_control_commands(DDProfContext &ctx) {
+  DDProfWorkerContext &worker_ctx = ctx.worker_ctx;
+  PersistentWorkerState &state = *worker_ctx.persistent_worker_state;
+  bool rates_changed = false;
+  for (const ControlCommand &command : worker_ctx.pending_control_commands) {
+    int const pos = command.type == ControlCommandType::kAllocationRate
+        ? context_allocation_profiling_watcher_idx(ctx)
+        : find_watcher(ctx, command.watcher);
+    PerfWatcher &watcher = ctx.watchers[pos];
+    int64_t const previous_value = watcher.sample_period;
+    switch (command.type) {
+    case ControlCommandType::kRate:
+      // keep requesting deterministic allocation sampling
+      set_sample_value(watcher,
+                       watcher.sample_period < 0 && !watcher.options.is_freq
+                           ? -command.value
+                           : command.value);
+      break;
+    case ControlCommandType::kAllocationRate:
+      watcher.sample_period = command.value;
+      break;
+    case ControlCommandType::kEnable:
+    case ControlCommandType::kDisable: {
+      bool const enabled = command.type == ControlCommandType::kEnable;
+      DDRES_CHECK_FWD(
+          pevent_set_enabled(&worker_ctx.pevent_hdr, pos, enabled));
+      state.watcher_disabled[pos] = !enabled;
+      LG_NTC("Watcher #%d (%s) %s", pos, watcher_name(watcher),
+             enabled ? "enabled" : "disabled");
+      continue;
+    }
+    default:
+      continue;
+    }
+    if (!IsDDResOK(pevent_update_sample_rate(
+            &worker_ctx.pevent_hdr, pos,
+            watcher_scaled_sample_value(watcher,
+                                        worker_ctx.sampling_rate_scale)))) {
+      // rejected by the kernel: keep sampling at the previous value
+      LG_WRN("Unable to set sampling value of watcher #%d (%s) to %ld", pos,
+             watcher_name(watcher), command.value);
+      watcher.sample_period = previous_value;
+      pevent_update_sample_rate(
+          &worker_ctx.pevent_hdr, pos,
+          watcher_scaled_sample_value(watcher, worker_ctx.sampling_rate_scale));
+      continue;
+    }
+    // sample_period shares its storage with sample_frequency
+    state.sample_value_overrides[pos] = watcher.sample_period;
+    LG_NTC("Watcher #%d (%s) sampling value set to %ld", pos,
+           watcher_name(watcher), command.value);
+    rates_changed = true;
+  }
+  worker_ctx.pending_control_commands.clear();
+  if (rates_changed) {
+    DDRES_CHECK_FWD(recreate_current_profile(ctx));
+  }
+  return {};
 }
 
 void *ddprof_worker_export_thread(void *arg) {
@@ -525,9 +1107,23 @@ DDRes worker_library_init(DDProfContext &ctx,
 
     std::fill(ctx.worker_ctx.lost_events_per_watcher.begin(),
               ctx.worker_ctx.lost_events_per_watcher.end(), 0UL);
+    ctx.worker_ctx.ring_buffer_usage.fill({});
+    ctx.worker_ctx.ring_buffer_resize_requested = false;
 
     // register the existing persistent storage for the state
     ctx.worker_ctx.persistent_worker_state = persistent_worker_state;
+    // sampling rates of perf events were kept by the previous worker
+    if (persistent_worker_state->sampling_rate_scale > 0) {
+      ctx.worker_ctx.sampling_rate_scale =
+          persistent_worker_state->sampling_rate_scale;
+    }
+    // and so were the changes received on the control socket
+    for (size_t i = 0; i < ctx.watchers.size(); ++i) {
+      if (persistent_worker_state->sample_value_overrides[i]) {
+        set_sample_value(ctx.watchers[i],
+                         persistent_worker_state->sample_value_overrides[i]);
+      }
+    }
 
     PEventHdr *pevent_hdr = &ctx.worker_ctx.pevent_hdr;
 
@@ -605,7 +1201,9 @@ DDRes ddprof_worker_cycle(DDProfContext &ctx,
     return ddres_create(DD_SEV_ERROR, DD_WHAT_EXPORTER);
   }
 
+  DDRES_CHECK_FWD(worker_size_ring_buffers(ctx));
   DDRES_CHECK_FWD(report_lost_events(ctx));
+  DDRES_CHECK_FWD(report_event_counts(ctx));
 
   // Dispatch to thread
   ctx.worker_ctx.exp_error = false;
@@ -639,6 +1237,8 @@ DDRes ddprof_worker_cycle(DDProfContext &ctx,
   // Scrape procfs for process usage statistics
   DDRES_CHECK_FWD(worker_update_stats(ctx.worker_ctx, cycle_duration,
                                       count_symbolizers_cleared));
+  DDRES_CHECK_FWD(worker_apply_control_commands(ctx));
+  DDRES_CHECK_FWD(worker_apply_cpu_budget(ctx));
 
   // And emit diagnostic output (if it's enabled)
   print_diagnostics(ctx.worker_ctx.us->dso_hdr);
@@ -657,16 +1257,21 @@ DDRes ddprof_worker_cycle(DDProfContext &ctx,
   // allow new backpopulates
   ctx.worker_ctx.us->dso_hdr.reset_backpopulate_state();
 
-  // Update the time last sent
-  ctx.worker_ctx.send_time += ctx.params.upload_period;
-
-  // If the clock was frozen for some reason, we need to detect situations
-  // where we'll have catchup windows and reset the export timer.  This can
-  // easily happen under temporary load when the profiler is off-CPU, if the
-  // process is put in the cgroup freezer, or if we're being emulated.
-  if (now > ctx.worker_ctx.send_time) {
-    LG_WRN("Timer skew detected; frequent warnings may suggest system issue");
+  if (std::exchange(ctx.worker_ctx.export_requested, false)) {
+    // export requested on the control socket: start a new period
     export_time_set(ctx);
+  } else {
+    // Update the time last sent
+    ctx.worker_ctx.send_time += ctx.params.upload_period;
+
+    // If the clock was frozen for some reason, we need to detect situations
+    // where we'll have catchup windows and reset the export timer.  This can
+    // easily happen under temporary load when the profiler is off-CPU, if the
+    // process is put in the cgroup freezer, or if we're being emulated.
+    if (now > ctx.worker_ctx.send_time) {
+      LG_WRN("Timer skew detected; frequent warnings may suggest system issue");
+      export_time_set(ctx);
+    }
   }
   unwind_cycle(ctx.worker_ctx.us);
   ctx.worker_ctx.live_allocation.cycle();
@@ -680,10 +1285,12 @@ DDRes ddprof_worker_cycle(DDProfContext &ctx,
 DDRes ddprof_worker_maybe_export(DDProfContext &ctx,
                                  std::chrono::steady_clock::time_point now) {
   try {
-    if (now > ctx.worker_ctx.send_time) {
+    DDRES_CHECK_FWD(free_exited_pids(ctx));
+    if (now > ctx.worker_ctx.send_time || ctx.worker_ctx.export_requested) {
       // restart worker if number of uploads is reached
       ctx.worker_ctx.persistent_worker_state->restart_worker =
-          (ctx.worker_ctx.count_worker + 1 >= ctx.params.worker_period);
+          (ctx.worker_ctx.count_worker + 1 >= ctx.params.worker_period) ||
+          ctx.worker_ctx.ring_buffer_resize_requested;
       // when restarting worker, do a synchronous export
       DDRES_CHECK_FWD(ddprof_worker_cycle(
           ctx, now, ctx.worker_ctx.persistent_worker_state->restart_worker));
@@ -693,6 +1300,106 @@ DDRes ddprof_worker_maybe_export(DDProfContext &ctx,
   return {};
 }
 
+DDRes ddprof_worker_control(DDProfContext &ctx, int &poll_fd) {
+  DDProfWorkerContext &worker_ctx = ctx.worker_ctx;
+  try {
+    auto const now = std::chrono::steady_clock::now();
+    if (!worker_ctx.control_connection) {
+      // nothing to accept if the client went away (non-blocking socket)
+      worker_ctx.control_connection.reset(::accept4(
+          ctx.control_socket_fd.get(), nullptr, nullptr, SOCK_CLOEXEC));
+      worker_ctx.control_command_buffer.clear();
+      worker_ctx.control_command_deadline = now + k_control_command_timeout;
+    }
+    if (worker_ctx.control_connection) {
+      int const fd = worker_ctx.control_connection.get();
+      std::optional<std::string> const line =
+          read_control_command(fd, worker_ctx.control_command_buffer);
+      if (line || now >= worker_ctx.control_command_deadline) {
+        std::optional<ControlCommand> const command =
+            line ? parse_control_command(*line) : std::nullopt;
+        if (!command) {
+          LG_NTC("Invalid command received on control socket");
+          write_control_reply(fd, "error: invalid command (send help)\n");
+        } else {
+          write_control_reply(fd, worker_control(ctx, *command));
+        }
+        worker_ctx.control_connection.reset();
+      }
+    }
+  }
+  CatchExcept2DDRes();
+  poll_fd = worker_ctx.control_connection ? worker_ctx.control_connection.get()
+                                          : ctx.control_socket_fd.get();
+  return {};
+}
+
+DDRes ddprof_worker_dump_flight_recorder(DDProfContext &ctx) {
+  struct DumpedEvent {
+    const perf_event_header *hdr;
+    uint64_t timestamp;
+    int watcher_pos;
+  };
+  DDProfWorkerContext &worker_ctx = ctx.worker_ctx;
+  PersistentWorkerState &state = *worker_ctx.persistent_worker_state;
+  std::span const pevents{worker_ctx.pevent_hdr.pes,
+                          worker_ctx.pevent_hdr.size};
+  std::vector<std::vector<std::byte>> snapshots;
+  snapshots.reserve(pevents.size());
+  std::vector<DumpedEvent> events;
+
+  // writers are paused while ring buffers are copied
+  DDRes const res = pevent_pause_overwrite(&worker_ctx.pevent_hdr, true);
+  if (IsDDResOK(res)) {
+    for (const PEvent &pevent : pevents) {
+      if (!pevent.overwrite) {
+        continue;
+      }
+      uint64_t const sample_type =
+          ctx.watchers[pevent.watcher_pos].sample_type;
+      auto &snapshot = snapshots.emplace_back();
+      auto const offsets = perf_rb_backward_snapshot(pevent.rb, snapshot);
+      for (size_t const offset : offsets) {
+        const auto *hdr =
+            reinterpret_cast<const perf_event_header *>(&snapshot[offset]);
+        uint64_t const timestamp = hdr_time(hdr, sample_type);
+        // already exported by a previous dump
+        if (timestamp && timestamp <= state.flight_recorder_dumped_until) {
+          continue;
+        }
+        events.push_back({hdr, timestamp, pevent.watcher_pos});
+      }
+    }
+  }
+  // resume after a partial failure too
+  DDRES_CHECK_FWD(pevent_pause_overwrite(&worker_ctx.pevent_hdr, false));
+  DDRES_CHECK_FWD(res);
+
+  // process events of all CPUs in order (fork and exit events delimit the
+  // lifetime of processes)
+  std::stable_sort(events.begin(), events.end(),
+                   [](const DumpedEvent &lhs, const DumpedEvent &rhs) {
+                     return lhs.timestamp < rhs.timestamp;
+                   });
+  // dumped events are older than the ones processed so far
+  auto const last_processed_event_timestamp =
+      std::exchange(worker_ctx.last_processed_event_timestamp, {});
+  for (const DumpedEvent &event : events) {
+    DDRES_CHECK_FWD(ddprof_worker_process_event(event.hdr, event.watcher_pos,
+                                                ctx, false));
+  }
+  worker_ctx.last_processed_event_timestamp =
+      std::max(last_processed_event_timestamp,
+               worker_ctx.last_processed_event_timestamp);
+  if (!events.empty()) {
+    state.flight_recorder_dumped_until = std::max(
+        state.flight_recorder_dumped_until, events.back().timestamp);
+  }
+  LG_NTC("Flight recorder dump of %zu events", events.size());
+  worker_ctx.export_requested = true;
+  return {};
+}
+
 DDRes ddprof_worker_init(DDProfContext &ctx,
                          PersistentWorkerState *persistent_worker_state) {
   try {
@@ -762,7 +1469,7 @@ struct perf_event_hdr_wpid : perf_event_header {
 };
 
 DDRes ddprof_worker_process_event(const perf_event_header *hdr, int watcher_pos,
-                                  DDProfContext &ctx) {
+                                  DDProfContext &ctx, bool load_shedding) {
   // global try catch to avoid leaking exceptions to main loop
   try {
     ddprof_stats_add(STATS_EVENT_COUNT, 1, nullptr);
@@ -780,10 +1487,22 @@ DDRes ddprof_worker_process_event(const perf_event_header *hdr, int watcher_pos,
     /* Cases where the target type has a PID */
     case PERF_RECORD_SAMPLE:
       if (wpid->pid) {
-        uint64_t const mask = watcher->sample_type;
-        perf_event_sample *sample = hdr2samp(hdr, mask);
-        if (sample) {
-          DDRES_CHECK_FWD(ddprof_pr_sample(ctx, sample, watcher_pos));
+        // Only samples that need unwinding are shed: allocations must match
+        // their deallocations, count-only events are counted at full rate and
+        // switch outs open off-CPU intervals
+        bool const sheddable = load_shedding &&
+            watcher->type < kDDPROF_TYPE_CUSTOM &&
+            !watcher->options.count_only && !watcher_is_off_cpu(watcher);
+        uint32_t const weight = sheddable
+            ? ctx.worker_ctx.load_shedder.sample_weight(timestamp)
+            : 1;
+        if (!weight) {
+          ddprof_stats_add(STATS_SAMPLE_SHED, 1, nullptr);
+          break;
+        }
+        PerfSampleView sample;
+        if (watcher->sample_parser(hdr, watcher->sample_type, &sample)) {
+          DDRES_CHECK_FWD(ddprof_pr_sample(ctx, sample, watcher_pos, weight));
         }
       }
       break;
@@ -795,24 +1514,31 @@ DDRes ddprof_worker_process_event(const perf_event_header *hdr, int watcher_pos,
       break;
     case PERF_RECORD_COMM:
       if (wpid->pid) {
-        DDRES_CHECK_FWD(ddprof_pr_comm(
-            ctx, reinterpret_cast<const perf_event_comm *>(hdr), watcher_pos));
+        DDRES_CHECK_FWD(
+            ddprof_pr_comm(ctx, reinterpret_cast<const perf_event_comm *>(hdr),
+                           watcher_pos, timestamp));
       }
       break;
     case PERF_RECORD_EXIT:
       if (wpid->pid) {
         ddprof_pr_exit(ctx, reinterpret_cast<const perf_event_exit *>(hdr),
-                       watcher_pos);
+                       watcher_pos, timestamp);
       }
       break;
     case PERF_RECORD_FORK:
       if (wpid->pid) {
-        DDRES_CHECK_FWD(ddprof_pr_fork(
-            ctx, reinterpret_cast<const perf_event_fork *>(hdr), watcher_pos));
+        DDRES_CHECK_FWD(
+            ddprof_pr_fork(ctx, reinterpret_cast<const perf_event_fork *>(hdr),
+                           watcher_pos, timestamp));
       }
 
       break;
 
+    case PERF_RECORD_SWITCH:
+    case PERF_RECORD_SWITCH_CPU_WIDE:
+      DDRES_CHECK_FWD(ddprof_pr_switch(ctx, hdr, watcher_pos, timestamp));
+      break;
+
     /* Cases where the target type might not have a PID */
     case PERF_RECORD_LOST:
       ddprof_pr_lost(ctx, reinterpret_cast<const perf_event_lost *>(hdr),
@@ -822,6 +1548,11 @@ DDRes ddprof_worker_process_event(const perf_event_header *hdr, int watcher_pos,
       ddprof_pr_deallocation(
           ctx, reinterpret_cast<const DeallocationEvent *>(hdr), watcher_pos);
       break;
+    case PERF_CUSTOM_EVENT_DEALLOCATION_BATCH:
+      ddprof_pr_deallocation_batch(
+          ctx, reinterpret_cast<const DeallocationBatchEvent *>(hdr),
+          watcher_pos);
+      break;
     case PERF_CUSTOM_EVENT_CLEAR_LIVE_ALLOCATION: {
       const auto *event =
           reinterpret_cast<const ClearLiveAllocationEvent *>(hdr);
@@ -160,7 +160,7 @@ bool Dso::is_same_or_smaller(const Dso &o) const {
   }
   // only compare filename if we are backed by real files
   if (_type == DsoType::kStandard &&
-      (_filename != o._filename || _inode != o._inode)) {
+      (_filename != o._filename || !is_same_identity(o))) {
     return false;
   }
   if (_prot != o._prot) {
@@ -171,7 +171,16 @@ bool Dso::is_same_or_smaller(const Dso &o) const {
 
 bool Dso::is_same_file(const Dso &o) const {
   return _type == o._type && (_type == DsoType::kStandard) &&
-      _filename == o._filename && _inode == o._inode;
+      _filename == o._filename && is_same_identity(o);
+}
+
+bool Dso::is_same_identity(const Dso &o) const {
+  if (_build_id_size && o._build_id_size) {
+    return std::ranges::equal(build_id(), o.build_id());
+  }
+  // inode is unknown on the side that has a build id: a binary replaced at
+  // the same path is not considered the same file
+  return _inode == o._inode;
 }
 
 bool Dso::intersects(const Dso &o) const {
@@ -7,6 +7,7 @@
 
 #include "ddprof_defs.hpp"
 #include "ddres.hpp"
+#include "ddprof_module_lib.hpp"
 #include "defer.hpp"
 #include "logger.hpp"
 #include "procutils.hpp"
@@ -32,6 +33,14 @@ uint32_t mode_string_to_prot(const char mode[4]) {
       ((mode[1] == 'w') ? PROT_WRITE : 0) | ((mode[2] == 'x') ? PROT_EXEC : 0);
 }
 
+bool has_build_id(const char *path, BuildIdSpan build_id) {
+  if (build_id.empty()) {
+    return false;
+  }
+  auto file_build_id = find_build_id(path);
+  return file_build_id && *file_build_id == format_build_id(build_id);
+}
+
 UniqueFile open_proc_maps(int pid, const char *path_to_proc = "") {
   char proc_map_filename[PATH_MAX] = {};
   auto n = snprintf(proc_map_filename, std::size(proc_map_filename),
@@ -311,29 +320,59 @@ FileInfoId_t DsoHdr::update_id_dd_profiling(const Dso &dso) {
 }
 
 FileInfoId_t DsoHdr::update_id_from_path(const Dso &dso) {
+  BuildIdStr build_id;
+  if (!dso.build_id().empty()) {
+    // binary identified by the mmap event: no need to access the file, unless
+    // it failed to load from its known location
+    build_id = format_build_id(dso.build_id());
+    auto it = _file_info_build_id_map.find(build_id);
+    if (it != _file_info_build_id_map.end() &&
+        !_file_info_vector[it->second].errored()) {
+      dso._id = it->second;
+      return dso._id;
+    }
+  }
 
   FileInfo file_info = find_file_info(dso);
   if (!file_info._inode) {
     dso._id = k_file_info_error;
     return dso._id;
   }
+  file_info._build_id = build_id;
 
   // check if we already encountered binary
   const FileInfoInodeKey key(file_info._inode, file_info._size);
   auto it = _file_info_inode_map.find(key);
+  if (it == _file_info_inode_map.end() && !build_id.empty()) {
+    // same binary at another location
+    auto build_id_it = _file_info_build_id_map.find(build_id);
+    if (build_id_it != _file_info_build_id_map.end()) {
+      it = _file_info_inode_map.emplace(key, build_id_it->second).first;
+    }
+  }
   if (it == _file_info_inode_map.end()) {
     dso._id = _file_info_vector.size();
     _file_info_inode_map.emplace(key, dso._id);
-    _file_info_vector.emplace_back(std::move(file_info), dso._id);
+    if (!build_id.empty()) {
+      _file_info_build_id_map.emplace(build_id, dso._id);
+    }
 #ifdef DEBUG
     LG_NTC("New file %d - %s - %ld", dso._id, file_info._path.c_str(),
            file_info._size);
 #endif
+    _file_info_vector.emplace_back(std::move(file_info), dso._id);
   } else { // already exists
     dso._id = it->second;
+    const FileInfoValue &value = _file_info_vector[dso._id];
+    if (file_info._build_id.empty()) {
+      file_info._build_id = value.get_build_id();
+    } else if (value.get_build_id().empty()) {
+      _file_info_build_id_map.emplace(file_info._build_id, dso._id);
+    }
     // update with last location
     // looking up the actual path using mountinfo would prevent this
-    if (file_info._path != _file_info_vector[dso._id].info()._path) {
+    if (file_info._path != value.info()._path ||
+        file_info._build_id != value.get_build_id()) {
       _file_info_vector[dso._id] = FileInfoValue(std::move(file_info), dso._id);
     }
   }
@@ -537,8 +576,11 @@ FileInfo DsoHdr::find_file_info(const Dso &dso) {
 
   // First, try to find matching file in profiler mount namespace since it will
   // still be accessible when process exits
+  // (inode is unknown when the mmap event reported a build id: check the build
+  // id of the file instead)
   if (get_file_inode(dso._filename.c_str(), &inode, &size) &&
-      inode == dso._inode) {
+      (dso._inode ? inode == dso._inode
+                  : has_build_id(dso._filename.c_str(), dso.build_id()))) {
     return {dso._filename, size, inode};
   }
 
@@ -548,7 +590,7 @@ FileInfo DsoHdr::find_file_info(const Dso &dso) {
   std::string const proc_path = _path_to_proc + "/proc/" +
       std::to_string(dso._pid) + "/root" + dso._filename;
   if (get_file_inode(proc_path.c_str(), &inode, &size)) {
-    if (inode != dso._inode) {
+    if (dso._inode && inode != dso._inode) {
       LG_DBG("[DSO] inode mismatch for %s", proc_path.c_str());
     }
     return {proc_path, size, inode};
@@ -0,0 +1,48 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include "event_counts.hpp"
+
+#include "hash_helper.hpp"
+
+#include <string>
+
+namespace ddprof {
+
+std::size_t EventCounts::KeyHash::operator()(const Key &key) const noexcept {
+  std::size_t seed = 0;
+  hash_combine(seed, key.watcher_pos);
+  hash_combine(seed, key.pid);
+  hash_combine(seed, key.tid);
+  hash_combine(seed, key.raw_value);
+  return seed;
+}
+
+SymbolIdx_t EventCounts::get_or_insert_raw_symbol(int watcher_pos,
+                                                  std::string_view label,
+                                                  uint64_t raw_value,
+                                                  SymbolTable &symbol_table) {
+  Key key{watcher_pos, 0, 0, raw_value};
+  auto it = _raw_symbols.find(key);
+  if (it != _raw_symbols.end()) {
+    return it->second;
+  }
+  bool const other = _raw_symbols.size() >= k_max_raw_symbols;
+  if (other) {
+    // symbols are never freed: bound their number
+    key = {watcher_pos, -1, 0, 0};
+    it = _raw_symbols.find(key);
+    if (it != _raw_symbols.end()) {
+      return it->second;
+    }
+  }
+  it = _raw_symbols.emplace(key, symbol_table.size()).first;
+  std::string name = "[" + std::string(label) + " " +
+      (other ? std::string("other") : std::to_string(raw_value)) + "]";
+  symbol_table.emplace_back(name, name, 0, std::string{});
+  return it->second;
+}
+
+} // namespace ddprof
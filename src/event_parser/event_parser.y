@@ -305,6 +305,16 @@ opt:
          case EventConfField::kStackSampleSize:
             g_accum_event_conf.stack_sample_size = $3;
             break;
+         case EventConfField::kCountOnly:
+            g_accum_event_conf.count_only = $3 != 0;
+            break;
+         case EventConfField::kCounterGroup:
+            if ($3 <= 0 || $3 > UINT8_MAX) {
+              VAL_ERROR();
+              break;
+            }
+            g_accum_event_conf.counter_group = $3;
+            break;
          case EventConfField::kPeriod:
          case EventConfField::kFrequency:
            // If the cadence has already been set, it's an error
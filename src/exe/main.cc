@@ -16,6 +16,7 @@
 #include "libdd_profiling-embedded_hash.h"
 #include "logger.hpp"
 #include "perf_clock.hpp"
+#include "perf_watcher.hpp"
 #include "signal_helper.hpp"
 #include "system_checks.hpp"
 #include "tempfile.hpp"
@@ -24,6 +25,7 @@
 #include "user_override.hpp"
 
 #include <absl/strings/numbers.h>
+#include <algorithm>
 #include <array>
 #include <cerrno>
 #include <cstring>
@@ -307,6 +309,13 @@ int start_profiler_internal(std::unique_ptr<DDProfContext> ctx,
   ctx->perf_clock_source = PerfClock::init();
   if (ctx->perf_clock_source == PerfClockSource::kNoClock) {
     // If we can't use perf clock, we cannot reorder events
+    if (std::any_of(ctx->watchers.begin(), ctx->watchers.end(),
+                    [](const auto &watcher) {
+                      return watcher_is_off_cpu(&watcher);
+                    })) {
+      LG_ERR("Off-CPU profiling requires a perf clock to reorder events");
+      return -1;
+    }
     ctx->params.reorder_events = false;
   }
 
@@ -344,6 +353,25 @@ int start_profiler_internal(std::unique_ptr<DDProfContext> ctx,
     }
   };
 
+  const std::string &control_socket_path = ctx->params.control_socket_path;
+  if (!control_socket_path.empty()) {
+    // served by workers, commands are accepted one connection at a time
+    ctx->control_socket_fd = create_server_socket(
+        control_socket_path, SOCK_STREAM | SOCK_NONBLOCK);
+    if (!ctx->control_socket_fd) {
+      LG_ERR("Failed to create control socket %s",
+             control_socket_path.c_str());
+      return -1;
+    }
+  }
+
+  defer {
+    if (!control_socket_path.empty() &&
+        !is_socket_abstract(control_socket_path)) {
+      unlink(control_socket_path.c_str());
+    }
+  };
+
   exec_defer(std::move(defer_kill_temp_pid));
 
   if (ctx->params.pipefd_to_library) {
@@ -0,0 +1,277 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include "go_pclntab.hpp"
+
+#include "logger.hpp"
+
+#include <cstring>
+#include <limits>
+
+namespace ddprof {
+
+namespace {
+
+// Layout is described in go/src/runtime/symtab.go (pcHeader, _func)
+constexpr uint32_t k_go116_magic = 0xfffffffa;
+constexpr uint32_t k_go118_magic = 0xfffffff0;
+constexpr uint32_t k_go120_magic = 0xfffffff1;
+constexpr uint8_t k_ptr_size = 8;
+constexpr unsigned k_header_nb_words = 8;
+// runtime.funcFlag_TOPFRAME
+constexpr uint8_t k_func_flag_top_frame = 1;
+// runtime._PCDATA_InlTreeIndex
+constexpr uint32_t k_pcdata_inl_tree_index = 2;
+
+template <typename T>
+bool read_at(std::span<const std::byte> data, uint64_t off, T &value) {
+  if (off > data.size() || data.size() - off < sizeof(T)) {
+    return false;
+  }
+  memcpy(&value, data.data() + off, sizeof(T));
+  return true;
+}
+
+std::string_view read_string(std::span<const std::byte> data, uint64_t off) {
+  if (off >= data.size()) {
+    return {};
+  }
+  const auto *str = reinterpret_cast<const char *>(data.data() + off);
+  return {str, strnlen(str, data.size() - off)};
+}
+
+bool read_varint(std::span<const std::byte> data, uint64_t &off,
+                 uint32_t &value) {
+  value = 0;
+  for (unsigned shift = 0; shift < 32; shift += 7) {
+    uint8_t byte;
+    if (!read_at(data, off++, byte)) {
+      return false;
+    }
+    value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+std::optional<GoPclntab> GoPclntab::parse(std::span<const std::byte> data,
+                                          ElfAddress_t text_addr) {
+  GoPclntab table;
+  table._data = data;
+  uint32_t magic;
+  uint8_t header[4];
+  if (!read_at(data, 0, magic) || !read_at(data, sizeof(magic), header)) {
+    return std::nullopt;
+  }
+  switch (magic) {
+  case k_go116_magic:
+    table._version = Version::kGo116;
+    break;
+  case k_go118_magic:
+    table._version = Version::kGo118;
+    break;
+  case k_go120_magic:
+    table._version = Version::kGo120;
+    break;
+  default:
+    LG_DBG("[GO] Unsupported pclntab version (%x)", magic);
+    return std::nullopt;
+  }
+  table._pc_quantum = header[2];
+  if (header[0] || header[1] || !table._pc_quantum ||
+      header[3] != k_ptr_size) {
+    LG_DBG("[GO] Unsupported pclntab header");
+    return std::nullopt;
+  }
+
+  uint64_t words[k_header_nb_words] = {};
+  if (!read_at(data, sizeof(magic) + sizeof(header), words)) {
+    return std::nullopt;
+  }
+  // nfunc, nfiles, [textStart], funcnameOffset, cuOffset, filetabOffset,
+  // pctabOffset, pclnOffset
+  unsigned word = 0;
+  table._nb_funcs = words[word++];
+  ++word; // nfiles
+  if (table._version != Version::kGo116) {
+    table._text_start = words[word++];
+  }
+  if (!table._text_start) {
+    // position independent executables relocate textStart at load time
+    table._text_start = text_addr;
+  }
+  table._funcname_off = words[word++];
+  table._cu_off = words[word++];
+  table._filetab_off = words[word++];
+  table._pctab_off = words[word++];
+  table._functab_off = words[word++];
+
+  // end address of the last function follows the table
+  ElfAddress_t end_entry;
+  uint64_t func_off;
+  if (!table._nb_funcs || table._nb_funcs >= data.size() ||
+      !table.read_func_entry(table._nb_funcs, end_entry, func_off)) {
+    LG_DBG("[GO] Invalid pclntab function table");
+    return std::nullopt;
+  }
+  return table;
+}
+
+bool GoPclntab::read_func_entry(uint64_t idx, ElfAddress_t &entry,
+                                uint64_t &func_off) const {
+  if (_version == Version::kGo116) {
+    // {entry uintptr, funcoff uintptr}
+    uint64_t fields[2];
+    if (!read_at(_data, _functab_off + (idx * sizeof(fields)), fields)) {
+      return false;
+    }
+    entry = fields[0];
+    func_off = fields[1];
+  } else {
+    // {entryoff uint32, funcoff uint32}, relative to textStart
+    uint32_t fields[2];
+    if (!read_at(_data, _functab_off + (idx * sizeof(fields)), fields)) {
+      return false;
+    }
+    entry = _text_start + fields[0];
+    func_off = fields[1];
+  }
+  return true;
+}
+
+std::optional<GoPclntab::Func> GoPclntab::find_func(ElfAddress_t addr) const {
+  // last function starting at or before addr
+  uint64_t low = 0;
+  uint64_t high = _nb_funcs;
+  ElfAddress_t entry;
+  uint64_t func_off;
+  while (high - low > 1) {
+    uint64_t const mid = low + ((high - low) / 2);
+    if (!read_func_entry(mid, entry, func_off)) {
+      return std::nullopt;
+    }
+    if (entry <= addr) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+  Func func;
+  uint64_t next_func_off;
+  if (!read_func_entry(low, func.entry, func_off) ||
+      !read_func_entry(low + 1, func.end, next_func_off) ||
+      addr < func.entry || addr >= func.end) {
+    return std::nullopt;
+  }
+  func.offset = _functab_off + func_off;
+  size_t const entry_size = _version == Version::kGo116 ? sizeof(uint64_t)
+                                                        : sizeof(uint32_t);
+  if (!read_at(_data, func.offset + entry_size, func.fields)) {
+    return std::nullopt;
+  }
+  return func;
+}
+
+uint64_t GoPclntab::func_tail_offset(const Func &func) const {
+  uint64_t const entry_size = _version == Version::kGo116 ? sizeof(uint64_t)
+                                                          : sizeof(uint32_t);
+  // startLine is inserted after the fields from go 1.20
+  return func.offset + entry_size + sizeof(FuncFields) +
+      (_version == Version::kGo120 ? sizeof(int32_t) : 0);
+}
+
+bool GoPclntab::pc_value(uint32_t table_off, ElfAddress_t entry,
+                         ElfAddress_t addr, int32_t &value, ElfAddress_t &start,
+                         ElfAddress_t &end) const {
+  if (!table_off) {
+    return false;
+  }
+  // sequence of (value delta, pc delta) pairs, starting at -1 / entry
+  uint64_t off = _pctab_off + table_off;
+  int32_t current = -1;
+  ElfAddress_t pc = entry;
+  for (bool first = true;; first = false) {
+    uint32_t value_delta;
+    uint32_t pc_delta;
+    if (!read_varint(_data, off, value_delta) || (!value_delta && !first) ||
+        !read_varint(_data, off, pc_delta)) {
+      return false;
+    }
+    // zig-zag encoding
+    current += static_cast<int32_t>(-(value_delta & 1) ^ (value_delta >> 1));
+    ElfAddress_t const previous_pc = pc;
+    pc += static_cast<ElfAddress_t>(pc_delta) * _pc_quantum;
+    if (addr < pc) {
+      value = current;
+      start = previous_pc;
+      end = pc;
+      return true;
+    }
+  }
+}
+
+std::optional<GoPclntab::Location>
+GoPclntab::find_location(ElfAddress_t addr) const {
+  std::optional<Func> const func = find_func(addr);
+  if (!func) {
+    return std::nullopt;
+  }
+  Location location{};
+  location.function =
+      read_string(_data, _funcname_off + func->fields.name_off);
+  ElfAddress_t start;
+  ElfAddress_t end;
+  if (!pc_value(func->fields.pcln, func->entry, addr, location.line, start,
+                end)) {
+    location.line = 0;
+  }
+  int32_t file_idx;
+  uint32_t file_off;
+  if (pc_value(func->fields.pcfile, func->entry, addr, file_idx, start, end) &&
+      file_idx >= 0 &&
+      read_at(_data,
+              _cu_off +
+                  ((static_cast<uint64_t>(func->fields.cu_offset) + file_idx) *
+                   sizeof(file_off)),
+              file_off) &&
+      file_off != std::numeric_limits<uint32_t>::max()) {
+    location.file = read_string(_data, _filetab_off + file_off);
+  }
+  // pcdata table offsets follow funcID, flag and nfuncdata
+  uint32_t inl_table_off = 0;
+  int32_t inl_idx;
+  location.inlined = func->fields.npcdata > k_pcdata_inl_tree_index &&
+      read_at(_data,
+              func_tail_offset(*func) + sizeof(uint32_t) +
+                  (k_pcdata_inl_tree_index * sizeof(uint32_t)),
+              inl_table_off) &&
+      pc_value(inl_table_off, func->entry, addr, inl_idx, start, end) &&
+      inl_idx >= 0;
+  return location;
+}
+
+std::optional<GoPclntab::Frame> GoPclntab::find_frame(ElfAddress_t addr) const {
+  std::optional<Func> const func = find_func(addr);
+  if (!func) {
+    return std::nullopt;
+  }
+  Frame frame{};
+  if (!pc_value(func->fields.pcsp, func->entry, addr, frame.sp_delta,
+                frame.start, frame.end) ||
+      frame.sp_delta < 0) {
+    return std::nullopt;
+  }
+  // flag follows funcID
+  uint8_t flag = 0;
+  read_at(_data, func_tail_offset(*func) + 1, flag);
+  frame.top_frame = flag & k_func_flag_top_frame;
+  return frame;
+}
+
+} // namespace ddprof
@@ -0,0 +1,159 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include "go_symbol_lookup.hpp"
+
+#include "ddprof_module_lib.hpp"
+#include "logger.hpp"
+
+#include <cstring>
+#include <fcntl.h>
+#include <gelf.h>
+#include <utility>
+
+namespace ddprof {
+
+namespace {
+
+const char *kGoPclntabSection = ".gopclntab";
+const char *kTextSection = ".text";
+
+Elf_Scn *find_section(Elf *elf, const char *section_name, GElf_Shdr &shdr) {
+  size_t stridx;
+  if (elf_getshdrstrndx(elf, &stridx) != 0) {
+    return nullptr;
+  }
+  Elf_Scn *section = nullptr;
+  while ((section = elf_nextscn(elf, section)) != nullptr) {
+    if (!gelf_getshdr(section, &shdr)) {
+      continue;
+    }
+    const char *name = elf_strptr(elf, stridx, shdr.sh_name);
+    if (name && !strcmp(name, section_name)) {
+      return section;
+    }
+  }
+  return nullptr;
+}
+
+std::optional<GoPclntab> load_pclntab(Elf *elf, const std::string &path) {
+  if (!has_go_build_id(elf)) {
+    return std::nullopt;
+  }
+  GElf_Shdr shdr;
+  Elf_Scn *section = find_section(elf, kGoPclntabSection, shdr);
+  if (!section || shdr.sh_type != SHT_PROGBITS) {
+    // externally linked binaries keep the table in .data.rel.ro
+    LG_DBG("[GO] No function table in %s", path.c_str());
+    return std::nullopt;
+  }
+  Elf_Data *data = elf_getdata(section, nullptr);
+  if (!data || !data->d_buf) {
+    return std::nullopt;
+  }
+  GElf_Shdr text_shdr{};
+  find_section(elf, kTextSection, text_shdr);
+  std::optional<GoPclntab> pclntab = GoPclntab::parse(
+      {static_cast<const std::byte *>(data->d_buf), data->d_size},
+      text_shdr.sh_addr);
+  if (pclntab) {
+    LG_DBG("[GO] Loaded %lu functions from %s", pclntab->nb_functions(),
+           path.c_str());
+  }
+  return pclntab;
+}
+
+} // namespace
+
+GoSymbolLookup::GoFile &
+GoSymbolLookup::get_or_open(const FileInfoValue &file_info) {
+  GoFile &go_file = _files[file_info.get_id()];
+  go_file.used = true;
+  if (!go_file.is_go || go_file.pclntab) {
+    return go_file;
+  }
+  // the section is read from the mapping of the file
+  go_file.fd.reset(::open(file_info.get_path().c_str(), O_RDONLY | O_CLOEXEC));
+  if (go_file.fd) {
+    go_file.elf.reset(elf_begin(go_file.fd.get(), ELF_C_READ_MMAP, nullptr));
+  }
+  if (go_file.elf) {
+    go_file.pclntab = load_pclntab(go_file.elf.get(), file_info.get_path());
+  }
+  if (!go_file.pclntab) {
+    go_file.is_go = false;
+    go_file.elf.reset();
+    go_file.fd.reset();
+  }
+  return go_file;
+}
+
+void GoSymbolLookup::close(GoFile &go_file) {
+  go_file.pclntab.reset();
+  go_file.elf.reset();
+  go_file.fd.reset();
+}
+
+void GoSymbolLookup::cycle() {
+  for (auto &el : _files) {
+    if (!std::exchange(el.second.used, false)) {
+      close(el.second);
+    }
+  }
+}
+
+void GoSymbolLookup::release(FileInfoId_t file_info_id) {
+  auto it = _files.find(file_info_id);
+  if (it != _files.end()) {
+    close(it->second);
+  }
+}
+
+const GoPclntab *GoSymbolLookup::find_pclntab(const FileInfoValue &file_info) {
+  GoFile &go_file = get_or_open(file_info);
+  return go_file.pclntab ? &*go_file.pclntab : nullptr;
+}
+
+SymbolIdx_t GoSymbolLookup::get_or_insert(const FileInfoValue &file_info,
+                                          ElfAddress_t elf_addr,
+                                          SymbolTable &symbol_table) {
+  GoFile &go_file = get_or_open(file_info);
+  if (!go_file.pclntab) {
+    return k_symbol_idx_null;
+  }
+  auto const it = go_file.symbols.find(elf_addr);
+  if (it != go_file.symbols.end()) {
+    return it->second;
+  }
+  std::optional<GoPclntab::Location> const location =
+      go_file.pclntab->find_location(elf_addr);
+  if (!location || location->function.empty()) {
+    return k_symbol_idx_null;
+  }
+  if (location->inlined) {
+    // the function table does not expand inlined calls: leave the frame to
+    // the generic symbolizer, that reports one frame per inlined call
+    go_file.symbols.emplace(elf_addr, k_symbol_idx_null);
+    return k_symbol_idx_null;
+  }
+  SymbolIdx_t const symbol_idx = symbol_table.size();
+  // Go symbols are not mangled
+  symbol_table.emplace_back(std::string(location->function),
+                            std::string(location->function),
+                            static_cast<uint32_t>(location->line),
+                            std::string(location->file));
+  go_file.symbols.emplace(elf_addr, symbol_idx);
+  return symbol_idx;
+}
+
+void GoSymbolLookup::stats_display() const {
+  size_t nb_symbols = 0;
+  for (const auto &el : _files) {
+    nb_symbols += el.second.symbols.size();
+  }
+  LG_NTC("GO_SYMB   | %10s | %lu", "SIZE", nb_symbols);
+}
+
+} // namespace ddprof
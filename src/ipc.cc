@@ -6,8 +6,11 @@
 #include "ipc.hpp"
 
 #include "chrono_utils.hpp"
+#include "defer.hpp"
 
+#include <algorithm>
 #include <cerrno>
+#include <cstddef>
 #include <csignal>
 #include <cstdio>
 #include <cstdlib>
@@ -20,6 +23,7 @@
 #include <sys/time.h>
 #include <sys/un.h>
 #include <unistd.h>
+#include <unordered_map>
 
 namespace ddprof {
 
@@ -75,7 +79,8 @@ size_t UnixSocket::send_partial(ConstBuffer buffer,
                                 std::error_code &ec) const noexcept {
   ssize_t ret;
   do {
-    ret = ::send(_handle.get(), buffer.data(), buffer.size(), 0);
+    // peer might be gone, do not raise SIGPIPE in the calling process
+    ret = ::send(_handle.get(), buffer.data(), buffer.size(), MSG_NOSIGNAL);
   } while (ret < 0 && errno == EINTR);
 
   error_wrapper(ret, ec);
@@ -127,7 +132,7 @@ size_t UnixSocket::send_partial(ConstBuffer buffer, std::span<const int> fds,
 
   ssize_t ret;
   do {
-    ret = ::sendmsg(_handle.get(), &msg, 0);
+    ret = ::sendmsg(_handle.get(), &msg, MSG_NOSIGNAL);
   } while (ret < 0 && errno == EINTR);
   error_wrapper(ret, ec);
 
@@ -250,6 +255,17 @@ DDRes send(const UnixSocket &socket, const ReplyMessage &msg) {
   return {};
 }
 
+DDRes send(const UnixSocket &socket, const LiveAddressChunk &chunk) {
+  // only send the used part of the address array
+  size_t const size = offsetof(LiveAddressChunk, addresses) +
+      chunk.nb_addresses * sizeof(uintptr_t);
+  std::error_code ec;
+  socket.send({reinterpret_cast<const std::byte *>(&chunk), size}, ec);
+  DDRES_CHECK_ERRORCODE(ec, DD_WHAT_SOCKET,
+                        "Unable to send live address snapshot");
+  return {};
+}
+
 DDRes receive(const UnixSocket &socket, RequestMessage &msg) {
   std::error_code ec;
   socket.receive(to_byte_span(&msg), ec);
@@ -275,6 +291,23 @@ DDRes receive(const UnixSocket &socket, ReplyMessage &msg) {
   return {};
 }
 
+DDRes receive(const UnixSocket &socket, LiveAddressChunk &chunk) {
+  std::error_code ec;
+  // one chunk per packet
+  size_t const size = socket.receive_partial(to_byte_span(&chunk), ec);
+  DDRES_CHECK_ERRORCODE(ec, DD_WHAT_SOCKET,
+                        "Unable to receive live address snapshot");
+  if (size < offsetof(LiveAddressChunk, addresses) ||
+      chunk.nb_addresses > LiveAddressChunk::k_max_addresses ||
+      size != offsetof(LiveAddressChunk, addresses) +
+              chunk.nb_addresses * sizeof(uintptr_t)) {
+    DDRES_RETURN_ERROR_LOG(DD_WHAT_SOCKET,
+                           "Invalid live address snapshot chunk (size=%zu)",
+                           size);
+  }
+  return {};
+}
+
 DDRes get_profiler_info(UniqueFd &&client_socket,
                         std::chrono::microseconds timeout,
                         ReplyMessage *reply) noexcept {
@@ -294,8 +327,33 @@ DDRes get_profiler_info(UniqueFd &&client_socket,
   return {};
 }
 
-UniqueFd create_server_socket(std::string_view socket_path) noexcept {
-  UniqueFd fd{::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)};
+DDRes get_profiler_info_dedicated(const UniqueFd &client_socket,
+                                  std::chrono::microseconds timeout,
+                                  uint64_t allocation_rate,
+                                  ReplyMessage *reply) noexcept {
+  UnixSocket socket{client_socket.get()};
+  // socket remains owned by the caller
+  defer { socket.release(); };
+  std::error_code ec;
+  socket.set_read_timeout(timeout, ec);
+  DDRES_CHECK_ERRORCODE(ec, DD_WHAT_SOCKET,
+                        "Unable to set read timeout on socket");
+  socket.set_write_timeout(timeout, ec);
+  DDRES_CHECK_ERRORCODE(ec, DD_WHAT_SOCKET,
+                        "Unable to set write timeout on socket");
+
+  RequestMessage const request = {
+      .request = RequestMessage::kProfilerInfo |
+          RequestMessage::kDedicatedRingBuffer,
+      .pid = getpid(),
+      .allocation_rate = allocation_rate};
+  DDRES_CHECK_FWD(send(socket, request));
+  DDRES_CHECK_FWD(receive(socket, *reply));
+  return {};
+}
+
+UniqueFd create_server_socket(std::string_view socket_path, int type) noexcept {
+  UniqueFd fd{::socket(AF_UNIX, type | SOCK_CLOEXEC, 0)};
   if (fd.get() < 0) {
     LG_ERR("Unable to create server socket: %s",
            std::error_code(errno, std::system_category()).message().c_str());
@@ -360,8 +418,12 @@ UniqueFd create_client_socket(std::string_view socket_path) noexcept {
   return fd;
 }
 
-WorkerServer::WorkerServer(int socket, const ReplyMessage &msg)
+WorkerServer::WorkerServer(int socket, const ReplyMessage &msg,
+                           LiveAddressSnapshotCallback snapshot_callback,
+                           DedicatedRingBufferCallbacks ring_buffer_callbacks)
     : _socket(socket), _latch(1), _msg(msg),
+      _snapshot_callback(std::move(snapshot_callback)),
+      _ring_buffer_callbacks(std::move(ring_buffer_callbacks)),
       _loop_thread(&WorkerServer::event_loop, this) {
   // wait for loop thread to be ready
   _latch.wait();
@@ -372,8 +434,61 @@ WorkerServer::~WorkerServer() {
   // _loop_thread destructor will join the thread
 }
 
-WorkerServer start_worker_server(int socket, const ReplyMessage &msg) {
-  return WorkerServer{socket, msg};
+WorkerServer
+start_worker_server(int socket, const ReplyMessage &msg,
+                    LiveAddressSnapshotCallback snapshot_callback,
+                    DedicatedRingBufferCallbacks ring_buffer_callbacks) {
+  return WorkerServer{socket, msg, std::move(snapshot_callback),
+                      std::move(ring_buffer_callbacks)};
+}
+
+uint64_t WorkerServer::reply_profiler_info(const UnixSocket &socket,
+                                           const RequestMessage &request) {
+  if ((request.request & RequestMessage::kDedicatedRingBuffer) &&
+      _ring_buffer_callbacks.create && _msg.ring_buffer.mem_size != -1) {
+    ReplyMessage reply = _msg;
+    uint64_t const id = _ring_buffer_callbacks.create(
+        request.pid, request.allocation_rate, reply.ring_buffer);
+    if (id != 0) {
+      reply.request |= RequestMessage::kDedicatedRingBuffer;
+      if (IsDDResOK(send(socket, reply))) {
+        return id;
+      }
+      _ring_buffer_callbacks.release(id);
+      return 0;
+    }
+  }
+  // shared ring buffer
+  send(socket, _msg);
+  return 0;
+}
+
+void WorkerServer::receive_live_address_snapshot(const UnixSocket &socket,
+                                                 pid_t pid) {
+  // bound the memory used by a misbehaving client
+  constexpr size_t k_max_live_addresses = 64UL * 1024 * 1024;
+  LiveAddressSnapshot snapshot;
+  snapshot.pid = pid;
+  LiveAddressChunk chunk;
+  do {
+    if (!IsDDResOK(receive(socket, chunk))) {
+      return;
+    }
+    snapshot.timestamp = chunk.timestamp;
+    snapshot.addresses.insert(snapshot.addresses.end(), chunk.addresses,
+                              chunk.addresses + chunk.nb_addresses);
+  } while (!chunk.last && snapshot.addresses.size() < k_max_live_addresses);
+
+  if (!chunk.last) {
+    LG_WRN("Live address snapshot from pid %d is too large, ignoring it", pid);
+    return;
+  }
+  LG_DBG("Received %zu live addresses from pid %d",
+         snapshot.addresses.size(), pid);
+  if (_snapshot_callback) {
+    std::sort(snapshot.addresses.begin(), snapshot.addresses.end());
+    _snapshot_callback(std::move(snapshot));
+  }
 }
 
 void WorkerServer::event_loop() {
@@ -392,9 +507,13 @@ void WorkerServer::event_loop() {
   poll_fds.push_back({.fd = sfd, .events = POLLIN});
 
   bool shutting_down = false;
+  // connections of processes using a dedicated ring buffer (fd -> ring buffer
+  // id), they are kept open until the process closes them
+  std::unordered_map<int, uint64_t> dedicated_connections;
 
-  // Stop when shutting down is requested and all connections are closed
-  while (!shutting_down || poll_fds.size() > 2) {
+  // Stop when shutting down is requested and all pending requests are served
+  while (!shutting_down ||
+         poll_fds.size() > 2 + dedicated_connections.size()) {
     int const ret = poll(poll_fds.data(), poll_fds.size(), -1);
     if (ret < 0) {
       if (errno == EINTR) {
@@ -409,12 +528,25 @@ void WorkerServer::event_loop() {
     auto last = poll_fds.end();
     while (first != last) {
       if (first->revents) {
-        UnixSocket const sock(first->fd);
-        if (first->revents & POLLIN) {
+        UnixSocket sock(first->fd);
+        auto it = dedicated_connections.find(first->fd);
+        if (it != dedicated_connections.end()) {
+          // nothing is expected on this connection but its hangup
+          _ring_buffer_callbacks.release(it->second);
+          dedicated_connections.erase(it);
+        } else if (first->revents & POLLIN) {
           RequestMessage request;
           if (IsDDResOK(receive(sock, request))) {
             LG_DBG("Received request from pid: %d", request.pid);
-            send(sock, _msg);
+            if (request.request & RequestMessage::kLiveAddressSnapshot) {
+              receive_live_address_snapshot(sock, request.pid);
+            } else if (uint64_t const id = reply_profiler_info(sock, request);
+                       id != 0) {
+              // keep the connection open to detect process exit
+              dedicated_connections.emplace(sock.release(), id);
+              ++first;
+              continue;
+            }
           }
         }
         last = std::prev(last);
@@ -4,6 +4,7 @@
 // Datadog, Inc.
 #include "address_bitset.hpp"
 
+#include <algorithm>
 #include <cassert>
 
 #include <unlikely.hpp>
@@ -35,9 +36,11 @@ size_t round_up_to_power_of_two(size_t num) {
 } // namespace
 
 // AddressTable implementation
-AddressTable::AddressTable(size_t size)
+AddressTable::AddressTable(size_t size, AddressTable *older_table)
     : table_size(round_up_to_power_of_two(size)), table_mask(table_size - 1),
       max_capacity(table_size * _max_load_factor_percent / _percent_divisor),
+      generation(older_table ? older_table->generation + 1 : 1),
+      older(older_table),
       slots(std::make_unique<std::atomic<uintptr_t>[]>(table_size)) {
   // Initialize all slots to empty
   for (size_t i = 0; i < table_size; ++i) {
@@ -45,6 +48,34 @@ AddressTable::AddressTable(size_t size)
   }
 }
 
+AddressTable::~AddressTable() { delete older; }
+
+void AddressFilter::increment(std::atomic<uint8_t> &counter) {
+  uint8_t value = counter.load(std::memory_order_relaxed);
+  while (value != _k_saturated &&
+         !counter.compare_exchange_weak(value, value + 1,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed)) {}
+}
+
+void AddressFilter::decrement(std::atomic<uint8_t> &counter) {
+  uint8_t value = counter.load(std::memory_order_relaxed);
+  // a saturated counter no longer knows how many addresses it accounts for
+  while (value != _k_saturated && value != 0 &&
+         !counter.compare_exchange_weak(value, value - 1,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed)) {}
+}
+
+void AddressFilter::clear() {
+  if (!_counters) {
+    return;
+  }
+  for (size_t i = 0; i < _k_nb_counters; ++i) {
+    _counters[i].store(0, std::memory_order_relaxed);
+  }
+}
+
 AddressBitset::AddressBitset(AddressBitset &&other) noexcept {
   move_from(other);
 }
@@ -75,9 +106,18 @@ void AddressBitset::move_from(AddressBitset &other) noexcept {
   _per_table_size = other._per_table_size;
   _chunk_tables = std::move(other._chunk_tables);
   _large_alloc_table = std::move(other._large_alloc_table);
+  _filter = std::move(other._filter);
+  _total_slots.store(other._total_slots.load(std::memory_order_relaxed),
+                     std::memory_order_relaxed);
+  _max_probe_length.store(
+      other._max_probe_length.load(std::memory_order_relaxed),
+      std::memory_order_relaxed);
+  _nb_growths.store(other._nb_growths.load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
 
   // Reset the state of 'other'
   other._per_table_size = 0;
+  other._total_slots.store(0, std::memory_order_relaxed);
 }
 
 void AddressBitset::init(size_t table_size) {
@@ -94,42 +134,63 @@ void AddressBitset::init(size_t table_size) {
     _chunk_tables[i].store(nullptr, std::memory_order_release);
   }
 
+  _filter = AddressFilter{};
+  _total_slots.store(0, std::memory_order_relaxed);
+  _max_probe_length.store(0, std::memory_order_relaxed);
+  _nb_growths.store(0, std::memory_order_relaxed);
+
   // Initialize large allocation table eagerly so it is always available
   _large_alloc_table = std::make_unique<std::atomic<AddressTable *>>();
-  auto *large_table = new AddressTable(_per_table_size);
+  auto *large_table = new_table(_per_table_size, nullptr);
   _large_alloc_table->store(large_table, std::memory_order_release);
 }
 
-AddressTable *AddressBitset::get_table(uintptr_t addr, bool is_large_alloc,
-                                       bool create_if_missing) {
+AddressTable *AddressBitset::new_table(size_t size, AddressTable *older) {
+  auto *table = new AddressTable(size, older);
+  _total_slots.fetch_add(table->table_size, std::memory_order_relaxed);
+  return table;
+}
+
+std::atomic<AddressTable *> *
+AddressBitset::get_shard(uintptr_t addr, bool is_large_alloc) const {
   // For large allocations (mmap), use dedicated table to avoid sharding
-  std::atomic<AddressTable *> *table_ptr;
   if (is_large_alloc) {
-    table_ptr = _large_alloc_table.get();
-  } else {
-    // Use address bits for chunk selection to preserve locality
-    // Nearby addresses will map to the same chunk
-    const size_t chunk_idx = (addr >> _k_chunk_shift) & (_k_max_chunks - 1);
-    table_ptr = &_chunk_tables[chunk_idx];
+    return _large_alloc_table.get();
+  }
+  if (!_chunk_tables) {
+    return nullptr;
+  }
+  // Use address bits for chunk selection to preserve locality
+  // Nearby addresses will map to the same chunk
+  const size_t chunk_idx = (addr >> _k_chunk_shift) & (_k_max_chunks - 1);
+  return &_chunk_tables[chunk_idx];
+}
+
+AddressTable *AddressBitset::get_table(uintptr_t addr, bool is_large_alloc,
+                                       bool create_if_missing) {
+  std::atomic<AddressTable *> *table_ptr = get_shard(addr, is_large_alloc);
+  if (!table_ptr) {
+    return nullptr;
   }
 
   AddressTable *table = table_ptr->load(std::memory_order_acquire);
 
   if (!table && create_if_missing) {
     // Lazy allocation: create table (only for add operations)
-    auto *new_table = new AddressTable(_per_table_size);
+    auto *created = new_table(_per_table_size, nullptr);
     AddressTable *expected = nullptr;
 
     // Use acq_rel: release ensures table construction is visible to other
     // threads, acquire synchronizes with competing allocations
-    if (table_ptr->compare_exchange_strong(expected, new_table,
+    if (table_ptr->compare_exchange_strong(expected, created,
                                            std::memory_order_acq_rel,
                                            std::memory_order_acquire)) {
       // Successfully installed our new table
-      table = new_table;
+      table = created;
     } else {
       // Another thread beat us to it - use theirs
-      delete new_table;
+      _total_slots.fetch_sub(created->table_size, std::memory_order_relaxed);
+      delete created;
       table = expected;
     }
   }
@@ -137,67 +198,125 @@ AddressTable *AddressBitset::get_table(uintptr_t addr, bool is_large_alloc,
   return table;
 }
 
-bool AddressBitset::add(uintptr_t addr, bool is_large_alloc) {
-  assert(addr != kEmptySlot && addr != kDeletedSlot);
+AddressTable *AddressBitset::grow(std::atomic<AddressTable *> &shard,
+                                  AddressTable *table) {
+  AddressTable *current = shard.load(std::memory_order_acquire);
+  if (current != table) {
+    return current; // Another thread already grew the shard
+  }
+  if (table->generation >= _k_max_generations) {
+    return nullptr;
+  }
+  const size_t size = std::min(table->table_size * 2, _k_max_table_size);
+  if (_total_slots.load(std::memory_order_relaxed) + size >
+      _k_max_total_slots) {
+    return nullptr;
+  }
 
-  AddressTable *table = get_table(addr, is_large_alloc, true);
-  if (!table) {
-    return false;
+  auto *grown = new_table(size, table);
+  AddressTable *expected = table;
+  if (shard.compare_exchange_strong(expected, grown,
+                                    std::memory_order_acq_rel,
+                                    std::memory_order_acquire)) {
+    _nb_growths.fetch_add(1, std::memory_order_relaxed);
+    return grown;
   }
+  // Lost the race: keep the table installed by the other thread
+  grown->older = nullptr;
+  _total_slots.fetch_sub(grown->table_size, std::memory_order_relaxed);
+  delete grown;
+  return expected;
+}
 
-  // Check if table is at max capacity (60% load factor)
-  if (table->count.load(std::memory_order_relaxed) >= table->max_capacity) {
-    return false; // Table is full
+AddressBitset::InsertResult
+AddressBitset::insert(AddressTable &table, uintptr_t addr, uint64_t hash) {
+  // Check if table is at max capacity (80% load factor)
+  if (table.count.load(std::memory_order_relaxed) >= table.max_capacity) {
+    return InsertResult::kFull;
   }
 
-  const uint64_t hash = compute_full_hash(addr);
-  uint32_t slot = hash_to_slot(hash, table->table_mask);
+  uint32_t slot = hash_to_slot(hash, table.table_mask);
 
   // Linear probing to find an empty/deleted slot or the address
   for (size_t probe = 0; probe < _k_max_probe_distance; ++probe) {
-    uintptr_t current = table->slots[slot].load(std::memory_order_acquire);
+    uintptr_t current = table.slots[slot].load(std::memory_order_acquire);
 
     // If empty or deleted, try to claim it
     if (current == kEmptySlot || current == kDeletedSlot) {
       uintptr_t expected = current;
-      if (table->slots[slot].compare_exchange_strong(
+      if (table.slots[slot].compare_exchange_strong(
               expected, addr, std::memory_order_acq_rel)) {
         // Successfully inserted
-        table->count.fetch_add(1, std::memory_order_relaxed);
-        return true;
+        table.count.fetch_add(1, std::memory_order_relaxed);
+        size_t max_probe = _max_probe_length.load(std::memory_order_relaxed);
+        while (probe > max_probe &&
+               !_max_probe_length.compare_exchange_weak(
+                   max_probe, probe, std::memory_order_relaxed)) {}
+        return InsertResult::kInserted;
       }
       // CAS failed, reload and check what's there now
-      current = table->slots[slot].load(std::memory_order_acquire);
+      current = table.slots[slot].load(std::memory_order_acquire);
     }
 
     // Check if slot already contains our address
     if (current == addr) {
-      return false; // Already tracked
+      return InsertResult::kAlreadyTracked;
     }
 
     // Slot occupied by different address - probe next slot
-    slot = (slot + 1) & table->table_mask;
+    slot = (slot + 1) & table.table_mask;
   }
 
-  // Table is too full or probe distance exceeded
-  return false;
+  // Probe distance exceeded
+  return InsertResult::kFull;
 }
 
-bool AddressBitset::remove(uintptr_t addr, bool is_large_alloc) {
+bool AddressBitset::add(uintptr_t addr, bool is_large_alloc) {
   assert(addr != kEmptySlot && addr != kDeletedSlot);
 
-  // Don't create table if it doesn't exist - address was never added
-  AddressTable *table = get_table(addr, is_large_alloc, false);
+  AddressTable *table = get_table(addr, is_large_alloc, true);
   if (!table) {
-    return false; // Table doesn't exist, so address was never added
+    return false;
   }
 
   const uint64_t hash = compute_full_hash(addr);
-  uint32_t slot = hash_to_slot(hash, table->table_mask);
+  // The address can still be tracked by an older table of the shard
+  if (table->older && _filter.may_contain(hash)) {
+    for (const AddressTable *older = table->older; older;
+         older = older->older) {
+      if (find_in(*older, addr, hash)) {
+        return false; // Already tracked
+      }
+    }
+  }
+
+  // Account for the address before it becomes visible in the table
+  _filter.add(hash);
+  while (table) {
+    switch (insert(*table, addr, hash)) {
+    case InsertResult::kInserted:
+      return true;
+    case InsertResult::kAlreadyTracked:
+      _filter.remove(hash);
+      return false;
+    case InsertResult::kFull:
+      table = grow(*get_shard(addr, is_large_alloc), table);
+      break;
+    }
+  }
+
+  // The shard can not grow anymore
+  _filter.remove(hash);
+  return false;
+}
+
+bool AddressBitset::remove_from(AddressTable &table, uintptr_t addr,
+                                uint64_t hash) {
+  uint32_t slot = hash_to_slot(hash, table.table_mask);
 
   // Linear probing to find the address
   for (size_t probe = 0; probe < _k_max_probe_distance; ++probe) {
-    uintptr_t current = table->slots[slot].load(std::memory_order_acquire);
+    uintptr_t current = table.slots[slot].load(std::memory_order_acquire);
 
     if (current == kEmptySlot) {
       // Hit an empty slot - address not in table
@@ -206,15 +325,15 @@ bool AddressBitset::remove(uintptr_t addr, bool is_large_alloc) {
 
     if (current == kDeletedSlot) {
       // Skip tombstones, continue probing
-      slot = (slot + 1) & table->table_mask;
+      slot = (slot + 1) & table.table_mask;
       continue;
     }
 
     if (current == addr) {
       // Found it - mark as deleted (tombstone)
-      if (table->slots[slot].compare_exchange_strong(
+      if (table.slots[slot].compare_exchange_strong(
               current, kDeletedSlot, std::memory_order_acq_rel)) {
-        table->count.fetch_sub(1, std::memory_order_relaxed);
+        table.count.fetch_sub(1, std::memory_order_relaxed);
         return true;
       }
       // CAS failed - someone else modified this slot
@@ -222,36 +341,106 @@ bool AddressBitset::remove(uintptr_t addr, bool is_large_alloc) {
     }
 
     // Different address - keep probing
-    slot = (slot + 1) & table->table_mask;
+    slot = (slot + 1) & table.table_mask;
   }
 
   // Probe distance exceeded
   return false;
 }
 
+bool AddressBitset::remove(uintptr_t addr, bool is_large_alloc) {
+  assert(addr != kEmptySlot && addr != kDeletedSlot);
+
+  const uint64_t hash = compute_full_hash(addr);
+  if (!_filter.may_contain(hash)) {
+    return false; // Fast path: address was never added
+  }
+
+  // Don't create table if it doesn't exist - address was never added
+  // Newest table first: short lived allocations are found there
+  for (AddressTable *table = find_table(addr, is_large_alloc); table;
+       table = table->older) {
+    // Drained tables no longer receive insertions
+    if (table->count.load(std::memory_order_relaxed) == 0) {
+      continue;
+    }
+    if (remove_from(*table, addr, hash)) {
+      _filter.remove(hash);
+      return true;
+    }
+  }
+  return false;
+}
+
+AddressTable *AddressBitset::find_table(uintptr_t addr,
+                                        bool is_large_alloc) const {
+  const std::atomic<AddressTable *> *shard = get_shard(addr, is_large_alloc);
+  return shard ? shard->load(std::memory_order_acquire) : nullptr;
+}
+
+bool AddressBitset::find_in(const AddressTable &table, uintptr_t addr,
+                            uint64_t hash) {
+  uint32_t slot = hash_to_slot(hash, table.table_mask);
+  for (size_t probe = 0; probe < _k_max_probe_distance; ++probe) {
+    uintptr_t const current = table.slots[slot].load(std::memory_order_acquire);
+    if (current == addr) {
+      return true;
+    }
+    if (current == kEmptySlot) {
+      return false;
+    }
+    slot = (slot + 1) & table.table_mask;
+  }
+  return false;
+}
+
+bool AddressBitset::contains(uintptr_t addr, bool is_large_alloc) const {
+  assert(addr != kEmptySlot && addr != kDeletedSlot);
+
+  const uint64_t hash = compute_full_hash(addr);
+  if (!_filter.may_contain(hash)) {
+    return false;
+  }
+  for (const AddressTable *table = find_table(addr, is_large_alloc); table;
+       table = table->older) {
+    if (find_in(*table, addr, hash)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+namespace {
+void clear_tables(AddressTable *table) {
+  // Tables of grown shards are kept: the shard is likely to grow again
+  for (; table; table = table->older) {
+    for (size_t i = 0; i < table->table_size; ++i) {
+      table->slots[i].store(kEmptySlot, std::memory_order_relaxed);
+    }
+    table->count.store(0, std::memory_order_relaxed);
+  }
+}
+
+size_t count_tables(const AddressTable *table) {
+  size_t total = 0;
+  for (; table; table = table->older) {
+    total += table->count.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+} // namespace
+
 void AddressBitset::clear() {
+  _filter.clear();
   if (_chunk_tables) {
     for (size_t chunk_idx = 0; chunk_idx < _k_max_chunks; ++chunk_idx) {
-      AddressTable *table =
-          _chunk_tables[chunk_idx].load(std::memory_order_acquire);
-      if (table) {
-        for (size_t i = 0; i < table->table_size; ++i) {
-          table->slots[i].store(kEmptySlot, std::memory_order_relaxed);
-        }
-        table->count.store(0, std::memory_order_relaxed);
-      }
+      clear_tables(_chunk_tables[chunk_idx].load(std::memory_order_acquire));
     }
   }
 
   // Clear large allocation table
   if (_large_alloc_table) {
-    AddressTable *table = _large_alloc_table->load(std::memory_order_acquire);
-    if (table) {
-      for (size_t i = 0; i < table->table_size; ++i) {
-        table->slots[i].store(kEmptySlot, std::memory_order_relaxed);
-      }
-      table->count.store(0, std::memory_order_relaxed);
-    }
+    clear_tables(_large_alloc_table->load(std::memory_order_acquire));
   }
 }
 
@@ -260,23 +449,17 @@ int AddressBitset::count() const {
     return 0;
   }
 
-  int total = 0;
+  size_t total = 0;
   for (size_t i = 0; i < _k_max_chunks; ++i) {
-    AddressTable *table = _chunk_tables[i].load(std::memory_order_relaxed);
-    if (table) {
-      total += table->count.load(std::memory_order_relaxed);
-    }
+    total += count_tables(_chunk_tables[i].load(std::memory_order_relaxed));
   }
 
   // Add count from large allocation table
   if (_large_alloc_table) {
-    AddressTable *table = _large_alloc_table->load(std::memory_order_relaxed);
-    if (table) {
-      total += table->count.load(std::memory_order_relaxed);
-    }
+    total += count_tables(_large_alloc_table->load(std::memory_order_relaxed));
   }
 
-  return total;
+  return static_cast<int>(total);
 }
 
 int AddressBitset::active_shards() const {
@@ -300,4 +483,12 @@ int AddressBitset::active_shards() const {
   return active;
 }
 
+AddressBitset::Stats AddressBitset::stats() const {
+  return {.count = static_cast<size_t>(count()),
+          .capacity = _total_slots.load(std::memory_order_relaxed),
+          .max_probe_length =
+              _max_probe_length.load(std::memory_order_relaxed),
+          .nb_growths = _nb_growths.load(std::memory_order_relaxed)};
+}
+
 } // namespace ddprof
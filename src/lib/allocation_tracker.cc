@@ -24,7 +24,10 @@
 #include <chrono>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <new>
+#include <pthread.h>
+#include <sched.h>
 #include <unistd.h>
 
 namespace ddprof {
@@ -47,22 +50,6 @@ __attribute((aligned(DDPROF_TLS_STATE_ALIGN))) __thread char
     ddprof_lib_state[sizeof(TrackerThreadLocalState)];
 #endif
 
-DDPROF_NOINLINE auto sleep_and_retry_reserve(MPSCRingBufferWriter &writer,
-                                             size_t size, bool &timeout) {
-  constexpr std::chrono::nanoseconds k_sleep_duration =
-      std::chrono::microseconds(500);
-  constexpr int k_max_sleep_attempts = 5;
-
-  for (int i = 0; i < k_max_sleep_attempts; i++) {
-    std::this_thread::sleep_for(k_sleep_duration);
-    auto buffer = writer.reserve(size, &timeout, true);
-    if (!buffer.empty() || timeout) {
-      return buffer;
-    }
-  }
-  return Buffer{};
-}
-
 // munmap of previous ring buffer is deferred here (not on free()) so in-flight
 // hooks cannot race with teardown.
 void reset_pevent(PEvent &pevent) {
@@ -119,22 +106,23 @@ AllocationTracker::~AllocationTracker() {
     push_allocation_tracker_state();
     free();
   }
+  stop_snapshot_thread();
 }
 
 DDRes AllocationTracker::allocation_tracking_init(
     uint64_t allocation_profiling_rate, uint32_t flags,
     uint32_t stack_sample_size, const RingBufferInfo &ring_buffer,
-    const IntervalTimerCheck &timer_check) {
+    const IntervalTimerCheck &timer_check, std::string_view socket_path) {
   if (_instance) {
     // the log here is acceptable as we assume we are not in a reentrant state
     DDRES_RETURN_ERROR_LOG(DD_WHAT_UKNW, "Allocation profiler already started");
   }
 
   static AllocationTracker tracker;
-  DDRES_CHECK_FWD(tracker.init(allocation_profiling_rate,
-                               flags & kDeterministicSampling,
-                               flags & kTrackDeallocations, stack_sample_size,
-                               ring_buffer, timer_check));
+  DDRES_CHECK_FWD(tracker.init(
+      allocation_profiling_rate, flags & kDeterministicSampling,
+      flags & kTrackDeallocations, flags & kBatchDeallocations,
+      stack_sample_size, ring_buffer, timer_check, socket_path));
   _instance.store(&tracker, std::memory_order_release);
 
   return {};
@@ -143,9 +131,11 @@ DDRes AllocationTracker::allocation_tracking_init(
 DDRes AllocationTracker::init(uint64_t mem_profile_interval,
                               bool deterministic_sampling,
                               bool track_deallocations,
+                              bool batch_deallocations,
                               uint32_t stack_sample_size,
                               const RingBufferInfo &ring_buffer,
-                              const IntervalTimerCheck &timer_check) {
+                              const IntervalTimerCheck &timer_check,
+                              std::string_view socket_path) {
   if (ring_buffer.ring_buffer_type !=
       static_cast<int>(RingBufferType::kMPSCRingBuffer)) {
     return ddres_error(DD_WHAT_PERFRB);
@@ -155,10 +145,11 @@ DDRes AllocationTracker::init(uint64_t mem_profile_interval,
 
   _sampling_interval = mem_profile_interval;
   _deterministic_sampling = deterministic_sampling;
+  _batch_deallocations = track_deallocations && batch_deallocations;
   _stack_sample_size = stack_sample_size;
   _high_priority_area_size = 0;
   if (track_deallocations) {
-    _allocated_address_set.init(0); // Use default size, fail on add if full
+    _allocated_address_set.init(0); // Use default size, grows when full
     constexpr double k_max_high_priority_area_size_fraction = 0.1;
     constexpr int64_t k_high_priority_event_count = 10000;
     _high_priority_area_size =
@@ -179,6 +170,12 @@ DDRes AllocationTracker::init(uint64_t mem_profile_interval,
   PerfClock::init(static_cast<PerfClockSource>(rb.perf_clock_source));
 
   _interval_timer_check = timer_check;
+  _socket_path = socket_path;
+  for (auto &entry : _lost_free_log.entries) {
+    entry.store(0, std::memory_order_relaxed);
+  }
+  _lost_free_log.cursor = 0;
+  _lost_free_log.overflow = false;
   if (_interval_timer_check.is_set()) {
     auto delay = _interval_timer_check.initial_delay.count()
         ? _interval_timer_check.initial_delay
@@ -196,6 +193,8 @@ DDRes AllocationTracker::init(uint64_t mem_profile_interval,
   _state.failure_count = 0;
   _state.address_conflict_count = 0;
   _state.pid = getpid();
+  _state.next_dealloc_flush_time.store(
+      PerfClock::now() + k_max_dealloc_batch_age, std::memory_order_release);
 
   init_tl_state_internal();
 
@@ -249,7 +248,7 @@ void AllocationTracker::track_allocation(uintptr_t addr, size_t /*size*/,
   int64_t remaining_bytes = tl_state.remaining_bytes;
 
   // compute number of samples this allocation should be accounted for
-  auto sampling_interval = _sampling_interval;
+  auto sampling_interval = _sampling_interval.load(std::memory_order_relaxed);
   size_t nsamples = remaining_bytes / sampling_interval;
   remaining_bytes = remaining_bytes % sampling_interval;
 
@@ -271,6 +270,10 @@ void AllocationTracker::track_allocation(uintptr_t addr, size_t /*size*/,
       addr = 0;
     }
   }
+  if (tl_state.dealloc_batch_time) {
+    // keep the deallocations of this thread ahead of its allocations
+    push_thread_dealloc_batch(tl_state);
+  }
   auto res = push_alloc_sample(addr, total_size, tl_state);
   free_on_consecutive_failures(IsDDResFatal(res));
   if (unlikely(!IsDDResOK(res)) && _state.track_deallocations && addr) {
@@ -284,12 +287,25 @@ void AllocationTracker::track_deallocation(uintptr_t addr,
   // Reentrancy should be prevented by caller (by using ReentryGuard on
   // TrackerThreadLocalState::reentry_guard).
 
-  if (!_state.track_deallocations ||
-      !_allocated_address_set.remove(addr, is_large_alloc)) {
+  if (!_state.track_deallocations) {
+    return;
+  }
+  if (!_allocated_address_set.remove(addr, is_large_alloc)) {
+    if (tl_state.dealloc_batch_time &&
+        dealloc_batch_is_stale(tl_state.dealloc_batch_time,
+                               PerfClock::now())) {
+      // do not leave stale deallocations of a thread that does not free
+      // sampled addresses anymore
+      free_on_consecutive_failures(
+          IsDDResFatal(push_thread_dealloc_batch(tl_state)));
+    }
     return;
   }
 
-  auto fatal_failure = IsDDResFatal(push_dealloc_sample(addr, tl_state));
+  auto fatal_failure = IsDDResFatal(
+      _batch_deallocations
+          ? stage_dealloc_sample(addr, tl_state, is_large_alloc)
+          : push_dealloc_sample(addr, tl_state, is_large_alloc));
   free_on_consecutive_failures(fatal_failure);
 }
 
@@ -319,8 +335,13 @@ DDRes AllocationTracker::push_allocation_tracker_state() {
 
   event->address_conflict_count =
       _state.address_conflict_count.exchange(0, std::memory_order_acq_rel);
-  event->tracked_address_count = _allocated_address_set.count();
+  const AddressBitset::Stats table_stats = _allocated_address_set.stats();
+  event->tracked_address_count = table_stats.count;
   event->active_shards = _allocated_address_set.active_shards();
+  event->address_table_load_factor_pct = table_stats.capacity
+      ? table_stats.count * 100 / table_stats.capacity
+      : 0;
+  event->address_table_max_probe_length = table_stats.max_probe_length;
   event->lost_alloc_count =
       _state.lost_alloc_count.exchange(0, std::memory_order_acq_rel);
   event->lost_dealloc_count =
@@ -384,19 +405,178 @@ DDRes AllocationTracker::push_clear_live_allocation(
   return {};
 }
 
-DDRes AllocationTracker::push_dealloc_sample(
-    uintptr_t addr, TrackerThreadLocalState &tl_state) {
+bool AllocationTracker::log_lost_free(uintptr_t addr, bool is_large_alloc) {
+  uintptr_t const value =
+      addr | (is_large_alloc ? LostFreeLog::k_large_alloc_flag : 0);
+  uint32_t const start =
+      _lost_free_log.cursor.fetch_add(1, std::memory_order_relaxed);
+  for (size_t probe = 0; probe < LostFreeLog::k_max_probes; ++probe) {
+    auto &entry =
+        _lost_free_log.entries[(start + probe) % LostFreeLog::k_capacity];
+    uintptr_t expected = 0;
+    if (entry.compare_exchange_strong(expected, value,
+                                      std::memory_order_acq_rel)) {
+      return true;
+    }
+  }
+  _lost_free_log.overflow.store(true, std::memory_order_release);
+  return false;
+}
+
+void AllocationTracker::replay_lost_frees() {
+  MPSCRingBufferWriter writer{&_pevent.rb, _high_priority_area_size};
+  bool notify_needed = false;
+  for (auto &entry : _lost_free_log.entries) {
+    uintptr_t const value = entry.load(std::memory_order_acquire);
+    if (!value) {
+      continue;
+    }
+    uintptr_t const addr = value & ~LostFreeLog::k_large_alloc_flag;
+    bool const is_large_alloc = value & LostFreeLog::k_large_alloc_flag;
+    // If the address was reused and is tracked again, the profiler replaces
+    // the stale allocation when it receives the new one.
+    if (!_allocated_address_set.contains(addr, is_large_alloc)) {
+      auto buffer = writer.reserve(sizeof(DeallocationEvent), nullptr, true);
+      if (buffer.empty()) {
+        // still no room, retry on next timer check
+        break;
+      }
+      auto *event = reinterpret_cast<DeallocationEvent *>(buffer.data());
+      event->hdr.misc = 0;
+      event->hdr.size = sizeof(DeallocationEvent);
+      event->hdr.type = PERF_CUSTOM_EVENT_DEALLOCATION;
+      event->sample_id.time = PerfClock::now().time_since_epoch().count();
+      event->sample_id.pid = _state.pid;
+      event->sample_id.tid = 0;
+      event->ptr = addr;
+      notify_needed |= writer.commit(buffer);
+    }
+    // writers only claim empty entries
+    entry.store(0, std::memory_order_release);
+  }
+
+  if (notify_needed) {
+    uint64_t count = 1;
+    if (write(_pevent.fd, &count, sizeof(count)) != sizeof(count)) {
+      LG_DBG("Error writing to memory allocation eventfd (%s)",
+             strerror(errno));
+    }
+  }
+}
+
+bool AllocationTracker::request_live_address_snapshot() {
+  if (_socket_path.empty()) {
+    return false;
+  }
+  if (_snapshot_thread_pid != _state.pid) {
+    // No snapshot thread in this process yet: the caller starts it once the
+    // mutex is released, the thread handles the pending overflow on startup
+    _snapshot_thread_pid = _state.pid;
+    return true;
+  }
+  uint32_t expected = kSnapshotIdle;
+  if (_snapshot_request.compare_exchange_strong(expected, kSnapshotPending)) {
+    _snapshot_request.notify_one();
+  }
+  return false;
+}
+
+void AllocationTracker::start_snapshot_thread() {
+  _snapshot_request.store(kSnapshotPending);
+  pthread_t thread;
+  int const err = pthread_create(&thread, nullptr, &snapshot_thread_main, this);
+  std::lock_guard const lock{_state.mutex};
+  if (err) {
+    LG_DBG("Unable to start live address snapshot thread (%s)", strerror(err));
+    // retry on next timer check
+    _snapshot_thread_pid = 0;
+    return;
+  }
+  _snapshot_thread = thread;
+}
+
+void AllocationTracker::stop_snapshot_thread() {
+  if (_snapshot_thread_pid != getpid()) {
+    return;
+  }
+  _snapshot_request.store(kStop);
+  _snapshot_request.notify_one();
+  pthread_join(_snapshot_thread, nullptr);
+  _snapshot_thread_pid = 0;
+}
+
+void *AllocationTracker::snapshot_thread_main(void *arg) {
+  auto *tracker = static_cast<AllocationTracker *>(arg);
+  // allocations from this thread are never tracked
+  TrackerThreadLocalState *tl_state = get_tl_state();
+  ReentryGuard const guard(tl_state ? &tl_state->reentry_guard : nullptr);
+
+  while (true) {
+    tracker->_snapshot_request.wait(kSnapshotIdle);
+    if (tracker->_snapshot_request.exchange(kSnapshotIdle) == kStop) {
+      break;
+    }
+    if (tracker->_lost_free_log.overflow.exchange(false,
+                                                  std::memory_order_acq_rel) &&
+        !IsDDResOK(tracker->push_live_address_snapshot())) {
+      LG_DBG("Unable to send live address snapshot");
+      tracker->_lost_free_log.overflow.store(true, std::memory_order_release);
+    }
+  }
+  return nullptr;
+}
+
+DDRes AllocationTracker::push_live_address_snapshot() {
+  if (_socket_path.empty()) {
+    return ddres_warn(DD_WHAT_SOCKET);
+  }
+  auto client_socket = create_client_socket(_socket_path);
+  if (!client_socket) {
+    return ddres_warn(DD_WHAT_SOCKET);
+  }
+  UnixSocket const socket{std::move(client_socket)};
+  std::error_code ec;
+  socket.set_write_timeout(kDefaultSocketTimeout, ec);
+  DDRES_CHECK_ERRORCODE(ec, DD_WHAT_SOCKET,
+                        "Unable to set write timeout on socket");
+
+  RequestMessage const request = {
+      .request = RequestMessage::kLiveAddressSnapshot, .pid = _state.pid};
+  DDRES_CHECK_FWD(send(socket, request));
+
+  // Allocations registered by the profiler after this time might be missing
+  // from the snapshot and are not reconciled.
+  LiveAddressChunk chunk;
+  chunk.timestamp = PerfClock::now().time_since_epoch().count();
+  DDRes res{};
+  _allocated_address_set.for_each([&](uintptr_t addr) {
+    if (!IsDDResOK(res)) {
+      return;
+    }
+    chunk.addresses[chunk.nb_addresses++] = addr;
+    if (chunk.nb_addresses == LiveAddressChunk::k_max_addresses) {
+      res = send(socket, chunk);
+      chunk.nb_addresses = 0;
+    }
+  });
+  DDRES_CHECK_FWD(res);
+  chunk.last = 1;
+  return send(socket, chunk);
+}
+
+DDRes AllocationTracker::push_dealloc_sample(uintptr_t addr,
+                                             TrackerThreadLocalState &tl_state,
+                                             bool is_large_alloc) {
   MPSCRingBufferWriter writer{&_pevent.rb, _high_priority_area_size};
 
   bool timeout = false;
   auto buffer = writer.reserve(sizeof(DeallocationEvent), &timeout, true);
-  if (buffer.empty()) {
-    buffer =
-        sleep_and_retry_reserve(writer, sizeof(DeallocationEvent), timeout);
-  }
   if (buffer.empty()) {
     // ring buffer is full, increase lost count
+    // Do not wait for the profiler to catch up: keep the address for a later
+    // replay (or a full reconciliation if the log is full).
     _state.lost_dealloc_count.fetch_add(1, std::memory_order_acq_rel);
+    log_lost_free(addr, is_large_alloc);
     if (timeout) {
       LG_DBG("Unable to get write lock on ring buffer");
       return DDRes{._what = DD_WHAT_PERFRB, ._sev = DD_SEV_ERROR};
@@ -434,6 +614,169 @@ DDRes AllocationTracker::push_dealloc_sample(
   return {};
 }
 
+DDRes AllocationTracker::stage_dealloc_sample(
+    uintptr_t addr, TrackerThreadLocalState &tl_state, bool is_large_alloc) {
+  DeallocBatch *batch = lock_dealloc_batch(tl_state, true);
+  if (!batch) {
+    // no batch left, or another thread is pushing the batch
+    return push_dealloc_sample(addr, tl_state, is_large_alloc);
+  }
+  auto now = PerfClock::now();
+  // Time is kept per deallocation: the profiler uses it to ignore
+  // deallocations older than a new allocation at the same address
+  unsigned const idx = batch->nb_deallocs.load(std::memory_order_relaxed);
+  batch->entries[idx] = {.addr = addr, .time = now.time_since_epoch().count()};
+  if (is_large_alloc) {
+    batch->large_allocs |= (1U << idx);
+  }
+  batch->nb_deallocs.store(idx + 1, std::memory_order_relaxed);
+  tl_state.dealloc_batch_time = batch->entries[0].time;
+
+  DDRes res{};
+  if (idx + 1 == batch->entries.size() ||
+      dealloc_batch_is_stale(batch->entries[0].time, now)) {
+    tl_state.dealloc_batch_time = 0;
+    res = push_dealloc_batch(*batch);
+  }
+  unlock_dealloc_batch(*batch);
+
+  check_timer(now, tl_state);
+
+  return res;
+}
+
+AllocationTracker::DeallocBatch *
+AllocationTracker::lock_dealloc_batch(TrackerThreadLocalState &tl_state,
+                                      bool claim) {
+  if (!tl_state.dealloc_batch && claim) {
+    tl_state.dealloc_batch = TrackerThreadLocalState::k_no_dealloc_batch;
+    for (size_t i = 0; i < _dealloc_batches.size(); ++i) {
+      pid_t expected = 0;
+      if (_dealloc_batches[i].owner.compare_exchange_strong(
+              expected, tl_state.tid, std::memory_order_acq_rel)) {
+        tl_state.dealloc_batch = i + 1;
+        break;
+      }
+    }
+  }
+  if (!tl_state.dealloc_batch ||
+      tl_state.dealloc_batch == TrackerThreadLocalState::k_no_dealloc_batch) {
+    return nullptr;
+  }
+  DeallocBatch &batch = _dealloc_batches[tl_state.dealloc_batch - 1];
+  if (batch.busy.exchange(true, std::memory_order_acquire)) {
+    return nullptr;
+  }
+  return &batch;
+}
+
+void AllocationTracker::unlock_dealloc_batch(DeallocBatch &batch) {
+  batch.busy.store(false, std::memory_order_release);
+}
+
+DDRes AllocationTracker::push_thread_dealloc_batch(
+    TrackerThreadLocalState &tl_state) {
+  DeallocBatch *batch = lock_dealloc_batch(tl_state, false);
+  if (!batch) {
+    return {};
+  }
+  tl_state.dealloc_batch_time = 0;
+  DDRes const res = push_dealloc_batch(*batch);
+  unlock_dealloc_batch(*batch);
+  return res;
+}
+
+void AllocationTracker::push_stale_dealloc_batches(PerfClock::time_point now) {
+  auto deadline =
+      _state.next_dealloc_flush_time.load(std::memory_order_acquire);
+  if (now <= deadline ||
+      !_state.next_dealloc_flush_time.compare_exchange_strong(
+          deadline, now + k_max_dealloc_batch_age,
+          std::memory_order_acq_rel)) {
+    // another thread pushes the batches
+    return;
+  }
+  for (DeallocBatch &batch : _dealloc_batches) {
+    if (!batch.nb_deallocs.load(std::memory_order_relaxed) ||
+        batch.busy.exchange(true, std::memory_order_acquire)) {
+      continue;
+    }
+    if (batch.nb_deallocs.load(std::memory_order_relaxed) &&
+        dealloc_batch_is_stale(batch.entries[0].time, now)) {
+      free_on_consecutive_failures(IsDDResFatal(push_dealloc_batch(batch)));
+    }
+    unlock_dealloc_batch(batch);
+  }
+}
+
+bool AllocationTracker::dealloc_batch_is_stale(int64_t oldest_time,
+                                               PerfClock::time_point now) {
+  auto const oldest = PerfClock::time_point{PerfClock::duration{oldest_time}};
+  return now - oldest >= k_max_dealloc_batch_age;
+}
+
+DDRes AllocationTracker::push_dealloc_batch(DeallocBatch &batch) {
+  unsigned const nb_deallocs =
+      batch.nb_deallocs.load(std::memory_order_relaxed);
+  unsigned const large_allocs = batch.large_allocs;
+  batch.nb_deallocs.store(0, std::memory_order_relaxed);
+  batch.large_allocs = 0;
+  if (nb_deallocs == 0) {
+    return {};
+  }
+
+  MPSCRingBufferWriter writer{&_pevent.rb, _high_priority_area_size};
+  size_t const event_size = sizeof_deallocation_batch_event(nb_deallocs);
+
+  bool timeout = false;
+  auto buffer = writer.reserve(event_size, &timeout, true);
+  if (buffer.empty()) {
+    // same as push_dealloc_sample: keep the addresses for a later replay
+    _state.lost_dealloc_count.fetch_add(nb_deallocs, std::memory_order_acq_rel);
+    for (unsigned i = 0; i < nb_deallocs; ++i) {
+      log_lost_free(batch.entries[i].addr,
+                    large_allocs & (1U << i));
+    }
+    if (timeout) {
+      LG_DBG("Unable to get write lock on ring buffer");
+      return DDRes{._what = DD_WHAT_PERFRB, ._sev = DD_SEV_ERROR};
+    }
+    // not an error
+    return ddres_warn(DD_WHAT_PERFRB);
+  }
+
+  auto *event = reinterpret_cast<DeallocationBatchEvent *>(buffer.data());
+  event->hdr.misc = 0;
+  event->hdr.size = event_size;
+  event->hdr.type = PERF_CUSTOM_EVENT_DEALLOCATION_BATCH;
+  // Use the newest deallocation: the batch must not be ordered before an
+  // allocation that one of its later entries frees
+  event->sample_id.time = batch.entries[nb_deallocs - 1].time;
+
+  pid_t const tid = batch.owner.load(std::memory_order_relaxed);
+  DDPROF_DCHECK_FATAL(_state.pid != 0 && tid != 0, "pid or tid is not set");
+  event->sample_id.pid = _state.pid;
+  event->sample_id.tid = tid;
+
+  event->nb_deallocations = nb_deallocs;
+  for (unsigned i = 0; i < nb_deallocs; ++i) {
+    event->deallocations[i] = {
+        .ptr = batch.entries[i].addr,
+        .time = static_cast<uint64_t>(batch.entries[i].time)};
+  }
+
+  if (writer.commit(buffer)) {
+    uint64_t count = 1;
+    if (write(_pevent.fd, &count, sizeof(count)) != sizeof(count)) {
+      LG_DBG("Error writing to memory allocation eventfd (%s)",
+             strerror(errno));
+      return DDRes{._what = DD_WHAT_PERFRB, ._sev = DD_SEV_ERROR};
+    }
+  }
+
+  return {};
+}
+
 DDRes AllocationTracker::push_alloc_sample(uintptr_t addr,
                                            uint64_t allocated_size,
                                            TrackerThreadLocalState &tl_state) {
@@ -517,6 +860,11 @@ DDRes AllocationTracker::push_alloc_sample(uintptr_t addr,
 
 void AllocationTracker::check_timer(PerfClock::time_point now,
                                     TrackerThreadLocalState &tl_state) {
+  if (_batch_deallocations &&
+      now > _state.next_dealloc_flush_time.load(std::memory_order_acquire)) {
+    // idle threads do not push their own batches
+    push_stale_dealloc_batches(now);
+  }
   if (tl_state.allocation_allowed &&
       now > _state.next_check_time.load(std::memory_order_acquire)) {
     update_timer(now);
@@ -524,41 +872,68 @@ void AllocationTracker::check_timer(PerfClock::time_point now,
 }
 
 void AllocationTracker::update_timer(PerfClock::time_point now) {
-  std::lock_guard const lock{_state.mutex};
+  bool start_thread = false;
+  {
+    std::lock_guard const lock{_state.mutex};
 
-  // recheck that we are the thread that should update the timer
-  if (now <= _state.next_check_time.load()) {
-    return;
-  }
+    // recheck that we are the thread that should update the timer
+    if (now <= _state.next_check_time.load()) {
+      return;
+    }
 
-  if (!_interval_timer_check.is_set() ||
-      _interval_timer_check.interval.count() == 0) {
-    _state.next_check_time.store(PerfClock::time_point::max(),
+    if (!_interval_timer_check.is_set() ||
+        _interval_timer_check.interval.count() == 0) {
+      _state.next_check_time.store(PerfClock::time_point::max(),
+                                   std::memory_order_release);
+      return;
+    }
+
+    _state.next_check_time.store(now + _interval_timer_check.interval,
                                  std::memory_order_release);
-    return;
+    update_sampling_interval();
+    if (_state.track_deallocations) {
+      replay_lost_frees();
+      if (_lost_free_log.overflow.load(std::memory_order_acquire)) {
+        start_thread = request_live_address_snapshot();
+      }
+    }
+    push_allocation_tracker_state();
+    _interval_timer_check.callback();
   }
+  if (start_thread) {
+    start_snapshot_thread();
+  }
+}
 
-  _state.next_check_time.store(now + _interval_timer_check.interval,
-                               std::memory_order_release);
-  push_allocation_tracker_state();
-  _interval_timer_check.callback();
+void AllocationTracker::update_sampling_interval() {
+  // profiler adjusts sampling interval to remain within its CPU budget
+  uint64_t const requested_interval =
+      __atomic_load_n(_pevent.rb.sampling_interval, __ATOMIC_RELAXED);
+  if (requested_interval &&
+      requested_interval !=
+          _sampling_interval.load(std::memory_order_relaxed)) {
+    LG_DBG("Updating allocation sampling interval to %lu", requested_interval);
+    _sampling_interval.store(requested_interval, std::memory_order_relaxed);
+  }
 }
 
 DDPROF_NOINLINE uint64_t
 AllocationTracker::next_sample_interval(std::minstd_rand &gen) const {
-  if (_sampling_interval == 1) {
+  uint64_t const sampling_interval =
+      _sampling_interval.load(std::memory_order_relaxed);
+  if (sampling_interval == 1) {
     return 1;
   }
   if (_deterministic_sampling) {
-    return _sampling_interval;
+    return sampling_interval;
   }
-  double const sampling_rate = 1.0 / static_cast<double>(_sampling_interval);
+  double const sampling_rate = 1.0 / static_cast<double>(sampling_interval);
   std::exponential_distribution<> dist(sampling_rate);
   double value = dist(gen);
   constexpr int kMaxSamplingMultiplier = 20;
   const double min_value = 8.0;
   value = std::min(
-      value, static_cast<double>(_sampling_interval * kMaxSamplingMultiplier));
+      value, static_cast<double>(sampling_interval * kMaxSamplingMultiplier));
   value = std::max(value, min_value);
   return static_cast<size_t>(value);
 }
@@ -571,10 +946,66 @@ void AllocationTracker::notify_thread_start() {
   }
 }
 
+void AllocationTracker::flush_current_thread_deallocs() {
+  AllocationTracker *instance = get_instance();
+  if (!instance || !instance->_batch_deallocations) {
+    return;
+  }
+  TrackerThreadLocalState *tl_state = get_tl_state(false);
+  if (!tl_state || !tl_state->dealloc_batch_time) {
+    return;
+  }
+  ReentryGuard const guard(&tl_state->reentry_guard);
+  if (guard) {
+    instance->free_on_consecutive_failures(
+        IsDDResFatal(instance->push_thread_dealloc_batch(*tl_state)));
+  }
+}
+
+void AllocationTracker::notify_thread_exit() {
+  AllocationTracker *instance = get_instance();
+  if (!instance || !instance->_batch_deallocations) {
+    return;
+  }
+  TrackerThreadLocalState *tl_state = get_tl_state(false);
+  if (!tl_state || !tl_state->dealloc_batch ||
+      tl_state->dealloc_batch == TrackerThreadLocalState::k_no_dealloc_batch) {
+    return;
+  }
+  ReentryGuard const guard(&tl_state->reentry_guard);
+  if (!guard) {
+    return;
+  }
+  DeallocBatch &batch = instance->_dealloc_batches[tl_state->dealloc_batch - 1];
+  // a thread pushing the batch reads its owner
+  while (batch.busy.exchange(true, std::memory_order_acquire)) {
+    sched_yield();
+  }
+  instance->free_on_consecutive_failures(
+      IsDDResFatal(instance->push_dealloc_batch(batch)));
+  // give the batch back for threads created later
+  batch.owner.store(0, std::memory_order_release);
+  unlock_dealloc_batch(batch);
+  tl_state->dealloc_batch = 0;
+  tl_state->dealloc_batch_time = 0;
+}
+
+void AllocationTracker::notify_fork_prepare() {
+  flush_current_thread_deallocs();
+}
+
 void AllocationTracker::notify_fork() {
   AllocationTracker *instance = get_instance();
   if (instance) {
     instance->_state.pid = getpid();
+    // Other threads do not exist in the child: give their batches back.
+    // Deallocations staged before the fork belong to the parent.
+    for (DeallocBatch &batch : instance->_dealloc_batches) {
+      batch.owner.store(0, std::memory_order_relaxed);
+      batch.nb_deallocs.store(0, std::memory_order_relaxed);
+      batch.large_allocs = 0;
+      batch.busy.store(false, std::memory_order_release);
+    }
   }
   TrackerThreadLocalState *tl_state = get_tl_state();
   if (unlikely(!tl_state)) {
@@ -585,6 +1016,8 @@ void AllocationTracker::notify_fork() {
     return;
   }
   tl_state->tid = ddprof::gettid();
+  tl_state->dealloc_batch = 0;
+  tl_state->dealloc_batch_time = 0;
 }
 
 void AllocationTracker::notify_pthread_getattr_np() {
@@ -12,6 +12,7 @@
 #include "defer.hpp"
 #include "ipc.hpp"
 #include "lib_embedded_data.h"
+#include "logger.hpp"
 #include "logger_setup.hpp"
 #include "signal_helper.hpp"
 #include "symbol_overrides.hpp"
@@ -43,6 +44,9 @@ struct ProfilerState {
   bool allocation_profiling_started = false;
   bool follow_execs = true;
   pid_t profiler_pid = 0;
+  // connection to the profiler, kept open while a dedicated ring buffer is
+  // used (the profiler releases the ring buffer when it is closed)
+  int profiler_connection = -1;
 
   decltype(&::getenv) getenv = &::getenv;
   decltype(&::putenv) putenv = &::putenv;
@@ -184,6 +188,15 @@ void allocation_profiling_stop() {
     AllocationTracker::allocation_tracking_free();
     g_state.allocation_profiling_started = false;
   }
+  if (g_state.profiler_connection != -1) {
+    close(g_state.profiler_connection);
+    g_state.profiler_connection = -1;
+  }
+}
+
+uint64_t get_allocation_rate() {
+  const char *rate_str = g_state.getenv(k_allocation_rate_env_variable);
+  return rate_str ? strtoull(rate_str, nullptr, 10) : 0;
 }
 
 // Return socket created by ddprof when injecting lib if present
@@ -311,6 +324,8 @@ int exec_ddprof(pid_t target_pid, pid_t parent_pid,
   return -1;
 }
 
+void notify_fork_prepare() { AllocationTracker::notify_fork_prepare(); }
+
 void notify_fork() { AllocationTracker::notify_fork(); }
 
 int ddprof_start_profiling_internal() {
@@ -360,10 +375,14 @@ int ddprof_start_profiling_internal() {
       return -1;
     }
 
-    if (!IsDDResOK(get_profiler_info(std::move(client_socket),
-                                     kDefaultSocketTimeout, &info))) {
+    if (!IsDDResOK(get_profiler_info_dedicated(client_socket,
+                                               kDefaultSocketTimeout,
+                                               get_allocation_rate(), &info))) {
       return -1;
     }
+    if (info.request & RequestMessage::kDedicatedRingBuffer) {
+      g_state.profiler_connection = client_socket.release();
+    }
 
     g_state.profiler_pid = info.pid;
     if (info.allocation_profiling_rate != 0) {
@@ -376,7 +395,8 @@ int ddprof_start_profiling_internal() {
 
       if (info.allocation_flags & ReplyMessage::kLiveSum) {
         // tracking deallocations to allow a live view
-        flags |= AllocationTracker::kTrackDeallocations;
+        flags |= AllocationTracker::kTrackDeallocations |
+            AllocationTracker::kBatchDeallocations;
       }
 
       if (IsDDResOK(AllocationTracker::allocation_tracking_init(
@@ -386,7 +406,8 @@ int ddprof_start_profiling_internal() {
                std::chrono::milliseconds{
                    info.initial_loaded_libs_check_delay_ms},
                std::chrono::milliseconds{
-                   info.loaded_libs_check_interval_ms}}))) {
+                   info.loaded_libs_check_interval_ms}},
+              socket_path))) {
         // \fixme{nsavoire} pthread_create should probably be overridden
         // at load time since we need to capture stack end addresses of all
         // threads in case allocation profiling is started later on
@@ -396,16 +417,22 @@ int ddprof_start_profiling_internal() {
         g_state.allocation_profiling_started = true;
       } else {
         LG_ERR("Failed to start allocation profiling\n");
+        allocation_profiling_stop();
       }
     }
   } catch (const DDException &e) { return -1; }
 
   if (g_state.allocation_profiling_started) {
-    int const res = pthread_atfork(nullptr, nullptr, notify_fork);
+    int const res = pthread_atfork(notify_fork_prepare, nullptr, notify_fork);
     if (res) {
       LG_ERR("Unable to setup notify fork. Error: %d: %s", res, strerror(res));
       assert(0);
     }
+    // logging from allocation hooks must neither block nor slow down the
+    // application: drop messages that do not fit in the log rings
+    if (!LOG_set_async(true, true)) {
+      LG_WRN("Unable to enable asynchronous logging");
+    }
   }
   g_state.started = true;
   set_profiler_library_active();
@@ -436,6 +463,7 @@ void ddprof_stop_profiling(int timeout_ms) {
 
   if (g_state.allocation_profiling_started) {
     allocation_profiling_stop();
+    LOG_set_async(false);
   }
 
   auto time_limit =
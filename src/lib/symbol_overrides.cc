@@ -741,7 +741,9 @@ void *my_start(void *arg) {
   Args *args = reinterpret_cast<Args *>(arg);
   auto [start_routine, start_arg] = *args;
   delete args;
-  return start_routine(start_arg);
+  void *ret = start_routine(start_arg);
+  ddprof::AllocationTracker::notify_thread_exit();
+  return ret;
 }
 
 /** Hook pthread_create to cache stack end address just after thread start.
@@ -785,6 +787,19 @@ struct PthreadGetattrHook : HookBase {
   }
 };
 
+// Push the deallocations staged by the exiting thread
+struct PthreadExitHook : HookBase {
+  static constexpr auto name = "pthread_exit";
+  using FuncType = decltype(&::pthread_exit);
+  static inline FuncType ref{};
+
+  [[noreturn]] static void hook(void *retval) {
+    ddprof::AllocationTracker::notify_thread_exit();
+    ref(retval);
+    __builtin_unreachable();
+  }
+};
+
 struct MmapHook : HookBase {
   static constexpr auto name = "mmap";
   using FuncType = decltype(&::mmap);
@@ -935,6 +950,7 @@ void register_hooks() {
   register_hook<PthreadCreateHook>();
   register_hook<DlopenHook>();
   register_hook<PthreadGetattrHook>();
+  register_hook<PthreadExitHook>();
 }
 
 } // namespace
@@ -7,9 +7,28 @@
 
 #include "logger.hpp"
 
+#include <algorithm>
+
 namespace ddprof {
 
+void LiveAllocation::remove_from_stack(const ValuePerAddress &v,
+                                       PprofStacks &stacks) {
+  // Decrement count and value of the corresponding PprofStacks::value_type
+  // object
+  if (v._unique_stack) {
+    v._unique_stack->second._value -= v._value;
+    if (v._unique_stack->second._count) {
+      --(v._unique_stack->second._count);
+    }
+    if (!v._unique_stack->second._count) {
+      // If count reaches 0, remove the UnwindOutput from stacks
+      stacks.erase(v._unique_stack->first);
+    }
+  }
+}
+
 bool LiveAllocation::register_deallocation(uintptr_t address,
+                                           PerfClock::time_point timestamp,
                                            PprofStacks &stacks,
                                            AddressMap &address_map) {
   // Find the ValuePerAddress object corresponding to the address
@@ -22,27 +41,50 @@ bool LiveAllocation::register_deallocation(uintptr_t address,
     return false;
   }
   ValuePerAddress const &v = map_iter->second;
-
-  // Decrement count and value of the corresponding PprofStacks::value_type
-  // object
-  if (v._unique_stack) {
-    v._unique_stack->second._value -= v._value;
-    if (v._unique_stack->second._count) {
-      --(v._unique_stack->second._count);
-    }
-    if (!v._unique_stack->second._count) {
-      // If count reaches 0, remove the UnwindOutput from stacks
-      stacks.erase(v._unique_stack->first);
-    }
+  if (timestamp < v._timestamp) {
+    LG_DBG("Stale de-allocation at %lx", address);
+    return false;
   }
+  remove_from_stack(v, stacks);
 
   // Remove the element from the address map
   address_map.erase(map_iter);
   return true;
 }
 
+size_t LiveAllocation::reconcile(int watcher_pos, pid_t pid,
+                                 std::span<const uintptr_t> sorted_addresses,
+                                 PerfClock::time_point snapshot_time) {
+  PidMap &pid_map = access_resize(_watcher_vector, watcher_pos);
+  auto pid_iter = pid_map.find(pid);
+  if (pid_iter == pid_map.end()) {
+    return 0;
+  }
+  PidStacks &pid_stacks = pid_iter->second;
+  size_t nb_removed = 0;
+  for (auto iter = pid_stacks._address_map.begin();
+       iter != pid_stacks._address_map.end();) {
+    // allocations that happened after the start of the snapshot might be
+    // missing from it
+    if (iter->second._timestamp < snapshot_time &&
+        !std::binary_search(sorted_addresses.begin(), sorted_addresses.end(),
+                            iter->first)) {
+      remove_from_stack(iter->second, pid_stacks._unique_stacks);
+      iter = pid_stacks._address_map.erase(iter);
+      ++nb_removed;
+    } else {
+      ++iter;
+    }
+  }
+  _stats._reconciled_allocations += nb_removed;
+  LG_NTC("<%d> PID %d: %zu live allocations reconciled (%zu remaining)",
+         watcher_pos, pid, nb_removed, pid_stacks._address_map.size());
+  return nb_removed;
+}
+
 bool LiveAllocation::register_allocation(const UnwindOutput &uo,
                                          uintptr_t address, int64_t value,
+                                         PerfClock::time_point timestamp,
                                          PprofStacks &stacks,
                                          AddressMap &address_map) {
   if (uo.locs.empty()) {
@@ -80,6 +122,7 @@ bool LiveAllocation::register_allocation(const UnwindOutput &uo,
   }
 
   v._value = value;
+  v._timestamp = timestamp;
   v._unique_stack = &unique_stack;
   v._unique_stack->second._value += value;
   ++(v._unique_stack->second._count);
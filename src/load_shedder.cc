@@ -0,0 +1,31 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include "load_shedder.hpp"
+
+#include "logger.hpp"
+
+namespace ddprof {
+
+void LoadShedder::update(double fill_ratio, PerfClock::time_point now) {
+  bool const too_old = _max_age >= k_max_event_age;
+  if (fill_ratio >= k_high_fill_ratio || too_old) {
+    if (_keep_shift < k_max_keep_shift) {
+      ++_keep_shift;
+      LG_DBG("Load shedding: keeping 1/%u samples (fill=%.2f, age=%ldms)",
+             1U << _keep_shift, fill_ratio,
+             std::chrono::duration_cast<std::chrono::milliseconds>(_max_age)
+                 .count());
+    }
+  } else if (_keep_shift > 0 && fill_ratio <= k_low_fill_ratio &&
+             _max_age < k_max_event_age / 2) {
+    --_keep_shift;
+    LG_DBG("Load shedding: keeping 1/%u samples", 1U << _keep_shift);
+  }
+  _max_age = {};
+  _now = now;
+}
+
+} // namespace ddprof
@@ -16,10 +16,18 @@
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <csignal>
 #include <fcntl.h>
+#include <mutex>
+#include <new>
 #include <optional>
+#include <pthread.h>
+#include <string_view>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
+#include <thread>
 #include <unistd.h>
 
 // TODO this is a unix-ism and not portable to Windows.
@@ -50,6 +58,368 @@ struct LoggerContext {
 };
 
 LoggerContext log_ctx{.fd = -1, .mode = LOG_STDERR, .level = LL_ERROR};
+
+// Room for the `<XXX> MMM DD hh:mm:ss.uuuuuu DDPROF[32768]: ` prefix
+constexpr size_t k_header_cap = 256;
+
+constexpr const char *k_level_names[] = {
+    "EMERGENCY", "ALERT",  "CRITICAL",      "ERROR",
+    "WARNING",   "NOTICE", "INFORMATIONAL", "DEBUG",
+};
+
+// Formatting of the date is only done once per second
+struct TimeFormatCache {
+  time_t seconds{-1};
+  char str[sizeof("mmm dd HH:MM:SS0")]{};
+
+  const char *get(time_t t) {
+    if (t != seconds) {
+      struct tm lt;
+      localtime_r(&t, &lt);
+      (void)strftime(str, sizeof(str), "%b %d %H:%M:%S", &lt);
+      seconds = t;
+    }
+    return str;
+  }
+};
+
+size_t format_header(char *buf, int lvl, int fac,
+                     std::chrono::microseconds time,
+                     TimeFormatCache &time_cache) {
+  auto const time_s = std::chrono::duration_cast<std::chrono::seconds>(time);
+  const char *tm_str = time_cache.get(time_s.count());
+  long const us = (time - time_s).count();
+  const char *name =
+      !log_ctx.name.empty() ? log_ctx.name.c_str() : name_default;
+  // Get the PID; overriding if necessary (allow for testing overflow)
+  pid_t const pid = getpid();
+  int sz;
+  if (log_ctx.mode == LOG_SYSLOG) {
+    sz = snprintf(buf, k_header_cap, "<%d>%s.%06ld %s[%d]: ",
+                  lvl + (fac * LL_LENGTH), tm_str, us, name, pid);
+  } else {
+    sz = snprintf(buf, k_header_cap, "<%s>%s.%06ld %s[%d]: ",
+                  k_level_names[lvl], tm_str, us, name, pid);
+  }
+  return sz < 0 ? 0 : std::min(static_cast<size_t>(sz), k_header_cap - 1);
+}
+
+void write_iov(iovec *iov, int iovcnt) {
+  ssize_t rc;
+  do {
+    if (log_ctx.mode == LOG_SYSLOG) {
+      msghdr msg = {};
+      msg.msg_iov = iov;
+      msg.msg_iovlen = iovcnt;
+      rc = sendmsg(log_ctx.fd, &msg, MSG_NOSIGNAL);
+    } else {
+      rc = writev(log_ctx.fd, iov, iovcnt);
+    }
+  } while (rc < 0 && errno == EINTR);
+}
+
+void write_log_line(int lvl, int fac, std::chrono::microseconds time,
+                    std::string_view text, TimeFormatCache &time_cache) {
+  char header[k_header_cap];
+  size_t const header_size =
+      format_header(header, lvl, fac, time, time_cache);
+  char newline[] = "\n";
+  iovec iov[] = {{header, header_size},
+                 {const_cast<char *>(text.data()), text.size()},
+                 {newline, 1}};
+  // Some consumers expect newline-delimited logs.
+  write_iov(iov, log_ctx.mode == LOG_SYSLOG ? 2 : 3);
+}
+
+/****************************** Asynchronous mode *****************************/
+// Every thread queues its log lines in its own ring (single producer), which
+// are drained by a flusher thread (single consumer). Producers never take
+// locks nor allocate from the heap: rings are mmaped and reused by new threads
+// once their owner exits.
+
+struct LogRecord {
+  uint32_t size; // size of the record, including this header
+  uint16_t text_size;
+  int8_t lvl; // negative for padding up to the end of the ring
+  uint8_t fac;
+  int64_t time_us;
+};
+static_assert(LOG_MSG_CAP <= UINT16_MAX);
+
+struct LogRing {
+  static constexpr size_t k_size = 16384;
+  static constexpr size_t k_mask = k_size - 1;
+
+  std::atomic<uint64_t> head{0}; // written by owner
+  std::atomic<uint64_t> tail{0}; // written by flusher
+  std::atomic<bool> owned{true};
+  std::atomic<bool> busy{false}; // owner is pushing (reentry from a signal)
+  LogRing *next{nullptr};
+  alignas(LogRecord) std::byte data[k_size];
+};
+static_assert(sizeof(LogRecord) + LOG_MSG_CAP <= LogRing::k_size / 2);
+
+constexpr auto k_flush_period = std::chrono::milliseconds(20);
+constexpr size_t k_flush_buffer_size = 65536;
+
+struct AsyncLogState {
+  std::atomic<bool> enabled{false};
+  std::atomic<bool> stop{false};
+  bool drop_when_full{false};
+  // Messages queued (or dropped) since the flusher last woke up. The flusher
+  // sleeps on it while there is nothing to write.
+  std::atomic<uint32_t> pending{0};
+  bool handlers_installed{false};
+  pthread_key_t ring_key{};
+  pthread_t flusher{};
+  std::atomic<LogRing *> rings{nullptr};
+  std::atomic<uint64_t> dropped{0};
+
+  // Consumer state, protected by drain_mutex
+  std::mutex drain_mutex;
+  TimeFormatCache time_cache;
+  char last_text[LOG_MSG_CAP];
+  size_t last_size{0};
+  int last_lvl{-1};
+  int last_fac{0};
+  std::chrono::microseconds last_time{};
+  uint64_t repeats{0};
+  char out[k_flush_buffer_size];
+  size_t out_size{0};
+};
+
+AsyncLogState s_async;
+
+void release_thread_ring(void *ring) {
+  static_cast<LogRing *>(ring)->owned.store(false, std::memory_order_release);
+}
+
+LogRing *get_thread_ring() {
+  auto *ring = static_cast<LogRing *>(pthread_getspecific(s_async.ring_key));
+  if (ring) {
+    return ring;
+  }
+  // reuse the ring of an exited thread
+  for (ring = s_async.rings.load(std::memory_order_acquire); ring;
+       ring = ring->next) {
+    bool expected = false;
+    if (ring->owned.compare_exchange_strong(expected, true,
+                                            std::memory_order_acquire)) {
+      break;
+    }
+  }
+  if (!ring) {
+    void *addr = mmap(nullptr, sizeof(LogRing), PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+      return nullptr;
+    }
+    ring = new (addr) LogRing{};
+    ring->next = s_async.rings.load(std::memory_order_relaxed);
+    while (!s_async.rings.compare_exchange_weak(ring->next, ring,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed)) {}
+  }
+  pthread_setspecific(s_async.ring_key, ring);
+  return ring;
+}
+
+bool ring_push(LogRing &ring, int lvl, int fac, std::chrono::microseconds time,
+               std::string_view text) {
+  uint64_t head = ring.head.load(std::memory_order_relaxed);
+  uint64_t const tail = ring.tail.load(std::memory_order_acquire);
+  size_t const record_size = (sizeof(LogRecord) + text.size() +
+                              sizeof(LogRecord) - 1) &
+      ~(sizeof(LogRecord) - 1);
+  size_t offset = head & LogRing::k_mask;
+  size_t const contiguous = LogRing::k_size - offset;
+  // records are not split at the end of the ring
+  size_t const needed =
+      record_size <= contiguous ? record_size : contiguous + record_size;
+  if (LogRing::k_size - (head - tail) < needed) {
+    return false;
+  }
+  if (record_size > contiguous) {
+    auto *padding = new (&ring.data[offset]) LogRecord{};
+    padding->size = static_cast<uint32_t>(contiguous);
+    padding->lvl = -1;
+    head += contiguous;
+    offset = 0;
+  }
+  auto *record = new (&ring.data[offset])
+      LogRecord{.size = static_cast<uint32_t>(record_size),
+                .text_size = static_cast<uint16_t>(text.size()),
+                .lvl = static_cast<int8_t>(lvl),
+                .fac = static_cast<uint8_t>(fac),
+                .time_us = time.count()};
+  memcpy(record + 1, text.data(), text.size());
+  ring.head.store(head + record_size, std::memory_order_release);
+  return true;
+}
+
+// Only the first message after a drain wakes the flusher
+void wake_flusher() {
+  if (s_async.pending.fetch_add(1) == 0) {
+    s_async.pending.notify_one();
+  }
+}
+
+// Returns false if message should be written synchronously
+bool async_push(int lvl, int fac, std::chrono::microseconds time,
+                std::string_view text) {
+  LogRing *ring = get_thread_ring();
+  if (ring && ring->busy.exchange(true, std::memory_order_acquire)) {
+    // a signal handler interrupted this thread while it was logging
+    s_async.dropped.fetch_add(1, std::memory_order_relaxed);
+    wake_flusher();
+    return true;
+  }
+  if (ring) {
+    bool const queued = ring_push(*ring, lvl, fac, time, text);
+    ring->busy.store(false, std::memory_order_release);
+    if (queued) {
+      wake_flusher();
+      return true;
+    }
+  }
+  if (s_async.drop_when_full) {
+    s_async.dropped.fetch_add(1, std::memory_order_relaxed);
+    wake_flusher();
+    return true;
+  }
+  return false;
+}
+
+void flush_output() {
+  if (s_async.out_size) {
+    iovec iov = {s_async.out, s_async.out_size};
+    write_iov(&iov, 1);
+    s_async.out_size = 0;
+  }
+}
+
+void output_line(int lvl, int fac, std::chrono::microseconds time,
+                 std::string_view text) {
+  if (log_ctx.mode == LOG_SYSLOG) {
+    // one datagram per message
+    write_log_line(lvl, fac, time, text, s_async.time_cache);
+    return;
+  }
+  if (s_async.out_size + k_header_cap + text.size() + 1 > k_flush_buffer_size) {
+    flush_output();
+  }
+  char *out = s_async.out + s_async.out_size;
+  size_t const header_size =
+      format_header(out, lvl, fac, time, s_async.time_cache);
+  memcpy(out + header_size, text.data(), text.size());
+  out[header_size + text.size()] = '\n';
+  s_async.out_size += header_size + text.size() + 1;
+}
+
+void output_repeats() {
+  if (s_async.repeats) {
+    char text[64];
+    int const sz = snprintf(text, sizeof(text),
+                            "last message repeated %lu times",
+                            static_cast<unsigned long>(s_async.repeats));
+    output_line(s_async.last_lvl, s_async.last_fac, s_async.last_time,
+                {text, static_cast<size_t>(sz)});
+    s_async.repeats = 0;
+  }
+}
+
+void output_record(const LogRecord &record) {
+  std::string_view const text{reinterpret_cast<const char *>(&record + 1),
+                              record.text_size};
+  std::chrono::microseconds const time{record.time_us};
+  // coalesce identical messages
+  if (record.lvl == s_async.last_lvl &&
+      text == std::string_view{s_async.last_text, s_async.last_size}) {
+    ++s_async.repeats;
+    s_async.last_time = time;
+    return;
+  }
+  output_repeats();
+  output_line(record.lvl, record.fac, time, text);
+  memcpy(s_async.last_text, text.data(), text.size());
+  s_async.last_size = text.size();
+  s_async.last_lvl = record.lvl;
+  s_async.last_fac = record.fac;
+  s_async.last_time = time;
+}
+
+// Write all queued messages (drain_mutex must be held)
+void drain_rings() {
+  for (LogRing *ring = s_async.rings.load(std::memory_order_acquire); ring;
+       ring = ring->next) {
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    uint64_t const head = ring->head.load(std::memory_order_acquire);
+    while (tail != head) {
+      const auto *record = reinterpret_cast<const LogRecord *>(
+          &ring->data[tail & LogRing::k_mask]);
+      if (record->lvl >= 0) {
+        output_record(*record);
+      }
+      tail += record->size;
+    }
+    ring->tail.store(tail, std::memory_order_release);
+  }
+  output_repeats();
+  if (uint64_t const dropped = s_async.dropped.exchange(0)) {
+    char text[64];
+    int const sz =
+        snprintf(text, sizeof(text), "%lu log messages were dropped",
+                 static_cast<unsigned long>(dropped));
+    output_line(LL_WARNING, log_ctx.facility,
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()),
+                {text, static_cast<size_t>(sz)});
+  }
+  flush_output();
+}
+
+// Sequentially consistent accesses to `stop` and `pending`: a stop request
+// that does not wake the flusher is seen after the next drain
+void *flusher_main(void * /*unused*/) {
+  while (!s_async.stop.load()) {
+    // sleep until a message is queued
+    s_async.pending.wait(0);
+    // let messages accumulate, they are written in batches
+    std::this_thread::sleep_for(k_flush_period);
+    s_async.pending.store(0);
+    std::lock_guard const lock(s_async.drain_mutex);
+    drain_rings();
+  }
+  return nullptr;
+}
+
+void fork_prepare() { s_async.drain_mutex.lock(); }
+
+void fork_parent() { s_async.drain_mutex.unlock(); }
+
+// Flusher thread does not exist in the child: fall back to synchronous logs
+// and leave messages queued before fork to the parent.
+void fork_child() {
+  s_async.drain_mutex.unlock();
+  s_async.enabled.store(false, std::memory_order_relaxed);
+  for (LogRing *ring = s_async.rings.load(std::memory_order_relaxed); ring;
+       ring = ring->next) {
+    ring->tail.store(ring->head.load(std::memory_order_relaxed),
+                     std::memory_order_relaxed);
+    ring->owned.store(false, std::memory_order_relaxed);
+  }
+  pthread_setspecific(s_async.ring_key, nullptr);
+}
+
+void stop_async() {
+  if (!s_async.enabled.exchange(false)) {
+    return;
+  }
+  s_async.stop.store(true);
+  wake_flusher();
+  pthread_join(s_async.flusher, nullptr);
+  LOG_flush();
+}
 } // namespace
 
 void LOG_setlevel(int lvl) {
@@ -88,6 +458,7 @@ bool LOG_syslog_open() {
 }
 
 void LOG_close() {
+  stop_async();
   if (LOG_SYSLOG == log_ctx.mode || LOG_FILE == log_ctx.mode) {
     close(log_ctx.fd);
   }
@@ -139,17 +510,7 @@ void LOG_setratelimit(uint64_t max_log_per_interval,
   log_ctx.rate_limiter.emplace(max_log_per_interval, interval);
 }
 
-// The message buffer shall be a static, thread-local region defined by the
-// LOG_MSG_CAP compile-time parameter.  The accessible storage amount shall be
-// this region minus room for the following template:
-// `<XXX> MMM DD hh:mm:ss DDPROF[32768]: `  -- let's call this 38 chars
 void vlprintfln(int lvl, int fac, const char *format, va_list args) {
-
-  char buf[LOG_MSG_CAP];
-  ssize_t sz = -1;
-  ssize_t sz_h = -1;
-  int rc = 0;
-
   // Special value handling
   if (lvl == -1) {
     lvl = log_ctx.level;
@@ -157,8 +518,6 @@ void vlprintfln(int lvl, int fac, const char *format, va_list args) {
   if (fac == -1) {
     fac = log_ctx.facility;
   }
-  const char *name =
-      !log_ctx.name.empty() ? log_ctx.name.c_str() : name_default;
 
   // Sanity checks
   if (log_ctx.fd < 0) {
@@ -168,58 +527,27 @@ void vlprintfln(int lvl, int fac, const char *format, va_list args) {
     return;
   }
 
-  // Get the time
   // Note that setting the time on most syslog daemons is probably unnecessary,
   // since the service will strip it out and replace it.  We add it here anyway
   // for completeness (and we need it anyway for other log modes)
-  char tm_str[sizeof("mmm dd HH:MM:SS0")];
-  auto d = std::chrono::system_clock::now().time_since_epoch();
-  auto d_s = std::chrono::duration_cast<std::chrono::seconds>(d);
-  auto d_us = std::chrono::duration_cast<std::chrono::microseconds>(d - d_s);
-
-  time_t const t = d_s.count();
-  struct tm lt;
-  localtime_r(&t, &lt);
-  (void)strftime(tm_str, sizeof(tm_str), "%b %d %H:%M:%S", &lt);
-
-  // Get the PID; overriding if necessary (allow for testing overflow)
-  pid_t const pid = getpid();
+  auto const time = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::system_clock::now().time_since_epoch());
 
-  if (log_ctx.mode == LOG_SYSLOG) {
-    sz_h = snprintf(buf, LOG_MSG_CAP,
-                    "<%d>%s.%06ld %s[%d]: ", lvl + (fac * LL_LENGTH), tm_str,
-                    d_us.count(), name, pid);
-  } else {
-    static constexpr const char *levels[] = {
-        "EMERGENCY", "ALERT",  "CRITICAL",      "ERROR",
-        "WARNING",   "NOTICE", "INFORMATIONAL", "DEBUG",
-    };
-    sz_h = snprintf(buf, LOG_MSG_CAP, "<%s>%s.%06lu %s[%d]: ", levels[lvl],
-                    tm_str, d_us.count(), name, pid);
+  char text[LOG_MSG_CAP];
+  int const sz = vsnprintf(text, sizeof(text), format, args);
+  if (sz < 0) {
+    return;
   }
+  // if size is greater than cap, truncate
+  std::string_view const msg{
+      text, std::min(static_cast<size_t>(sz), sizeof(text) - 1)};
 
-  // Write the body into the buffer
-  ssize_t const cap =
-      LOG_MSG_CAP - sz_h - 2; // Room for optional newline and \0
-  sz = vsnprintf(&buf[sz_h], cap, format, args);
-  sz = std::min(sz, cap); // if size is greater than cap, truncate
-  sz += sz_h;
-
-  // Some consumers expect newline-delimited logs.
-  if (log_ctx.mode != LOG_SYSLOG) {
-    buf[sz] = '\n';
-    buf[sz + 1] = '\0';
-    sz++;
+  if (s_async.enabled.load(std::memory_order_acquire) &&
+      async_push(lvl, fac, time, msg)) {
+    return;
   }
-
-  // Flush to file descriptor
-  do {
-    if (log_ctx.mode == LOG_SYSLOG) {
-      rc = sendto(log_ctx.fd, buf, sz, MSG_NOSIGNAL, nullptr, 0);
-    } else {
-      rc = write(log_ctx.fd, buf, sz);
-    }
-  } while (rc < 0 && errno == EINTR);
+  TimeFormatCache time_cache;
+  write_log_line(lvl, fac, time, msg, time_cache);
 }
 
 // NOLINTNEXTLINE(cert-dcl50-cpp)
@@ -238,6 +566,47 @@ void lprintfln(int lvl, int fac, const char *fmt, ...) {
   va_end(args);
 }
 
+bool LOG_set_async(bool async, bool drop_when_full) {
+  if (!async) {
+    stop_async();
+    return true;
+  }
+  s_async.drop_when_full = drop_when_full;
+  if (s_async.enabled.load()) {
+    return true;
+  }
+  if (!s_async.handlers_installed) {
+    if (pthread_key_create(&s_async.ring_key, release_thread_ring) != 0 ||
+        pthread_atfork(fork_prepare, fork_parent, fork_child) != 0) {
+      return false;
+    }
+    // NOLINTNEXTLINE(cert-err33-c)
+    atexit(LOG_flush);
+    s_async.handlers_installed = true;
+  }
+  s_async.stop.store(false);
+  s_async.pending.store(0);
+
+  // flusher thread should not receive signals of the process
+  sigset_t all_signals;
+  sigset_t old_signals;
+  sigfillset(&all_signals);
+  pthread_sigmask(SIG_SETMASK, &all_signals, &old_signals);
+  int const res = pthread_create(&s_async.flusher, nullptr, flusher_main,
+                                 nullptr);
+  pthread_sigmask(SIG_SETMASK, &old_signals, nullptr);
+  if (res != 0) {
+    return false;
+  }
+  s_async.enabled.store(true, std::memory_order_release);
+  return true;
+}
+
+void LOG_flush() {
+  std::lock_guard const lock(s_async.drain_mutex);
+  drain_rings();
+}
+
 void LOG_set_logs_allowed_function(LogsAllowedCallback logs_allowed_function) {
   log_ctx.logs_allowed_function = std::move(logs_allowed_function);
 }
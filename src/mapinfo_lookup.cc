@@ -5,6 +5,7 @@
 
 #include "mapinfo_lookup.hpp"
 
+#include "build_id.hpp"
 #include "ddres.hpp"
 
 namespace ddprof {
@@ -22,6 +23,9 @@ MapInfoIdx_t MapInfoLookup::get_or_insert(pid_t pid,
         ? dso._filename
         : dso._filename.substr(pos + 1);
     MapInfoIdx_t const map_info_idx = mapinfo_table.size();
+    if ((!build_id || build_id->empty()) && !dso.build_id().empty()) {
+      build_id = format_build_id(dso.build_id());
+    }
     mapinfo_table.emplace_back(dso._start, dso._end, dso._offset,
                                std::move(sname_str),
                                build_id ? *build_id : BuildIdStr{});
@@ -0,0 +1,41 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include "off_cpu_tracker.hpp"
+
+#include <utility>
+
+namespace ddprof {
+
+void OffCpuTracker::switch_out(const UnwindOutput &output,
+                               PerfClock::time_point time, uint64_t scale) {
+  ThreadState &state = _threads[output.tid];
+  // copy assignment keeps the capacity of the previous stack
+  state.output = output;
+  state.switch_out_time = time;
+  state.scale = scale;
+}
+
+OffCpuTracker::OffCpuSample
+OffCpuTracker::switch_in(pid_t tid, PerfClock::time_point time) {
+  auto it = _threads.find(tid);
+  if (it == _threads.end() || !it->second.scale) {
+    return {};
+  }
+  ThreadState &state = it->second;
+  uint64_t const scale = std::exchange(state.scale, 0);
+  if (time < state.switch_out_time) {
+    // events of the thread were not ordered
+    return {};
+  }
+  return {&state.output, time - state.switch_out_time, scale};
+}
+
+void OffCpuTracker::clear_pid(pid_t pid) {
+  std::erase_if(_threads,
+                [pid](const auto &el) { return el.second.output.pid == pid; });
+}
+
+} // namespace ddprof
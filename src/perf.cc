@@ -11,6 +11,7 @@
 
 #include <atomic>
 #include <cassert>
+#include <cerrno>
 #include <cstring>
 #include <fcntl.h>
 #include <sys/mman.h>
@@ -70,6 +71,52 @@ int perf_event_open(struct perf_event_attr *attr, pid_t pid, int cpu, int gfd,
   return syscall(__NR_perf_event_open, attr, pid, cpu, gfd, flags);
 }
 
+bool perf_sample_cgroup_available() {
+  static const bool s_available = [] {
+    perf_event_attr attr = {};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_DUMMY;
+    attr.sample_type = k_perf_sample_cgroup;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    int const fd = perf_event_open(&attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+    if (fd == -1) {
+      LG_DBG("PERF_SAMPLE_CGROUP is not supported (%s)", strerror(errno));
+      return false;
+    }
+    close(fd);
+    return true;
+  }();
+  return s_available;
+}
+
+bool perf_mmap_build_id_available() {
+#ifdef PERF_RECORD_MISC_MMAP_BUILD_ID
+  static const bool s_available = [] {
+    perf_event_attr attr = {};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_DUMMY;
+    attr.mmap2 = 1;
+    attr.build_id = 1;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    int const fd = perf_event_open(&attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+    if (fd == -1) {
+      LG_DBG("PERF_RECORD_MISC_MMAP_BUILD_ID is not supported (%s)",
+             strerror(errno));
+      return false;
+    }
+    close(fd);
+    return true;
+  }();
+  return s_available;
+#else
+  return false;
+#endif
+}
+
 const char *perf_type_str(int type_id) {
   switch (type_id) {
   case PERF_TYPE_HARDWARE:
@@ -105,6 +152,18 @@ perf_event_attr perf_config_from_watcher(const PerfWatcher *watcher,
   attr.exclude_kernel =
       (watcher->options.use_kernel == PerfWatcherUseKernel::kOff);
 
+  // Switch in records close the intervals opened by sched_switch samples
+  attr.context_switch = watcher_is_off_cpu(watcher);
+
+  // Flight recorder: records are written backward so that the newest ones
+  // can be found from the head of an overwritten ring buffer
+  attr.write_backward = watcher->options.flight_recorder;
+
+  // Group leaders read the counters of the group with each sample
+  if (watcher->sample_type & PERF_SAMPLE_READ) {
+    attr.read_format = k_perf_read_format;
+  }
+
   // Extras (metadata for tracking process state)
   if (extras) {
     attr.mmap = 1;
@@ -113,6 +172,10 @@ perf_event_attr perf_config_from_watcher(const PerfWatcher *watcher,
     attr.comm = 1;
     attr.use_clockid = 1;
     attr.clockid = CLOCK_MONOTONIC;
+#ifdef PERF_RECORD_MISC_MMAP_BUILD_ID
+    // mmap events report the build id instead of the inode
+    attr.build_id = perf_mmap_build_id_available();
+#endif
   }
 
   set_perf_clock_source(attr, perf_clock_source);
@@ -131,8 +194,9 @@ size_t get_mask_from_size(size_t size) {
 }
 
 PerfMmapRegion perfown_sz(int fd, size_t size_of_buffer,
-                          bool allow_single_mapping) {
+                          bool allow_single_mapping, bool read_only) {
   PerfMmapRegion mapping{nullptr, false};
+  int const prot = read_only ? PROT_READ : PROT_READ | PROT_WRITE;
 
   size_t const total_length = (2 * size_of_buffer) - get_page_size();
   void *reserved = mmap(nullptr, total_length, PROT_NONE,
@@ -143,11 +207,11 @@ PerfMmapRegion perfown_sz(int fd, size_t size_of_buffer,
         make_defer([&]() { munmap(reserved, total_length); });
     auto *ptr = static_cast<std::byte *>(reserved);
     bool const first_map_ok = mmap(ptr + size_of_buffer - get_page_size(),
-                                   size_of_buffer, PROT_READ | PROT_WRITE,
-                                   MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED;
+                                   size_of_buffer, prot, MAP_SHARED | MAP_FIXED,
+                                   fd, 0) != MAP_FAILED;
     bool const second_map_ok = first_map_ok &&
-        mmap(ptr, size_of_buffer, PROT_READ | PROT_WRITE,
-             MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED;
+        mmap(ptr, size_of_buffer, prot, MAP_SHARED | MAP_FIXED, fd, 0) !=
+            MAP_FAILED;
 
     if (second_map_ok) {
       cleanup_reserved.release();
@@ -164,8 +228,7 @@ PerfMmapRegion perfown_sz(int fd, size_t size_of_buffer,
   }
 
   if (!mapping.addr && allow_single_mapping) {
-    void *single = mmap(nullptr, size_of_buffer, PROT_READ | PROT_WRITE,
-                        MAP_SHARED, fd, 0);
+    void *single = mmap(nullptr, size_of_buffer, prot, MAP_SHARED, fd, 0);
     if (single == MAP_FAILED || !single) {
       return mapping;
     }
@@ -220,36 +283,62 @@ all_perf_configs_from_watcher(const PerfWatcher *watcher, bool extras,
     attr.exclude_kernel = true;
     ret_attr.push_back(attr);
   }
+  if (watcher->sample_type & PERF_SAMPLE_READ) {
+    // older kernels (< 6.1) do not allow inherited events to read their group
+    size_t const nb_configs = ret_attr.size();
+    for (size_t i = 0; i < nb_configs; ++i) {
+      perf_event_attr no_inherit_attr = ret_attr[i];
+      no_inherit_attr.inherit = 0;
+      ret_attr.push_back(no_inherit_attr);
+    }
+  }
   return ret_attr;
 }
 
+perf_event_attr perf_config_group_member(const PerfWatcher *watcher,
+                                         const perf_event_attr &leader_attr) {
+  struct perf_event_attr attr = g_dd_native_attr;
+  attr.type = watcher->type;
+  attr.config = watcher->config;
+  // Members only count: they are scheduled with the leader and their values
+  // are read with its samples
+  attr.sample_regs_user = 0;
+  attr.precise_ip = 0;
+  attr.disabled = 0;
+  attr.enable_on_exec = 0;
+  attr.inherit = leader_attr.inherit;
+  attr.exclude_kernel = leader_attr.exclude_kernel;
+  return attr;
+}
+
 uint64_t perf_value_from_sample(const PerfWatcher *watcher,
-                                const perf_event_sample *sample) {
+                                const PerfSampleView &sample) {
   uint64_t val = 0;
   if (watcher->value_source == EventConfValueSource::kRaw) {
     if (PERF_SAMPLE_RAW & watcher->sample_type) {
       uint64_t const raw_offset = watcher->raw_off;
       uint64_t const raw_sz = watcher->raw_sz;
-      if (raw_sz + raw_offset <= sample->size_raw) {
+      if (raw_sz + raw_offset > sample.size_raw()) {
         assert(0 && "Overflow in raw event access");
         LG_WRN("Overflow in raw event access");
         return 0;
       }
+      const char *data_raw = sample.data_raw();
       switch (raw_sz) {
       case 1:
-        val = *reinterpret_cast<const uint8_t *>(sample->data_raw + raw_offset);
+        val = *reinterpret_cast<const uint8_t *>(data_raw + raw_offset);
         break;
       case 2:
         val =
-            *reinterpret_cast<const uint16_t *>(sample->data_raw + raw_offset);
+            *reinterpret_cast<const uint16_t *>(data_raw + raw_offset);
         break;
       case 4:
         val =
-            *reinterpret_cast<const uint32_t *>(sample->data_raw + raw_offset);
+            *reinterpret_cast<const uint32_t *>(data_raw + raw_offset);
         break;
       case 8: // NOLINT(readability-magic-numbers)
         val =
-            *reinterpret_cast<const uint64_t *>(sample->data_raw + raw_offset);
+            *reinterpret_cast<const uint64_t *>(data_raw + raw_offset);
         break;
       default:
         assert(0 && "Non-integral size for raw value");
@@ -265,13 +354,13 @@ uint64_t perf_value_from_sample(const PerfWatcher *watcher,
   }
   // Register value
   if (watcher->value_source == EventConfValueSource::kRegister) {
-    return sample->regs[watcher->regno];
+    return sample.regs()[watcher->regno];
   }
 
   // period by default
   assert(watcher->value_source == EventConfValueSource::kSample &&
          "All watcher types were considered");
-  return sample->period;
+  return sample.period();
 }
 
 } // namespace ddprof
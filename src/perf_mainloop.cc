@@ -5,15 +5,20 @@
 
 #include "perf_mainloop.hpp"
 
+#include "cpu_budget_governor.hpp"
 #include "ddprof_context_lib.hpp"
 #include "ddprof_worker.hpp"
 #include "ddres.hpp"
 #include "defer.hpp"
 #include "ipc.hpp"
 #include "logger.hpp"
+#include "loser_tree.hpp"
 #include "perf.hpp"
 #include "persistent_worker_state.hpp"
 #include "pevent.hpp"
+#include "pevent_lib.hpp"
+#include "process_ring_buffers.hpp"
+#include "ring_buffer_sizer.hpp"
 #include "ringbuffer_utils.hpp"
 #include "unique_fd.hpp"
 #include "unwind.h"
@@ -24,8 +29,10 @@
 #include <cerrno>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
+#include <mutex>
+#include <optional>
 #include <poll.h>
-#include <queue>
 #include <sys/mman.h>
 #include <sys/signalfd.h>
 #include <sys/socket.h>
@@ -33,13 +40,16 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <utility>
 #include <variant>
+#include <vector>
 
 namespace ddprof {
 namespace {
 
 pid_t g_child_pid = 0;
 std::atomic<bool> g_termination_requested{false};
+std::atomic<bool> g_dump_requested{false};
 
 void handle_signal(int /*unused*/) {
   g_termination_requested.store(true, std::memory_order::relaxed);
@@ -65,16 +75,38 @@ DDRes install_signal_handler() {
   return {};
 }
 
+// Flight recorder dumps are requested with SIGUSR2
+void handle_dump_signal(int /*unused*/) {
+  if (g_child_pid) {
+    kill(g_child_pid, SIGUSR2);
+  } else {
+    // worker process, or no worker yet (the next one inherits the request)
+    g_dump_requested.store(true, std::memory_order::relaxed);
+  }
+}
+
+DDRes install_dump_signal_handler() {
+  struct sigaction sa {};
+  DDRES_CHECK_ERRNO(sigemptyset(&sa.sa_mask), DD_WHAT_MAINLOOP_INIT,
+                    "sigemptyset failed");
+  sa.sa_handler = &handle_dump_signal;
+  sa.sa_flags = SA_RESTART;
+  DDRES_CHECK_ERRNO(sigaction(SIGUSR2, &sa, nullptr), DD_WHAT_MAINLOOP_INIT,
+                    "Setting SIGUSR2 handler failed");
+  return {};
+}
+
 void modify_sigprocmask(int how) {
   sigset_t mask;
   sigemptyset(&mask);
   sigaddset(&mask, SIGINT);
   sigaddset(&mask, SIGTERM);
+  sigaddset(&mask, SIGUSR2);
   sigprocmask(how, &mask, nullptr);
 }
 
 DDRes spawn_workers(PersistentWorkerState *persistent_worker_state,
-                    bool *is_worker) {
+                    PEventHdr *pevent_hdr, bool *is_worker) {
   *is_worker = false;
 
   DDRES_CHECK_FWD(install_signal_handler());
@@ -87,7 +119,13 @@ DDRes spawn_workers(PersistentWorkerState *persistent_worker_state,
     // g_termination_requested flag and fork/waitpid
     modify_sigprocmask(SIG_BLOCK);
     g_child_pid = fork();
-    // unblock signals
+    if (g_child_pid > 0) {
+      // a pending dump request is served by the new worker: later workers
+      // must not dump again on startup
+      g_dump_requested.store(false, std::memory_order::relaxed);
+    }
+    // unblock signals (dump requests received meanwhile are forwarded to
+    // the new worker)
     modify_sigprocmask(SIG_UNBLOCK);
 
     if (!g_child_pid) {
@@ -111,6 +149,9 @@ DDRes spawn_workers(PersistentWorkerState *persistent_worker_state,
       }
     }
     LG_NFO("Refreshing worker process");
+    // ring buffers are no longer mapped by the worker
+    DDRES_CHECK_FWD(pevent_resize_ring_buffers(
+        pevent_hdr, persistent_worker_state->ring_buffer_orders));
   }
 
   return {};
@@ -136,8 +177,13 @@ ReplyMessage create_reply_message(const DDProfContext &ctx) {
       reply.ring_buffer.mem_size = event_it->ring_buffer_size;
       reply.ring_buffer.ring_buffer_type =
           static_cast<int>(event_it->ring_buffer_type);
+      const PerfWatcher &alloc_watcher = ctx.watchers[alloc_watcher_idx];
+      // rate might have been lowered to remain within CPU budget
+      auto const rate = static_cast<int64_t>(watcher_scaled_sample_value(
+          alloc_watcher, ctx.worker_ctx.sampling_rate_scale));
+      // negative rate requests deterministic sampling
       reply.allocation_profiling_rate =
-          ctx.watchers[alloc_watcher_idx].sample_period;
+          alloc_watcher.sample_period < 0 ? -rate : rate;
       reply.stack_sample_size =
           ctx.watchers[alloc_watcher_idx].options.stack_sample_size;
       reply.initial_loaded_libs_check_delay_ms =
@@ -160,13 +206,20 @@ void pollfd_setup(std::span<PEvent> pes, struct pollfd *pfd) {
   for (size_t i = 0; i < pes.size(); ++i) {
     // NOTE: if fd is negative, it will be ignored
     pfd[i].fd = pes[i].fd;
-    pfd[i].events = POLLIN;
+    // overwrite ring buffers are only read on dumps, but still report the
+    // end of the profiled process (POLLHUP)
+    pfd[i].events = pes[i].overwrite ? 0 : POLLIN;
   }
 }
 
+// Maximum number of events dequeued from a MPSC ring buffer and held for
+// reordering. Events in MPSC ring buffers are not ordered by timestamp, they
+// are sorted within this window before being merged with other ring buffers.
+constexpr size_t k_mpsc_reorder_window = 1024;
+
 // EventWrapper holds a reference to a perf_event_header with its associated
 // timestamp.
-// It is used to order events in a std::priority_queue without copying events.
+// It is used to order events without copying them.
 // perf_event_header is not owned by EventWrapper, it points on ring buffer
 // memory, and must remain valid during the lifetime of EventWrapper.
 // Consequently, care must be taken to advance reader cursor position in ring
@@ -174,24 +227,140 @@ void pollfd_setup(std::span<PEvent> pes, struct pollfd *pfd) {
 struct EventWrapper {
   const perf_event_header *event;
   PerfClock::time_point timestamp;
-  int buffer_idx;
 
   friend bool operator>(const EventWrapper &lhs, const EventWrapper &rhs) {
     return lhs.timestamp > rhs.timestamp;
   }
 };
 
-using EventQueue = std::priority_queue<EventWrapper, std::vector<EventWrapper>,
-                                       std::greater<EventWrapper>>;
+// k-way merge of events from all ring buffers, ordered by timestamp.
+// A loser tree holds the timestamp of the head event of each ring buffer:
+// - a perf ring buffer has at most one event in flight (its head)
+// - a MPSC ring buffer has up to k_mpsc_reorder_window events in flight, kept
+//   in a min-heap whose top is the ring buffer head
+// All memory is reserved upfront, merging does not allocate.
+class EventMerger {
+public:
+  explicit EventMerger(std::span<PEvent> pes)
+      : _tree(pes.size(), PerfClock::time_point::max()), _heads(pes.size()) {
+    for (size_t i = 0; i < pes.size(); ++i) {
+      if (pes[i].rb.type == RingBufferType::kMPSCRingBuffer) {
+        _heads[i].window.reserve(k_mpsc_reorder_window);
+      }
+    }
+  }
+
+  [[nodiscard]] bool empty() const {
+    return _tree.top_key() == PerfClock::time_point::max();
+  }
+  [[nodiscard]] size_t top_idx() const { return _tree.top(); }
+  [[nodiscard]] PerfClock::time_point top_timestamp() const {
+    return _tree.top_key();
+  }
+  [[nodiscard]] const perf_event_header *top_event() const {
+    const auto &head = _heads[_tree.top()];
+    return head.window.empty() ? head.event : head.window.front().event;
+  }
+
+  // Read new events from ring buffers that are not already in flight.
+  // Returns the number of events read.
+  int fill(std::span<PEvent> pes, const DDProfContext &ctx,
+           PerfClock::time_point max_timestamp) {
+    int new_events = 0;
+    for (size_t i = 0; i < pes.size(); ++i) {
+      if (pes[i].overwrite) {
+        continue;
+      }
+      auto &rb = pes[i].rb;
+      auto &head = _heads[i];
+      auto sample_type = ctx.watchers[pes[i].watcher_pos].sample_type;
+      if (rb.type == RingBufferType::kPerfRingBuffer) {
+        // if perf ring buffer has already an event in flight, skip it
+        if (!perf_rb_has_inflight_events(rb)) {
+          head.event = perf_rb_read_event(rb);
+          if (head.event) {
+            _tree.set_key(i, event_timestamp(head.event, sample_type));
+            ++new_events;
+          }
+        }
+        continue;
+      }
+      bool pushed = false;
+      while (head.window.size() < k_mpsc_reorder_window) {
+        const perf_event_header *event = mpsc_rb_read_event(rb);
+        if (!event) {
+          break;
+        }
+        auto timestamp = event_timestamp(event, sample_type);
+        head.window.push_back({event, timestamp});
+        std::push_heap(head.window.begin(), head.window.end(),
+                       std::greater<>{});
+        pushed = true;
+        ++new_events;
+        if (timestamp > max_timestamp) {
+          break;
+        }
+      }
+      if (pushed) {
+        _tree.set_key(i, head.window.front().timestamp);
+      }
+    }
+    if (new_events) {
+      _tree.rebuild();
+    }
+    return new_events;
+  }
+
+  // Release the top event and replace it by the next event of the same ring
+  // buffer
+  void pop(std::span<PEvent> pes, const DDProfContext &ctx) {
+    size_t const idx = _tree.top();
+    auto &pevent = pes[idx];
+    auto &rb = pevent.rb;
+    auto &head = _heads[idx];
+    if (rb.type == RingBufferType::kPerfRingBuffer) {
+      // advance ring buffer, this frees space for the writer end
+      perf_rb_advance(rb);
+      head.event = perf_rb_read_event(rb);
+      _tree.update_top(
+          head.event ? event_timestamp(
+                           head.event,
+                           ctx.watchers[pevent.watcher_pos].sample_type)
+                     : PerfClock::time_point::max());
+      return;
+    }
+    // advance ring buffer if possible, this frees space for the writer end
+    mpsc_rb_advance_if_possible(rb, head.window.front().event);
+    std::pop_heap(head.window.begin(), head.window.end(), std::greater<>{});
+    head.window.pop_back();
+    _tree.update_top(head.window.empty() ? PerfClock::time_point::max()
+                                         : head.window.front().timestamp);
+  }
+
+private:
+  struct Head {
+    const perf_event_header *event{nullptr};
+    std::vector<EventWrapper> window;
+  };
+
+  static PerfClock::time_point event_timestamp(const perf_event_header *event,
+                                               uint64_t sample_type) {
+    return perf_clock_time_point_from_timestamp(hdr_time(event, sample_type));
+  }
+
+  LoserTree<PerfClock::time_point> _tree;
+  std::vector<Head> _heads;
+};
 
 DDRes worker_process_ring_buffers_ordered(std::span<PEvent> pes,
                                           DDProfContext &ctx,
-                                          EventQueue &event_queue, bool drain) {
+                                          EventMerger &event_merger,
+                                          bool drain) {
   // Reorder events from ring buffers before processing them.
   // Events in each perf ring buffer are already ordered by timestamp.
   // For MPSC ring buffers, there is no such guarantee.
-  // The strategy is to dequeue events from ring buffers and push them in a
-  // priority queue, ordered by timestamp. And then process this priority queue.
+  // The strategy is to dequeue events from ring buffers and merge them by
+  // timestamp with a loser tree (see EventMerger).
   // When a ring buffer is empty, we cannot be sure that a new event with a
   // timestamp less than a previously enqueued event will not be added to the
   // ring buffer in the future.
@@ -199,29 +368,25 @@ DDRes worker_process_ring_buffers_ordered(std::span<PEvent> pes,
   // between the timestamp of an event and the time it appears in the ring
   // buffer, and we process events with timestamps up to (now -
   // kMaxSampleLatency).
-  // For MPSC ring buffers, we dequeue events and push them into the priority
-  // queue until we reach an event with a timestamp greater than (now -
-  // kMaxSampleLatency) or the ring buffer is empty. Note that when an event
-  // with a timestamp greater than (now - kMaxSampleLatency) is dequeued, it is
-  // still pushed in the priority_queue.
+  // For MPSC ring buffers, we dequeue events and push them into the reorder
+  // window until we reach an event with a timestamp greater than (now -
+  // kMaxSampleLatency), the ring buffer is empty or the window is full. Note
+  // that when an event with a timestamp greater than (now - kMaxSampleLatency)
+  // is dequeued, it is still pushed in the window.
   // For perf ring buffers, we ensure that at anytime at most one event from
-  // each ring buffer is in the priority queue. This ensures that events with
-  // identical timestamps in a ring buffer are processed in the same order as in
-  // the ring buffer (priority queue is not stable, therefore pushing events
-  // with identical timestamps might permute them) and this also makes advancing
-  // the reader cursor position in the ring buffer easier since know that only
-  // one event has been read, we can just bump the reader cursor to the last
-  // read position.
-  // When an event from a perf ring buffer is dequeued fron the priority queue,
-  // we advance the reader cursor position in the ring buffer to free the slot
-  // for the writer, and attempt to read the next event from the ring buffer if
-  // not empty.
-  // When an event from a MPSC ring buffer is dequeued from the priority queue,
-  // we try to advance the reader cursor position in the ring buffer to free the
-  // slot for the writer. Since events might be out of order for this ring
-  // buffer, advancing is done by marking processed events as discarded and
-  // bumping the reader position until empty or we reach the first non-discarded
-  // event.
+  // each ring buffer is in flight. This ensures that events with identical
+  // timestamps in a ring buffer are processed in the same order as in the ring
+  // buffer and this also makes advancing the reader cursor position in the
+  // ring buffer easier since know that only one event has been read, we can
+  // just bump the reader cursor to the last read position.
+  // When an event from a perf ring buffer is processed, we advance the reader
+  // cursor position in the ring buffer to free the slot for the writer, and
+  // attempt to read the next event from the ring buffer if not empty.
+  // When an event from a MPSC ring buffer is processed, we try to advance the
+  // reader cursor position in the ring buffer to free the slot for the writer.
+  // Since events might be out of order for this ring buffer, advancing is done
+  // by marking processed events as discarded and bumping the reader position
+  // until empty or we reach the first non-discarded event.
 
   const std::chrono::microseconds kMaxSampleLatency{50};
 
@@ -233,71 +398,21 @@ DDRes worker_process_ring_buffers_ordered(std::span<PEvent> pes,
          now <= deadline) {
     auto max_timestamp =
         drain ? PerfClock::time_point::max() : now - kMaxSampleLatency;
-    int new_events = 0;
 
-    // Dequeue events from each ring buffer and push them in the priority queue
-    for (int i = 0; i < static_cast<int>(pes.size()); ++i) {
-      auto &rb = pes[i].rb;
+    int const new_events = event_merger.fill(pes, ctx, max_timestamp);
 
-      if (rb.type == RingBufferType::kPerfRingBuffer) {
-        // if perf ring buffer has already events in the priority queue, skip it
-        if (!perf_rb_has_inflight_events(rb)) {
-          const perf_event_header *event = perf_rb_read_event(rb);
-          if (event) {
-            auto timestamp = perf_clock_time_point_from_timestamp(
-                hdr_time(event, ctx.watchers[pes[i].watcher_pos].sample_type));
-            event_queue.push({event, timestamp, i});
-            ++new_events;
-          }
-        }
-      } else {
-        while (true) {
-          const perf_event_header *event = mpsc_rb_read_event(rb);
-          if (!event) {
-            break;
-          }
-
-          auto timestamp = perf_clock_time_point_from_timestamp(
-              hdr_time(event, ctx.watchers[pes[i].watcher_pos].sample_type));
-          event_queue.push({event, timestamp, i});
-          ++new_events;
-          if (timestamp > max_timestamp) {
-            break;
-          }
-        }
-      }
-    }
-
-    while (!event_queue.empty()) {
-      const auto &evt = event_queue.top();
-      if (evt.timestamp > max_timestamp) {
+    while (!event_merger.empty()) {
+      if (event_merger.top_timestamp() > max_timestamp) {
         // the next event is too recent, stop processing
         return {};
       }
-      auto &pevent = pes[evt.buffer_idx];
-      auto res =
-          ddprof_worker_process_event(evt.event, pevent.watcher_pos, ctx);
+      auto res = ddprof_worker_process_event(
+          event_merger.top_event(), pes[event_merger.top_idx()].watcher_pos,
+          ctx);
       if (!IsDDResOK(res)) {
         return res;
       }
-
-      auto &rb = pevent.rb;
-      if (rb.type == RingBufferType::kPerfRingBuffer) {
-        // advance ring buffer, this frees space for the writer end
-        perf_rb_advance(rb);
-
-        const perf_event_header *new_event = perf_rb_read_event(rb);
-        if (new_event) {
-          // enqueue next event from the same ring buffer
-          auto timestamp = perf_clock_time_point_from_timestamp(hdr_time(
-              new_event, ctx.watchers[pevent.watcher_pos].sample_type));
-          event_queue.push({new_event, timestamp, evt.buffer_idx});
-        }
-      } else {
-        // advance ring buffer if possible, this frees space for the writer end
-        mpsc_rb_advance_if_possible(rb, evt.event);
-      }
-      event_queue.pop();
+      event_merger.pop(pes, ctx);
     }
 
     if (!new_events) {
@@ -311,6 +426,28 @@ DDRes worker_process_ring_buffers_ordered(std::span<PEvent> pes,
   return {};
 }
 
+// Track the highest fill ratio of each perf ring buffer
+void update_ring_buffer_usage(std::span<PEvent> pes,
+                              std::span<RingBufferUsage> usage) {
+  for (size_t i = 0; i < pes.size(); ++i) {
+    if (pes[i].rb.type == RingBufferType::kPerfRingBuffer &&
+        pes[i].rb.data_size && !pes[i].overwrite) {
+      usage[i].peak_fill_ratio =
+          std::max(usage[i].peak_fill_ratio, rb_fill_ratio(pes[i].rb));
+    }
+  }
+}
+
+double max_fill_ratio(std::span<PEvent> pes) {
+  double res = 0;
+  for (const auto &pevent : pes) {
+    if (pevent.rb.data_size && !pevent.overwrite) {
+      res = std::max(res, rb_fill_ratio(pevent.rb));
+    }
+  }
+  return res;
+}
+
 inline DDRes
 worker_process_ring_buffers(std::span<PEvent> pes, DDProfContext &ctx,
                             std::chrono::steady_clock::time_point *now,
@@ -324,6 +461,10 @@ worker_process_ring_buffers(std::span<PEvent> pes, DDProfContext &ctx,
   do {
     events = false;
     for (auto &pevent : pes) {
+      if (pevent.overwrite) {
+        // read on dumps (flight recorder)
+        continue;
+      }
       auto &ring_buffer = pevent.rb;
       if (ring_buffer.type == RingBufferType::kPerfRingBuffer) {
         PerfRingBufferReader reader(&ring_buffer);
@@ -375,11 +516,14 @@ worker_process_ring_buffers(std::span<PEvent> pes, DDProfContext &ctx,
 DDRes worker_loop(DDProfContext &ctx, const WorkerAttr *attr,
                   PersistentWorkerState *persistent_worker_state) {
 
-  // Setup poll() to watch perf_event file descriptors
-  pollfd poll_fds[k_max_nb_perf_event_open];
+  // Setup poll() to watch perf_event file descriptors, followed by the
+  // control socket or its connection being served (ignored if negative)
+  pollfd poll_fds[k_max_nb_perf_event_open + 1];
   std::span const pevents{ctx.worker_ctx.pevent_hdr.pes,
                           ctx.worker_ctx.pevent_hdr.size};
   pollfd_setup(pevents, poll_fds);
+  pollfd &control_pfd = poll_fds[pevents.size()];
+  control_pfd = {.fd = ctx.control_socket_fd.get(), .events = POLLIN};
 
   // Perform user-provided initialization
   defer { attr->finish_fun(ctx); };
@@ -391,10 +535,42 @@ DDRes worker_loop(DDProfContext &ctx, const WorkerAttr *attr,
     ctx.worker_ctx.us->dso_hdr.pid_backpopulate(ctx.params.pid, nb_elems);
   }
 
-  WorkerServer const server =
-      start_worker_server(ctx.socket_fd.get(), create_reply_message(ctx));
-
-  EventQueue event_queue;
+  ReplyMessage const reply = create_reply_message(ctx);
+  std::optional<ProcessRingBuffers> process_ring_buffers;
+  DedicatedRingBufferCallbacks ring_buffer_callbacks;
+  int const alloc_watcher_idx = context_allocation_profiling_watcher_idx(ctx);
+  if (alloc_watcher_idx != -1 &&
+      ProcessRingBuffers::enabled(ctx.params.pid,
+                                  ctx.params.process_ring_buffers)) {
+    process_ring_buffers.emplace(
+        pevents, alloc_watcher_idx,
+        ctx.watchers[alloc_watcher_idx].options.stack_sample_size,
+        std::abs(reply.allocation_profiling_rate), *persistent_worker_state);
+    // processes might have exited while no worker was running
+    process_ring_buffers->release_dead_processes();
+    ctx.worker_ctx.process_ring_buffers = &*process_ring_buffers;
+    ring_buffer_callbacks = {
+        .create =
+            [&](pid_t pid, uint64_t allocation_rate, RingBufferInfo &info) {
+              return process_ring_buffers->assign(pid, allocation_rate, info);
+            },
+        .release = [&](uint64_t id) { process_ring_buffers->release(id); }};
+  }
+  defer { ctx.worker_ctx.process_ring_buffers = nullptr; };
+
+  // Live address snapshots are received by the server thread and applied
+  // from this loop
+  std::mutex snapshot_mutex;
+  std::vector<LiveAddressSnapshot> pending_snapshots;
+  WorkerServer const server = start_worker_server(
+      ctx.socket_fd.get(), reply,
+      [&](LiveAddressSnapshot &&snapshot) {
+        std::lock_guard const lock{snapshot_mutex};
+        pending_snapshots.push_back(std::move(snapshot));
+      },
+      std::move(ring_buffer_callbacks));
+
+  EventMerger event_merger{pevents};
   bool skip_poll = false;
   const auto k_poll_timeout = std::chrono::milliseconds{10};
 
@@ -402,7 +578,8 @@ DDRes worker_loop(DDProfContext &ctx, const WorkerAttr *attr,
   while (!g_termination_requested.load(std::memory_order::relaxed)) {
 
     if (!skip_poll) {
-      int const n = poll(poll_fds, pevents.size(), k_poll_timeout.count());
+      int const n =
+          poll(poll_fds, pevents.size() + 1, k_poll_timeout.count());
 
       // If there was an issue, return and let the caller check errno
       if (-1 == n && errno == EINTR) {
@@ -411,6 +588,13 @@ DDRes worker_loop(DDProfContext &ctx, const WorkerAttr *attr,
       DDRES_CHECK_ERRNO(n, DD_WHAT_POLLERROR, "poll failed");
     }
 
+    // a connection of the control socket is served until its command is
+    // complete, without waiting for it
+    if ((!skip_poll && (control_pfd.revents & (POLLIN | POLLHUP))) ||
+        ctx.worker_ctx.control_connection) {
+      DDRES_CHECK_FWD(ddprof_worker_control(ctx, control_pfd.fd));
+    }
+
     bool stop = false;
     for (size_t i = 0; i < pevents.size(); ++i) {
       pollfd const &pfd = poll_fds[i];
@@ -426,16 +610,38 @@ DDRes worker_loop(DDProfContext &ctx, const WorkerAttr *attr,
       }
     }
 
+    if (ctx.params.load_shedding) {
+      ctx.worker_ctx.load_shedder.update(max_fill_ratio(pevents),
+                                         PerfClock::now());
+    }
+    if (ctx.params.ring_buffer_budget_mib > 0) {
+      update_ring_buffer_usage(pevents, ctx.worker_ctx.ring_buffer_usage);
+    }
+
     std::chrono::steady_clock::time_point now;
     if (ctx.params.reorder_events) {
-      DDRES_CHECK_FWD(
-          worker_process_ring_buffers_ordered(pevents, ctx, event_queue, stop));
+      DDRES_CHECK_FWD(worker_process_ring_buffers_ordered(pevents, ctx,
+                                                          event_merger, stop));
       now = std::chrono::steady_clock::now();
     } else {
       DDRES_CHECK_FWD(
           worker_process_ring_buffers(pevents, ctx, &now, &skip_poll));
     }
 
+    if (g_dump_requested.exchange(false, std::memory_order::relaxed) ||
+        std::exchange(ctx.worker_ctx.flight_recorder_dump_requested, false)) {
+      DDRES_CHECK_FWD(ddprof_worker_dump_flight_recorder(ctx));
+    }
+
+    std::vector<LiveAddressSnapshot> snapshots;
+    {
+      std::lock_guard const lock{snapshot_mutex};
+      snapshots.swap(pending_snapshots);
+    }
+    for (const LiveAddressSnapshot &snapshot : snapshots) {
+      ddprof_worker_reconcile_live_allocations(ctx, snapshot);
+    }
+
     DDRES_CHECK_FWD(ddprof_worker_maybe_export(ctx, now));
 
     if (ctx.worker_ctx.persistent_worker_state->restart_worker) {
@@ -458,6 +664,12 @@ void worker(DDProfContext &ctx, const WorkerAttr *attr,
   persistent_worker_state->restart_worker = false;
   persistent_worker_state->errors = true;
 
+  // keep formatting and writing of logs out of the sample processing path
+  if (!LOG_set_async(true)) {
+    LG_WRN("Unable to enable asynchronous logging");
+  }
+  defer { LOG_set_async(false); };
+
   DDRes const res = worker_loop(ctx, attr, persistent_worker_state);
   if (IsDDResFatal(res)) {
     LG_WRN("[PERF] Shut down worker (what:%s).",
@@ -490,8 +702,13 @@ DDRes main_loop(const WorkerAttr *attr, DDProfContext *ctx) {
 
   // Create worker processes to fulfill poll loop.  Only the parent process
   // can exit with an error code, which signals the termination of profiling.
+  if (ctx->params.flight_recorder) {
+    DDRES_CHECK_FWD(install_dump_signal_handler());
+  }
+
   bool is_worker = false;
-  DDRes res = spawn_workers(persistent_worker_state, &is_worker);
+  DDRes res = spawn_workers(persistent_worker_state,
+                            &ctx->worker_ctx.pevent_hdr, &is_worker);
   if (IsDDResNotOK(res)) {
     return res;
   }
@@ -24,6 +24,7 @@ bool rb_init(RingBuffer *rb, void *base, size_t size,
   rb->mask = get_mask_from_size(size);
   rb->type = ring_buffer_type;
   rb->spinlock = nullptr;
+  rb->sampling_interval = nullptr;
   rb->mirrored_mapping = mirrored_mapping;
   rb->wrap_copy.reset();
   rb->wrap_copy_capacity = 0;
@@ -40,6 +41,7 @@ bool rb_init(RingBuffer *rb, void *base, size_t size,
     rb->reader_pos = &meta->reader_pos;
     rb->writer_pos = &meta->writer_pos;
     rb->spinlock = &meta->spinlock;
+    rb->sampling_interval = &meta->sampling_interval;
     rb->perf_clock_source = meta->perf_clock_source;
     rb->time_mult = meta->time_mult;
     rb->time_shift = meta->time_shift;
@@ -136,13 +138,14 @@ bool samp2hdr(perf_event_header *hdr, const perf_event_sample *sample,
     SZ_CHECK;
   }
   if (PERF_SAMPLE_READ & mask) {
-    *(reinterpret_cast<struct read_format *>(buf)) = *sample->v;
-    buf += sizeof(struct read_format) /
-        sizeof(size_t); // read_format is uint64_t's
-    sz += sizeof(struct read_format);
+    size_t const sz_read = sizeof(struct read_group_format) +
+        (sample->read_group->nr * sizeof(struct read_group_entry));
+    sz += sz_read;
     if (sz >= sz_hdr) {
       return false;
     }
+    memcpy(buf, sample->read_group, sz_read);
+    buf += sz_read / sizeof(*buf); // read_group_format is uint64_t's
   }
   if (PERF_SAMPLE_CALLCHAIN & mask) {
     *buf++ = sample->nr;
@@ -244,7 +247,8 @@ perf_event_sample *hdr2samp(const perf_event_header *hdr, uint64_t mask) {
     sample.period = *buf++;
   }
   if (PERF_SAMPLE_READ & mask) {
-    sample.v = reinterpret_cast<const struct read_format *>(buf++);
+    sample.read_group = reinterpret_cast<const struct read_group_format *>(buf);
+    buf += 1 + (sample.read_group->nr * 2); // {value, id} per counter
   }
 
   if (PERF_SAMPLE_CALLCHAIN & mask) {
@@ -337,7 +341,9 @@ uint64_t hdr_time(const perf_event_header *hdr, uint64_t mask) {
   case PERF_RECORD_COMM:
   case PERF_RECORD_EXIT:
   case PERF_RECORD_FORK:
-  case PERF_RECORD_LOST: {
+  case PERF_RECORD_LOST:
+  case PERF_RECORD_SWITCH:
+  case PERF_RECORD_SWITCH_CPU_WIDE: {
     auto nb_fields_after = std::popcount(
         mask &
         (PERF_SAMPLE_TIME | PERF_SAMPLE_ID | PERF_SAMPLE_STREAM_ID |
@@ -348,6 +354,9 @@ uint64_t hdr_time(const perf_event_header *hdr, uint64_t mask) {
   }
   case PERF_CUSTOM_EVENT_DEALLOCATION:
     return reinterpret_cast<const DeallocationEvent *>(hdr)->sample_id.time;
+  case PERF_CUSTOM_EVENT_DEALLOCATION_BATCH:
+    return reinterpret_cast<const DeallocationBatchEvent *>(hdr)
+        ->sample_id.time;
   case PERF_CUSTOM_EVENT_CLEAR_LIVE_ALLOCATION:
     return reinterpret_cast<const ClearLiveAllocationEvent *>(hdr)
         ->sample_id.time;
@@ -0,0 +1,156 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include "perf_sample_parser.hpp"
+
+#include "perf_archmap.hpp"
+#include "perf_watcher.hpp"
+
+#include <type_traits>
+
+namespace ddprof {
+
+// Walks the sample layout (see perf_event_open(2)) and records field offsets.
+// `mask` is either a std::integral_constant, in which case every test below is
+// resolved at compile time, or a runtime uint64_t.
+template <typename T>
+bool parse_sample_fields(const perf_event_header *hdr, T mask,
+                         PerfSampleView *view) {
+  const auto *base = reinterpret_cast<const std::byte *>(hdr);
+  // sample starts after header
+  const auto *buf = reinterpret_cast<const uint64_t *>(&hdr[1]);
+  auto offset = [&]() {
+    return static_cast<uint16_t>(reinterpret_cast<const std::byte *>(buf) -
+                                 base);
+  };
+
+  *view = PerfSampleView{hdr};
+  if (PERF_SAMPLE_IDENTIFIER & mask) {
+    ++buf;
+  }
+  if (PERF_SAMPLE_IP & mask) {
+    view->_ip_off = offset();
+    ++buf;
+  }
+  if (PERF_SAMPLE_TID & mask) {
+    view->_tid_off = offset();
+    ++buf;
+  }
+  if (PERF_SAMPLE_TIME & mask) {
+    view->_time_off = offset();
+    ++buf;
+  }
+  if (PERF_SAMPLE_ADDR & mask) {
+    view->_addr_off = offset();
+    ++buf;
+  }
+  if (PERF_SAMPLE_ID & mask) {
+    ++buf;
+  }
+  if (PERF_SAMPLE_STREAM_ID & mask) {
+    ++buf;
+  }
+  if (PERF_SAMPLE_CPU & mask) {
+    view->_cpu_off = offset();
+    ++buf;
+  }
+  if (PERF_SAMPLE_PERIOD & mask) {
+    view->_period_off = offset();
+    ++buf;
+  }
+  if (PERF_SAMPLE_READ & mask) {
+    view->_read_off = offset();
+    buf += 1 + (2 * *buf); // {value, id} per counter of the group
+  }
+  if (PERF_SAMPLE_CALLCHAIN & mask) {
+    view->_callchain_off = offset();
+    buf += 1 + *buf;
+  }
+  if (PERF_SAMPLE_RAW & mask) {
+    view->_raw_off = offset();
+    // size_raw is a 32-bit integer!
+    uint32_t const size_raw = *reinterpret_cast<const uint32_t *>(buf);
+    buf += 1 + (size_raw / sizeof(*buf)); // Advance + align
+  }
+  if (PERF_SAMPLE_REGS_USER & mask) {
+    // ddprof only has register definitions for 64-bit processors.  Reject
+    // everything else for now.
+    if (*buf++ != PERF_SAMPLE_REGS_ABI_64) {
+      return false;
+    }
+    view->_regs_off = offset();
+    buf += k_perf_register_count;
+  }
+  if (PERF_SAMPLE_STACK_USER & mask) {
+    uint64_t const size_stack = *buf++;
+    // Empirically, it seems that the size of the static stack is either 0 or
+    // the amount requested in the call to `perf_event_open()`.
+    if (size_stack != 0) {
+      view->_stack_off = offset();
+      buf += (size_stack + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+      // If the size was specified, we also have a dyn_size
+      uint64_t const dynsz_stack = *buf++;
+      // If the dyn_size is too big, zero out the stack size since it is
+      // likely an error
+      view->_size_stack = size_stack < dynsz_stack ? 0 : dynsz_stack;
+    }
+  }
+  // Fields in between (weight, data source...) are never requested
+  if (k_perf_sample_cgroup & mask) {
+    view->_cgroup_off = offset();
+    ++buf;
+  }
+  return true;
+}
+
+namespace {
+
+template <uint64_t Mask>
+bool parse_sample(const perf_event_header *hdr, uint64_t /*sample_type*/,
+                  PerfSampleView *view) {
+  return parse_sample_fields(hdr, std::integral_constant<uint64_t, Mask>{},
+                             view);
+}
+
+bool parse_sample_generic(const perf_event_header *hdr, uint64_t sample_type,
+                          PerfSampleView *view) {
+  return parse_sample_fields(hdr, sample_type, view);
+}
+
+// sample types in use: default (perf events), with raw data (tracepoints),
+// with address (allocations), with cgroup (when supported by the kernel) and
+// with the counters of a group (group leaders)
+#define SAMPLE_TYPE_TABLE(X)                                                   \
+  X(BASE_STYPES)                                                               \
+  X(BASE_STYPES | PERF_SAMPLE_RAW)                                             \
+  X(BASE_STYPES | PERF_SAMPLE_ADDR)                                            \
+  X(BASE_STYPES | PERF_SAMPLE_RAW | PERF_SAMPLE_ADDR)                          \
+  X(BASE_STYPES | k_perf_sample_cgroup)                                        \
+  X(BASE_STYPES | PERF_SAMPLE_RAW | k_perf_sample_cgroup)                      \
+  X(BASE_STYPES | PERF_SAMPLE_READ)                                            \
+  X(BASE_STYPES | PERF_SAMPLE_READ | k_perf_sample_cgroup)
+
+struct SampleParserEntry {
+  uint64_t sample_type;
+  PerfSampleParser parser;
+};
+
+#define X_PARSER(mask) {(mask), &parse_sample<(mask)>},
+constexpr SampleParserEntry k_sample_parsers[] = {
+    SAMPLE_TYPE_TABLE(X_PARSER)};
+#undef X_PARSER
+
+} // namespace
+
+PerfSampleParser perf_sample_parser_from_type(uint64_t sample_type) {
+  for (const auto &entry : k_sample_parsers) {
+    if (entry.sample_type == sample_type) {
+      return entry.parser;
+    }
+  }
+  return &parse_sample_generic;
+}
+
+} // namespace ddprof
@@ -13,10 +13,6 @@
 
 namespace ddprof {
 
-#define BASE_STYPES                                                            \
-  (PERF_SAMPLE_STACK_USER | PERF_SAMPLE_REGS_USER | PERF_SAMPLE_TID |          \
-   PERF_SAMPLE_TIME | PERF_SAMPLE_PERIOD)
-
 uint64_t perf_event_default_sample_type() { return BASE_STYPES; }
 
 // putting parentheses around "h" param breaks compilation
@@ -186,12 +182,17 @@ std::string_view watcher_help_text() {
 "----------------\n"
 "1. CPU profiling with a custom sampling frequency: -e \"sCPU p=50\"\n"
 "2. Live Allocation Tracking (leak detection):\n"
-"  -e sALLOC,mode=l\n\n"
+"  -e sALLOC,mode=l\n"
+"3. Counting system calls per syscall number:\n"
+"  -e \"raw_syscalls:sys_enter c=1 o=8 z=8\"\n"
+"4. Cache and branch misses read with each CPU cycles sample:\n"
+"  -e \"hCPU cg=1\" -e \"hCMISS cg=1\" -e \"hBMISS cg=1\"\n\n"
 "Event Types:\n"
 "------------\n"
 "The most common types are:\n"
 "- sCPU for CPU Time \n"
 "- sALLOC for allocations (only available in wrapper mode) \n"
+"- sOFFCPU for time spent off CPU (blocked), from sched_switch tracepoints \n"
 "Please consult the `https://github.com/DataDog/ddprof/blob/main/include/perf_watcher.hpp#L117-L138` for an up to date list of available events. \n"
 "Note: Some events may require hardware support and elevated permissions.\n\n"
 "Configuration Keys:\n"
@@ -208,7 +209,9 @@ std::string_view watcher_help_text() {
 "- `r|register|regno`: Register to retrieve the value associated with this event.\n"
 "- `st|stack_sample_size|stcksz : Same as the stack_sample_size input option for this event."
 "- `o|raw_offset|rawoff`: Raw offset to retrieve the value associated with this event.\n"
-"- `z|raw_size|rawsz`: Raw size associated to raw offset.\n\n"
+"- `z|raw_size|rawsz`: Raw size associated to raw offset.\n"
+"- `c|count_only|count`: Count events per thread without capturing stacks (c=1). A raw field splits counts per value.\n"
+"- `cg|counter_group`: Counter group number. The first event of a group samples stacks, the others are read with its samples.\n\n"
 "Disclaimer:\n"
 "-----------\n"
 "Please note that this documentation is currently under construction. We recommend the use of presets.\n"
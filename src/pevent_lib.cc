@@ -10,12 +10,15 @@
 #include "defer.hpp"
 #include "lib/allocation_event.hpp"
 #include "perf.hpp"
+#include "perf_sample_parser.hpp"
+#include "process_ring_buffers.hpp"
 #include "ringbuffer_utils.hpp"
 #include "sys_utils.hpp"
 #include "syscalls.hpp"
 #include "tracepoint_config.hpp"
 #include "user_override.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cerrno>
 #include <cstddef>
@@ -51,13 +54,10 @@ void display_system_config() {
 
 // set info for a perf_event_open type of buffer
 void pevent_set_info(int fd, int attr_idx, PEvent &pevent,
-                     uint32_t stack_sample_size) {
+                     int buffer_size_order, bool overwrite) {
   static bool log_once = true;
   pevent.fd = fd;
   pevent.mapfd = fd;
-  int const buffer_size_order = pevent_compute_min_mmap_order(
-      k_default_buffer_size_shift, stack_sample_size,
-      k_min_number_samples_per_ring_buffer);
   if (buffer_size_order > k_default_buffer_size_shift && log_once) {
     LG_NTC("Increasing size order of the ring buffer to %d (from %d)",
            buffer_size_order, k_default_buffer_size_shift);
@@ -65,12 +65,29 @@ void pevent_set_info(int fd, int attr_idx, PEvent &pevent,
   }
   pevent.ring_buffer_size = perf_mmap_size(buffer_size_order);
   pevent.custom_event = false;
+  pevent.overwrite = overwrite;
   pevent.ring_buffer_type = RingBufferType::kPerfRingBuffer;
   pevent.attr_idx = attr_idx;
 }
 
+// Events redirected to the ring buffer of `pevent` (sub fds) are detached
+// from it once it is unmapped, they are redirected again
+DDRes pevent_remap_event(PEvent &pevent, size_t ring_buffer_size) {
+  DDRES_CHECK_FWD(pevent_munmap_event(&pevent));
+  pevent.ring_buffer_size = ring_buffer_size;
+  DDRES_CHECK_FWD(pevent_mmap_event(&pevent));
+  for (auto fd : pevent.sub_fds) {
+    DDRES_CHECK_INT(ioctl(fd, PERF_EVENT_IOC_SET_OUTPUT, pevent.fd),
+                    DD_WHAT_IOCTL,
+                    "Error ioctl PERF_EVENT_IOC_SET_OUTPUT fd=%d output_fd=%d",
+                    fd, pevent.fd);
+  }
+  return {};
+}
+
 DDRes pevent_register_cpu_0(const PerfWatcher *watcher, int watcher_idx,
-                            pid_t pid, PerfClockSource perf_clock_source,
+                            pid_t pid, unsigned long open_flags,
+                            PerfClockSource perf_clock_source,
                             PEventHdr *pevent_hdr, size_t &pevent_idx) {
   // register cpu 0 and find a working config
   PEvent *pes = pevent_hdr->pes;
@@ -81,12 +98,19 @@ DDRes pevent_register_cpu_0(const PerfWatcher *watcher, int watcher_idx,
   // attempt with different configs
   for (auto &attr : perf_event_data) {
     // register cpu 0
-    int const fd = perf_event_open(&attr, pid, 0, -1, PERF_FLAG_FD_CLOEXEC);
+    int const fd = perf_event_open(&attr, pid, 0, -1, open_flags);
     if (fd != -1) {
       // Copy the successful config
       pevent_hdr->attrs[pevent_hdr->nb_attrs] = attr;
       pevent_set_info(fd, pevent_hdr->nb_attrs, pes[pevent_idx],
-                      watcher->options.stack_sample_size);
+                      pevent_initial_mmap_order(*watcher),
+                      attr.write_backward);
+      if ((watcher->sample_type & PERF_SAMPLE_READ) && !attr.inherit &&
+          pid != -1 && !(open_flags & PERF_FLAG_PID_CGROUP)) {
+        LG_WRN("Watcher %s can not read its counter group with inherited "
+               "events (kernel < 6.1): threads created later are not sampled",
+               watcher->desc.c_str());
+      }
       ++pevent_hdr->nb_attrs;
       assert(pevent_hdr->nb_attrs <= kMaxTypeWatcher);
       break;
@@ -110,14 +134,15 @@ DDRes pevent_register_cpu_0(const PerfWatcher *watcher, int watcher_idx,
 
 DDRes pevent_open_all_cpus(const PerfWatcher *watcher, int watcher_idx,
                            std::span<pid_t> pids, int num_cpu,
+                           unsigned long open_flags,
                            PerfClockSource perf_clock_source,
                            PEventHdr *pevent_hdr) {
   PEvent *pes = pevent_hdr->pes;
 
   size_t template_pevent_idx = -1;
   DDRES_CHECK_FWD(pevent_register_cpu_0(watcher, watcher_idx, pids[0],
-                                        perf_clock_source, pevent_hdr,
-                                        template_pevent_idx));
+                                        open_flags, perf_clock_source,
+                                        pevent_hdr, template_pevent_idx));
   int const template_attr_idx = pes[template_pevent_idx].attr_idx;
   perf_event_attr *attr = &pevent_hdr->attrs[template_attr_idx];
 
@@ -128,15 +153,15 @@ DDRes pevent_open_all_cpus(const PerfWatcher *watcher, int watcher_idx,
     if (cpu_idx > 0) {
       size_t pevent_idx = -1;
       DDRES_CHECK_FWD(pevent_create(pevent_hdr, watcher_idx, &pevent_idx));
-      int const fd =
-          perf_event_open(attr, pids[0], cpu_idx, -1, PERF_FLAG_FD_CLOEXEC);
+      int const fd = perf_event_open(attr, pids[0], cpu_idx, -1, open_flags);
       if (fd == -1) {
         DDRES_RETURN_ERROR_LOG(DD_WHAT_PERFOPEN,
                                "Error calling perfopen on watcher %d.%d (%s)",
                                watcher_idx, cpu_idx, strerror(errno));
       }
       pevent_set_info(fd, pes[template_pevent_idx].attr_idx, pes[pevent_idx],
-                      watcher->options.stack_sample_size);
+                      pevent_initial_mmap_order(*watcher),
+                      attr->write_backward);
       pevent = &pes[pevent_idx];
     } else {
       pevent = &pes[template_pevent_idx];
@@ -159,16 +184,72 @@ DDRes pevent_open_all_cpus(const PerfWatcher *watcher, int watcher_idx,
   return {};
 }
 
+// Opens the other members of the counter group led by the watcher, on each
+// of its events in [first_pevent_idx, pevent_hdr->size) (one per CPU).
+// Events of other tids (sub fds) are not grouped and only read their own
+// counter.
+DDRes pevent_open_group_members(const DDProfContext &ctx, int leader_idx,
+                                pid_t pid, size_t first_pevent_idx,
+                                unsigned long open_flags,
+                                PEventHdr *pevent_hdr) {
+  for (size_t k = first_pevent_idx; k < pevent_hdr->size; ++k) {
+    PEvent &leader = pevent_hdr->pes[k];
+    int const cpu_idx = static_cast<int>(k - first_pevent_idx);
+    const perf_event_attr &leader_attr = pevent_hdr->attrs[leader.attr_idx];
+    for (size_t watcher_idx = leader_idx + 1;
+         watcher_idx < ctx.watchers.size(); ++watcher_idx) {
+      const PerfWatcher *watcher = &ctx.watchers[watcher_idx];
+      if (watcher->group_leader_pos != leader_idx) {
+        continue;
+      }
+      perf_event_attr attr = perf_config_group_member(watcher, leader_attr);
+      int const fd =
+          perf_event_open(&attr, pid, cpu_idx, leader.fd, open_flags);
+      if (fd == -1) {
+        DDRES_RETURN_ERROR_LOG(
+            DD_WHAT_PERFOPEN,
+            "Error calling perf_event_open on watcher %zu.%d in group of "
+            "watcher %d (%s)",
+            watcher_idx, cpu_idx, leader_idx, strerror(errno));
+      }
+      leader.group_fds.push_back(fd);
+    }
+  }
+  return {};
+}
+
 /// Setup perf event according to requested watchers.
 DDRes pevent_open(DDProfContext &ctx, std::span<pid_t> pids, int num_cpu,
                   PEventHdr *pevent_hdr) {
   assert(pevent_hdr->size == 0); // check for previous init
+  // in cgroup mode, the only pid is a file descriptor of the cgroup directory
+  unsigned long const open_flags = ctx.params.cgroup_path.empty()
+      ? PERF_FLAG_FD_CLOEXEC
+      : PERF_FLAG_FD_CLOEXEC | PERF_FLAG_PID_CGROUP;
   for (unsigned long watcher_idx = 0; watcher_idx < ctx.watchers.size();
        ++watcher_idx) {
     PerfWatcher *watcher = &ctx.watchers[watcher_idx];
+    if (watcher->type < kDDPROF_TYPE_CUSTOM &&
+        perf_sample_cgroup_available()) {
+      // container ids are resolved from the cgroup of samples
+      watcher->sample_type |= k_perf_sample_cgroup;
+    }
+    // sample layout is fixed from now on, pick the matching parser
+    watcher->sample_parser = perf_sample_parser_from_type(watcher->sample_type);
+    if (watcher->group_leader_pos != -1) {
+      // opened with the leader of its counter group
+      continue;
+    }
     if (watcher->type < kDDPROF_TYPE_CUSTOM) {
+      size_t const first_pevent_idx = pevent_hdr->size;
       DDRES_CHECK_FWD(pevent_open_all_cpus(watcher, watcher_idx, pids, num_cpu,
-                                           ctx.perf_clock_source, pevent_hdr));
+                                           open_flags, ctx.perf_clock_source,
+                                           pevent_hdr));
+      if (watcher->sample_type & PERF_SAMPLE_READ) {
+        DDRES_CHECK_FWD(pevent_open_group_members(ctx, watcher_idx, pids[0],
+                                                  first_pevent_idx, open_flags,
+                                                  pevent_hdr));
+      }
     } else {
       // custom event, eg.allocation profiling
       size_t pevent_idx = 0;
@@ -178,6 +259,25 @@ DDRes pevent_open(DDProfContext &ctx, std::span<pid_t> pids, int num_cpu,
           k_min_number_samples_per_ring_buffer);
       DDRES_CHECK_FWD(ring_buffer_create(order, RingBufferType::kMPSCRingBuffer,
                                          true, &pevent_hdr->pes[pevent_idx]));
+      if (watcher->config == kDDPROF_COUNT_ALLOCATIONS &&
+          ProcessRingBuffers::enabled(ctx.params.pid,
+                                      ctx.params.process_ring_buffers)) {
+        // ring buffers assigned to processes by the worker server
+        size_t const nb_ring_buffers =
+            std::min<size_t>(ctx.params.process_ring_buffers,
+                             ProcessRingBuffers::k_nb_ring_buffers);
+        for (size_t i = 0; i < nb_ring_buffers; ++i) {
+          int const offset = ProcessRingBuffers::k_order_offsets[i];
+          DDRES_CHECK_FWD(
+              pevent_create(pevent_hdr, watcher_idx, &pevent_idx));
+          int const dedicated_order = pevent_compute_min_mmap_order(
+              order + offset, watcher->options.stack_sample_size,
+              k_min_number_samples_per_ring_buffer);
+          DDRES_CHECK_FWD(ring_buffer_create(
+              dedicated_order, RingBufferType::kMPSCRingBuffer, true,
+              &pevent_hdr->pes[pevent_idx]));
+        }
+      }
     }
   }
   return {};
@@ -214,7 +314,8 @@ DDRes pevent_mmap_event(PEvent *event) {
     bool const allow_single_mapping =
         (event->ring_buffer_type == RingBufferType::kPerfRingBuffer);
     const PerfMmapRegion mapping =
-        perfown_sz(event->mapfd, event->ring_buffer_size, allow_single_mapping);
+        perfown_sz(event->mapfd, event->ring_buffer_size, allow_single_mapping,
+                   event->overwrite);
     if (!mapping.addr) {
       DDRES_RETURN_ERROR_LOG(
           DD_WHAT_PERFMMAP,
@@ -299,6 +400,106 @@ DDRes pevent_enable(PEventHdr *pevent_hdr) {
   return {};
 }
 
+DDRes pevent_update_sample_rate(PEventHdr *pevent_hdr, int watcher_pos,
+                                uint64_t value) {
+  for (size_t i = 0; i < pevent_hdr->size; ++i) {
+    PEvent &pevent = pevent_hdr->pes[i];
+    if (pevent.watcher_pos != watcher_pos) {
+      continue;
+    }
+    if (pevent.custom_event) {
+      if (pevent.rb.sampling_interval) {
+        __atomic_store_n(pevent.rb.sampling_interval, value, __ATOMIC_RELAXED);
+      }
+      continue;
+    }
+    for (auto fd : pevent.sub_fds) {
+      DDRES_CHECK_INT(ioctl(fd, PERF_EVENT_IOC_PERIOD, &value), DD_WHAT_IOCTL,
+                      "Error ioctl PERF_EVENT_IOC_PERIOD fd=%d (idx#%zu)", fd,
+                      i);
+    }
+    DDRES_CHECK_INT(ioctl(pevent.fd, PERF_EVENT_IOC_PERIOD, &value),
+                    DD_WHAT_IOCTL,
+                    "Error ioctl PERF_EVENT_IOC_PERIOD fd=%d (idx#%zu)",
+                    pevent.fd, i);
+  }
+  return {};
+}
+
+DDRes pevent_set_enabled(PEventHdr *pevent_hdr, int watcher_pos,
+                         bool enabled) {
+  unsigned long const request =
+      enabled ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE;
+  // members of a counter group stop counting with their leader
+  for (size_t i = 0; i < pevent_hdr->size; ++i) {
+    PEvent const &pevent = pevent_hdr->pes[i];
+    if (pevent.watcher_pos != watcher_pos || pevent.custom_event) {
+      continue;
+    }
+    for (auto fd : pevent.sub_fds) {
+      DDRES_CHECK_INT(ioctl(fd, request), DD_WHAT_IOCTL,
+                      "Error ioctl fd=%d (idx#%zu)", fd, i);
+    }
+    DDRES_CHECK_INT(ioctl(pevent.fd, request), DD_WHAT_IOCTL,
+                    "Error ioctl fd=%d (idx#%zu)", pevent.fd, i);
+  }
+  return {};
+}
+
+DDRes pevent_pause_overwrite(PEventHdr *pevent_hdr, bool paused) {
+  unsigned long const value = paused ? 1 : 0;
+  // pausing applies to the ring buffer, including the output of sub fds
+  for (size_t i = 0; i < pevent_hdr->size; ++i) {
+    PEvent const &pevent = pevent_hdr->pes[i];
+    if (!pevent.overwrite) {
+      continue;
+    }
+    DDRES_CHECK_INT(ioctl(pevent.fd, PERF_EVENT_IOC_PAUSE_OUTPUT, value),
+                    DD_WHAT_IOCTL,
+                    "Error ioctl PERF_EVENT_IOC_PAUSE_OUTPUT fd=%d (idx#%zu)",
+                    pevent.fd, i);
+  }
+  return {};
+}
+
+int pevent_initial_mmap_order(const PerfWatcher &watcher) {
+  return pevent_compute_min_mmap_order(k_default_buffer_size_shift,
+                                       watcher.options.stack_sample_size,
+                                       k_min_number_samples_per_ring_buffer);
+}
+
+DDRes pevent_resize_ring_buffers(PEventHdr *pevent_hdr,
+                                 std::span<const int8_t> orders) {
+  // mlock accounting follows the user used by pevent_mmap
+  UIDInfo info;
+  bool const overridden =
+      IsDDResOK(user_override_to_nobody_if_root(&info));
+  defer {
+    if (overridden) {
+      user_override(info.uid, info.gid);
+    }
+  };
+
+  for (size_t i = 0; i < pevent_hdr->size; ++i) {
+    PEvent &pevent = pevent_hdr->pes[i];
+    if (!orders[i] || pevent.custom_event || pevent.overwrite ||
+        pevent.mapfd == -1 ||
+        pevent.ring_buffer_size == perf_mmap_size(orders[i])) {
+      continue;
+    }
+    size_t const previous_size = pevent.ring_buffer_size;
+    if (IsDDResOK(pevent_remap_event(pevent, perf_mmap_size(orders[i])))) {
+      LG_NFO("Resized ring buffer of watcher #%d (idx#%zu) to order %d",
+             pevent.watcher_pos, i, orders[i]);
+      continue;
+    }
+    LG_WRN("Unable to resize ring buffer of watcher #%d (idx#%zu) to order %d",
+           pevent.watcher_pos, i, orders[i]);
+    DDRES_CHECK_FWD(pevent_remap_event(pevent, previous_size));
+  }
+  return {};
+}
+
 DDRes pevent_munmap_event(PEvent *event) {
   if (event->rb.base) {
     if (perfdisown(event->rb.base, event->ring_buffer_size,
@@ -343,6 +544,14 @@ DDRes pevent_close_event(PEvent *event) {
             sub_fd, event->watcher_pos, strerror(errno));
       }
     }
+    for (auto group_fd : event->group_fds) {
+      if (close(group_fd) == -1) {
+        DDRES_RETURN_ERROR_LOG(
+            DD_WHAT_PERFOPEN,
+            "Error when closing group_fd=%d (watcher #%d) (%s)", group_fd,
+            event->watcher_pos, strerror(errno));
+      }
+    }
   }
   if (event->custom_event && event->mapfd != -1) {
     if (close(event->mapfd) == -1) {
@@ -0,0 +1,83 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include "pid_admission.hpp"
+
+namespace ddprof {
+
+PidAdmission::Decision PidAdmission::add_sample(pid_t pid, uint64_t weight) {
+  if (_maximum_pids < 0) {
+    return {true, k_no_pid};
+  }
+  PidState &state = _pids[pid];
+  state.weight += weight;
+  state.last_sample = ++_nb_samples;
+  if (state.admitted) {
+    return {true, k_no_pid};
+  }
+  if (_nb_admitted < static_cast<size_t>(_maximum_pids)) {
+    state.admitted = true;
+    ++_nb_admitted;
+    return {true, k_no_pid};
+  }
+  auto candidate = find_eviction_candidate();
+  if (candidate == _pids.end() ||
+      state.weight <= candidate->second.weight * k_eviction_weight_ratio) {
+    return {false, k_no_pid};
+  }
+  // the evicted process keeps its weight and can win its slot back
+  candidate->second.admitted = false;
+  state.admitted = true;
+  return {true, candidate->first};
+}
+
+void PidAdmission::remove(pid_t pid) {
+  auto it = _pids.find(pid);
+  if (it == _pids.end()) {
+    return;
+  }
+  if (it->second.admitted) {
+    --_nb_admitted;
+  }
+  _pids.erase(it);
+}
+
+bool PidAdmission::is_admitted(pid_t pid) const {
+  if (_maximum_pids < 0) {
+    return true;
+  }
+  auto it = _pids.find(pid);
+  return it != _pids.end() && it->second.admitted;
+}
+
+void PidAdmission::cycle() {
+  for (auto it = _pids.begin(); it != _pids.end();) {
+    it->second.weight /= 2;
+    if (!it->second.admitted && !it->second.weight) {
+      it = _pids.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+std::unordered_map<pid_t, PidAdmission::PidState>::iterator
+PidAdmission::find_eviction_candidate() {
+  auto candidate = _pids.end();
+  for (auto it = _pids.begin(); it != _pids.end(); ++it) {
+    if (!it->second.admitted) {
+      continue;
+    }
+    if (candidate == _pids.end() ||
+        it->second.weight < candidate->second.weight ||
+        (it->second.weight == candidate->second.weight &&
+         it->second.last_sample < candidate->second.last_sample)) {
+      candidate = it;
+    }
+  }
+  return candidate;
+}
+
+} // namespace ddprof
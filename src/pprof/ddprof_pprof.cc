@@ -7,6 +7,7 @@
 
 #include "base_frame_symbol_lookup.hpp"
 #include "common_symbol_errors.hpp"
+#include "cpu_budget_governor.hpp"
 #include "ddog_profiling_utils.hpp"
 #include "ddprof_defs.hpp"
 #include "ddres.hpp"
@@ -45,6 +46,10 @@ constexpr const char *sample_type_name(uint32_t raw_type) {
     return "cpu-time";
   case DDOG_PROF_SAMPLE_TYPE_CPU_SAMPLES:
     return "cpu-samples";
+  case DDOG_PROF_SAMPLE_TYPE_WALL_TIME:
+    return "wall-time";
+  case DDOG_PROF_SAMPLE_TYPE_WALL_SAMPLES:
+    return "wall-samples";
   case DDOG_PROF_SAMPLE_TYPE_ALLOC_SPACE:
     return "alloc-space";
   case DDOG_PROF_SAMPLE_TYPE_ALLOC_SAMPLES:
@@ -63,6 +68,10 @@ static_assert(std::string_view(sample_type_name(
                   DDOG_PROF_SAMPLE_TYPE_CPU_TIME)) == "cpu-time");
 static_assert(std::string_view(sample_type_name(
                   DDOG_PROF_SAMPLE_TYPE_CPU_SAMPLES)) == "cpu-samples");
+static_assert(std::string_view(sample_type_name(
+                  DDOG_PROF_SAMPLE_TYPE_WALL_TIME)) == "wall-time");
+static_assert(std::string_view(sample_type_name(
+                  DDOG_PROF_SAMPLE_TYPE_WALL_SAMPLES)) == "wall-samples");
 static_assert(std::string_view(sample_type_name(
                   DDOG_PROF_SAMPLE_TYPE_ALLOC_SPACE)) == "alloc-space");
 static_assert(std::string_view(sample_type_name(
@@ -76,10 +85,6 @@ static_assert(std::string_view(sample_type_name(
 static_assert(std::string_view(
                   sample_type_name(DDOG_PROF_SAMPLE_TYPE_SAMPLE)) == "sample");
 
-// Upper bound on distinct ddog_prof_SampleType slots (sum + live types +
-// their count companions across all watcher kinds).
-constexpr int k_max_value_types = 16;
-
 std::string_view pid_str(pid_t pid,
                          std::unordered_map<pid_t, std::string> &pid_strs) {
   auto it = pid_strs.find(pid);
@@ -398,6 +403,11 @@ DDRes pprof_create_profile(DDProfPProf *pprof, DDProfContext &ctx) {
     // event-based types (but providing frequency would also be broken in those
     // cases)
     int64_t default_period = default_watcher->sample_period;
+    if (ctx.worker_ctx.sampling_rate_scale < 1.0) {
+      // Rates were lowered to keep the profiler within its CPU budget
+      default_period = static_cast<int64_t>(watcher_scaled_sample_value(
+          *default_watcher, ctx.worker_ctx.sampling_rate_scale));
+    }
     if (default_watcher->options.is_freq) {
       default_period =
           std::chrono::nanoseconds(std::chrono::seconds{1}).count() /
@@ -458,6 +468,7 @@ DDRes pprof_free_profile(DDProfPProf *pprof) {
   ddog_prof_Profile_drop(&pprof->_profile);
   pprof->_profile = {};
   pprof->_nb_values = 0;
+  pprof->_tags.clear();
   return {};
 }
 
@@ -477,6 +488,13 @@ DDRes pprof_aggregate(const UnwindOutput *uw_output,
   if (pprof_indices.pprof_count_index != -1) {
     values[pprof_indices.pprof_count_index] = pack.count;
   }
+  for (const DDProfGroupValue &group_value : pack.group_values) {
+    const PProfIndices &indices = group_value.watcher->pprof_indices[value_pos];
+    values[indices.pprof_index] = group_value.value;
+    if (indices.pprof_count_index != -1) {
+      values[indices.pprof_count_index] = group_value.count;
+    }
+  }
 
   std::array<ddog_prof_Location, kMaxStackDepth> locations_buff;
   std::span locs{uw_output->locs};
@@ -0,0 +1,171 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include "process_ring_buffers.hpp"
+
+#include "ddprof_defs.hpp"
+#include "ipc.hpp"
+#include "logger.hpp"
+#include "perf.hpp"
+#include "persistent_worker_state.hpp"
+#include "pevent_lib.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+
+namespace ddprof {
+
+namespace {
+constexpr uint64_t k_max_buffered_samples = 1UL << 16;
+} // namespace
+
+ProcessRingBuffers::ProcessRingBuffers(std::span<const PEvent> pevents,
+                                       int watcher_pos,
+                                       uint32_t stack_sample_size,
+                                       uint64_t sampling_interval,
+                                       PersistentWorkerState &persistent_state)
+    : _slots(persistent_state.dedicated_ring_buffers),
+      _next_id(&persistent_state.next_dedicated_ring_buffer_id),
+      _stack_sample_size(stack_sample_size),
+      _sampling_interval(sampling_interval) {
+  size_t nb_pevents = 0;
+  for (const PEvent &pevent : pevents) {
+    if (pevent.watcher_pos != watcher_pos || !pevent.custom_event) {
+      continue;
+    }
+    if (nb_pevents == 0) {
+      _shared_sampling_interval = pevent.rb.sampling_interval;
+    } else if (nb_pevents <= k_nb_ring_buffers) {
+      _pevents[nb_pevents - 1] = &pevent;
+    }
+    ++nb_pevents;
+  }
+}
+
+int ProcessRingBuffers::ring_buffer_order(uint64_t allocation_rate) const {
+  uint64_t sampling_interval = _sampling_interval;
+  if (_shared_sampling_interval) {
+    // sampling interval might have been raised to remain within CPU budget
+    sampling_interval = std::max(
+        sampling_interval,
+        __atomic_load_n(_shared_sampling_interval, __ATOMIC_RELAXED));
+  }
+  uint64_t nb_samples = k_min_number_samples_per_ring_buffer;
+  if (sampling_interval) {
+    uint64_t const samples_per_sec = allocation_rate / sampling_interval;
+    nb_samples = std::clamp<uint64_t>(
+        samples_per_sec * k_buffered_duration.count() / 1000,
+        k_min_number_samples_per_ring_buffer, k_max_buffered_samples);
+  }
+  return pevent_compute_min_mmap_order(k_default_buffer_size_shift,
+                                       _stack_sample_size, nb_samples);
+}
+
+uint64_t ProcessRingBuffers::assign(pid_t pid, uint64_t allocation_rate,
+                                    RingBufferInfo &info) {
+  size_t const min_size = perf_mmap_size(ring_buffer_order(allocation_rate));
+  std::lock_guard const lock{_mutex};
+  // a process that execs reconnects with the same pid
+  for (Slot &slot : _slots) {
+    if (slot.pid == pid) {
+      release_slot(slot);
+    }
+  }
+  // smallest free ring buffer that is large enough, or largest free one
+  size_t best = k_nb_ring_buffers;
+  for (size_t i = 0; i < k_nb_ring_buffers; ++i) {
+    if (!_pevents[i] || _slots[i].pid != 0) {
+      continue;
+    }
+    if (best == k_nb_ring_buffers) {
+      best = i;
+      continue;
+    }
+    size_t const size = _pevents[i]->ring_buffer_size;
+    size_t const best_size = _pevents[best]->ring_buffer_size;
+    if (best_size < min_size ? size > best_size
+                             : size >= min_size && size < best_size) {
+      best = i;
+    }
+  }
+  if (best == k_nb_ring_buffers) {
+    LG_NFO("No dedicated ring buffer left, pid %d uses the shared one", pid);
+    return 0;
+  }
+
+  const PEvent &pevent = *_pevents[best];
+  Slot &slot = _slots[best];
+  slot = {.pid = pid,
+          .id = ++*_next_id,
+          .timestamp = PerfClock::now().time_since_epoch().count(),
+          .nb_lost = 0};
+  info.ring_fd = pevent.mapfd;
+  info.event_fd = pevent.fd;
+  info.mem_size = static_cast<int64_t>(pevent.ring_buffer_size);
+  info.ring_buffer_type = static_cast<int>(pevent.ring_buffer_type);
+  LG_NFO("Assigned dedicated ring buffer #%zu (%zu KB) to pid %d", best,
+         pevent.ring_buffer_size / 1024, pid);
+  return slot.id;
+}
+
+void ProcessRingBuffers::release(uint64_t id) {
+  std::lock_guard const lock{_mutex};
+  for (Slot &slot : _slots) {
+    if (slot.pid != 0 && slot.id == id) {
+      release_slot(slot);
+    }
+  }
+}
+
+void ProcessRingBuffers::release_pid(pid_t pid,
+                                     PerfClock::time_point exit_time) {
+  std::lock_guard const lock{_mutex};
+  for (Slot &slot : _slots) {
+    if (slot.pid == pid &&
+        slot.timestamp < exit_time.time_since_epoch().count()) {
+      release_slot(slot);
+    }
+  }
+}
+
+uint64_t ProcessRingBuffers::add_lost_events(pid_t pid, uint64_t nb_lost) {
+  if (!nb_lost) {
+    return 0;
+  }
+  std::lock_guard const lock{_mutex};
+  for (Slot &slot : _slots) {
+    if (slot.pid == pid) {
+      slot.nb_lost += nb_lost;
+      return slot.nb_lost;
+    }
+  }
+  return 0;
+}
+
+void ProcessRingBuffers::release_dead_processes() {
+  std::lock_guard const lock{_mutex};
+  for (Slot &slot : _slots) {
+    if (slot.pid != 0 && kill(slot.pid, 0) == -1 && errno == ESRCH) {
+      release_slot(slot);
+    }
+  }
+}
+
+size_t ProcessRingBuffers::nb_assigned() const {
+  std::lock_guard const lock{_mutex};
+  return std::count_if(_slots.begin(), _slots.end(),
+                       [](const Slot &slot) { return slot.pid != 0; });
+}
+
+void ProcessRingBuffers::release_slot(Slot &slot) {
+  LG_NFO("Released dedicated ring buffer #%zu of pid %d (%lu lost events)",
+         static_cast<size_t>(&slot - _slots.data()), slot.pid, slot.nb_lost);
+  // Events still in the ring buffer are processed normally: they hold the
+  // pid of the process that wrote them
+  slot = {};
+}
+
+} // namespace ddprof
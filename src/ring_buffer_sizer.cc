@@ -0,0 +1,55 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include "ring_buffer_sizer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace ddprof {
+
+bool ring_buffer_next_orders(std::span<const RingBufferOrder> orders,
+                             std::span<const RingBufferUsage> usage,
+                             size_t budget_pages, std::span<int> next_orders) {
+  assert(orders.size() == usage.size() && orders.size() == next_orders.size());
+  size_t pages = 0;
+  std::vector<size_t> grow_candidates;
+  for (size_t i = 0; i < orders.size(); ++i) {
+    int const order = orders[i].order;
+    next_orders[i] = order;
+    if (!usage[i].lost_events &&
+        usage[i].peak_fill_ratio < k_ring_buffer_shrink_fill_ratio &&
+        order > orders[i].min_order) {
+      // fill ratio doubles, still far from overflowing
+      next_orders[i] = order - 1;
+    } else if (usage[i].lost_events &&
+               usage[i].peak_fill_ratio >= k_ring_buffer_grow_fill_ratio &&
+               order < orders[i].min_order + k_max_ring_buffer_order_increase) {
+      grow_candidates.push_back(i);
+    }
+    pages += ring_buffer_pages(next_orders[i]);
+  }
+
+  std::stable_sort(grow_candidates.begin(), grow_candidates.end(),
+                   [&usage](size_t lhs, size_t rhs) {
+                     return usage[lhs].peak_fill_ratio >
+                         usage[rhs].peak_fill_ratio;
+                   });
+  bool grew = false;
+  for (size_t const i : grow_candidates) {
+    // doubling the data pages
+    size_t const extra_pages = ring_buffer_pages(orders[i].order) - 1;
+    if (pages + extra_pages > budget_pages) {
+      continue;
+    }
+    next_orders[i] = orders[i].order + 1;
+    pages += extra_pages;
+    grew = true;
+  }
+  return grew;
+}
+
+} // namespace ddprof
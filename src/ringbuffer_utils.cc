@@ -31,6 +31,39 @@ void init_metadata_page(MPSCRingBufferMetaDataPage *page) {
 }
 } // namespace
 
+std::vector<size_t>
+perf_rb_backward_snapshot(const RingBuffer &rb,
+                          std::vector<std::byte> &snapshot) {
+  assert(rb.type == RingBufferType::kPerfRingBuffer);
+  std::vector<size_t> offsets;
+  snapshot.clear();
+  snapshot.reserve(rb.data_size);
+  // The head moves back by the size of each new record: the newest record
+  // starts at the head and older ones follow, up to head + data_size
+  uint64_t pos = __atomic_load_n(rb.writer_pos, __ATOMIC_ACQUIRE);
+  while (snapshot.size() + sizeof(perf_event_header) <= rb.data_size) {
+    uint64_t const pos_linear = pos & rb.mask;
+    // records are aligned on 8 bytes, headers never wrap around
+    const auto *hdr =
+        reinterpret_cast<const perf_event_header *>(rb.data + pos_linear);
+    size_t const sz = hdr->size;
+    // zeroed memory follows the oldest record until the buffer is full
+    if (sz < sizeof(perf_event_header) ||
+        snapshot.size() + sz > rb.data_size) {
+      break;
+    }
+    size_t const offset = snapshot.size();
+    size_t const first_chunk = std::min<size_t>(sz, rb.data_size - pos_linear);
+    snapshot.resize(offset + sz);
+    memcpy(snapshot.data() + offset, rb.data + pos_linear, first_chunk);
+    memcpy(snapshot.data() + offset + first_chunk, rb.data, sz - first_chunk);
+    offsets.push_back(offset);
+    pos += sz;
+  }
+  std::reverse(offsets.begin(), offsets.end());
+  return offsets;
+}
+
 DDRes ring_buffer_attach(const RingBufferInfo &info, PEvent *pevent) {
   pevent->fd = info.event_fd;
   pevent->mapfd = info.ring_fd;
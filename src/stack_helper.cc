@@ -118,6 +118,8 @@ bool memory_read(ProcessAddress_t addr, ElfWord_t *result, int regno,
         regno >= 0 &&
         regno < static_cast<int>(std::size(us->initial_regs.regs))) {
       *result = us->initial_regs.regs[regno];
+      // result does not only depend on the stack contents
+      us->stack_reads_cacheable = false;
       return true;
     }
 #ifdef DEBUG
@@ -152,6 +154,7 @@ bool memory_read(ProcessAddress_t addr, ElfWord_t *result, int regno,
     return false;
   }
   *result = *reinterpret_cast<const ElfWord_t *>(us->stack + stack_idx);
+  us->stack_reads.push_back(static_cast<uint32_t>(stack_idx));
   return true;
 }
 
@@ -34,4 +34,11 @@ DDRes sys_perf_event_paranoid(int32_t &val) {
   return {};
 }
 
+DDRes sys_perf_event_max_sample_rate(int32_t &val) {
+  val = std::numeric_limits<int32_t>::max();
+  DDRES_CHECK_FWD(sys_read_int_from_file(
+      "/proc/sys/kernel/perf_event_max_sample_rate", val));
+  return {};
+}
+
 } // namespace ddprof
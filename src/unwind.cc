@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <array>
+#include <span>
 
 namespace ddprof {
 
@@ -35,6 +36,15 @@ void find_dso_add_error_frame(DDRes ddres, UnwindState *us) {
 }
 
 void add_container_id(Process &process, UnwindState *us) {
+  if (us->cgroup_id) {
+    std::string_view const cgroup_container_id =
+        us->container_id_cache.get(us->cgroup_id);
+    if (cgroup_container_id != k_container_id_unknown) {
+      us->output.container_id = cgroup_container_id;
+      return;
+    }
+  }
+  // fall back to the cgroup file of the process
   const auto &container_id = process.get_container_id();
   if (container_id) {
     us->output.container_id = *container_id;
@@ -47,7 +57,65 @@ void add_exe_name(UnwindState *us) {
 }
 
 void add_thread_name(Process &process, UnwindState *us) {
-  us->output.thread_name = process.get_or_insert_thread_name(us->output.tid);
+  us->output.thread_name =
+      process.get_or_insert_thread_name(us->output.tid, us->sample_time);
+}
+
+// Reuse frames of a previous unwind that read the same stack contents
+DDRes unwind_dwfl_cached(Process &process, bool avoid_new_attach,
+                         UnwindState *us) {
+  std::span const stack{reinterpret_cast<const std::byte *>(us->stack),
+                        us->stack_sz};
+  const std::vector<FunLoc> *locs =
+      us->unwind_cache.find(us->pid, us->initial_regs.regs, stack);
+  if (locs) {
+    ddprof_stats_add(STATS_UNWIND_CACHE_HITS, 1, nullptr);
+    us->output.locs = *locs;
+    us->current_ip = locs->back().ip;
+    us->_dwfl_wrapper = process.get_dwfl();
+    return {};
+  }
+  DDRes const res = unwind_dwfl(process, avoid_new_attach, us);
+  if (IsDDResOK(res) && us->stack_reads_cacheable &&
+      !(us->_dwfl_wrapper && us->_dwfl_wrapper->_inconsistent)) {
+    std::sort(us->stack_reads.begin(), us->stack_reads.end());
+    us->stack_reads.erase(
+        std::unique(us->stack_reads.begin(), us->stack_reads.end()),
+        us->stack_reads.end());
+    us->unwind_cache.insert(us->pid, us->initial_regs.regs, stack,
+                            us->stack_reads, us->output.locs);
+  }
+  return res;
+}
+
+// Free CFI tables (and Go function tables) of files that no other process
+// was unwound with
+void release_pid_files(UnwindState *us, pid_t pid) {
+  const Process *process = us->process_hdr.find(pid);
+  const DwflWrapper *dwfl_wrapper = process ? process->get_dwfl() : nullptr;
+  if (!dwfl_wrapper) {
+    return;
+  }
+  for (const auto &[file_info_id, ddprof_mod] : dwfl_wrapper->_ddprof_mods) {
+    if (ddprof_mod._cfi_tables_generation != us->cfi_tables_generation) {
+      continue;
+    }
+    auto it = us->cfi_tables.find(file_info_id);
+    if (it == us->cfi_tables.end() || !it->second.remove_process()) {
+      continue;
+    }
+    us->nb_cfi_rows -= it->second.size();
+    us->cfi_tables.erase(it);
+    us->symbol_hdr._go_symbol_lookup.release(file_info_id);
+  }
+}
+
+void release_pid_state(UnwindState *us, pid_t pid) {
+  release_pid_files(us, pid);
+  us->dso_hdr.pid_free(pid);
+  us->symbol_hdr.clear(pid);
+  us->process_hdr.clear(pid);
+  us->unwind_cache.clear(pid);
 }
 } // namespace
 
@@ -63,24 +131,28 @@ void unwind_init_sample(UnwindState *us, const uint64_t *sample_regs,
   us->pid = sample_pid;
   us->stack_sz = sample_size_stack;
   us->stack = sample_data_stack;
+  us->stack_reads.clear();
+  us->stack_reads_cacheable = true;
+  us->sample_time = PerfClock::time_point::max();
+  us->cgroup_id = 0;
+  us->sample_weight = 1;
 }
 
 DDRes unwindstate_unwind(UnwindState *us) {
   DDRes res = ddres_init();
   Process &process = us->process_hdr.get(us->pid);
-  bool avoid_new_attach = false;
-  if (us->maximum_pids != k_unlimited_max_profiled_pids &&
-      us->process_hdr.process_count() >
-          static_cast<unsigned>(us->maximum_pids)) {
-    // we limit number of pids heavily as we can not guarantee unwinding
-    // does not open new files
-    // There is currently no priority in the processes that we should unwind
-    // So there could be a situation where we are stuck with PIDs that are not
-    // interesting.
-    avoid_new_attach = true;
-  }
   if (us->pid != 0) { // we can not unwind pid 0
-    res = unwind_dwfl(process, avoid_new_attach, us);
+    // we limit number of pids heavily as we can not guarantee unwinding
+    // does not open new files: the most sampled processes are kept
+    PidAdmission::Decision const admission =
+        us->pid_admission.add_sample(us->pid, us->sample_weight);
+    if (admission.evicted != PidAdmission::k_no_pid) {
+      LG_DBG("Evicting unwinding state of pid %d (for pid %d)",
+             admission.evicted, us->pid);
+      release_pid_state(us, admission.evicted);
+      ddprof_stats_add(STATS_PROCESS_EVICTED, 1, nullptr);
+    }
+    res = unwind_dwfl_cached(process, !admission.admitted, us);
   }
   if (IsDDResNotOK(res)) {
     if (res._what == DD_WHAT_UW_MAX_PIDS) {
@@ -105,10 +177,17 @@ DDRes unwindstate_unwind(UnwindState *us) {
   return res;
 }
 
+std::vector<pid_t> unwind_take_exited_pids(UnwindState *us,
+                                           PerfClock::time_point now) {
+  PerfClock::time_point const deadline =
+      now - ProcessHdr::k_exit_grace_window;
+  us->process_hdr.erase_exited_thread_names(deadline);
+  return us->process_hdr.take_exited(deadline);
+}
+
 void unwind_pid_free(UnwindState *us, pid_t pid) {
-  us->dso_hdr.pid_free(pid);
-  us->symbol_hdr.clear(pid);
-  us->process_hdr.clear(pid);
+  release_pid_state(us, pid);
+  us->pid_admission.remove(pid);
 }
 
 void unwind_cycle(UnwindState *us) {
@@ -116,6 +195,11 @@ void unwind_cycle(UnwindState *us) {
   us->symbol_hdr.cycle();
   us->process_hdr.display_stats();
   us->dso_hdr.stats().reset();
+  us->pid_admission.cycle();
+  // symbol lookups can be refreshed: do not keep frames across cycles
+  us->unwind_cache.clear();
+  // files are not tracked once unmapped: drop tables of the previous cycle
+  us->clear_cfi_tables();
   unwind_metrics_reset();
 }
 
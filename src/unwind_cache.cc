@@ -0,0 +1,88 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include "unwind_cache.hpp"
+
+#include "ddprof_defs.hpp"
+#include "hash_helper.hpp"
+
+#include <cstring>
+
+namespace ddprof {
+
+std::size_t UnwindCache::KeyHash::operator()(const Key &key) const noexcept {
+  std::size_t seed = 0;
+  for (auto reg : key.regs) {
+    hash_combine(seed, reg);
+  }
+  hash_combine(seed, key.stack_size);
+  return seed;
+}
+
+UnwindCache::Key UnwindCache::make_key(std::span<const uint64_t> regs,
+                                       std::span<const std::byte> stack) {
+  Key key{};
+  for (size_t i = 0; i < k_key_registers.size(); ++i) {
+    key.regs[i] = regs[k_key_registers[i]];
+  }
+  key.stack_size = stack.size();
+  return key;
+}
+
+uint64_t UnwindCache::read_word(std::span<const std::byte> stack,
+                               uint32_t offset) {
+  // offsets were validated against the stack size which is part of the key
+  ElfWord_t word;
+  memcpy(&word, stack.data() + offset, sizeof(word));
+  return word;
+}
+
+bool UnwindCache::same_words(std::span<const std::byte> stack,
+                             const Entry &entry) {
+  for (size_t i = 0; i < entry.read_offsets.size(); ++i) {
+    if (read_word(stack, entry.read_offsets[i]) != entry.words[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const std::vector<FunLoc> *
+UnwindCache::find(pid_t pid, std::span<const uint64_t> regs,
+                  std::span<const std::byte> stack) {
+  auto pid_it = _pid_map.find(pid);
+  if (pid_it == _pid_map.end()) {
+    return nullptr;
+  }
+  auto it = pid_it->second.find(make_key(regs, stack));
+  if (it == pid_it->second.end()) {
+    return nullptr;
+  }
+  const Entry &entry = it->second;
+  if (!same_words(stack, entry)) {
+    return nullptr;
+  }
+  ++_hit_count;
+  return &entry.locs;
+}
+
+void UnwindCache::insert(pid_t pid, std::span<const uint64_t> regs,
+                         std::span<const std::byte> stack,
+                         std::span<const uint32_t> read_offsets,
+                         std::span<const FunLoc> locs) {
+  EntryMap &entries = _pid_map[pid];
+  if (entries.size() >= k_max_entries_per_pid) {
+    entries.clear();
+  }
+  Entry &entry = entries[make_key(regs, stack)];
+  entry.read_offsets.assign(read_offsets.begin(), read_offsets.end());
+  entry.words.clear();
+  for (auto offset : read_offsets) {
+    entry.words.push_back(read_word(stack, offset));
+  }
+  entry.locs.assign(locs.begin(), locs.end());
+}
+
+} // namespace ddprof
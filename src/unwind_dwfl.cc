@@ -5,12 +5,14 @@
 
 #include "unwind_dwfl.hpp"
 
+#include "cfi_table.hpp"
 #include "ddprof_stats.hpp"
 #include "ddres.hpp"
 #include "dwfl_internals.hpp"
 #include "dwfl_thread_callbacks.hpp"
 #include "logger.hpp"
 #include "runtime_symbol_lookup.hpp"
+#include "stack_helper.hpp"
 #include "symbol_hdr.hpp"
 #include "unique_fd.hpp"
 #include "unwind_helper.hpp"
@@ -215,8 +217,13 @@ DDRes add_unsymbolized_frame(UnwindState *us, const Dso &dso, ElfAddress_t pc,
                              FileInfoId_t file_info_id) {
   MapInfoIdx_t const map_idx = us->symbol_hdr._mapinfo_lookup.get_or_insert(
       us->pid, us->symbol_hdr._mapinfo_table, dso, ddprof_mod._build_id);
-  return add_frame(k_symbol_idx_null, file_info_id, map_idx, pc,
-                   pc - ddprof_mod._sym_bias, us);
+  ElfAddress_t const elf_addr = pc - ddprof_mod._sym_bias;
+  // Go binaries are symbolized from their function table, other files when
+  // exporting
+  SymbolIdx_t const symbol_idx = us->symbol_hdr._go_symbol_lookup.get_or_insert(
+      us->dso_hdr.get_file_info_value(file_info_id), elf_addr,
+      us->symbol_hdr._symbol_table);
+  return add_frame(symbol_idx, file_info_id, map_idx, pc, elf_addr, us);
 }
 
 // check for runtime symbols provided in /tmp files
@@ -246,6 +253,118 @@ DDRes add_runtime_symbol_frame(UnwindState *us, const Dso &dso, ElfAddress_t pc,
                    pc - dso.start() + dso.offset(), us);
 }
 
+// Module of `pc` if it is a regular file, already registered or registered
+// now with dwfl
+DDProfMod *find_cfi_module(UnwindState *us, ProcessAddress_t pc,
+                           const Dso **dso, FileInfoId_t &file_info_id) {
+  DsoHdr &dso_hdr = us->dso_hdr;
+  DsoHdr::PidMapping &pid_mapping = dso_hdr.get_pid_mapping(us->pid);
+  DsoHdr::DsoFindRes const find_res =
+      dso_hdr.dso_find_or_backpopulate(pid_mapping, us->pid, pc);
+  if (!find_res.second || has_runtime_symbols(find_res.first->second)) {
+    return nullptr;
+  }
+  *dso = &find_res.first->second;
+  file_info_id = dso_hdr.get_or_insert_file_info(**dso);
+  if (file_info_id <= k_file_info_error) {
+    return nullptr;
+  }
+  DDProfMod *ddprof_mod = us->_dwfl_wrapper->unsafe_get(file_info_id);
+  if (!ddprof_mod &&
+      IsDDResNotOK(us->_dwfl_wrapper->register_mod(
+          pc, **dso, dso_hdr.get_file_info_value(file_info_id), &ddprof_mod))) {
+    return nullptr;
+  }
+  return ddprof_mod;
+}
+
+// Unwind with the flat CFI tables, only tracking SP, FP and the return address.
+// Returns false if a frame has rules that the tables do not handle: libdw
+// should then unwind the whole stack.
+bool unwind_cfi_tables(UnwindState *us) {
+  if (us->nb_cfi_rows >= k_max_cfi_tables_rows) {
+    us->clear_cfi_tables();
+  }
+  const auto &regs = us->initial_regs.regs;
+  ProcessAddress_t pc = regs[REGNAME(PC)];
+  ProcessAddress_t sp = regs[REGNAME(SP)];
+  ProcessAddress_t fp = regs[k_perf_fp_regno];
+  bool fp_known = true;
+  for (bool activation = true; pc; activation = false) {
+    if (is_max_stack_depth_reached(*us)) {
+      add_common_frame(us, SymbolErrors::truncated_stack);
+      ddprof_stats_add(STATS_UNWIND_TRUNCATED_OUTPUT, 1, nullptr);
+      return true;
+    }
+    const Dso *dso = nullptr;
+    FileInfoId_t file_info_id = k_file_info_undef;
+    DDProfMod *ddprof_mod = find_cfi_module(us, pc, &dso, file_info_id);
+    if (!ddprof_mod) {
+      if (!dso && !activation) {
+        // return address outside of mappings ends libdw unwinding as well
+        add_error_frame(nullptr, us, pc, SymbolErrors::unknown_mapping);
+        return true;
+      }
+      return false;
+    }
+    // return addresses point after the call instruction
+    ProcessAddress_t const frame_pc = activation ? pc : pc - 1;
+    const GoPclntab *go_pclntab = us->symbol_hdr._go_symbol_lookup.find_pclntab(
+        us->dso_hdr.get_file_info_value(file_info_id));
+    CfiTable &cfi_table = us->cfi_tables[file_info_id];
+    if (ddprof_mod->_cfi_tables_generation != us->cfi_tables_generation) {
+      // first use of the table by this process
+      ddprof_mod->_cfi_tables_generation = us->cfi_tables_generation;
+      cfi_table.add_process();
+    }
+    size_t const nb_rows = cfi_table.size();
+    const CfiRow *row = cfi_table.find_or_compile(
+        ddprof_mod->_mod, frame_pc, ddprof_mod->_sym_bias, go_pclntab);
+    us->nb_cfi_rows += cfi_table.size() - nb_rows;
+    if (!row || (row->cfa_reg == CfiRow::kCfaFp && !fp_known)) {
+      return false;
+    }
+    us->current_ip = frame_pc;
+    if (IsDDResNotOK(add_unsymbolized_frame(us, *dso, frame_pc, *ddprof_mod,
+                                            file_info_id))) {
+      return false;
+    }
+
+    ProcessAddress_t const cfa =
+        (row->cfa_reg == CfiRow::kCfaSp ? sp : fp) + row->cfa_offset;
+    ElfWord_t ra = 0;
+    switch (row->ra_rule) {
+    case CfiRow::kUndefined:
+      // outermost frame
+      return true;
+    case CfiRow::kSameValue:
+      if (!activation || k_perf_ra_regno < 0) {
+        return false;
+      }
+      ra = regs[k_perf_ra_regno];
+      break;
+    case CfiRow::kOffset:
+      if (!memory_read(cfa + row->ra_offset, &ra, -1, us)) {
+        // stack is truncated
+        return true;
+      }
+      break;
+    }
+    if (row->fp_rule == CfiRow::kUndefined) {
+      fp_known = false;
+    } else if (row->fp_rule == CfiRow::kOffset) {
+      fp_known = memory_read(cfa + row->fp_offset, &fp, k_perf_fp_regno, us);
+    }
+    // stack grows down
+    if (cfa < sp || (cfa == sp && !activation)) {
+      return false;
+    }
+    sp = cfa;
+    pc = ra;
+  }
+  return true;
+}
+
 DDRes unwind_init_dwfl(Process &process, bool avoid_new_attach,
                        UnwindState *us) {
   us->_dwfl_wrapper = process.get_or_insert_dwfl();
@@ -266,6 +385,17 @@ DDRes unwind_dwfl(Process &process, bool avoid_new_attach, UnwindState *us) {
     LOG_ERROR_DETAILS(LG_DBG, res._what);
     return res;
   }
+  if (us->use_cfi_tables) {
+    if (unwind_cfi_tables(us) && !us->output.locs.empty()) {
+      ddprof_stats_add(STATS_UNWIND_FRAMES, us->output.locs.size(), nullptr);
+      return {};
+    }
+    ddprof_stats_add(STATS_UNWIND_CFI_TABLE_FALLBACKS, 1, nullptr);
+    us->output.locs.clear();
+    us->current_ip = us->initial_regs.regs[REGNAME(PC)];
+    us->stack_reads.clear();
+    us->stack_reads_cacheable = true;
+  }
   //
   // Launch the dwarf unwinding (uses frame_cb callback)
   if (dwfl_getthread_frames(us->_dwfl_wrapper->_dwfl, us->pid, frame_cb, us) !=
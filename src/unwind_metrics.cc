@@ -11,7 +11,8 @@ namespace {
 constexpr DDPROF_STATS s_cycled_stats[] = {
     STATS_UNWIND_FRAMES,          STATS_UNWIND_ERRORS,
     STATS_UNWIND_TRUNCATED_INPUT, STATS_UNWIND_TRUNCATED_OUTPUT,
-    STATS_UNWIND_AVG_STACK_SIZE,  STATS_UNWIND_AVG_STACK_DEPTH};
+    STATS_UNWIND_AVG_STACK_SIZE,  STATS_UNWIND_AVG_STACK_DEPTH,
+    STATS_UNWIND_CFI_TABLE_FALLBACKS};
 }
 
 void unwind_metrics_reset() {
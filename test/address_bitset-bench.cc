@@ -33,6 +33,8 @@ constexpr size_t kRemoveBatchDivisor = 10;
 constexpr size_t kRemoveLookback = 1000;
 constexpr size_t kDefaultAllocSize = 1024;
 constexpr size_t kSmallTableSize = 65536;
+// one sampled allocation / free every kFreeHeavySampledRatio frees
+constexpr size_t kFreeHeavySampledRatio = 1000;
 
 #ifdef ENABLE_ABSL_BENCHMARKS
 constexpr size_t kMaxTracked = 524288;
@@ -434,6 +436,52 @@ BENCHMARK(BM_AddressBitset_FreeLookupMiss<ContentionMode::kLowContention>)
     ->Threads(4)
     ->Threads(8);
 
+// Free-heavy workload: most frees are for addresses that were never sampled,
+// a small fraction of the operations track / untrack a sampled address.
+template <ContentionMode Mode>
+void BM_AddressBitset_FreeHeavy_MT(benchmark::State &state) {
+  static AddressBitset bitset(AddressBitset::_k_default_table_size);
+
+  const auto &tracked =
+      get_address_pool<Mode>(kSmallAddressPool, kDefaultAllocSize);
+  const auto &untracked =
+      get_address_pool<Mode>(kLargeAddressPool, kDefaultAllocSize);
+  const auto range = get_thread_address_range(
+      tracked.size(), state.thread_index(), state.threads());
+
+  size_t idx = 0;
+  size_t tracked_idx = range.start;
+  for (auto _ : state) {
+    if (idx % kFreeHeavySampledRatio == 0) {
+      uintptr_t const addr = tracked[tracked_idx];
+      bitset.add(addr);
+      benchmark::DoNotOptimize(bitset.remove(addr));
+      if (++tracked_idx >= range.end) {
+        tracked_idx = range.start;
+      }
+    } else {
+      // Offset into the block: pools can share addresses, these can't be
+      // tracked
+      uintptr_t const addr =
+          untracked[idx % untracked.size()] + (kDefaultAllocSize / 2);
+      benchmark::DoNotOptimize(bitset.remove(addr));
+    }
+    ++idx;
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AddressBitset_FreeHeavy_MT<ContentionMode::kHighContention>)
+    ->Threads(1)
+    ->Threads(4)
+    ->Threads(8)
+    ->Threads(16);
+BENCHMARK(BM_AddressBitset_FreeHeavy_MT<ContentionMode::kLowContention>)
+    ->Threads(1)
+    ->Threads(4)
+    ->Threads(8)
+    ->Threads(16);
+
 void BM_AddressBitset_FreeLookupMiss_HighLoad(benchmark::State &state) {
   AddressBitset bitset(kSmallTableSize);
 
@@ -4,9 +4,12 @@
 // Datadog, Inc.
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <cstdint>
 #include <random>
+#include <thread>
 #include <unordered_set>
+#include <vector>
 
 #include "address_bitset.hpp"
 
@@ -23,6 +26,76 @@ TEST(address_bitset, simple) {
   EXPECT_TRUE(address_bitset.remove(0xbadbeef));
 }
 
+TEST(address_bitset, contains_and_for_each) {
+  AddressBitset address_bitset(AddressBitset::_k_default_table_size);
+  constexpr uintptr_t kLargeAddr = 0x7f0000001000ULL;
+  EXPECT_TRUE(address_bitset.add(0xbadbeef));
+  EXPECT_TRUE(address_bitset.add(0xbadbeef0));
+  EXPECT_TRUE(address_bitset.add(kLargeAddr, true));
+  EXPECT_TRUE(address_bitset.contains(0xbadbeef));
+  EXPECT_TRUE(address_bitset.contains(kLargeAddr, true));
+  EXPECT_FALSE(address_bitset.contains(kLargeAddr));
+  EXPECT_FALSE(address_bitset.contains(0xcafebabe));
+
+  EXPECT_TRUE(address_bitset.remove(0xbadbeef0));
+  EXPECT_FALSE(address_bitset.contains(0xbadbeef0));
+  std::unordered_set<uintptr_t> visited;
+  address_bitset.for_each([&](uintptr_t addr) { visited.insert(addr); });
+  EXPECT_EQ(visited, (std::unordered_set<uintptr_t>{0xbadbeef, kLargeAddr}));
+}
+
+TEST(address_bitset, filter) {
+  AddressFilter filter;
+  constexpr uint64_t kHash = 0x123456789abcdef0ULL;
+  EXPECT_FALSE(filter.may_contain(kHash));
+  filter.add(kHash);
+  filter.add(kHash);
+  EXPECT_TRUE(filter.may_contain(kHash));
+  filter.remove(kHash);
+  EXPECT_TRUE(filter.may_contain(kHash));
+  filter.remove(kHash);
+  EXPECT_FALSE(filter.may_contain(kHash));
+
+  // saturated counters are never decremented
+  for (int i = 0; i < AddressFilter::_k_saturated + 1; ++i) {
+    filter.add(kHash);
+  }
+  for (int i = 0; i < AddressFilter::_k_saturated + 1; ++i) {
+    filter.remove(kHash);
+  }
+  EXPECT_TRUE(filter.may_contain(kHash));
+  filter.clear();
+  EXPECT_FALSE(filter.may_contain(kHash));
+}
+
+TEST(address_bitset, filter_mt) {
+  // concurrent adds and removes leave the filter empty
+  AddressBitset address_bitset(AddressBitset::_k_default_table_size);
+  constexpr int kNbThreads = 8;
+  constexpr uintptr_t kNbAddresses = 2000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNbThreads; ++t) {
+    threads.emplace_back([&address_bitset, t]() {
+      for (int round = 0; round < 10; ++round) {
+        for (uintptr_t i = 0; i < kNbAddresses; ++i) {
+          EXPECT_TRUE(address_bitset.add(((t * kNbAddresses) + i + 1) << 4));
+        }
+        for (uintptr_t i = 0; i < kNbAddresses; ++i) {
+          EXPECT_TRUE(
+              address_bitset.remove(((t * kNbAddresses) + i + 1) << 4));
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(address_bitset.count(), 0);
+  for (uintptr_t i = 0; i < kNbThreads * kNbAddresses; ++i) {
+    EXPECT_FALSE(address_bitset.contains((i + 1) << 4));
+  }
+}
+
 TEST(address_bitset, many_addresses) {
 #ifdef __SANITIZE_ADDRESS__
   constexpr unsigned kTestElements = 5000;
@@ -105,4 +178,83 @@ TEST(address_bitset, no_false_collisions) {
   EXPECT_EQ(remove_failures, 0);
 }
 
+TEST(address_bitset, grow) {
+  constexpr size_t kTableSize = 1024;
+  constexpr uintptr_t kNbAddresses = 100000;
+  AddressBitset address_bitset(kTableSize);
+  // All addresses in the same shard
+  for (uintptr_t i = 1; i <= kNbAddresses; ++i) {
+    EXPECT_TRUE(address_bitset.add(i << 4));
+  }
+  EXPECT_FALSE(address_bitset.add(uintptr_t{1} << 4));
+  EXPECT_EQ(address_bitset.count(), kNbAddresses);
+  auto stats = address_bitset.stats();
+  EXPECT_GT(stats.nb_growths, 0);
+  EXPECT_GE(stats.capacity, kNbAddresses);
+  EXPECT_LT(stats.max_probe_length, AddressBitset::_k_max_probe_distance);
+
+  size_t visited = 0;
+  address_bitset.for_each([&](uintptr_t) { ++visited; });
+  EXPECT_EQ(visited, kNbAddresses);
+
+  for (uintptr_t i = 1; i <= kNbAddresses; ++i) {
+    EXPECT_TRUE(address_bitset.contains(i << 4));
+    EXPECT_TRUE(address_bitset.remove(i << 4));
+  }
+  EXPECT_EQ(address_bitset.count(), 0);
+  // Drained tables are skipped, new insertions go to the largest table
+  EXPECT_TRUE(address_bitset.add(uintptr_t{1} << 4));
+  EXPECT_EQ(address_bitset.stats().nb_growths, stats.nb_growths);
+}
+
+TEST(address_bitset, grow_mt_stress) {
+  constexpr unsigned kNbThreads = 64;
+#ifdef __SANITIZE_ADDRESS__
+  constexpr uintptr_t kLivePerThread = 1024;
+#else
+  constexpr uintptr_t kLivePerThread = 8192;
+#endif
+  constexpr unsigned kNbRounds = 4;
+  AddressBitset address_bitset(AddressBitset::_k_default_table_size);
+  std::atomic<size_t> add_failures{0};
+  std::atomic<size_t> remove_failures{0};
+
+  // Interleaved addresses: all threads grow the same shards concurrently
+  auto address = [](unsigned thread, unsigned round, uintptr_t i) {
+    uintptr_t const idx = (round * kLivePerThread + i) * kNbThreads + thread;
+    return (idx + 1) << 4;
+  };
+  std::vector<std::thread> threads;
+  threads.reserve(kNbThreads);
+  for (unsigned t = 0; t < kNbThreads; ++t) {
+    threads.emplace_back([&, t] {
+      for (unsigned round = 0; round < kNbRounds; ++round) {
+        for (uintptr_t i = 0; i < kLivePerThread; ++i) {
+          if (!address_bitset.add(address(t, round, i))) {
+            ++add_failures;
+          }
+          // free the allocations of the previous round while allocating
+          if (round > 0 && !address_bitset.remove(address(t, round - 1, i))) {
+            ++remove_failures;
+          }
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(add_failures, 0);
+  EXPECT_EQ(remove_failures, 0);
+  EXPECT_EQ(address_bitset.count(), kNbThreads * kLivePerThread);
+  EXPECT_GT(address_bitset.stats().nb_growths, 0);
+
+  for (unsigned t = 0; t < kNbThreads; ++t) {
+    for (uintptr_t i = 0; i < kLivePerThread; ++i) {
+      EXPECT_TRUE(address_bitset.remove(address(t, kNbRounds - 1, i)));
+    }
+  }
+  EXPECT_EQ(address_bitset.count(), 0);
+}
+
 } // namespace ddprof
@@ -2,6 +2,7 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <random>
 #include <thread>
@@ -46,6 +47,10 @@ void read_buffer(ddprof::RingBufferHolder &holder) {
 
       } else if (hdr->type == PERF_CUSTOM_EVENT_DEALLOCATION) {
         ++nb_dealloc_samples;
+      } else if (hdr->type == PERF_CUSTOM_EVENT_DEALLOCATION_BATCH) {
+        nb_dealloc_samples +=
+            reinterpret_cast<const DeallocationBatchEvent *>(hdr)
+                ->nb_deallocations;
       } else {
         ++nb_unknown_samples;
       }
@@ -314,6 +319,92 @@ static void BM_LongLived_Tracking(benchmark::State &state) {
   perform_memory_operations_2(true, state);
 }
 
+// Free-heavy path: most frees are for allocations that were not sampled
+std::unique_ptr<ddprof::RingBufferHolder> free_heavy_ring_buffer;
+
+void free_heavy_setup(const benchmark::State &) {
+  const size_t buf_size_order = 8;
+  free_heavy_ring_buffer = std::make_unique<ddprof::RingBufferHolder>(
+      buf_size_order, RingBufferType::kMPSCRingBuffer);
+  ddprof::AllocationTracker::allocation_tracking_init(
+      k_rate,
+      ddprof::AllocationTracker::kDeterministicSampling |
+          ddprof::AllocationTracker::kTrackDeallocations,
+      k_default_perf_stack_sample_size,
+      free_heavy_ring_buffer->get_buffer_info(), {});
+}
+
+void free_heavy_teardown(const benchmark::State &) {
+  ddprof::AllocationTracker::allocation_tracking_free();
+  free_heavy_ring_buffer.reset();
+}
+
+static void BM_FreeHeavy_Tracking(benchmark::State &state) {
+  static constexpr size_t k_alloc_size = 64;
+  static constexpr uintptr_t k_nb_addresses = 4096;
+  ddprof::AllocationTracker::init_tl_state();
+  // one address range per thread
+  const uintptr_t base = (state.thread_index() + 1) * (k_nb_addresses << 4);
+  uintptr_t idx = 0;
+  for (auto _ : state) {
+    const uintptr_t addr = base + ((idx++ % k_nb_addresses) << 4);
+    my_malloc(k_alloc_size, addr);
+    my_free(addr);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Every free is tracked: compares pushing each deallocation (range 0) with
+// pushing them in batches (range 1)
+std::unique_ptr<ddprof::RingBufferHolder> tracked_frees_ring_buffer;
+std::mutex tracked_frees_mutex;
+
+void tracked_frees_setup(const benchmark::State &state) {
+  const size_t buf_size_order = 12;
+  constexpr uint32_t k_stack_sample_size = 512;
+  tracked_frees_ring_buffer = std::make_unique<ddprof::RingBufferHolder>(
+      buf_size_order, RingBufferType::kMPSCRingBuffer);
+  uint32_t flags = ddprof::AllocationTracker::kDeterministicSampling |
+      ddprof::AllocationTracker::kTrackDeallocations;
+  if (state.range(0)) {
+    flags |= ddprof::AllocationTracker::kBatchDeallocations;
+  }
+  ddprof::AllocationTracker::allocation_tracking_init(
+      1, flags, k_stack_sample_size,
+      tracked_frees_ring_buffer->get_buffer_info(), {});
+}
+
+void tracked_frees_teardown(const benchmark::State &) {
+  ddprof::AllocationTracker::allocation_tracking_free();
+  tracked_frees_ring_buffer.reset();
+}
+
+static void BM_TrackedFrees(benchmark::State &state) {
+  static constexpr uintptr_t k_nb_addresses = 512;
+  ddprof::AllocationTracker::init_tl_state();
+  const uintptr_t base = (state.thread_index() + 1) * (k_nb_addresses << 4);
+  uintptr_t idx = k_nb_addresses;
+  for (auto _ : state) {
+    if (idx == k_nb_addresses) {
+      // track a new set of addresses and empty the ring buffer (untimed)
+      state.PauseTiming();
+      {
+        std::lock_guard const lock{tracked_frees_mutex};
+        for (uintptr_t i = 0; i < k_nb_addresses; ++i) {
+          my_malloc(1, base + (i << 4));
+        }
+        ddprof::MPSCRingBufferReader reader(
+            &tracked_frees_ring_buffer->get_ring_buffer());
+        while (!reader.read_sample().empty()) {}
+      }
+      idx = 0;
+      state.ResumeTiming();
+    }
+    my_free(base + (idx++ << 4));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
 // short lived threads
 BENCHMARK(BM_ShortLived_NoTracking)->MeasureProcessCPUTime()->UseRealTime();
 BENCHMARK(BM_ShortLived_Tracking)->MeasureProcessCPUTime()->UseRealTime();
@@ -322,4 +413,21 @@ BENCHMARK(BM_ShortLived_Tracking)->MeasureProcessCPUTime()->UseRealTime();
 BENCHMARK(BM_LongLived_NoTracking)->MeasureProcessCPUTime();
 BENCHMARK(BM_LongLived_Tracking)->MeasureProcessCPUTime();
 
+// concurrent malloc / free pairs
+BENCHMARK(BM_FreeHeavy_Tracking)
+    ->Setup(free_heavy_setup)
+    ->Teardown(free_heavy_teardown)
+    ->Threads(1)
+    ->Threads(4)
+    ->Threads(8);
+
+BENCHMARK(BM_TrackedFrees)
+    ->Setup(tracked_frees_setup)
+    ->Teardown(tracked_frees_teardown)
+    ->Arg(0)
+    ->Arg(1)
+    ->Threads(1)
+    ->Threads(4)
+    ->Threads(8);
+
 } // namespace ddprof
@@ -28,6 +28,9 @@
 
 #include <cstdlib>
 #include <gtest/gtest.h>
+#include <thread>
+#include <unordered_set>
+#include <vector>
 #ifdef USE_JEMALLOC
 #  include <jemalloc/jemalloc.h>
 #else
@@ -238,6 +241,186 @@ TEST(allocation_tracker, many_tracked_allocs) {
   EXPECT_EQ(nb_samples, kTestAllocations);
 }
 
+TEST(allocation_tracker, lost_frees_are_replayed) {
+  LogHandle log_handle;
+  // timer checks need a clock
+  TscClock::init();
+  PerfClock::init();
+  // small ring buffer so that deallocations do not fit
+  const size_t buf_size_order = 2;
+  constexpr uint32_t kStackSampleSize = 1024;
+  RingBufferHolder ring_buffer{buf_size_order, RingBufferType::kMPSCRingBuffer};
+  AllocationTracker::allocation_tracking_init(
+      kSamplingRate,
+      AllocationTracker::kDeterministicSampling |
+          AllocationTracker::kTrackDeallocations,
+      kStackSampleSize, ring_buffer.get_buffer_info(),
+      {[] {}, std::chrono::milliseconds{1}, std::chrono::milliseconds{1}});
+  defer { AllocationTracker::allocation_tracking_free(); };
+
+  constexpr uintptr_t kBaseAddr = 0x1000;
+  constexpr int kNbAllocations = 600;
+  constexpr uintptr_t kEndAddr = kBaseAddr + (kNbAllocations * 16);
+  std::unordered_set<uintptr_t> freed;
+  uint64_t nb_replayed_deallocs = 0;
+  auto drain = [&]() {
+    ddprof::MPSCRingBufferReader reader{&ring_buffer.get_ring_buffer()};
+    while (reader.available_size() > 0) {
+      auto buf = reader.read_sample();
+      const auto *hdr = reinterpret_cast<const perf_event_header *>(buf.data());
+      if (hdr->type != PERF_CUSTOM_EVENT_DEALLOCATION) {
+        continue;
+      }
+      const auto *event = reinterpret_cast<const DeallocationEvent *>(hdr);
+      if (event->ptr < kEndAddr) {
+        EXPECT_TRUE(freed.insert(event->ptr).second);
+        // replayed deallocations are not attributed to a thread
+        nb_replayed_deallocs += (event->sample_id.tid == 0);
+      }
+    }
+  };
+
+  for (int i = 0; i < kNbAllocations; ++i) {
+    my_malloc(1, kBaseAddr + (i * 16));
+    drain();
+  }
+  // free path does not wait for the consumer
+  for (int i = 0; i < kNbAllocations; ++i) {
+    my_free(kBaseAddr + (i * 16));
+  }
+  drain();
+  EXPECT_LT(freed.size(), kNbAllocations);
+
+  // lost deallocations are pushed again on timer checks
+  uintptr_t addr = kEndAddr;
+  for (int i = 0; i < 100 && freed.size() < kNbAllocations; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{2});
+    my_malloc(1, addr);
+    my_free(addr);
+    addr += 16;
+    drain();
+  }
+  EXPECT_EQ(freed.size(), kNbAllocations);
+  EXPECT_GT(nb_replayed_deallocs, 0);
+  ASSERT_TRUE(AllocationTracker::is_active());
+}
+
+TEST(allocation_tracker, batched_deallocations) {
+  LogHandle log_handle;
+  TscClock::init();
+  PerfClock::init();
+  RingBufferHolder ring_buffer{kBufSizeOrder, RingBufferType::kMPSCRingBuffer};
+  AllocationTracker::allocation_tracking_init(
+      kSamplingRate,
+      AllocationTracker::kDeterministicSampling |
+          AllocationTracker::kTrackDeallocations |
+          AllocationTracker::kBatchDeallocations,
+      k_default_perf_stack_sample_size, ring_buffer.get_buffer_info(), {});
+  defer { AllocationTracker::allocation_tracking_free(); };
+
+  constexpr uintptr_t kBaseAddr = 0x1000;
+  constexpr size_t kBatchSize = AllocationTracker::k_dealloc_batch_size;
+  constexpr size_t kNbAllocations = (2 * kBatchSize) + 3;
+  std::vector<uintptr_t> freed;
+  size_t nb_batches = 0;
+  size_t nb_alloc_samples = 0;
+  pid_t expected_tid = ddprof::gettid();
+  auto drain = [&]() {
+    MPSCRingBufferReader reader{&ring_buffer.get_ring_buffer()};
+    while (reader.available_size() > 0) {
+      auto buf = reader.read_sample();
+      const auto *hdr = reinterpret_cast<const perf_event_header *>(buf.data());
+      if (hdr->type == PERF_RECORD_SAMPLE) {
+        ++nb_alloc_samples;
+        continue;
+      }
+      ASSERT_EQ(hdr->type, PERF_CUSTOM_EVENT_DEALLOCATION_BATCH);
+      const auto *event =
+          reinterpret_cast<const DeallocationBatchEvent *>(hdr);
+      ASSERT_EQ(hdr->size,
+                sizeof_deallocation_batch_event(event->nb_deallocations));
+      ASSERT_EQ(event->sample_id.pid, getpid());
+      ASSERT_EQ(event->sample_id.tid, expected_tid);
+      ASSERT_EQ(event->sample_id.time,
+                event->deallocations[event->nb_deallocations - 1].time);
+      for (uint64_t i = 0; i < event->nb_deallocations; ++i) {
+        if (i > 0) {
+          ASSERT_GE(event->deallocations[i].time,
+                    event->deallocations[i - 1].time);
+        }
+        freed.push_back(event->deallocations[i].ptr);
+      }
+      ++nb_batches;
+    }
+  };
+
+  for (size_t i = 0; i < kNbAllocations; ++i) {
+    my_malloc(1, kBaseAddr + (i * 16));
+  }
+  drain();
+  EXPECT_EQ(nb_alloc_samples, kNbAllocations);
+
+  // deallocations are pushed by full batches
+  for (size_t i = 0; i < kNbAllocations; ++i) {
+    my_free(kBaseAddr + (i * 16));
+  }
+  drain();
+  EXPECT_EQ(nb_batches, 2);
+  EXPECT_EQ(freed.size(), 2 * kBatchSize);
+
+  // staged deallocations are pushed on thread exit
+  AllocationTracker::notify_thread_exit();
+  drain();
+  ASSERT_EQ(freed.size(), kNbAllocations);
+  for (size_t i = 0; i < kNbAllocations; ++i) {
+    EXPECT_EQ(freed[i], kBaseAddr + (i * 16));
+  }
+
+  // stale deallocations are pushed on the next untracked free
+  my_malloc(1, kBaseAddr);
+  my_free(kBaseAddr);
+  drain();
+  ASSERT_EQ(freed.size(), kNbAllocations);
+  std::this_thread::sleep_for(AllocationTracker::k_max_dealloc_batch_age);
+  my_free(kBaseAddr + 8);
+  drain();
+  ASSERT_EQ(freed.size(), kNbAllocations + 1);
+  EXPECT_EQ(freed.back(), kBaseAddr);
+
+  // and ahead of an allocation of the same thread
+  my_malloc(1, kBaseAddr);
+  my_free(kBaseAddr);
+  my_malloc(1, kBaseAddr);
+  {
+    MPSCRingBufferReader reader{&ring_buffer.get_ring_buffer()};
+    auto buf = reader.read_sample();
+    ASSERT_EQ(reinterpret_cast<const perf_event_header *>(buf.data())->type,
+              PERF_RECORD_SAMPLE);
+    buf = reader.read_sample();
+    ASSERT_EQ(reinterpret_cast<const perf_event_header *>(buf.data())->type,
+              PERF_CUSTOM_EVENT_DEALLOCATION_BATCH);
+    buf = reader.read_sample();
+    ASSERT_EQ(reinterpret_cast<const perf_event_header *>(buf.data())->type,
+              PERF_RECORD_SAMPLE);
+  }
+
+  // stale deallocations of an idle thread are pushed from the hooks of other
+  // threads
+  size_t const nb_freed = freed.size();
+  my_malloc(1, kBaseAddr + 16);
+  std::thread([&]() {
+    expected_tid = ddprof::gettid();
+    my_free(kBaseAddr + 16);
+  }).join();
+  drain();
+  ASSERT_EQ(freed.size(), nb_freed);
+  std::this_thread::sleep_for(AllocationTracker::k_max_dealloc_batch_age);
+  my_malloc(1, kBaseAddr + 32);
+  drain();
+  ASSERT_EQ(freed.size(), nb_freed + 1);
+  EXPECT_EQ(freed.back(), kBaseAddr + 16);
+}
+
 class AllocFunctionChecker {
 public:
   AllocFunctionChecker(RingBuffer &ring_buffer, size_t alloc_size)
@@ -0,0 +1,139 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include <gtest/gtest.h>
+
+#include "cfi_table.hpp"
+#include "ddprof_base.hpp"
+#include "dwfl_wrapper.hpp"
+#include "go_symbol_lookup.hpp"
+#include "loghandle.hpp"
+#include "savecontext.hpp"
+#include "unwind.hpp"
+#include "unwind_state.hpp"
+
+#include <unistd.h>
+#include <vector>
+
+namespace ddprof {
+
+namespace {
+std::byte stack[k_default_perf_stack_sample_size];
+uint64_t regs[k_nb_registers_to_unwind];
+size_t stack_size;
+
+template <int N> DDPROF_NOINLINE void recurse() {
+  if constexpr (N == 0) {
+    stack_size = save_context(retrieve_stack_bounds(), regs, stack);
+  } else {
+    recurse<N - 1>();
+  }
+  DDPROF_BLOCK_TAIL_CALL_OPTIMIZATION();
+}
+
+std::vector<ElfAddress_t> unwind(UnwindState &state) {
+  unwind_init_sample(&state, regs, getpid(), stack_size,
+                     reinterpret_cast<char *>(stack));
+  unwindstate_unwind(&state);
+  std::vector<ElfAddress_t> ips;
+  for (const FunLoc &loc : state.output.locs) {
+    ips.push_back(loc.ip);
+  }
+  return ips;
+}
+
+DDPROF_NOINLINE int leaf(int value) {
+  DoNotOptimize(value);
+  return value + 1;
+}
+} // namespace
+
+TEST(CfiTable, same_frames_as_libdw) {
+  LogHandle handle;
+  recurse<20>();
+
+  UnwindState libdw_state = create_unwind_state().value();
+  libdw_state.use_cfi_tables = false;
+  std::vector<ElfAddress_t> const libdw_ips = unwind(libdw_state);
+  EXPECT_GT(libdw_ips.size(), 20);
+
+  UnwindState state = create_unwind_state().value();
+  EXPECT_EQ(unwind(state), libdw_ips);
+  EXPECT_FALSE(state.cfi_tables.empty());
+
+  // second unwind only uses compiled rows
+  size_t nb_rows = 0;
+  for (const auto &el : state.cfi_tables) {
+    nb_rows += el.second.size();
+  }
+  state.unwind_cache.clear();
+  EXPECT_EQ(unwind(state), libdw_ips);
+  size_t nb_rows_after = 0;
+  for (const auto &el : state.cfi_tables) {
+    nb_rows_after += el.second.size();
+  }
+  EXPECT_EQ(nb_rows_after, nb_rows);
+}
+
+#ifdef __x86_64__
+TEST(CfiTable, function_entry) {
+  LogHandle handle;
+  recurse<0>();
+  UnwindState state = create_unwind_state().value();
+  unwind(state);
+  ASSERT_TRUE(state._dwfl_wrapper);
+
+  auto const pc = reinterpret_cast<ProcessAddress_t>(&leaf);
+  const DDProfMod *mod = nullptr;
+  for (const auto &el : state._dwfl_wrapper->_ddprof_mods) {
+    if (pc >= el.second._low_addr && pc < el.second._high_addr) {
+      mod = &el.second;
+    }
+  }
+  ASSERT_TRUE(mod);
+
+  // at function entry, CFA is SP + 8 and the return address is on top of
+  // the stack
+  std::optional<CfiRow> const row =
+      CfiTable::compile_row(mod->_mod, pc - mod->_sym_bias, mod->_sym_bias);
+  ASSERT_TRUE(row);
+  EXPECT_LE(row->start, pc - mod->_sym_bias);
+  EXPECT_GT(row->end, pc - mod->_sym_bias);
+  EXPECT_EQ(row->cfa_reg, CfiRow::kCfaSp);
+  EXPECT_EQ(row->cfa_offset, 8);
+  EXPECT_EQ(row->ra_rule, CfiRow::kOffset);
+  EXPECT_EQ(row->ra_offset, -8);
+  EXPECT_EQ(row->fp_rule, CfiRow::kSameValue);
+
+  // lookups go through the table once the row is compiled
+  CfiTable table;
+  const CfiRow *found = table.find_or_compile(mod->_mod, pc, mod->_sym_bias);
+  ASSERT_TRUE(found);
+  EXPECT_EQ(found->start, row->start);
+  EXPECT_EQ(table.size(), 1);
+  EXPECT_TRUE(table.find_or_compile(nullptr, pc, mod->_sym_bias));
+  EXPECT_EQ(table.size(), 1);
+}
+
+TEST(CfiTable, go_frame) {
+  LogHandle handle;
+  GoSymbolLookup lookup;
+  const GoPclntab *pclntab = lookup.find_pclntab(
+      FileInfoValue{FileInfo(UNIT_TEST_DATA "/go_exe", 0, 0), 1});
+  ASSERT_TRUE(pclntab);
+  // main.leaf of go_exe (see go_pclntab-ut), after push %rbp / sub $0x210
+  std::optional<CfiRow> const row =
+      CfiTable::compile_go_row(*pclntab, 0x47ae40);
+  ASSERT_TRUE(row);
+  EXPECT_EQ(row->cfa_reg, CfiRow::kCfaSp);
+  EXPECT_EQ(row->cfa_offset, 0x220);
+  EXPECT_EQ(row->ra_rule, CfiRow::kOffset);
+  EXPECT_EQ(row->ra_offset, -8);
+  EXPECT_EQ(row->fp_rule, CfiRow::kOffset);
+  EXPECT_EQ(row->fp_offset, -16);
+}
+#endif
+
+} // namespace ddprof
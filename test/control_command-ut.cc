@@ -0,0 +1,111 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include <gtest/gtest.h>
+
+#include "control_command.hpp"
+#include "unique_fd.hpp"
+
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace ddprof {
+
+TEST(control_command, simple_commands) {
+  auto command = parse_control_command("status\n");
+  ASSERT_TRUE(command);
+  EXPECT_EQ(command->type, ControlCommandType::kStatus);
+
+  command = parse_control_command("  export ");
+  ASSERT_TRUE(command);
+  EXPECT_EQ(command->type, ControlCommandType::kExport);
+
+  command = parse_control_command("help");
+  ASSERT_TRUE(command);
+  EXPECT_EQ(command->type, ControlCommandType::kHelp);
+
+  command = parse_control_command("dump\n");
+  ASSERT_TRUE(command);
+  EXPECT_EQ(command->type, ControlCommandType::kDump);
+
+  EXPECT_FALSE(parse_control_command(""));
+  EXPECT_FALSE(parse_control_command("\n"));
+  EXPECT_FALSE(parse_control_command("restart"));
+  EXPECT_FALSE(parse_control_command("status now"));
+}
+
+TEST(control_command, watcher_commands) {
+  auto command = parse_control_command("rate sCPU 99");
+  ASSERT_TRUE(command);
+  EXPECT_EQ(command->type, ControlCommandType::kRate);
+  EXPECT_EQ(command->watcher, "sCPU");
+  EXPECT_EQ(command->value, 99);
+
+  command = parse_control_command("disable 1\n");
+  ASSERT_TRUE(command);
+  EXPECT_EQ(command->type, ControlCommandType::kDisable);
+  EXPECT_EQ(command->watcher, "1");
+
+  command = parse_control_command("enable\tsALLOC");
+  ASSERT_TRUE(command);
+  EXPECT_EQ(command->type, ControlCommandType::kEnable);
+  EXPECT_EQ(command->watcher, "sALLOC");
+
+  EXPECT_FALSE(parse_control_command("rate sCPU"));
+  EXPECT_FALSE(parse_control_command("rate sCPU 0"));
+  EXPECT_FALSE(parse_control_command("rate sCPU -10"));
+  EXPECT_FALSE(parse_control_command("rate sCPU 10hz"));
+  EXPECT_FALSE(parse_control_command("rate sCPU 10 20"));
+  EXPECT_FALSE(parse_control_command("disable"));
+}
+
+TEST(control_command, allocation_rate) {
+  auto command = parse_control_command("allocation_rate 524288");
+  ASSERT_TRUE(command);
+  EXPECT_EQ(command->type, ControlCommandType::kAllocationRate);
+  EXPECT_EQ(command->value, 524288);
+
+  // negative rate requests deterministic sampling
+  command = parse_control_command("allocation_rate -4096");
+  ASSERT_TRUE(command);
+  EXPECT_EQ(command->value, -4096);
+
+  EXPECT_FALSE(parse_control_command("allocation_rate 0"));
+  EXPECT_FALSE(parse_control_command("allocation_rate"));
+  EXPECT_FALSE(parse_control_command("allocation_rate 99999999999999999999"));
+}
+
+TEST(control_command, read_write) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  UniqueFd server{fds[0]};
+  UniqueFd client{fds[1]};
+
+  // nothing sent yet: does not block
+  std::string buffer;
+  EXPECT_FALSE(read_control_command(server.get(), buffer));
+
+  // command received in several parts
+  write_control_reply(client.get(), "rate sC");
+  EXPECT_FALSE(read_control_command(server.get(), buffer));
+  write_control_reply(client.get(), "PU 10\nignored");
+  auto command = read_control_command(server.get(), buffer);
+  ASSERT_TRUE(command);
+  EXPECT_EQ(*command, "rate sCPU 10");
+
+  // command terminated by the end of the connection
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  server.reset(fds[0]);
+  client.reset(fds[1]);
+  write_control_reply(client.get(), "status");
+  client.reset();
+  buffer.clear();
+  command = read_control_command(server.get(), buffer);
+  ASSERT_TRUE(command);
+  EXPECT_EQ(*command, "status");
+}
+
+} // namespace ddprof
@@ -0,0 +1,124 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include "counter_group.hpp"
+
+#include <algorithm>
+#include <array>
+#include <gtest/gtest.h>
+#include <initializer_list>
+#include <linux/perf_event.h>
+
+namespace ddprof {
+
+namespace {
+// Sample record only made of the counters of the group: {value, id} pairs
+class GroupRecord {
+public:
+  explicit GroupRecord(std::initializer_list<uint64_t> entries) {
+    _buf[0] = entries.size() / 2;
+    std::copy(entries.begin(), entries.end(), _buf.begin() + 1);
+    _hdr.type = PERF_RECORD_SAMPLE;
+    _hdr.size = sizeof(_hdr) + ((1 + entries.size()) * sizeof(uint64_t));
+  }
+
+  [[nodiscard]] PerfSampleView view() const {
+    PerfSampleView view;
+    EXPECT_TRUE(
+        perf_sample_parser_from_type(PERF_SAMPLE_READ)(&_hdr, PERF_SAMPLE_READ,
+                                                       &view));
+    return view;
+  }
+
+private:
+  perf_event_header _hdr{};
+  std::array<uint64_t, 16> _buf{};
+};
+
+// Same, preceded by the pid and tid of the sample
+class ThreadGroupRecord {
+public:
+  ThreadGroupRecord(uint64_t tid, std::initializer_list<uint64_t> entries) {
+    _buf[0] = (tid << 32) | tid;
+    _buf[1] = entries.size() / 2;
+    std::copy(entries.begin(), entries.end(), _buf.begin() + 2);
+    _hdr.type = PERF_RECORD_SAMPLE;
+    _hdr.size = sizeof(_hdr) + ((2 + entries.size()) * sizeof(uint64_t));
+  }
+
+  [[nodiscard]] PerfSampleView view() const {
+    constexpr uint64_t k_sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_READ;
+    PerfSampleView view;
+    EXPECT_TRUE(perf_sample_parser_from_type(k_sample_type)(
+        &_hdr, k_sample_type, &view));
+    return view;
+  }
+
+private:
+  perf_event_header _hdr{};
+  std::array<uint64_t, 16> _buf{};
+};
+} // namespace
+
+TEST(CounterGroupTest, parse) {
+  GroupRecord const record{100, 1, 7, 2, 9, 3};
+  PerfSampleView const view = record.view();
+  EXPECT_EQ(view.nr_read_values(), 3);
+  EXPECT_EQ(view.read_value(0), 100);
+  EXPECT_EQ(view.read_id(0), 1);
+  EXPECT_EQ(view.read_value(2), 9);
+  EXPECT_EQ(view.read_id(2), 3);
+}
+
+TEST(CounterGroupTest, deltas) {
+  CounterGroupDeltas deltas;
+  // leader alone (eg. events of other threads)
+  EXPECT_TRUE(deltas.update(GroupRecord{100, 1}.view(), false).empty());
+
+  // first read is a baseline: counters might have been enabled long ago
+  std::span<const uint64_t> values =
+      deltas.update(GroupRecord{100, 1, 7, 2, 9, 3}.view(), false);
+  ASSERT_EQ(values.size(), 2);
+  EXPECT_EQ(values[0], 0);
+  EXPECT_EQ(values[1], 0);
+
+  values = deltas.update(GroupRecord{200, 1, 10, 2, 9, 3}.view(), false);
+  ASSERT_EQ(values.size(), 2);
+  EXPECT_EQ(values[0], 3);
+  EXPECT_EQ(values[1], 0);
+
+  // another event of the same group (other CPU)
+  values = deltas.update(GroupRecord{50, 4, 5, 5, 1, 6}.view(), false);
+  EXPECT_EQ(values[0], 0);
+  EXPECT_EQ(deltas.size(), 2);
+  values = deltas.update(GroupRecord{60, 4, 6, 5, 1, 6}.view(), false);
+  EXPECT_EQ(values[0], 1);
+  EXPECT_EQ(deltas.size(), 2);
+}
+
+TEST(CounterGroupTest, per_thread) {
+  // inherited events report the id of their parent: tell threads apart
+  constexpr uint64_t k_tid1 = 11;
+  constexpr uint64_t k_tid2 = 12;
+  CounterGroupDeltas deltas;
+  auto update = [&](uint64_t tid, uint64_t value) {
+    std::span<const uint64_t> const values =
+        deltas.update(ThreadGroupRecord{tid, {100, 1, value, 2}}.view(), true);
+    EXPECT_EQ(values.size(), 1);
+    return values.empty() ? 0 : values[0];
+  };
+  EXPECT_EQ(update(k_tid1, 1000), 0);
+  EXPECT_EQ(update(k_tid2, 10), 0);
+  EXPECT_EQ(update(k_tid1, 1100), 100);
+  EXPECT_EQ(update(k_tid2, 30), 20);
+  EXPECT_EQ(deltas.size(), 2);
+
+  // entries are only forgotten when their thread exits
+  deltas.thread_exit(k_tid1);
+  EXPECT_EQ(deltas.size(), 1);
+  EXPECT_EQ(update(k_tid2, 35), 5);
+}
+
+} // namespace ddprof
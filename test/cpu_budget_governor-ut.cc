@@ -0,0 +1,58 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include <gtest/gtest.h>
+
+#include "cpu_budget_governor.hpp"
+#include "perf_watcher.hpp"
+
+namespace ddprof {
+
+TEST(cpu_budget_governor, no_budget) {
+  EXPECT_EQ(cpu_budget_next_rate_scale(0.5, 1000, 0), 1.0);
+}
+
+TEST(cpu_budget_governor, over_budget) {
+  // usage is 4 times the budget: scale is halved (bounded step)
+  EXPECT_DOUBLE_EQ(cpu_budget_next_rate_scale(1.0, 400, 100), 0.5);
+  // usage slightly over budget
+  EXPECT_DOUBLE_EQ(cpu_budget_next_rate_scale(1.0, 125, 100), 0.8);
+  // never goes below minimum scale
+  double scale = 1.0;
+  for (int i = 0; i < 20; ++i) {
+    scale = cpu_budget_next_rate_scale(scale, 1000, 10);
+  }
+  EXPECT_DOUBLE_EQ(scale, k_min_sampling_rate_scale);
+}
+
+TEST(cpu_budget_governor, under_budget) {
+  // within dead band
+  EXPECT_DOUBLE_EQ(cpu_budget_next_rate_scale(0.5, 95, 100), 0.5);
+  // configured rates are never exceeded
+  EXPECT_DOUBLE_EQ(cpu_budget_next_rate_scale(1.0, 10, 100), 1.0);
+  // low usage restores rates progressively
+  EXPECT_DOUBLE_EQ(cpu_budget_next_rate_scale(0.25, 10, 100), 0.5);
+  EXPECT_DOUBLE_EQ(cpu_budget_next_rate_scale(0.25, 0, 100), 0.5);
+  EXPECT_DOUBLE_EQ(cpu_budget_next_rate_scale(0.5, 80, 100), 0.625);
+}
+
+TEST(cpu_budget_governor, scaled_sample_value) {
+  PerfWatcher watcher{};
+  watcher.options.is_freq = true;
+  watcher.sample_frequency = 100;
+  EXPECT_EQ(watcher_scaled_sample_value(watcher, 1.0), 100);
+  EXPECT_EQ(watcher_scaled_sample_value(watcher, 0.5), 50);
+  EXPECT_EQ(watcher_scaled_sample_value(watcher, 0.001), 1);
+
+  watcher.options.is_freq = false;
+  watcher.sample_period = -524288;
+  EXPECT_EQ(watcher_scaled_sample_value(watcher, 1.0), 524288);
+  EXPECT_EQ(watcher_scaled_sample_value(watcher, 0.25), 4 * 524288);
+
+  watcher.sample_period = 0;
+  EXPECT_EQ(watcher_scaled_sample_value(watcher, 0.5), 0);
+}
+
+} // namespace ddprof
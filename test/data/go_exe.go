@@ -0,0 +1,16 @@
+package main
+
+import "fmt"
+
+//go:noinline
+func leaf(n int) int {
+	var arr [64]int
+	for i := range arr {
+		arr[i] = i * n
+	}
+	return arr[n%64]
+}
+
+func main() {
+	fmt.Println(leaf(3))
+}
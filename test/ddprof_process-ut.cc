@@ -5,10 +5,15 @@
 
 #include "ddprof_process.hpp"
 
+#include "cgroup_container_id_cache.hpp"
 #include "loghandle.hpp"
 
+#include <algorithm>
 #include <atomic>
+#include <cstdlib>
+#include <filesystem>
 #include <gtest/gtest.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #ifndef gettid
@@ -44,6 +49,48 @@ TEST(DDProfProcess, container_id) {
   }
 }
 
+TEST(DDProfProcess, container_id_from_cgroup_path) {
+  const std::string k_id =
+      "3e74d3fd9db4c9dd921ae05c2502fb984d0cde1b36e581b13f79c639da4518a1";
+  EXPECT_EQ(container_id_from_cgroup_path(
+                "/kubepods/besteffort/pod3d274242-8ee0-11e9-a8a6-1e68d864ef1a/"
+                + k_id),
+            k_id);
+  EXPECT_EQ(container_id_from_cgroup_path("/system.slice/docker-" + k_id +
+                                          ".scope"),
+            k_id);
+  EXPECT_EQ(container_id_from_cgroup_path(
+                "/ecs/34dc0b5e626f2c5c4c5170e34b10e765-1234567890"),
+            "34dc0b5e626f2c5c4c5170e34b10e765-1234567890");
+  EXPECT_FALSE(container_id_from_cgroup_path("/user.slice/session-2.scope"));
+  EXPECT_FALSE(container_id_from_cgroup_path("/"));
+}
+
+TEST(DDProfProcess, cgroup_container_id_cache) {
+  LogHandle handle;
+  char tmpl[] = "/tmp/cgroup_root_XXXXXX";
+  ASSERT_NE(mkdtemp(tmpl), nullptr);
+  std::filesystem::path const root{tmpl};
+  const std::string k_id =
+      "3e74d3fd9db4c9dd921ae05c2502fb984d0cde1b36e581b13f79c639da4518a1";
+  std::filesystem::path const container = root / "kubepods" / k_id;
+  std::filesystem::create_directories(container);
+  auto inode = [](const std::filesystem::path &path) -> uint64_t {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? info.st_ino : 0;
+  };
+
+  CGroupContainerIdCache cache{root.string()};
+  EXPECT_EQ(cache.get(inode(container)), k_id);
+  EXPECT_EQ(cache.get(inode(root / "kubepods")), k_container_id_none);
+  // all cgroups were cached by the first scan (root and 2 levels)
+  EXPECT_EQ(cache.size(), 3);
+  // unknown cgroups are remembered as such
+  EXPECT_EQ(cache.get(0xdeadbeefdeadbeef), k_container_id_unknown);
+  EXPECT_EQ(cache.size(), 4);
+  std::filesystem::remove_all(root);
+}
+
 TEST(DDProfProcess, simple_pid_2) {
   LogHandle handle;
   ProcessHdr process_hdr(UNIT_TEST_DATA);
@@ -84,4 +131,74 @@ TEST(DDProfProcess, simple_tid) {
   pthread_join(test_thread, nullptr);
 }
 
+TEST(DDProfProcess, thread_name_history) {
+  LogHandle handle;
+  Process p(getpid());
+  constexpr pid_t k_tid = 1430928460; // no procfs entry
+  auto t0 = PerfClock::time_point{std::chrono::seconds{10}};
+  p.set_thread_name(k_tid, "worker", t0);
+  p.set_thread_name(k_tid, "renamed", t0 + std::chrono::seconds{1});
+
+  // samples are labelled with the name active at their timestamp
+  EXPECT_EQ(p.get_or_insert_thread_name(k_tid, t0), "worker");
+  EXPECT_EQ(p.get_or_insert_thread_name(k_tid, t0 + std::chrono::seconds{2}),
+            "renamed");
+  EXPECT_EQ(p.get_or_insert_thread_name(k_tid), "renamed");
+  // name before first event is the oldest known name
+  EXPECT_EQ(p.get_or_insert_thread_name(k_tid, t0 - std::chrono::seconds{1}),
+            "worker");
+
+  // out of order rename
+  p.set_thread_name(k_tid, "early", t0 + std::chrono::milliseconds{500});
+  EXPECT_EQ(p.get_or_insert_thread_name(
+                k_tid, t0 + std::chrono::milliseconds{600}),
+            "early");
+
+  for (size_t i = 0; i < 2 * Process::k_max_thread_name_history; ++i) {
+    p.set_thread_name(k_tid, std::to_string(i),
+                      t0 + std::chrono::seconds{10 + i});
+  }
+  EXPECT_EQ(p.get_or_insert_thread_name(k_tid),
+            std::to_string(2 * Process::k_max_thread_name_history - 1));
+
+  p.erase_thread_name(k_tid);
+  // unknown thread without procfs entry
+  EXPECT_EQ(p.get_or_insert_thread_name(k_tid), "");
+}
+
+TEST(DDProfProcess, thread_exit) {
+  LogHandle handle;
+  ProcessHdr process_hdr{};
+  constexpr pid_t k_pid = 1430928460; // no procfs entry
+  constexpr pid_t k_tid = k_pid + 1;
+  const PerfClock::time_point t0{std::chrono::seconds{10}};
+  const auto exit_time = t0 + std::chrono::seconds{1};
+  Process &p = process_hdr.get(k_pid);
+  p.set_thread_name(k_tid, "worker", t0);
+  process_hdr.flag_thread_exited(k_pid, k_tid, exit_time);
+  // thread id reused by a new thread
+  p.set_thread_name(k_tid, "reused", exit_time + std::chrono::seconds{1});
+
+  // samples in flight still get the name of the exited thread
+  process_hdr.erase_exited_thread_names(exit_time);
+  EXPECT_EQ(p.get_or_insert_thread_name(k_tid, exit_time), "worker");
+
+  process_hdr.erase_exited_thread_names(exit_time +
+                                        ProcessHdr::k_exit_grace_window);
+  EXPECT_EQ(process_hdr.exited_count(), 0);
+  EXPECT_EQ(p.get_or_insert_thread_name(k_tid, exit_time), "reused");
+  EXPECT_EQ(p.get_or_insert_thread_name(k_tid), "reused");
+}
+
+TEST(DDProfProcess, cancel_exit) {
+  ProcessHdr process_hdr{};
+  const PerfClock::time_point t0{std::chrono::seconds{1}};
+  // pid reuse before the end of the grace window
+  process_hdr.flag_exited(42, t0);
+  process_hdr.cancel_exit(42);
+  auto const exited = process_hdr.take_exited(PerfClock::time_point::max());
+  EXPECT_EQ(std::count(exited.begin(), exited.end(), 42), 0);
+  EXPECT_EQ(process_hdr.exited_count(), 0);
+}
+
 } // namespace ddprof
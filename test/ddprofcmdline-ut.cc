@@ -347,4 +347,21 @@ TEST(CmdLineTst, MultipleEvents) {
   ASSERT_TRUE(watchers_from_str(str, watchers));
   ASSERT_EQ(watchers.size(), 2);
 }
+
+TEST(CmdLineTst, CountOnlyEvent) {
+  PerfWatcher watcher = {};
+  ASSERT_TRUE(watcher_from_str("sPF count_only=1", &watcher));
+  EXPECT_TRUE(watcher.options.count_only);
+  EXPECT_FALSE(watcher.sample_type & PERF_SAMPLE_STACK_USER);
+  EXPECT_FALSE(watcher.sample_type & PERF_SAMPLE_REGS_USER);
+  EXPECT_EQ(watcher.options.stack_sample_size, 0);
+
+  ASSERT_TRUE(watcher_from_str("sPF c=0", &watcher));
+  EXPECT_FALSE(watcher.options.count_only);
+  EXPECT_TRUE(watcher.sample_type & PERF_SAMPLE_STACK_USER);
+
+  // allocations are tracked with their stacks
+  EXPECT_FALSE(watcher_from_str("sALLOC c=1", &watcher));
+  EXPECT_FALSE(watcher_from_str("sPF c=1 mode=l", &watcher));
+}
 } // namespace ddprof
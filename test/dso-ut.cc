@@ -6,10 +6,14 @@
 #include "dso_hdr.hpp"
 
 #include <gtest/gtest.h>
+#include <libelf.h>
+#include <limits>
 #include <pthread.h>
 #include <string>
 #include <sys/mman.h>
+#include <vector>
 
+#include "ddprof_module_lib.hpp"
 #include "defer.hpp"
 #include "loghandle.hpp"
 #include "perf_clock.hpp"
@@ -454,6 +458,72 @@ TEST(DSOTest, exe_name) {
   LG_NTC("%s", exe_name.c_str());
 }
 
+TEST(DSOTest, build_id_identity) {
+  LogHandle handle;
+  pid_t const my_pid = getpid();
+  DsoHdr dso_hdr;
+  std::string exe_name;
+  ASSERT_TRUE(dso_hdr.find_exe_name(my_pid, exe_name));
+  const unsigned char build_id[] = {0xde, 0xad, 0xbe, 0xef};
+  const unsigned char other_build_id[] = {0xca, 0xfe};
+
+  Dso dso{my_pid, 0x1000, 0x1fff, 0, std::string(exe_name), 0, PROT_EXEC};
+  dso.set_build_id(build_id);
+  FileInfoId_t const id = dso_hdr.get_or_insert_file_info(dso);
+  ASSERT_GT(id, k_file_info_error);
+  EXPECT_EQ(dso_hdr.get_file_info_value(id).get_build_id(), "deadbeef");
+
+  // same binary at a path that can not be accessed: no file access needed
+  Dso moved{my_pid, 0x1000, 0x1fff, 0, "/nonexistent/bin", 0, PROT_EXEC};
+  moved.set_build_id(build_id);
+  EXPECT_EQ(dso_hdr.get_or_insert_file_info(moved), id);
+
+  Dso other{my_pid, 0x1000, 0x1fff, 0, "/nonexistent/bin", 0, PROT_EXEC};
+  other.set_build_id(other_build_id);
+  EXPECT_EQ(dso_hdr.get_or_insert_file_info(other), k_file_info_error);
+
+  EXPECT_FALSE(moved.is_same_identity(other));
+  // a binary with an unknown build id at the same path might be another one
+  Dso same_path{my_pid, 0x1000, 0x1fff, 0, "/nonexistent/bin", 42,
+                PROT_EXEC};
+  EXPECT_FALSE(moved.is_same_identity(same_path));
+  EXPECT_FALSE(moved.is_same_file(same_path));
+}
+
+TEST(DSOTest, build_id_exited_process) {
+  LogHandle handle;
+  elf_version(EV_CURRENT);
+  DsoHdr dso_hdr;
+  std::string exe_name;
+  ASSERT_TRUE(dso_hdr.find_exe_name(getpid(), exe_name));
+  auto build_id_str = find_build_id(exe_name.c_str());
+  if (!build_id_str) {
+    GTEST_SKIP() << "No build id in " << exe_name;
+  }
+  std::vector<unsigned char> build_id;
+  for (size_t i = 0; i + 1 < build_id_str->size(); i += 2) {
+    build_id.push_back(
+        static_cast<unsigned char>(std::stoi(build_id_str->substr(i, 2),
+                                             nullptr, 16)));
+  }
+
+  // no /proc/<pid>/root: the file is found in the profiler mount namespace
+  constexpr pid_t k_exited_pid = std::numeric_limits<pid_t>::max();
+  Dso dso{k_exited_pid, 0x1000, 0x1fff, 0, std::string(exe_name), 0,
+          PROT_EXEC};
+  dso.set_build_id(build_id);
+  FileInfoId_t const id = dso_hdr.get_or_insert_file_info(dso);
+  ASSERT_GT(id, k_file_info_error);
+  EXPECT_EQ(dso_hdr.get_file_info_value(id).get_build_id(), *build_id_str);
+
+  // a different binary at the same path is not used
+  build_id.back() ^= 1;
+  Dso other{k_exited_pid, 0x1000, 0x1fff, 0, std::string(exe_name), 0,
+            PROT_EXEC};
+  other.set_build_id(build_id);
+  EXPECT_EQ(dso_hdr.get_or_insert_file_info(other), k_file_info_error);
+}
+
 TEST(DSOTest, user_change) {
   if (!is_root()) {
     return;
@@ -0,0 +1,71 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include "event_counts.hpp"
+
+#include <gtest/gtest.h>
+
+namespace ddprof {
+
+TEST(EventCountsTest, aggregate) {
+  EventCounts event_counts;
+  for (int i = 0; i < 1000; ++i) {
+    event_counts.add({0, 10, 11, 0}, 2, 1);
+  }
+  event_counts.add({0, 10, 12, 0}, 1, 1);
+  event_counts.add({1, 10, 11, 0}, 1, 1);
+  event_counts.add({1, 10, 11, 42}, 5, 5);
+
+  const EventCounts::CountMap &counts = event_counts.counts();
+  EXPECT_EQ(counts.size(), 4);
+  const auto it = counts.find({0, 10, 11, 0});
+  ASSERT_NE(it, counts.end());
+  EXPECT_EQ(it->second.value, 2000);
+  EXPECT_EQ(it->second.count, 1000);
+  EXPECT_EQ(counts.at({1, 10, 11, 42}).count, 5);
+
+  event_counts.clear();
+  EXPECT_TRUE(event_counts.counts().empty());
+}
+
+TEST(EventCountsTest, raw_symbols) {
+  EventCounts event_counts;
+  SymbolTable symbol_table;
+  SymbolIdx_t const idx =
+      event_counts.get_or_insert_raw_symbol(0, "sys_enter", 231, symbol_table);
+  EXPECT_EQ(symbol_table[idx]._symname, "[sys_enter 231]");
+  EXPECT_EQ(
+      event_counts.get_or_insert_raw_symbol(0, "sys_enter", 231, symbol_table),
+      idx);
+  EXPECT_NE(
+      event_counts.get_or_insert_raw_symbol(1, "sys_enter", 231, symbol_table),
+      idx);
+  EXPECT_EQ(symbol_table.size(), 2);
+}
+
+TEST(EventCountsTest, raw_symbols_are_capped) {
+  EventCounts event_counts;
+  SymbolTable symbol_table;
+  for (uint64_t i = 0; i < EventCounts::k_max_raw_symbols; ++i) {
+    event_counts.get_or_insert_raw_symbol(0, "sys_enter", i, symbol_table);
+  }
+  EXPECT_EQ(symbol_table.size(), EventCounts::k_max_raw_symbols);
+  SymbolIdx_t const other_idx = event_counts.get_or_insert_raw_symbol(
+      0, "sys_enter", EventCounts::k_max_raw_symbols, symbol_table);
+  EXPECT_EQ(symbol_table[other_idx]._symname, "[sys_enter other]");
+  EXPECT_EQ(event_counts.get_or_insert_raw_symbol(
+                0, "sys_enter", EventCounts::k_max_raw_symbols + 1,
+                symbol_table),
+            other_idx);
+  // values seen before the cap keep their frame
+  EXPECT_EQ(
+      symbol_table[event_counts.get_or_insert_raw_symbol(0, "sys_enter", 7,
+                                                         symbol_table)]
+          ._symname,
+      "[sys_enter 7]");
+  EXPECT_EQ(symbol_table.size(), EventCounts::k_max_raw_symbols + 1);
+}
+
+} // namespace ddprof
@@ -0,0 +1,124 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include "go_pclntab.hpp"
+#include "go_symbol_lookup.hpp"
+
+#include "loghandle.hpp"
+
+#include <gtest/gtest.h>
+#include <libelf.h>
+
+namespace ddprof {
+
+namespace {
+// go_exe is built from go_exe.go (go 1.21, amd64):
+//   CGO_ENABLED=0 go build -trimpath -ldflags="-s -w"
+// Addresses are taken from `go tool nm` on the same build without -s -w.
+constexpr ElfAddress_t k_leaf_addr = 0x47ae20;
+constexpr ElfAddress_t k_main_addr = 0x47aec0;
+// code of fmt.Println inlined in main.main
+constexpr ElfAddress_t k_main_inlined_addr = k_main_addr + 0x40;
+constexpr ElfAddress_t k_goexit_addr = 0x45c7e0;
+
+FileInfoValue file_info(const char *path, FileInfoId_t id) {
+  return {FileInfo(path, 0, 0), id};
+}
+} // namespace
+
+TEST(GoPclntab, symbols) {
+  LogHandle handle;
+  elf_version(EV_CURRENT);
+  GoSymbolLookup lookup;
+  SymbolTable symbol_table;
+  FileInfoValue const go_exe = file_info(UNIT_TEST_DATA "/go_exe", 1);
+
+  SymbolIdx_t const leaf_idx =
+      lookup.get_or_insert(go_exe, k_leaf_addr + 0x20, symbol_table);
+  ASSERT_NE(leaf_idx, k_symbol_idx_null);
+  EXPECT_EQ(symbol_table[leaf_idx]._symname, "main.leaf");
+  EXPECT_EQ(symbol_table[leaf_idx]._srcpath, "go_exe/main.go");
+  EXPECT_EQ(symbol_table[leaf_idx]._lineno, 7);
+  // cached
+  EXPECT_EQ(lookup.get_or_insert(go_exe, k_leaf_addr + 0x20, symbol_table),
+            leaf_idx);
+
+  SymbolIdx_t const main_idx =
+      lookup.get_or_insert(go_exe, k_main_addr + 0x20, symbol_table);
+  ASSERT_NE(main_idx, k_symbol_idx_null);
+  EXPECT_EQ(symbol_table[main_idx]._symname, "main.main");
+  EXPECT_EQ(symbol_table[main_idx]._lineno, 15);
+  EXPECT_EQ(symbol_table.size(), 2);
+
+  // fmt.Println inlined in main.main is left to the generic symbolizer
+  EXPECT_EQ(lookup.get_or_insert(go_exe, k_main_inlined_addr, symbol_table),
+            k_symbol_idx_null);
+  EXPECT_EQ(symbol_table.size(), 2);
+
+  // outside of go functions
+  EXPECT_EQ(lookup.get_or_insert(go_exe, 0x1000, symbol_table),
+            k_symbol_idx_null);
+
+  // unused files are closed, cached symbols remain
+  lookup.cycle();
+  lookup.cycle();
+  EXPECT_EQ(lookup.get_or_insert(go_exe, k_leaf_addr + 0x20, symbol_table),
+            leaf_idx);
+  EXPECT_EQ(lookup.get_or_insert(go_exe, k_main_addr + 0x10, symbol_table),
+            main_idx + 1);
+  // no process maps the file anymore
+  lookup.release(go_exe.get_id());
+  EXPECT_EQ(lookup.get_or_insert(go_exe, k_main_addr + 0x10, symbol_table),
+            main_idx + 1);
+  EXPECT_TRUE(lookup.find_pclntab(go_exe));
+
+  // not go binaries, or without function table
+  EXPECT_FALSE(lookup.find_pclntab(file_info(UNIT_TEST_DATA "/gnu_exe", 2)));
+  EXPECT_FALSE(
+      lookup.find_pclntab(file_info(UNIT_TEST_DATA "/go_exe.debug", 3)));
+  EXPECT_FALSE(lookup.find_pclntab(file_info("/nonexistent/go_exe", 4)));
+}
+
+TEST(GoPclntab, frames) {
+  LogHandle handle;
+  elf_version(EV_CURRENT);
+  GoSymbolLookup lookup;
+  const GoPclntab *pclntab =
+      lookup.find_pclntab(file_info(UNIT_TEST_DATA "/go_exe", 1));
+  ASSERT_TRUE(pclntab);
+  EXPECT_GT(pclntab->nb_functions(), 1000);
+
+  // entry: nothing pushed yet
+  std::optional<GoPclntab::Frame> frame = pclntab->find_frame(k_leaf_addr);
+  ASSERT_TRUE(frame);
+  EXPECT_EQ(frame->start, k_leaf_addr);
+  EXPECT_EQ(frame->sp_delta, 0);
+  EXPECT_FALSE(frame->top_frame);
+
+  // after push %rbp / sub $0x210,%rsp
+  frame = pclntab->find_frame(k_leaf_addr + 0x20);
+  ASSERT_TRUE(frame);
+  EXPECT_EQ(frame->sp_delta, 0x218);
+  EXPECT_LE(frame->start, k_leaf_addr + 0x20);
+  EXPECT_GT(frame->end, k_leaf_addr + 0x20);
+
+  frame = pclntab->find_frame(k_goexit_addr);
+  ASSERT_TRUE(frame);
+  EXPECT_TRUE(frame->top_frame);
+
+  std::optional<GoPclntab::Location> location =
+      pclntab->find_location(k_goexit_addr);
+  ASSERT_TRUE(location);
+  EXPECT_EQ(location->function, "runtime.goexit");
+  EXPECT_FALSE(location->inlined);
+
+  location = pclntab->find_location(k_main_inlined_addr);
+  ASSERT_TRUE(location);
+  EXPECT_EQ(location->function, "main.main");
+  EXPECT_EQ(location->file, "fmt/print.go");
+  EXPECT_TRUE(location->inlined);
+}
+
+} // namespace ddprof
@@ -8,8 +8,13 @@
 #include "syscalls.hpp"
 #include "unique_fd.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstdlib>
 #include <fcntl.h>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <sys/eventfd.h>
 #include <sys/socket.h>
@@ -165,4 +170,120 @@ TEST(IPCTest, worker_server) {
   }
 }
 
+TEST(IPCTest, live_address_snapshot) {
+  constexpr auto kSocketName = "@live_address_snapshot";
+  auto server_socket = create_server_socket(kSocketName);
+  ReplyMessage msg;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::optional<LiveAddressSnapshot> received;
+  auto server = start_worker_server(
+      server_socket.get(), msg, [&](LiveAddressSnapshot &&snapshot) {
+        std::lock_guard const lock{mutex};
+        received = std::move(snapshot);
+        cv.notify_one();
+      });
+
+  // more than one chunk, in reverse order
+  constexpr size_t kNbAddresses = (2 * LiveAddressChunk::k_max_addresses) + 3;
+  {
+    UnixSocket const socket{create_client_socket(kSocketName)};
+    ASSERT_TRUE(IsDDResOK(send(
+        socket, RequestMessage{.request = RequestMessage::kLiveAddressSnapshot,
+                               .pid = 1234})));
+    LiveAddressChunk chunk;
+    chunk.timestamp = 42;
+    for (size_t i = kNbAddresses; i > 0; --i) {
+      chunk.addresses[chunk.nb_addresses++] = i * 16;
+      if (chunk.nb_addresses == LiveAddressChunk::k_max_addresses) {
+        ASSERT_TRUE(IsDDResOK(send(socket, chunk)));
+        chunk.nb_addresses = 0;
+      }
+    }
+    chunk.last = 1;
+    ASSERT_TRUE(IsDDResOK(send(socket, chunk)));
+  }
+
+  std::unique_lock lock{mutex};
+  ASSERT_TRUE(cv.wait_for(lock, kDefaultSocketTimeout,
+                          [&] { return received.has_value(); }));
+  EXPECT_EQ(received->pid, 1234);
+  EXPECT_EQ(received->timestamp, 42);
+  ASSERT_EQ(received->addresses.size(), kNbAddresses);
+  EXPECT_TRUE(std::is_sorted(received->addresses.begin(),
+                             received->addresses.end()));
+  EXPECT_EQ(received->addresses.front(), 16);
+}
+
+TEST(IPCTest, dedicated_ring_buffer) {
+  constexpr auto kSocketName = "@dedicated_ring_buffer";
+  auto server_socket = create_server_socket(kSocketName);
+  ReplyMessage msg;
+  msg.request = RequestMessage::kProfilerInfo;
+  msg.ring_buffer.mem_size = 4096;
+  msg.ring_buffer.event_fd = eventfd(0, 0);
+  msg.ring_buffer.ring_fd = memfd_create("shared", 0);
+  UniqueFd const dedicated_event_fd{eventfd(0, 0)};
+  UniqueFd const dedicated_ring_fd{memfd_create("dedicated", 0)};
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<uint64_t> released;
+  uint64_t next_id = 1;
+  std::atomic<bool> available = true;
+  auto server = start_worker_server(
+      server_socket.get(), msg, {},
+      {.create =
+           [&](pid_t pid, uint64_t allocation_rate, RingBufferInfo &info) {
+             EXPECT_EQ(pid, getpid());
+             EXPECT_EQ(allocation_rate, 1000);
+             if (!available) {
+               return uint64_t{0};
+             }
+             info.mem_size = 8192;
+             info.event_fd = dedicated_event_fd.get();
+             info.ring_fd = dedicated_ring_fd.get();
+             return next_id++;
+           },
+       .release =
+           [&](uint64_t id) {
+             std::lock_guard const lock{mutex};
+             released.push_back(id);
+             cv.notify_one();
+           }});
+
+  {
+    UniqueFd client_socket = create_client_socket(kSocketName);
+    ReplyMessage info;
+    ASSERT_TRUE(IsDDResOK(get_profiler_info_dedicated(
+        client_socket, kDefaultSocketTimeout, 1000, &info)));
+    UniqueFd const ring_fd{info.ring_buffer.ring_fd};
+    UniqueFd const event_fd{info.ring_buffer.event_fd};
+    EXPECT_TRUE(info.request & RequestMessage::kDedicatedRingBuffer);
+    EXPECT_EQ(info.ring_buffer.mem_size, 8192);
+    // connection is kept open by the server
+    std::this_thread::sleep_for(10ms);
+    std::lock_guard const lock{mutex};
+    EXPECT_TRUE(released.empty());
+  }
+  {
+    // closing the connection releases the ring buffer
+    std::unique_lock lock{mutex};
+    ASSERT_TRUE(cv.wait_for(lock, kDefaultSocketTimeout,
+                            [&] { return !released.empty(); }));
+    EXPECT_EQ(released, std::vector<uint64_t>{1});
+    available = false;
+  }
+
+  // fall back to the shared ring buffer
+  UniqueFd client_socket = create_client_socket(kSocketName);
+  ReplyMessage info;
+  ASSERT_TRUE(IsDDResOK(get_profiler_info_dedicated(
+      client_socket, kDefaultSocketTimeout, 1000, &info)));
+  UniqueFd const ring_fd{info.ring_buffer.ring_fd};
+  UniqueFd const event_fd{info.ring_buffer.event_fd};
+  EXPECT_FALSE(info.request & RequestMessage::kDedicatedRingBuffer);
+  EXPECT_EQ(info.ring_buffer.mem_size, 4096);
+}
+
 } // namespace ddprof
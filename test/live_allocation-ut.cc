@@ -125,6 +125,52 @@ TEST(LiveAllocationTest, overlap_registrations) {
   EXPECT_EQ(pid_stacks._unique_stacks.size(), 0);
 }
 
+TEST(LiveAllocationTest, reconcile) {
+  LogHandle handle;
+  UnwindOutput uo;
+  uo.locs.push_back({0x1234, 0x5678, 0x9abc});
+  LiveAllocation live_alloc;
+  int watcher_pos = 0;
+  pid_t pid = 12;
+  auto t0 = PerfClock::time_point{std::chrono::seconds{10}};
+  for (uintptr_t addr = 0x10; addr <= 0x50; addr += 0x10) {
+    live_alloc.register_allocation(uo, addr, 10, watcher_pos, pid, t0);
+  }
+  // registered after the start of the snapshot
+  live_alloc.register_allocation(uo, 0x60, 10, watcher_pos, pid,
+                                 t0 + std::chrono::seconds{2});
+
+  // deallocations of 0x20 and 0x40 were lost
+  std::vector<uintptr_t> const snapshot{0x10, 0x30, 0x50};
+  EXPECT_EQ(live_alloc.reconcile(watcher_pos, pid, snapshot,
+                                 t0 + std::chrono::seconds{1}),
+            2);
+  auto &pid_stacks = live_alloc._watcher_vector[watcher_pos][pid];
+  EXPECT_EQ(pid_stacks._address_map.size(), 4);
+  EXPECT_FALSE(pid_stacks._address_map.contains(0x20));
+  EXPECT_TRUE(pid_stacks._address_map.contains(0x60));
+  EXPECT_EQ(pid_stacks._unique_stacks[uo]._value, 40);
+  EXPECT_EQ(pid_stacks._unique_stacks[uo]._count, 4);
+  EXPECT_EQ(live_alloc.get_nb_reconciled_allocations(), 2);
+  // unknown pid
+  EXPECT_EQ(live_alloc.reconcile(watcher_pos, pid + 1, snapshot, t0), 0);
+}
+
+TEST(LiveAllocationTest, stale_deallocation) {
+  LogHandle handle;
+  UnwindOutput uo;
+  uo.locs.push_back({0x1234, 0x5678, 0x9abc});
+  LiveAllocation live_alloc;
+  auto t0 = PerfClock::time_point{std::chrono::seconds{10}};
+  live_alloc.register_allocation(uo, 0x10, 10, 0, 1, t0);
+  // deallocation replayed after the address was reused
+  live_alloc.register_deallocation(0x10, 0, 1, t0 - std::chrono::seconds{1});
+  EXPECT_EQ(live_alloc._watcher_vector[0][1]._address_map.size(), 1);
+  live_alloc.register_deallocation(0x10, 0, 1, t0 + std::chrono::seconds{1});
+  EXPECT_EQ(live_alloc._watcher_vector[0][1]._address_map.size(), 0);
+  EXPECT_EQ(live_alloc.get_nb_unmatched_deallocations(), 1);
+}
+
 TEST(LiveAllocationTest, stats) {
   LogHandle handle;
   LiveAllocation live_alloc;
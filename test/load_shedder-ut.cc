@@ -0,0 +1,80 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include <gtest/gtest.h>
+
+#include "load_shedder.hpp"
+
+namespace ddprof {
+
+namespace {
+constexpr uint64_t kDeterministicSeed = 42;
+} // namespace
+
+TEST(load_shedder, no_pressure) {
+  LoadShedder shedder{kDeterministicSeed};
+  shedder.update(0.2, PerfClock::time_point{});
+  EXPECT_EQ(shedder.keep_shift(), 0);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(shedder.sample_weight(PerfClock::time_point{}), 1);
+  }
+}
+
+TEST(load_shedder, fill_pressure) {
+  LoadShedder shedder{kDeterministicSeed};
+  for (int i = 0; i < 2 * LoadShedder::k_max_keep_shift; ++i) {
+    shedder.update(0.9, PerfClock::time_point{});
+  }
+  EXPECT_EQ(shedder.keep_shift(), LoadShedder::k_max_keep_shift);
+
+  // intermediate fill level keeps current state
+  shedder.update(0.3, PerfClock::time_point{});
+  EXPECT_EQ(shedder.keep_shift(), LoadShedder::k_max_keep_shift);
+
+  for (int i = 0; i < LoadShedder::k_max_keep_shift; ++i) {
+    shedder.update(0.0, PerfClock::time_point{});
+  }
+  EXPECT_EQ(shedder.keep_shift(), 0);
+}
+
+TEST(load_shedder, age_pressure) {
+  LoadShedder shedder{kDeterministicSeed};
+  auto now = PerfClock::time_point{std::chrono::seconds{10}};
+  shedder.update(0.0, now);
+  EXPECT_EQ(shedder.sample_weight(now - std::chrono::seconds{1}), 1);
+  shedder.update(0.0, now);
+  EXPECT_EQ(shedder.keep_shift(), 1);
+
+  // recent events release pressure
+  shedder.sample_weight(now - std::chrono::milliseconds{1});
+  shedder.update(0.0, now);
+  EXPECT_EQ(shedder.keep_shift(), 0);
+}
+
+TEST(load_shedder, unbiased_weights) {
+  LoadShedder shedder{kDeterministicSeed};
+  shedder.update(0.9, PerfClock::time_point{});
+  shedder.update(0.9, PerfClock::time_point{});
+  shedder.update(0.9, PerfClock::time_point{});
+  ASSERT_EQ(shedder.keep_shift(), 3);
+
+  constexpr uint64_t kNbSamples = 100000;
+  uint64_t total_weight = 0;
+  uint64_t nb_kept = 0;
+  for (uint64_t i = 0; i < kNbSamples; ++i) {
+    uint32_t const weight = shedder.sample_weight(PerfClock::time_point{});
+    if (weight) {
+      EXPECT_EQ(weight, 8);
+      ++nb_kept;
+    }
+    total_weight += weight;
+  }
+  EXPECT_NEAR(static_cast<double>(nb_kept), kNbSamples / 8.0,
+              kNbSamples / 100.0);
+  EXPECT_NEAR(static_cast<double>(total_weight), kNbSamples,
+              kNbSamples / 20.0);
+}
+
+} // namespace ddprof
@@ -1,6 +1,12 @@
 #include "loghandle.hpp"
 
+#include <cstdlib>
+#include <fstream>
 #include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 static int call_counter = 0;
 
@@ -17,4 +23,113 @@ TEST(RegionHolder, Simple) {
   LG_ERR("Print the foo: %s", func_incr());
   EXPECT_EQ(call_counter, 1);
 }
+
+namespace {
+std::vector<std::string> read_lines(const char *path) {
+  std::ifstream file(path);
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(file, line);) {
+    lines.push_back(std::move(line));
+  }
+  return lines;
+}
+
+bool ends_with(std::string_view str, std::string_view suffix) {
+  return str.size() >= suffix.size() &&
+      str.substr(str.size() - suffix.size()) == suffix;
+}
+} // namespace
+
+TEST(Logger, async_coalesce) {
+  char path[] = "/tmp/logger-ut-XXXXXX";
+  int const fd = mkstemp(path);
+  ASSERT_NE(fd, -1);
+  close(fd);
+  ASSERT_TRUE(LOG_open(LOG_FILE, path));
+  LOG_setlevel(LL_NOTICE);
+  ASSERT_TRUE(LOG_set_async(true));
+  for (int i = 0; i < 10; ++i) {
+    LG_NTC("same message");
+  }
+  LG_NTC("other message");
+  LOG_close(); // flushes messages
+
+  int nb_same = 0;
+  int nb_other = 0;
+  int nb_repeats = 0;
+  for (const auto &line : read_lines(path)) {
+    if (ends_with(line, "same message")) {
+      ++nb_same;
+    } else if (ends_with(line, "other message")) {
+      ++nb_other;
+      // messages of a thread keep their order
+      EXPECT_EQ(nb_same + nb_repeats, 10);
+    } else if (auto pos = line.find("last message repeated ");
+               pos != std::string::npos) {
+      nb_repeats += std::stoi(line.substr(pos + 22));
+    }
+  }
+  EXPECT_GE(nb_same, 1);
+  EXPECT_EQ(nb_same + nb_repeats, 10);
+  EXPECT_EQ(nb_other, 1);
+  unlink(path);
+}
+
+TEST(Logger, async_threads) {
+  char path[] = "/tmp/logger-ut-XXXXXX";
+  int const fd = mkstemp(path);
+  ASSERT_NE(fd, -1);
+  close(fd);
+  ASSERT_TRUE(LOG_open(LOG_FILE, path));
+  LOG_setlevel(LL_NOTICE);
+  ASSERT_TRUE(LOG_set_async(true));
+  constexpr int k_nb_threads = 8;
+  constexpr int k_nb_messages = 2000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < k_nb_threads; ++t) {
+    threads.emplace_back([t] {
+      for (int i = 0; i < k_nb_messages; ++i) {
+        LG_NTC("thread %d message %d", t, i);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  LOG_close();
+  // full rings fall back to synchronous writes: nothing is lost
+  EXPECT_EQ(read_lines(path).size(), k_nb_threads * k_nb_messages);
+  unlink(path);
+}
+
+TEST(Logger, async_drop_when_full) {
+  char path[] = "/tmp/logger-ut-XXXXXX";
+  int const fd = mkstemp(path);
+  ASSERT_NE(fd, -1);
+  close(fd);
+  ASSERT_TRUE(LOG_open(LOG_FILE, path));
+  LOG_setlevel(LL_NOTICE);
+  ASSERT_TRUE(LOG_set_async(true, true));
+  // more than a ring holds before the flusher wakes up
+  constexpr int k_nb_messages = 5000;
+  for (int i = 0; i < k_nb_messages; ++i) {
+    LG_NTC("message %d", i);
+  }
+  LOG_close();
+  constexpr std::string_view k_dropped = " log messages were dropped";
+  int nb_written = 0;
+  int nb_dropped = 0;
+  for (const auto &line : read_lines(path)) {
+    if (ends_with(line, k_dropped)) {
+      std::string const count = line.substr(0, line.size() - k_dropped.size());
+      nb_dropped += std::stoi(count.substr(count.rfind(' ') + 1));
+    } else {
+      ++nb_written;
+    }
+  }
+  EXPECT_GT(nb_dropped, 0);
+  EXPECT_EQ(nb_written + nb_dropped, k_nb_messages);
+  unlink(path);
+}
+
 } // namespace ddprof
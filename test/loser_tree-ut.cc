@@ -0,0 +1,112 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "loser_tree.hpp"
+
+namespace ddprof {
+
+namespace {
+constexpr uint32_t kDeterministicSeed = 42;
+constexpr uint64_t kSentinel = std::numeric_limits<uint64_t>::max();
+
+// Merge sorted sources, returning (key, source) pairs in merge order
+std::vector<std::pair<uint64_t, size_t>>
+merge(const std::vector<std::vector<uint64_t>> &sources) {
+  LoserTree<uint64_t> tree(sources.size(), kSentinel);
+  std::vector<size_t> pos(sources.size(), 0);
+  for (size_t i = 0; i < sources.size(); ++i) {
+    if (!sources[i].empty()) {
+      tree.set_key(i, sources[i][0]);
+    }
+  }
+  tree.rebuild();
+
+  std::vector<std::pair<uint64_t, size_t>> res;
+  while (tree.top_key() != kSentinel) {
+    size_t const src = tree.top();
+    res.emplace_back(tree.top_key(), src);
+    ++pos[src];
+    tree.update_top(pos[src] < sources[src].size() ? sources[src][pos[src]]
+                                                   : kSentinel);
+  }
+  return res;
+}
+} // namespace
+
+TEST(loser_tree, empty) {
+  LoserTree<uint64_t> tree(3, kSentinel);
+  EXPECT_EQ(tree.top_key(), kSentinel);
+  EXPECT_EQ(tree.size(), 3);
+}
+
+TEST(loser_tree, single_source) {
+  auto res = merge({{1, 2, 2, 5}});
+  ASSERT_EQ(res.size(), 4);
+  EXPECT_EQ(res[0].first, 1);
+  EXPECT_EQ(res[3].first, 5);
+}
+
+TEST(loser_tree, ties_ordered_by_source) {
+  auto res = merge({{3, 3}, {1, 3}, {3}});
+  std::vector<std::pair<uint64_t, size_t>> expected = {
+      {1, 1}, {3, 0}, {3, 0}, {3, 1}, {3, 2}};
+  EXPECT_EQ(res, expected);
+}
+
+TEST(loser_tree, refill_exhausted_source) {
+  LoserTree<uint64_t> tree(5, kSentinel);
+  tree.set_key(2, 10);
+  tree.rebuild();
+  EXPECT_EQ(tree.top(), 2);
+  tree.update_top(kSentinel);
+  EXPECT_EQ(tree.top_key(), kSentinel);
+
+  // sources receive new heads
+  tree.set_key(4, 7);
+  tree.set_key(0, 8);
+  tree.rebuild();
+  EXPECT_EQ(tree.top(), 4);
+  tree.update_top(9);
+  EXPECT_EQ(tree.top(), 0);
+  tree.update_top(kSentinel);
+  EXPECT_EQ(tree.top(), 4);
+  EXPECT_EQ(tree.top_key(), 9);
+}
+
+TEST(loser_tree, random_merge) {
+  std::mt19937 gen(kDeterministicSeed);
+  for (size_t nb_sources : {1, 2, 3, 7, 64, 450}) {
+    std::uniform_int_distribution<uint64_t> key_dis(0, 1000);
+    std::uniform_int_distribution<size_t> len_dis(0, 50);
+    std::vector<std::vector<uint64_t>> sources(nb_sources);
+    std::vector<uint64_t> all_keys;
+    for (auto &src : sources) {
+      src.resize(len_dis(gen));
+      std::generate(src.begin(), src.end(), [&] { return key_dis(gen); });
+      std::sort(src.begin(), src.end());
+      all_keys.insert(all_keys.end(), src.begin(), src.end());
+    }
+    std::sort(all_keys.begin(), all_keys.end());
+
+    auto res = merge(sources);
+    ASSERT_EQ(res.size(), all_keys.size());
+    for (size_t i = 0; i < res.size(); ++i) {
+      EXPECT_EQ(res[i].first, all_keys[i]);
+      if (i > 0 && res[i].first == res[i - 1].first) {
+        EXPECT_LE(res[i - 1].second, res[i].second);
+      }
+    }
+  }
+}
+
+} // namespace ddprof
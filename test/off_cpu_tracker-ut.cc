@@ -0,0 +1,122 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include "off_cpu_tracker.hpp"
+
+#include "loser_tree.hpp"
+
+#include <gtest/gtest.h>
+#include <limits>
+#include <vector>
+
+namespace ddprof {
+
+namespace {
+UnwindOutput make_output(pid_t pid, pid_t tid, ProcessAddress_t ip) {
+  UnwindOutput uo;
+  uo.pid = pid;
+  uo.tid = tid;
+  uo.locs.push_back({ip, ip, 1});
+  return uo;
+}
+
+PerfClock::time_point at(int64_t ns) {
+  return perf_clock_time_point_from_timestamp(ns);
+}
+
+struct SwitchEvent {
+  int64_t time;
+  bool out;
+};
+
+// Feeds the switches of thread 11 recorded in per-CPU buffers, merged by
+// timestamp as done by the worker
+std::vector<OffCpuTracker::OffCpuSample>
+replay_merged(OffCpuTracker &tracker,
+              const std::vector<std::vector<SwitchEvent>> &cpus) {
+  constexpr int64_t k_sentinel = std::numeric_limits<int64_t>::max();
+  LoserTree<int64_t> tree(cpus.size(), k_sentinel);
+  std::vector<size_t> pos(cpus.size(), 0);
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    tree.set_key(i, cpus[i].empty() ? k_sentinel : cpus[i][0].time);
+  }
+  tree.rebuild();
+
+  std::vector<OffCpuTracker::OffCpuSample> samples;
+  while (tree.top_key() != k_sentinel) {
+    size_t const cpu = tree.top();
+    const SwitchEvent &event = cpus[cpu][pos[cpu]++];
+    if (event.out) {
+      tracker.switch_out(make_output(10, 11, 0x1), at(event.time), 1);
+    } else if (auto sample = tracker.switch_in(11, at(event.time));
+               sample.output) {
+      samples.push_back(sample);
+    }
+    tree.update_top(pos[cpu] < cpus[cpu].size() ? cpus[cpu][pos[cpu]].time
+                                                : k_sentinel);
+  }
+  return samples;
+}
+} // namespace
+
+TEST(OffCpuTrackerTest, switch_in_after_switch_out) {
+  OffCpuTracker tracker;
+  // switch in without a sampled switch out
+  EXPECT_EQ(tracker.switch_in(11, at(100)).output, nullptr);
+
+  tracker.switch_out(make_output(10, 11, 0x1234), at(1000), 3);
+  OffCpuTracker::OffCpuSample const sample = tracker.switch_in(11, at(1500));
+  ASSERT_NE(sample.output, nullptr);
+  EXPECT_EQ(sample.output->locs[0].ip, 0x1234);
+  EXPECT_EQ(sample.off_cpu_time, std::chrono::nanoseconds(500));
+  EXPECT_EQ(sample.scale, 3);
+
+  // interval was consumed
+  EXPECT_EQ(tracker.switch_in(11, at(2000)).output, nullptr);
+  EXPECT_EQ(tracker.size(), 1);
+
+  // latest switch out wins
+  tracker.switch_out(make_output(10, 11, 0x1), at(3000), 1);
+  tracker.switch_out(make_output(10, 11, 0x2), at(4000), 1);
+  OffCpuTracker::OffCpuSample const last = tracker.switch_in(11, at(4100));
+  ASSERT_NE(last.output, nullptr);
+  EXPECT_EQ(last.output->locs[0].ip, 0x2);
+  EXPECT_EQ(last.off_cpu_time, std::chrono::nanoseconds(100));
+
+  // out of order switch in
+  tracker.switch_out(make_output(10, 11, 0x1), at(5000), 1);
+  EXPECT_EQ(tracker.switch_in(11, at(4900)).output, nullptr);
+}
+
+TEST(OffCpuTrackerTest, thread_migrating_across_cpus) {
+  // thread 11 is switched out on CPU 0 and back in on CPU 1, then switched
+  // out on CPU 1 and back in on CPU 0: every buffer is ordered, but reading
+  // buffers one after the other would pair the switch out at 1000 with the
+  // switch in at 4000
+  std::vector<std::vector<SwitchEvent>> const cpus = {
+      {{1000, true}, {4000, false}}, {{2000, false}, {3000, true}}};
+  OffCpuTracker tracker;
+  std::vector<OffCpuTracker::OffCpuSample> const samples =
+      replay_merged(tracker, cpus);
+  ASSERT_EQ(samples.size(), 2);
+  EXPECT_EQ(samples[0].off_cpu_time, std::chrono::nanoseconds(1000));
+  EXPECT_EQ(samples[1].off_cpu_time, std::chrono::nanoseconds(1000));
+}
+
+TEST(OffCpuTrackerTest, clear) {
+  OffCpuTracker tracker;
+  tracker.switch_out(make_output(10, 11, 0x1), at(1000), 1);
+  tracker.switch_out(make_output(10, 12, 0x1), at(1000), 1);
+  tracker.switch_out(make_output(20, 21, 0x1), at(1000), 1);
+  EXPECT_EQ(tracker.size(), 3);
+  tracker.clear_tid(12);
+  EXPECT_EQ(tracker.size(), 2);
+  tracker.clear_pid(10);
+  EXPECT_EQ(tracker.size(), 1);
+  EXPECT_EQ(tracker.switch_in(11, at(2000)).output, nullptr);
+  EXPECT_NE(tracker.switch_in(21, at(2000)).output, nullptr);
+}
+
+} // namespace ddprof
@@ -5,6 +5,7 @@
 
 #include "perf_archmap.hpp"
 #include "perf_ringbuffer.hpp"
+#include "perf_sample_parser.hpp"
 #include "perf_watcher.hpp" // for default sample type used in ddprof
 
 #include <gtest/gtest.h>
@@ -111,4 +112,65 @@ TEST(PerfRingbufferTest, SampleSymmetryx86) {
   ASSERT_TRUE(sample_eq(&sample, sample_new));
 }
 
+TEST(PerfRingbufferTest, SampleViewMatchesSample) {
+  char default_stack[4096] = {0};
+  for (uint64_t i = 0; i < std::size(default_stack); i++)
+    default_stack[i] = i & 255;
+  char default_raw[12] = {0};
+  for (uint64_t i = 0; i < std::size(default_raw); i++)
+    default_raw[i] = (i + 11) & 255;
+  uint64_t default_regs[k_perf_register_count] = {};
+  for (size_t i = 0; i < k_perf_register_count; ++i) {
+    default_regs[i] = 1ull << i;
+  }
+  struct perf_event_sample sample = {};
+  sample.header.type = PERF_RECORD_SAMPLE;
+  sample.ip = 0x2;
+  sample.pid = 0x3;
+  sample.tid = 0x4;
+  sample.time = 0x5;
+  sample.addr = 0x6;
+  sample.period = 0x7;
+  sample.size_raw = std::size(default_raw);
+  sample.data_raw = default_raw;
+  sample.abi = PERF_SAMPLE_REGS_ABI_64;
+  sample.regs = default_regs;
+  sample.size_stack = 4096;
+  sample.data_stack = default_stack;
+  sample.dyn_size_stack = 2048;
+
+  uint64_t const base = perf_event_default_sample_type();
+  // specialized parsers (sample types in use) and generic parser
+  for (uint64_t mask :
+       {base, base | PERF_SAMPLE_RAW, base | PERF_SAMPLE_ADDR,
+        base | PERF_SAMPLE_IP | PERF_SAMPLE_ADDR | PERF_SAMPLE_RAW}) {
+    char hdr_placeholder[2 * 4096] = {0};
+    auto *hdr = reinterpret_cast<perf_event_header *>(hdr_placeholder);
+    ASSERT_TRUE(samp2hdr(hdr, &sample, sizeof(hdr_placeholder), mask));
+    const perf_event_sample *ref = hdr2samp(hdr, mask);
+    ASSERT_TRUE(ref);
+
+    PerfSampleParser parser = perf_sample_parser_from_type(mask);
+    PerfSampleView view;
+    ASSERT_TRUE(parser(hdr, mask, &view));
+    EXPECT_EQ(view.header(), hdr);
+    EXPECT_EQ(view.ip(), (mask & PERF_SAMPLE_IP) ? ref->ip : 0);
+    EXPECT_EQ(view.pid(), ref->pid);
+    EXPECT_EQ(view.tid(), ref->tid);
+    EXPECT_EQ(view.time(), ref->time);
+    EXPECT_EQ(view.addr(), (mask & PERF_SAMPLE_ADDR) ? ref->addr : 0);
+    EXPECT_EQ(view.period(), ref->period);
+    EXPECT_EQ(view.regs(), ref->regs);
+    EXPECT_EQ(view.size_stack(), ref->size_stack);
+    EXPECT_EQ(view.data_stack(), ref->data_stack);
+    if (mask & PERF_SAMPLE_RAW) {
+      EXPECT_EQ(view.size_raw(), ref->size_raw);
+      EXPECT_EQ(view.data_raw(), ref->data_raw);
+    } else {
+      EXPECT_EQ(view.size_raw(), 0);
+      EXPECT_EQ(view.data_raw(), nullptr);
+    }
+  }
+}
+
 } // namespace ddprof
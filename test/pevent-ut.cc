@@ -9,7 +9,12 @@
 #include "loghandle.hpp"
 #include "perf_watcher.hpp"
 
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
 #include <gtest/gtest.h>
+#include <linux/magic.h>
+#include <sys/statfs.h>
 #include <sys/sysinfo.h>
 #include <unistd.h>
 
@@ -33,4 +38,40 @@ TEST(PeventTest, setup_cleanup) {
   ASSERT_TRUE(IsDDResOK(res));
 }
 
+TEST(PeventTest, setup_cgroup) {
+  LogHandle log_handle;
+  struct statfs fs_info;
+  if (statfs("/sys/fs/cgroup", &fs_info) != 0 ||
+      fs_info.f_type != CGROUP2_SUPER_MAGIC) {
+    GTEST_SKIP() << "cgroup v2 hierarchy is not mounted";
+  }
+  // scratch cgroup, removed at the end of the test
+  std::filesystem::path const cgroup_path{"/sys/fs/cgroup/ddprof-ut-" +
+                                          std::to_string(getpid())};
+  std::error_code ec;
+  if (!std::filesystem::create_directory(cgroup_path, ec)) {
+    GTEST_SKIP() << "unable to create cgroup (" << ec.message() << ")";
+  }
+  int cgroup_fd = open(cgroup_path.c_str(), O_RDONLY | O_DIRECTORY);
+  ASSERT_NE(cgroup_fd, -1);
+
+  PEventHdr pevent_hdr;
+  DDProfContext ctx;
+  ctx.params.cgroup_path = cgroup_path;
+  mock_ddprof_context(&ctx);
+  pevent_init(&pevent_hdr);
+  DDRes res = pevent_setup(ctx, {&cgroup_fd, 1}, get_nprocs(), &pevent_hdr);
+  close(cgroup_fd);
+  if (IsDDResOK(res)) {
+    // a single event per CPU, whatever the number of cgroup members
+    EXPECT_EQ(pevent_hdr.size, static_cast<unsigned>(get_nprocs()));
+    EXPECT_TRUE(pevent_hdr.pes[0].sub_fds.empty());
+    EXPECT_TRUE(IsDDResOK(pevent_cleanup(&pevent_hdr)));
+  }
+  std::filesystem::remove(cgroup_path);
+  if (IsDDResNotOK(res)) {
+    GTEST_SKIP() << "cgroup events are not allowed";
+  }
+}
+
 } // namespace ddprof
@@ -0,0 +1,72 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include "pid_admission.hpp"
+
+#include <gtest/gtest.h>
+
+namespace ddprof {
+
+TEST(PidAdmissionTest, unlimited) {
+  PidAdmission pid_admission(-1);
+  for (pid_t pid = 1; pid < 1000; ++pid) {
+    EXPECT_TRUE(pid_admission.add_sample(pid, 1).admitted);
+  }
+  EXPECT_TRUE(pid_admission.is_admitted(42));
+}
+
+TEST(PidAdmissionTest, evict_least_sampled) {
+  PidAdmission pid_admission(2);
+  for (int i = 0; i < 10; ++i) {
+    pid_admission.add_sample(1, 1);
+  }
+  EXPECT_TRUE(pid_admission.add_sample(2, 1).admitted);
+  EXPECT_EQ(pid_admission.nb_admitted(), 2);
+
+  // a newcomer needs to outweigh the least sampled process
+  PidAdmission::Decision decision = pid_admission.add_sample(3, 1);
+  EXPECT_FALSE(decision.admitted);
+  EXPECT_EQ(decision.evicted, PidAdmission::k_no_pid);
+  pid_admission.add_sample(3, 1);
+  decision = pid_admission.add_sample(3, 1);
+  EXPECT_TRUE(decision.admitted);
+  EXPECT_EQ(decision.evicted, 2);
+  EXPECT_FALSE(pid_admission.is_admitted(2));
+  EXPECT_TRUE(pid_admission.is_admitted(1));
+  EXPECT_EQ(pid_admission.nb_admitted(), 2);
+
+  // exits free a slot
+  pid_admission.remove(1);
+  EXPECT_TRUE(pid_admission.add_sample(2, 1).admitted);
+}
+
+TEST(PidAdmissionTest, decay) {
+  PidAdmission pid_admission(1);
+  pid_admission.add_sample(1, 100);
+  EXPECT_FALSE(pid_admission.add_sample(2, 10).admitted);
+  // samples of previous cycles weigh less
+  for (int i = 0; i < 5; ++i) {
+    pid_admission.cycle();
+  }
+  PidAdmission::Decision const decision = pid_admission.add_sample(2, 10);
+  EXPECT_TRUE(decision.admitted);
+  EXPECT_EQ(decision.evicted, 1);
+}
+
+TEST(PidAdmissionTest, least_recently_sampled) {
+  PidAdmission pid_admission(2);
+  pid_admission.add_sample(1, 1);
+  pid_admission.add_sample(2, 1);
+  pid_admission.add_sample(1, 1);
+  pid_admission.add_sample(2, 1);
+  pid_admission.cycle();
+  pid_admission.cycle();
+  // both admitted processes are idle, the least recently sampled goes first
+  PidAdmission::Decision const decision = pid_admission.add_sample(3, 1);
+  EXPECT_TRUE(decision.admitted);
+  EXPECT_EQ(decision.evicted, 1);
+}
+
+} // namespace ddprof
@@ -0,0 +1,127 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include <gtest/gtest.h>
+
+#include "ipc.hpp"
+#include "perf.hpp"
+#include "persistent_worker_state.hpp"
+#include "process_ring_buffers.hpp"
+#include "tsc_clock.hpp"
+
+#include <algorithm>
+#include <unistd.h>
+#include <vector>
+
+namespace ddprof {
+
+namespace {
+constexpr int k_watcher_pos = 1;
+constexpr uint32_t k_stack_sample_size = 4096;
+constexpr uint64_t k_sampling_interval = 1000;
+// above the maximum pid value allowed by the kernel
+constexpr pid_t k_dead_pid = (1 << 22) + 1000;
+constexpr auto k_order_offsets = ProcessRingBuffers::k_order_offsets;
+
+// shared ring buffer followed by the dedicated ones
+std::vector<PEvent> create_pevents() {
+  std::vector<PEvent> pevents(ProcessRingBuffers::k_nb_ring_buffers + 2);
+  // perf event of another watcher
+  pevents[0].watcher_pos = 0;
+  int fd = 100;
+  for (size_t i = 1; i < pevents.size(); ++i) {
+    PEvent &pevent = pevents[i];
+    pevent.watcher_pos = k_watcher_pos;
+    pevent.custom_event = true;
+    pevent.fd = fd++;
+    pevent.mapfd = fd++;
+    int const offset = i == 1 ? 0 : k_order_offsets[i - 2];
+    pevent.ring_buffer_size =
+        perf_mmap_size(k_mpsc_buffer_size_shift + offset);
+  }
+  return pevents;
+}
+} // namespace
+
+TEST(ProcessRingBuffers, assign) {
+  TscClock::init();
+  PerfClock::init();
+  std::vector<PEvent> const pevents = create_pevents();
+  PersistentWorkerState state{};
+  ProcessRingBuffers ring_buffers{pevents, k_watcher_pos, k_stack_sample_size,
+                                  k_sampling_interval, state};
+
+  // unknown allocation rate gets the smallest ring buffer
+  RingBufferInfo info;
+  uint64_t const id = ring_buffers.assign(1234, 0, info);
+  ASSERT_NE(id, 0);
+  EXPECT_EQ(info.mem_size,
+            perf_mmap_size(k_mpsc_buffer_size_shift +
+                           std::ranges::min(k_order_offsets)));
+  EXPECT_NE(info.ring_fd, pevents[1].mapfd);
+  EXPECT_EQ(ring_buffers.nb_assigned(), 1);
+
+  // high allocation rate gets the largest one
+  RingBufferInfo large_info;
+  ASSERT_NE(ring_buffers.assign(1235, 1UL << 40, large_info), 0);
+  EXPECT_EQ(large_info.mem_size,
+            perf_mmap_size(k_mpsc_buffer_size_shift +
+                           std::ranges::max(k_order_offsets)));
+
+  // reconnection of the same pid (exec) replaces its ring buffer
+  RingBufferInfo exec_info;
+  uint64_t const exec_id = ring_buffers.assign(1234, 0, exec_info);
+  EXPECT_NE(exec_id, id);
+  EXPECT_EQ(ring_buffers.nb_assigned(), 2);
+  // stale release is ignored
+  ring_buffers.release(id);
+  EXPECT_EQ(ring_buffers.nb_assigned(), 2);
+  ring_buffers.release(exec_id);
+  EXPECT_EQ(ring_buffers.nb_assigned(), 1);
+
+  // exit of a process releases its ring buffer, unless the exit happened
+  // before the assignment (pid reuse)
+  ring_buffers.release_pid(1235, PerfClock::time_point{});
+  EXPECT_EQ(ring_buffers.nb_assigned(), 1);
+  ring_buffers.release_pid(1235, PerfClock::now());
+  EXPECT_EQ(ring_buffers.nb_assigned(), 0);
+}
+
+TEST(ProcessRingBuffers, exhaustion) {
+  std::vector<PEvent> const pevents = create_pevents();
+  PersistentWorkerState state{};
+  ProcessRingBuffers ring_buffers{pevents, k_watcher_pos, k_stack_sample_size,
+                                  k_sampling_interval, state};
+  for (size_t i = 0; i < ProcessRingBuffers::k_nb_ring_buffers; ++i) {
+    RingBufferInfo info;
+    pid_t const pid = static_cast<pid_t>(k_dead_pid + i);
+    EXPECT_NE(ring_buffers.assign(pid, 0, info), 0);
+  }
+  // fall back to the shared ring buffer
+  RingBufferInfo info;
+  EXPECT_EQ(ring_buffers.assign(k_dead_pid - 1, 0, info), 0);
+  EXPECT_EQ(info.mem_size, -1);
+
+  // assignments are kept across workers, lost events are tracked per process
+  EXPECT_EQ(ring_buffers.add_lost_events(k_dead_pid + 3, 12), 12);
+  EXPECT_EQ(ring_buffers.add_lost_events(k_dead_pid + 3, 3), 15);
+  EXPECT_EQ(ring_buffers.add_lost_events(k_dead_pid - 1, 12), 0);
+  ProcessRingBuffers next_worker{pevents, k_watcher_pos, k_stack_sample_size,
+                                 k_sampling_interval, state};
+  EXPECT_EQ(next_worker.nb_assigned(), ProcessRingBuffers::k_nb_ring_buffers);
+  const auto *slot = std::ranges::find_if(
+      state.dedicated_ring_buffers,
+      [](const auto &el) { return el.pid == k_dead_pid + 3; });
+  ASSERT_NE(slot, std::end(state.dedicated_ring_buffers));
+  EXPECT_EQ(slot->nb_lost, 15);
+  next_worker.release_dead_processes();
+  EXPECT_EQ(next_worker.nb_assigned(), 0);
+
+  EXPECT_NE(next_worker.assign(getpid(), 0, info), 0);
+  next_worker.release_dead_processes();
+  EXPECT_EQ(next_worker.nb_assigned(), 1);
+}
+
+} // namespace ddprof
@@ -0,0 +1,57 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include <gtest/gtest.h>
+
+#include "ring_buffer_sizer.hpp"
+
+#include <array>
+
+namespace ddprof {
+
+TEST(ring_buffer_sizer, grow_and_shrink) {
+  std::array<RingBufferOrder, 4> const orders{
+      {{6, 6}, {7, 6}, {6, 6}, {8, 6}}};
+  std::array<RingBufferUsage, 4> const usage{{
+      {0.9, true},   // overflowing: grows
+      {0.05, false}, // idle: shrinks
+      {0.05, false}, // idle but already at minimum size
+      {0.5, true},   // lost events, but not close to overflow
+  }};
+  std::array<int, 4> next{};
+  EXPECT_TRUE(ring_buffer_next_orders(orders, usage, 10000, next));
+  EXPECT_EQ(next, (std::array<int, 4>{7, 6, 6, 8}));
+
+  // nothing to grow
+  std::array<RingBufferUsage, 4> const quiet{};
+  EXPECT_FALSE(ring_buffer_next_orders(orders, quiet, 10000, next));
+  EXPECT_EQ(next, (std::array<int, 4>{6, 6, 6, 7}));
+}
+
+TEST(ring_buffer_sizer, budget) {
+  std::array<RingBufferOrder, 3> const orders{{{6, 6}, {6, 6}, {6, 6}}};
+  std::array<RingBufferUsage, 3> const usage{
+      {{0.8, true}, {1.0, true}, {0.9, true}}};
+  std::array<int, 3> next{};
+  // room to grow a single ring buffer: the fullest one
+  size_t const budget = 3 * ring_buffer_pages(6) + 64;
+  EXPECT_TRUE(ring_buffer_next_orders(orders, usage, budget, next));
+  EXPECT_EQ(next, (std::array<int, 3>{6, 7, 6}));
+
+  // no room at all
+  EXPECT_FALSE(ring_buffer_next_orders(orders, usage, 3 * 65, next));
+  EXPECT_EQ(next, (std::array<int, 3>{6, 6, 6}));
+}
+
+TEST(ring_buffer_sizer, max_order) {
+  std::array<RingBufferOrder, 1> const orders{
+      {{6 + k_max_ring_buffer_order_increase, 6}}};
+  std::array<RingBufferUsage, 1> const usage{{{1.0, true}}};
+  std::array<int, 1> next{};
+  EXPECT_FALSE(ring_buffer_next_orders(orders, usage, 1 << 20, next));
+  EXPECT_EQ(next[0], 6 + k_max_ring_buffer_order_increase);
+}
+
+} // namespace ddprof
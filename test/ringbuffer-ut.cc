@@ -255,6 +255,66 @@ TEST(ringbuffer, perf_reader_wrap_copy) {
   rb_free(&rb);
 }
 
+TEST(ringbuffer, perf_backward_snapshot) {
+  constexpr int kBufSizeOrder = 0;
+  size_t const buffer_size = perf_mmap_size(kBufSizeOrder);
+  void *raw = nullptr;
+  ASSERT_EQ(posix_memalign(&raw, get_page_size(), buffer_size), 0);
+  auto free_mem = std::unique_ptr<void, decltype(&std::free)>(raw, &std::free);
+  memset(raw, 0, buffer_size);
+
+  RingBuffer rb{};
+  ASSERT_TRUE(
+      rb_init(&rb, raw, buffer_size, RingBufferType::kPerfRingBuffer, false));
+  auto *meta = reinterpret_cast<perf_event_mmap_page *>(raw);
+
+  // write records backward, the way the kernel does with write_backward
+  auto write_backward = [&](int64_t i, uint16_t size) {
+    meta->data_head -= size;
+    std::vector<std::byte> record(size);
+    MyElement const elem{.hdr = {.type = 3, .misc = 5, .size = size},
+                         .x = i,
+                         .y = 2 * i,
+                         .z = 3 * i};
+    memcpy(record.data(), &elem, sizeof(MyElement));
+    for (size_t k = 0; k < size; ++k) {
+      rb.data[(meta->data_head + k) & rb.mask] = record[k];
+    }
+  };
+  auto element_at = [&](const std::vector<std::byte> &snapshot,
+                        size_t offset) {
+    return reinterpret_cast<const MyElement *>(snapshot.data() + offset);
+  };
+
+  std::vector<std::byte> snapshot;
+  EXPECT_TRUE(perf_rb_backward_snapshot(rb, snapshot).empty());
+
+  for (int64_t i = 0; i < 3; ++i) {
+    write_backward(i, sizeof(MyElement));
+  }
+  auto offsets = perf_rb_backward_snapshot(rb, snapshot);
+  ASSERT_EQ(offsets.size(), 3);
+  for (size_t i = 0; i < offsets.size(); ++i) {
+    EXPECT_EQ(element_at(snapshot, offsets[i])->x, i);
+    EXPECT_EQ(element_at(snapshot, offsets[i])->z, 3 * i);
+  }
+
+  // a larger record whose end gets overwritten once the buffer wraps around
+  write_backward(3, 2 * sizeof(MyElement));
+  size_t const nb_kept = (rb.data_size / sizeof(MyElement)) - 1;
+  for (size_t i = 0; i < nb_kept; ++i) {
+    write_backward(static_cast<int64_t>(i + 4), sizeof(MyElement));
+  }
+  offsets = perf_rb_backward_snapshot(rb, snapshot);
+  ASSERT_EQ(offsets.size(), nb_kept);
+  for (size_t i = 0; i < offsets.size(); ++i) {
+    EXPECT_EQ(element_at(snapshot, offsets[i])->hdr.size, sizeof(MyElement));
+    EXPECT_EQ(element_at(snapshot, offsets[i])->x, i + 4);
+    EXPECT_EQ(element_at(snapshot, offsets[i])->y, 2 * (i + 4));
+  }
+  rb_free(&rb);
+}
+
 void mpsc_reader_fun(RingBuffer *rb, size_t nb_elements, size_t nb_producers,
                      bool use_new_object, bool advance_eagerly) {
   std::optional<MPSCRingBufferReader> reader(rb);
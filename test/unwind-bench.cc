@@ -0,0 +1,71 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include <benchmark/benchmark.h>
+
+#include "ddprof_base.hpp"
+#include "perf.hpp"
+#include "savecontext.hpp"
+#include "unwind.hpp"
+#include "unwind_state.hpp"
+
+#include <unistd.h>
+
+namespace ddprof {
+
+namespace {
+// same stack shape as test/deep_stacks
+constexpr size_t k_work_amount = 3000;
+constexpr size_t k_work_amount_decrease_per_call = 100;
+constexpr size_t k_stack_sample_size = 65528;
+
+std::byte stack[k_stack_sample_size];
+uint64_t regs[k_nb_registers_to_unwind];
+size_t stack_size;
+
+template <int N> DDPROF_NOINLINE void deep_stack() {
+  char arr[N];
+  for (int i = 0; i < N; ++i) {
+    arr[i] = static_cast<char>(i);
+  }
+  DoNotOptimize(arr);
+  if constexpr (N > k_work_amount_decrease_per_call) {
+    deep_stack<N - k_work_amount_decrease_per_call>();
+  } else {
+    stack_size = save_context(retrieve_stack_bounds(), regs, stack);
+  }
+  DDPROF_BLOCK_TAIL_CALL_OPTIMIZATION();
+}
+
+void unwind_deep_stack(benchmark::State &state, bool use_cfi_tables) {
+  deep_stack<k_work_amount>();
+  UnwindState us = create_unwind_state().value();
+  us.use_cfi_tables = use_cfi_tables;
+  size_t nb_frames = 0;
+  for (auto _ : state) {
+    // measure unwinding, not the cache of unwinding results
+    us.unwind_cache.clear();
+    unwind_init_sample(&us, regs, getpid(), stack_size,
+                       reinterpret_cast<char *>(stack));
+    unwindstate_unwind(&us);
+    nb_frames = us.output.locs.size();
+  }
+  state.counters["frames"] = static_cast<double>(nb_frames);
+}
+} // namespace
+
+static void BM_UnwindLibdw(benchmark::State &state) {
+  unwind_deep_stack(state, false);
+}
+
+BENCHMARK(BM_UnwindLibdw);
+
+static void BM_UnwindCfiTables(benchmark::State &state) {
+  unwind_deep_stack(state, true);
+}
+
+BENCHMARK(BM_UnwindCfiTables);
+
+} // namespace ddprof
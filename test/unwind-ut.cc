@@ -0,0 +1,95 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include <gtest/gtest.h>
+
+#include "ddprof_base.hpp"
+#include "loghandle.hpp"
+#include "savecontext.hpp"
+#include "unwind.hpp"
+#include "unwind_state.hpp"
+
+#include <algorithm>
+#include <unistd.h>
+#include <vector>
+
+namespace ddprof {
+
+namespace {
+std::byte stack[k_default_perf_stack_sample_size];
+uint64_t regs[k_nb_registers_to_unwind];
+size_t stack_size;
+
+template <int N> DDPROF_NOINLINE void recurse() {
+  if constexpr (N == 0) {
+    stack_size = save_context(retrieve_stack_bounds(), regs, stack);
+  } else {
+    recurse<N - 1>();
+  }
+  DDPROF_BLOCK_TAIL_CALL_OPTIMIZATION();
+}
+
+size_t unwind(UnwindState &state) {
+  unwind_init_sample(&state, regs, getpid(), stack_size,
+                     reinterpret_cast<char *>(stack));
+  unwindstate_unwind(&state);
+  return state.output.locs.size();
+}
+} // namespace
+
+TEST(Unwind, exit_grace_window) {
+  LogHandle handle;
+  recurse<5>();
+  UnwindState state = create_unwind_state().value();
+  pid_t const pid = getpid();
+  EXPECT_GT(unwind(state), 5);
+  ASSERT_NE(state.process_hdr.find(pid), nullptr);
+  EXPECT_GT(state.dso_hdr.get_nb_dso(), 0);
+  EXPECT_FALSE(state.cfi_tables.empty());
+
+  const PerfClock::time_point exit_time = PerfClock::now();
+  constexpr auto k_grace_window = ProcessHdr::k_exit_grace_window;
+  state.process_hdr.flag_exited(pid, exit_time);
+  // samples still in flight are unwound during the grace window
+  EXPECT_TRUE(
+      unwind_take_exited_pids(&state, exit_time + k_grace_window / 2).empty());
+  EXPECT_GT(unwind(state), 5);
+
+  std::vector<pid_t> const exited =
+      unwind_take_exited_pids(&state, exit_time + (2 * k_grace_window));
+  ASSERT_EQ(exited.size(), 1);
+  EXPECT_EQ(exited[0], pid);
+  unwind_pid_free(&state, pid);
+  EXPECT_EQ(state.process_hdr.find(pid), nullptr);
+  EXPECT_EQ(state.process_hdr.exited_count(), 0);
+  EXPECT_EQ(state.dso_hdr.get_nb_dso(), 0);
+  // no other process uses the tables
+  EXPECT_TRUE(state.cfi_tables.empty());
+  EXPECT_EQ(state.nb_cfi_rows, 0);
+}
+
+TEST(Unwind, short_lived_processes) {
+  LogHandle handle;
+  UnwindState state = create_unwind_state().value();
+  const PerfClock::time_point t0{std::chrono::seconds{10}};
+  constexpr auto k_lifetime = std::chrono::milliseconds{10};
+  // many short-lived processes, freed as the time goes by
+  constexpr int k_nb_processes = 10000;
+  size_t max_count = 0;
+  for (int i = 0; i < k_nb_processes; ++i) {
+    pid_t const pid = 1000 + i;
+    auto const now = t0 + i * k_lifetime;
+    state.process_hdr.get(pid).set_thread_name(pid, "short", now);
+    state.process_hdr.flag_exited(pid, now + k_lifetime);
+    for (pid_t const el : unwind_take_exited_pids(&state, now)) {
+      EXPECT_LT(el, pid);
+      unwind_pid_free(&state, el);
+    }
+    max_count = std::max<size_t>(max_count, state.process_hdr.process_count());
+  }
+  EXPECT_LE(max_count, ProcessHdr::k_exit_grace_window / k_lifetime + 2);
+}
+
+} // namespace ddprof
@@ -0,0 +1,101 @@
+// Unless explicitly stated otherwise all files in this repository are licensed
+// under the Apache License Version 2.0. This product includes software
+// developed at Datadog (https://www.datadoghq.com/). Copyright 2021-Present
+// Datadog, Inc.
+
+#include <gtest/gtest.h>
+
+#include "unwind_cache.hpp"
+
+#include <cstring>
+#include <utility>
+
+namespace ddprof {
+
+namespace {
+constexpr pid_t kPid = 1234;
+
+struct FakeSample {
+  std::array<uint64_t, k_perf_register_count> regs{};
+  std::array<uint64_t, 16> stack{};
+
+  FakeSample() {
+    regs[REGNAME(PC)] = 0x1000;
+    regs[REGNAME(SP)] = 0x7ff0000;
+    for (size_t i = 0; i < stack.size(); ++i) {
+      stack[i] = 0xcafe0000 + i;
+    }
+  }
+  [[nodiscard]] std::span<const std::byte> stack_bytes() const {
+    return std::as_bytes(std::span{stack});
+  }
+};
+
+std::vector<FunLoc> make_locs() {
+  std::vector<FunLoc> locs(2);
+  locs[0].ip = 0x1000;
+  locs[1].ip = 0x2000;
+  return locs;
+}
+} // namespace
+
+TEST(unwind_cache, hit_when_read_words_match) {
+  UnwindCache cache;
+  FakeSample sample;
+  const std::vector<uint32_t> offsets{0, 24};
+  cache.insert(kPid, sample.regs, sample.stack_bytes(), offsets, make_locs());
+
+  // words that were not read by the unwind can change
+  sample.stack[1] = 42;
+  // so can registers that are not part of the key
+  sample.regs[0] = 42;
+  const auto *locs = cache.find(kPid, sample.regs, sample.stack_bytes());
+  ASSERT_NE(locs, nullptr);
+  EXPECT_EQ(*locs, make_locs());
+  EXPECT_EQ(cache.hit_count(), 1);
+}
+
+TEST(unwind_cache, miss_when_read_words_differ) {
+  UnwindCache cache;
+  FakeSample sample;
+  const std::vector<uint32_t> offsets{0, 24};
+  cache.insert(kPid, sample.regs, sample.stack_bytes(), offsets, make_locs());
+
+  sample.stack[3] = 42;
+  EXPECT_EQ(cache.find(kPid, sample.regs, sample.stack_bytes()), nullptr);
+}
+
+TEST(unwind_cache, miss_when_read_words_are_swapped) {
+  UnwindCache cache;
+  FakeSample sample;
+  const std::vector<uint32_t> offsets{0, 24};
+  cache.insert(kPid, sample.regs, sample.stack_bytes(), offsets, make_locs());
+
+  // words are compared one by one, not through a digest of their values
+  std::swap(sample.stack[0], sample.stack[3]);
+  EXPECT_EQ(cache.find(kPid, sample.regs, sample.stack_bytes()), nullptr);
+}
+
+TEST(unwind_cache, miss_when_key_differs) {
+  UnwindCache cache;
+  FakeSample sample;
+  const std::vector<uint32_t> offsets{0};
+  cache.insert(kPid, sample.regs, sample.stack_bytes(), offsets, make_locs());
+
+  EXPECT_EQ(cache.find(kPid + 1, sample.regs, sample.stack_bytes()), nullptr);
+  EXPECT_EQ(cache.find(kPid, sample.regs, sample.stack_bytes().first(64)),
+            nullptr);
+  sample.regs[REGNAME(SP)] += 8;
+  EXPECT_EQ(cache.find(kPid, sample.regs, sample.stack_bytes()), nullptr);
+}
+
+TEST(unwind_cache, clear) {
+  UnwindCache cache;
+  FakeSample sample;
+  const std::vector<uint32_t> offsets{0};
+  cache.insert(kPid, sample.regs, sample.stack_bytes(), offsets, make_locs());
+  cache.clear(kPid);
+  EXPECT_EQ(cache.find(kPid, sample.regs, sample.stack_bytes()), nullptr);
+}
+
+} // namespace ddprof